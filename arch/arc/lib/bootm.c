@@ -34,7 +34,8 @@ void arch_lmb_reserve(struct lmb *lmb)
 
 	/* adjust sp by 4K to be safe */
 	sp -= 4096;
-	lmb_reserve(lmb, sp, (CONFIG_SYS_SDRAM_BASE + gd->ram_size - sp));
+	lmb_reserve_named(lmb, sp, (CONFIG_SYS_SDRAM_BASE + gd->ram_size - sp),
+			  "u-boot");
 }
 
 static int cleanup_before_linux(void)
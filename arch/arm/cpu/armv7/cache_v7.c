@@ -250,6 +250,21 @@ void flush_dcache_all(void)
 	v7_outer_cache_flush_all();
 }
 
+/*
+ * Invalidate and clean & invalidate only the level 1 data cache of the
+ * calling CPU, for secondary CPUs joining and leaving the coherency
+ * domain while the boot CPU's caches stay live
+ */
+void invalidate_l1_dcache(void)
+{
+	v7_maint_dcache_level_setway(0, ARMV7_DCACHE_INVAL_ALL);
+}
+
+void flush_l1_dcache(void)
+{
+	v7_maint_dcache_level_setway(0, ARMV7_DCACHE_CLEAN_INVAL_ALL);
+}
+
 /*
  * Invalidates range in all levels of D-cache/unified cache used:
  * Affects the range [start, stop - 1]
@@ -304,6 +319,14 @@ void flush_dcache_all(void)
 {
 }
 
+void invalidate_l1_dcache(void)
+{
+}
+
+void flush_l1_dcache(void)
+{
+}
+
 void invalidate_dcache_range(unsigned long start, unsigned long stop)
 {
 }
@@ -0,0 +1,221 @@
+/*
+ * Secondary CPUs running work for the boot CPU, see common/cpu_work.c
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <cpu_work.h>
+#include <asm/armv7.h>
+#include <asm/cache.h>
+#include <asm/io.h>
+#include <asm/system.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define ACTLR_SMP	(1 << 6)
+#define ACTLR_FW	(1 << 0)	/* Cortex-A5/A9: broadcast maintenance */
+#define SCU_CTRL_EN	(1 << 0)
+#define SCU_INV_ALL	0xffff		/* tag RAMs of all four CPUs */
+#define CPACR_VFP	(0xf << 20)	/* full access to cp10 and cp11 */
+#define FPEXC_EN	(1 << 30)
+
+/* Set by a secondary CPU once it has left, see arch_cpu_work_stop() */
+static struct {
+	volatile u32 parked;
+} __aligned(ARCH_DMA_MINALIGN) cpu_work_park[CONFIG_CPU_WORK_CPUS];
+
+static inline u32 get_actlr(void)
+{
+	u32 val;
+
+	asm volatile("mrc p15, 0, %0, c1, c0, 1" : "=r" (val));
+	return val;
+}
+
+static inline void set_actlr(u32 val)
+{
+	asm volatile("mcr p15, 0, %0, c1, c0, 1" : : "r" (val));
+	CP15ISB;
+}
+
+/* Snoop control unit of a Cortex-A5/A9 cluster */
+struct scu_regs {
+	u32 ctrl;
+	u32 config;
+	u32 status;
+	u32 invalidate;
+};
+
+/* What arch_cpu_work_init() changed, for arch_cpu_work_exit() to undo */
+static struct scu_regs *cpu_work_scu;
+static u32 cpu_work_actlr;
+
+/* ACTLR bits that make a CPU take part in coherency */
+static u32 cpu_work_smp_bits(void)
+{
+	u32 part;
+
+	asm volatile("mrc p15, 0, %0, c0, c0, 0" : "=r" (part));
+	part = (part >> 4) & 0xfff;
+	if (part == 0xc05 || part == 0xc09)
+		return ACTLR_SMP | ACTLR_FW;
+
+	return ACTLR_SMP;
+}
+
+/*
+ * Change ACTLR on the boot CPU, whose caches are on. The SMP bit must not
+ * change under a live L1, so clean it and run uncached meanwhile.
+ */
+static void cpu_work_set_actlr(u32 val)
+{
+	flush_dcache_all();
+	set_cr(get_cr() & ~CR_C);
+	flush_l1_dcache();
+	set_actlr(val);
+	set_cr(get_cr() | CR_C);
+}
+
+/*
+ * Make the boot CPU's L1 coherent with the secondary CPUs: turn on the
+ * SCU if the cluster has one, then take part in coherency.
+ */
+int arch_cpu_work_init(void)
+{
+	struct scu_regs *scu;
+	u32 smp = cpu_work_smp_bits();
+
+	cpu_work_scu = NULL;
+	if (smp & ACTLR_FW) {
+		/* PERIPHBASE, where the SCU registers start */
+		asm volatile("mrc p15, 4, %0, c15, c0, 0" : "=r" (scu));
+		scu = (struct scu_regs *)((ulong)scu & ~0x1fffUL);
+		if (!(readl(&scu->ctrl) & SCU_CTRL_EN)) {
+			writel(SCU_INV_ALL, &scu->invalidate);
+			setbits_le32(&scu->ctrl, SCU_CTRL_EN);
+			cpu_work_scu = scu;
+		}
+	}
+
+	cpu_work_actlr = get_actlr();
+	if ((cpu_work_actlr & smp) != smp)
+		cpu_work_set_actlr(cpu_work_actlr | smp);
+
+	return 0;
+}
+
+/* Undo arch_cpu_work_init() once the secondary CPUs are off */
+void arch_cpu_work_exit(void)
+{
+	if (get_actlr() != cpu_work_actlr)
+		cpu_work_set_actlr(cpu_work_actlr);
+	if (cpu_work_scu) {
+		clrbits_le32(&cpu_work_scu->ctrl, SCU_CTRL_EN);
+		cpu_work_scu = NULL;
+	}
+}
+
+static inline u32 get_cpacr(void)
+{
+	u32 val;
+
+	asm volatile("mrc p15, 0, %0, c1, c0, 2" : "=r" (val));
+	return val;
+}
+
+static inline void set_cpacr(u32 val)
+{
+	asm volatile("mcr p15, 0, %0, c1, c0, 2" : : "r" (val));
+	CP15ISB;
+}
+
+/* FPEXC, written with the cp10 form so that no FPU option is needed */
+static inline void set_fpexc(u32 val)
+{
+	asm volatile("mcr p10, 7, %0, cr8, cr0, 0" : : "r" (val));
+}
+
+/*
+ * Turn on VFP/NEON, if the CPU has it, the way the boot CPU runs.
+ * Returns the old CPACR, to turn it off again.
+ */
+static u32 cpu_work_vfp_on(void)
+{
+	u32 cpacr = get_cpacr();
+
+	set_cpacr(cpacr | CPACR_VFP);
+	/* Access bits stay clear without VFP */
+	if ((get_cpacr() & CPACR_VFP) == CPACR_VFP)
+		set_fpexc(FPEXC_EN);
+
+	return cpacr;
+}
+
+static void cpu_work_vfp_off(u32 cpacr)
+{
+	if ((get_cpacr() & CPACR_VFP) == CPACR_VFP)
+		set_fpexc(0);
+	set_cpacr(cpacr);
+}
+
+void arch_cpu_work_secondary(int cpu)
+{
+	u32 cpacr;
+
+	/* Join the boot CPU's coherency domain with an empty L1 */
+	invalidate_l1_dcache();
+	invalidate_icache_all();
+	set_actlr(get_actlr() | cpu_work_smp_bits());
+
+	/* Share its page table, set up by mmu_setup() */
+	asm volatile("mcr p15, 0, %0, c2, c0, 0"
+		     : : "r" (gd->arch.tlb_addr) : "memory");
+	asm volatile("mcr p15, 0, %0, c3, c0, 0" : : "r" (~0));
+	arm_init_domains();
+	asm volatile("mcr p15, 0, %0, c8, c7, 0" : : "r" (0));
+	CP15DSB;
+	CP15ISB;
+	set_cr(get_cr() | CR_M | CR_C | CR_I);
+	cpacr = cpu_work_vfp_on();
+
+	cpu_work_secondary(cpu);
+
+	/* Leave again, with nothing left behind in L1 */
+	cpu_work_vfp_off(cpacr);
+	set_cr(get_cr() & ~CR_C);
+	flush_l1_dcache();
+	set_actlr(get_actlr() & ~cpu_work_smp_bits());
+
+	/* With the cache off, this goes straight to memory */
+	cpu_work_park[cpu].parked = 1;
+	CP15DSB;
+}
+
+/*
+ * Wait for the CPU to say it has left the coherency domain, so that none
+ * of its cache is lost when it is turned off
+ */
+void arch_cpu_work_stop(int cpu)
+{
+	ulong start = (ulong)&cpu_work_park[cpu];
+	ulong end = start + sizeof(cpu_work_park[cpu]);
+	ulong timer = get_timer(0);
+
+	for (;;) {
+		/* Drop any stale copy of the flag and read it from memory */
+		invalidate_dcache_range(start, end);
+		if (cpu_work_park[cpu].parked)
+			break;
+		if (get_timer(timer) > 1000) {
+			printf("CPU %d did not stop, turning it off\n", cpu);
+			break;
+		}
+	}
+	cpu_work_park[cpu].parked = 0;
+	flush_dcache_range(start, end);
+
+#ifdef CONFIG_MP
+	cpu_disable(cpu);
+#endif
+}
@@ -75,6 +75,8 @@ void v7_outer_cache_flush_all(void);
 void v7_outer_cache_inval_all(void);
 void v7_outer_cache_flush_range(u32 start, u32 end);
 void v7_outer_cache_inval_range(u32 start, u32 end);
+void invalidate_l1_dcache(void);
+void flush_l1_dcache(void);
 
 #if defined(CONFIG_ARMV7_NONSEC) || defined(CONFIG_ARMV7_VIRT)
 
@@ -59,8 +59,9 @@ void arch_lmb_reserve(struct lmb *lmb)
 
 	/* adjust sp by 4K to be safe */
 	sp -= 4096;
-	lmb_reserve(lmb, sp,
-		    gd->bd->bi_dram[0].start + gd->bd->bi_dram[0].size - sp);
+	lmb_reserve_named(lmb, sp,
+			  gd->bd->bi_dram[0].start + gd->bd->bi_dram[0].size - sp,
+			  "u-boot");
 }
 
 /**
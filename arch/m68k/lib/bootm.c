@@ -45,7 +45,8 @@ void arch_lmb_reserve(struct lmb *lmb)
 
 	/* adjust sp by 1K to be safe */
 	sp -= 1024;
-	lmb_reserve(lmb, sp, (CONFIG_SYS_SDRAM_BASE + gd->ram_size - sp));
+	lmb_reserve_named(lmb, sp, (CONFIG_SYS_SDRAM_BASE + gd->ram_size - sp),
+			  "u-boot");
 }
 
 int do_bootm_linux(int flag, int argc, char * const argv[], bootm_headers_t *images)
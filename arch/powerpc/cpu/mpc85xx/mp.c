@@ -408,7 +408,7 @@ void cpu_mp_lmb_reserve(struct lmb *lmb)
 {
 	u32 bootpg = determine_mp_bootpg(NULL);
 
-	lmb_reserve(lmb, bootpg, 4096);
+	lmb_reserve_named(lmb, bootpg, 4096, "mp-bootpg");
 }
 
 void setup_mp(void)
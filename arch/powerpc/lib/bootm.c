@@ -148,7 +148,8 @@ void arch_lmb_reserve(struct lmb *lmb)
 
 	/* adjust sp by 4K to be safe */
 	sp -= 4096;
-	lmb_reserve(lmb, sp, (CONFIG_SYS_SDRAM_BASE + get_effective_memsize() - sp));
+	lmb_reserve_named(lmb, sp, (CONFIG_SYS_SDRAM_BASE +
+			  get_effective_memsize() - sp), "u-boot");
 
 #ifdef CONFIG_MP
 	cpu_mp_lmb_reserve(lmb);
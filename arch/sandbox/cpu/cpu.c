@@ -4,6 +4,7 @@
  */
 
 #include <common.h>
+#include <cpu_work.h>
 #include <dm/root.h>
 #include <os.h>
 #include <asm/state.h>
@@ -29,6 +30,19 @@ int do_reset(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	return 0;
 }
 
+#ifdef CONFIG_CPU_WORK
+/* Secondary CPUs are host threads */
+int arch_cpu_work_release(int cpu)
+{
+	return os_thread_create(cpu_work_secondary, cpu);
+}
+
+void arch_cpu_work_idle(void)
+{
+	os_thread_yield();
+}
+#endif
+
 /* delay x useconds */
 void __udelay(unsigned long usec)
 {
@@ -7,6 +7,8 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -535,3 +537,44 @@ int os_jump_to_image(const void *dest, int size)
 
 	return unlink(fname);
 }
+
+struct os_thread {
+	void (*func)(int arg);
+	int arg;
+};
+
+static void *os_thread_main(void *data)
+{
+	struct os_thread thread = *(struct os_thread *)data;
+
+	os_free(data);
+	thread.func(thread.arg);
+
+	return NULL;
+}
+
+int os_thread_create(void (*func)(int arg), int arg)
+{
+	struct os_thread *thread;
+	pthread_t id;
+
+	/* U-Boot's malloc() is not safe to call from another thread */
+	thread = os_malloc(sizeof(*thread));
+	if (!thread)
+		return -ENOMEM;
+	thread->func = func;
+	thread->arg = arg;
+
+	if (pthread_create(&id, NULL, os_thread_main, thread)) {
+		os_free(thread);
+		return -EAGAIN;
+	}
+	pthread_detach(id);
+
+	return 0;
+}
+
+void os_thread_yield(void)
+{
+	sched_yield();
+}
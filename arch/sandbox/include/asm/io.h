@@ -40,6 +40,9 @@ static inline void unmap_sysmem(const void *vaddr)
 /* Map from a pointer to our RAM buffer */
 phys_addr_t map_to_sysmem(const void *ptr);
 
+/* Host threads stand in for secondary CPUs, see cpu_work.c */
+#define mb()	__sync_synchronize()
+
 /* Define nops for sandbox I/O access */
 #define readb(addr) 0
 #define readw(addr) 0
@@ -72,7 +72,8 @@ void arch_lmb_reserve(struct lmb *lmb)
 	 * to avoid that the RAM image is copied over stack or
 	 * PROM.
 	 */
-	lmb_reserve(lmb, CONFIG_SYS_RELOC_MONITOR_BASE, CONFIG_SYS_RAM_END);
+	lmb_reserve_named(lmb, CONFIG_SYS_RELOC_MONITOR_BASE, CONFIG_SYS_RAM_END,
+			  "u-boot");
 }
 
 /* boot the linux kernel */
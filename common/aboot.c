@@ -37,6 +37,7 @@
 #include <config.h>
 #include <common.h>
 #include <aboot.h>
+#include <errno.h>
 #include <malloc.h>
 #include <part.h>
 #include <sparse_format.h>
@@ -241,3 +242,432 @@ void write_sparse_image(block_dev_desc_t *dev_desc,
 	fastboot_okay("");
 	return;
 }
+
+#ifdef CONFIG_FASTBOOT_STREAM
+#ifndef CONFIG_FASTBOOT_STREAM_BATCH
+#define CONFIG_FASTBOOT_STREAM_BATCH	(1 << 20)
+#endif
+#ifndef CONFIG_FASTBOOT_STREAM_WRITE_STEP
+#define CONFIG_FASTBOOT_STREAM_WRITE_STEP	(128 << 10)
+#endif
+
+enum {
+	STREAM_FILE_HDR,	/* gathering the sparse header */
+	STREAM_CHUNK_HDR,	/* gathering a chunk header */
+	STREAM_FILL,		/* gathering the value of a FILL chunk */
+	STREAM_RAW,		/* copying data into the batch */
+	STREAM_DONE,		/* anything more is ignored */
+};
+
+static void sparse_stream_fail(struct sparse_stream *ss, const char *s)
+{
+	fastboot_fail(s);
+	ss->error = 1;
+	/* Nothing more is written */
+	ss->count = 0;
+	ss->fill_left = 0;
+}
+
+/* Check that @blkcnt more blocks after those already batched fit */
+static int sparse_stream_fits(struct sparse_stream *ss, lbaint_t blkcnt)
+{
+	lbaint_t blk = ss->blk + ss->batch_len / ss->info.blksz;
+
+	if (blk + blkcnt > ss->info.start + ss->info.size) {
+		printf("%s: Request would exceed partition size!\n", __func__);
+		sparse_stream_fail(ss, "Request would exceed partition size!");
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Queue the batch being filled for writing, padding the last block of a
+ * raw image with zeroes, and start filling the next one. The caller makes
+ * sure that there is a free batch.
+ */
+static void sparse_stream_queue(struct sparse_stream *ss)
+{
+	unsigned int len = ROUNDUP(ss->batch_len, ss->info.blksz);
+	int n = (ss->head + ss->count) % STREAM_BATCHES;
+
+	if (!len)
+		return;
+
+	memset(ss->batch[n] + ss->batch_len, '\0', len - ss->batch_len);
+	ss->batch_blk[n] = ss->blk;
+	ss->batch_blkcnt[n] = len / ss->info.blksz;
+	ss->count++;
+	ss->blk += ss->batch_blkcnt[n];
+	ss->batch_len = 0;
+}
+
+static char *sparse_stream_filling(struct sparse_stream *ss)
+{
+	return ss->batch[(ss->head + ss->count) % STREAM_BATCHES];
+}
+
+static int sparse_stream_write_blocks(struct sparse_stream *ss, lbaint_t blk,
+				      lbaint_t blkcnt, const void *buf)
+{
+	lbaint_t blks;
+
+	blks = ss->dev_desc->block_write(ss->dev_desc->dev, blk, blkcnt, buf);
+	if (blks != blkcnt) {
+		printf("%s: Write failed, block # " LBAFU "\n", __func__, blk);
+		sparse_stream_fail(ss, "flash write failure");
+		return -1;
+	}
+	ss->bytes_written += blkcnt * ss->info.blksz;
+
+	return 0;
+}
+
+static void sparse_stream_next_chunk(struct sparse_stream *ss)
+{
+	if (ss->sparse && ss->chunk < ss->sparse_header.total_chunks)
+		ss->state = STREAM_CHUNK_HDR;
+	else
+		ss->state = STREAM_DONE;
+}
+
+/* Not a sparse image: write the whole download as it arrives */
+static void sparse_stream_raw(struct sparse_stream *ss)
+{
+	lbaint_t blkcnt = DIV_ROUND_UP(ss->size, ss->info.blksz);
+
+	if (blkcnt > ss->info.size) {
+		error("too large for partition: '%s'\n", ss->part_name);
+		sparse_stream_fail(ss, "too large for partition");
+		return;
+	}
+
+	puts("Flashing Raw Image\n");
+
+	/* The bytes taken for a sparse header are the start of the image */
+	memcpy(sparse_stream_filling(ss), ss->hdr, ss->hdr_len);
+	ss->batch_len = ss->hdr_len;
+	ss->chunk_left = ss->size - ss->hdr_len;
+	ss->state = ss->chunk_left ? STREAM_RAW : STREAM_DONE;
+}
+
+static void sparse_stream_file_hdr(struct sparse_stream *ss)
+{
+	sparse_header_t *sparse_header = &ss->sparse_header;
+
+	memcpy(sparse_header, ss->hdr, sizeof(*sparse_header));
+	if (!is_sparse_image(sparse_header)) {
+		sparse_stream_raw(ss);
+		return;
+	}
+
+	/* verify sparse_header->blk_sz is an exact multiple of info->blksz */
+	if (!sparse_header->blk_sz ||
+	    sparse_header->blk_sz & (ss->info.blksz - 1)) {
+		printf("%s: Sparse image block size issue [%u]\n",
+		       __func__, sparse_header->blk_sz);
+		sparse_stream_fail(ss, "sparse image block size issue");
+		return;
+	}
+
+	puts("Flashing Sparse Image\n");
+
+	ss->sparse = 1;
+	if (sparse_header->file_hdr_sz > sizeof(*sparse_header))
+		ss->skip = sparse_header->file_hdr_sz - sizeof(*sparse_header);
+	sparse_stream_next_chunk(ss);
+}
+
+static void sparse_stream_chunk_hdr(struct sparse_stream *ss)
+{
+	sparse_header_t *sparse_header = &ss->sparse_header;
+	chunk_header_t *chunk_header = &ss->chunk_header;
+	u64 chunk_data_sz;
+	lbaint_t blkcnt;
+
+	memcpy(chunk_header, ss->hdr, sizeof(*chunk_header));
+	ss->chunk++;
+	if (sparse_header->chunk_hdr_sz > sizeof(*chunk_header))
+		ss->skip = sparse_header->chunk_hdr_sz - sizeof(*chunk_header);
+
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
+
+	chunk_data_sz = (u64)sparse_header->blk_sz * chunk_header->chunk_sz;
+	blkcnt = chunk_data_sz / ss->info.blksz;
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    sparse_header->chunk_hdr_sz + chunk_data_sz) {
+			sparse_stream_fail(ss,
+				"Bogus chunk size for chunk type Raw");
+			return;
+		}
+		if (!sparse_stream_fits(ss, blkcnt))
+			return;
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->chunk_left = chunk_data_sz;
+		if (ss->chunk_left) {
+			ss->state = STREAM_RAW;
+			return;
+		}
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    sparse_header->chunk_hdr_sz + sizeof(uint32_t)) {
+			sparse_stream_fail(ss,
+				"Bogus chunk size for chunk type FILL");
+			return;
+		}
+		if (!sparse_stream_fits(ss, blkcnt))
+			return;
+		ss->state = STREAM_FILL;
+		return;
+
+	case CHUNK_TYPE_DONT_CARE:
+		/* Leave the blocks as they are, so the batch ends here */
+		sparse_stream_queue(ss);
+		ss->blk += blkcnt;
+		ss->total_blocks += chunk_header->chunk_sz;
+		break;
+
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz != sparse_header->chunk_hdr_sz) {
+			sparse_stream_fail(ss,
+				"Bogus chunk size for chunk type CRC32");
+			return;
+		}
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->skip += chunk_data_sz;
+		break;
+
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		sparse_stream_fail(ss, "Unknown chunk type");
+		return;
+	}
+	sparse_stream_next_chunk(ss);
+}
+
+/*
+ * Set up a FILL chunk to be written by sparse_stream_poll(), from a buffer
+ * of one write step filled once with the value. The caller makes sure that
+ * the last FILL chunk has been written.
+ */
+static void sparse_stream_fill(struct sparse_stream *ss)
+{
+	chunk_header_t *chunk_header = &ss->chunk_header;
+	lbaint_t blkcnt, n;
+	uint32_t fill_val;
+	int i;
+
+	sparse_stream_queue(ss);
+
+	memcpy(&fill_val, ss->hdr, sizeof(fill_val));
+	blkcnt = (u64)ss->sparse_header.blk_sz * chunk_header->chunk_sz /
+		 ss->info.blksz;
+	n = blkcnt < ss->step_blks ? blkcnt : ss->step_blks;
+	for (i = 0; i < n * ss->info.blksz / sizeof(fill_val); i++)
+		ss->fill_buf[i] = fill_val;
+
+	ss->fill_blk = ss->blk;
+	ss->fill_left = blkcnt;
+	ss->blk += blkcnt;
+	ss->total_blocks += chunk_header->chunk_sz;
+	sparse_stream_next_chunk(ss);
+}
+
+int sparse_stream_start(struct sparse_stream *ss, block_dev_desc_t *dev_desc,
+			disk_partition_t *info, const char *part_name,
+			unsigned int size)
+{
+	int i;
+
+	/* The last download may have been cut short */
+	sparse_stream_abort(ss);
+	memset(ss, '\0', sizeof(*ss));
+	ss->dev_desc = dev_desc;
+	ss->info = *info;
+	ss->part_name = part_name;
+	ss->size = size;
+	ss->blk = info->start;
+	ss->batch_size = ROUNDUP(CONFIG_FASTBOOT_STREAM_BATCH, info->blksz);
+	ss->step_blks = DIV_ROUND_UP(CONFIG_FASTBOOT_STREAM_WRITE_STEP,
+				     info->blksz);
+	ss->batch[0] = memalign(ARCH_DMA_MINALIGN,
+				ss->batch_size * STREAM_BATCHES);
+	ss->fill_buf = memalign(ARCH_DMA_MINALIGN,
+				ss->step_blks * info->blksz);
+	if (!ss->batch[0] || !ss->fill_buf) {
+		sparse_stream_abort(ss);
+		sparse_stream_fail(ss, "Malloc failed for stream buffer");
+		return -ENOMEM;
+	}
+	for (i = 1; i < STREAM_BATCHES; i++)
+		ss->batch[i] = ss->batch[i - 1] + ss->batch_size;
+	ss->state = STREAM_FILE_HDR;
+
+	return 0;
+}
+
+unsigned int sparse_stream_write(struct sparse_stream *ss, const void *data,
+				 unsigned int len)
+{
+	const u8 *p = data;
+	unsigned int n, need;
+
+	while (len && !ss->error) {
+		/* Wait for sparse_stream_poll() to free a batch */
+		if (ss->count == STREAM_BATCHES)
+			break;
+
+		if (ss->skip) {
+			n = min((u64)len, ss->skip);
+			ss->skip -= n;
+			p += n;
+			len -= n;
+			continue;
+		}
+
+		switch (ss->state) {
+		case STREAM_FILL:
+			/* Only one FILL chunk is written at a time */
+			if (ss->fill_left)
+				return p - (const u8 *)data;
+			/* fall through */
+		case STREAM_FILE_HDR:
+		case STREAM_CHUNK_HDR:
+			if (ss->state == STREAM_FILE_HDR)
+				need = sizeof(sparse_header_t);
+			else if (ss->state == STREAM_CHUNK_HDR)
+				need = sizeof(chunk_header_t);
+			else
+				need = sizeof(uint32_t);
+			/* Headers may be split between USB packets */
+			n = min(len, need - ss->hdr_len);
+			memcpy(ss->hdr + ss->hdr_len, p, n);
+			ss->hdr_len += n;
+			p += n;
+			len -= n;
+			if (ss->hdr_len < need)
+				break;
+
+			if (ss->state == STREAM_FILE_HDR)
+				sparse_stream_file_hdr(ss);
+			else if (ss->state == STREAM_CHUNK_HDR)
+				sparse_stream_chunk_hdr(ss);
+			else
+				sparse_stream_fill(ss);
+			ss->hdr_len = 0;
+			break;
+
+		case STREAM_RAW:
+			n = min((u64)len, ss->chunk_left);
+			n = min(n, ss->batch_size - ss->batch_len);
+			memcpy(sparse_stream_filling(ss) + ss->batch_len, p, n);
+			ss->batch_len += n;
+			ss->chunk_left -= n;
+			p += n;
+			len -= n;
+			if (ss->batch_len == ss->batch_size)
+				sparse_stream_queue(ss);
+			if (!ss->chunk_left)
+				sparse_stream_next_chunk(ss);
+			break;
+
+		case STREAM_DONE:
+			return p - (const u8 *)data + len;
+		}
+	}
+
+	/* After an error the rest of the download is dropped */
+	if (ss->error)
+		return p - (const u8 *)data + len;
+
+	return p - (const u8 *)data;
+}
+
+int sparse_stream_poll(struct sparse_stream *ss)
+{
+	lbaint_t n;
+	int i = ss->head;
+
+	if (ss->count) {
+		n = ss->batch_blkcnt[i] - ss->done;
+		if (n > ss->step_blks)
+			n = ss->step_blks;
+		if (sparse_stream_write_blocks(ss, ss->batch_blk[i] + ss->done,
+					       n, ss->batch[i] +
+					       ss->done * ss->info.blksz))
+			return 1;
+		ss->done += n;
+		if (ss->done == ss->batch_blkcnt[i]) {
+			ss->head = (i + 1) % STREAM_BATCHES;
+			ss->count--;
+			ss->done = 0;
+		}
+		return 1;
+	}
+
+	if (ss->fill_left) {
+		n = ss->fill_left < ss->step_blks ? ss->fill_left :
+			ss->step_blks;
+		if (sparse_stream_write_blocks(ss, ss->fill_blk, n,
+					       ss->fill_buf))
+			return 1;
+		ss->fill_blk += n;
+		ss->fill_left -= n;
+		return 1;
+	}
+
+	return 0;
+}
+
+void sparse_stream_finish(struct sparse_stream *ss)
+{
+	/* A download too short to be a sparse image */
+	if (!ss->error && ss->state == STREAM_FILE_HDR)
+		sparse_stream_raw(ss);
+
+	/* Write out everything still queued, then the last partial batch */
+	while (sparse_stream_poll(ss))
+		;
+	if (!ss->error)
+		sparse_stream_queue(ss);
+	while (sparse_stream_poll(ss))
+		;
+
+	if (!ss->error) {
+		printf("........ wrote %llu bytes to '%s'\n",
+		       (unsigned long long)ss->bytes_written, ss->part_name);
+		if (ss->sparse) {
+			debug("Wrote %d blocks, expected to write %d blocks\n",
+			      ss->total_blocks,
+			      ss->sparse_header.total_blks);
+			if (ss->state != STREAM_DONE ||
+			    ss->total_blocks != ss->sparse_header.total_blks)
+				sparse_stream_fail(ss,
+					"sparse image write failure");
+		}
+		if (!ss->error)
+			fastboot_okay("");
+	}
+
+	sparse_stream_abort(ss);
+}
+
+void sparse_stream_abort(struct sparse_stream *ss)
+{
+	free(ss->batch[0]);
+	ss->batch[0] = NULL;
+	free(ss->fill_buf);
+	ss->fill_buf = NULL;
+}
+#endif /* CONFIG_FASTBOOT_STREAM */
@@ -727,6 +727,10 @@ static int setup_dram_config(void)
 
 static int reloc_fdt(void)
 {
+#ifdef CONFIG_FDTDEC_INDEX
+	/* The index lives in the early malloc() area and points at the blob */
+	gd->fdt_index = NULL;
+#endif
 	if (gd->new_fdt) {
 		memcpy(gd->new_fdt, gd->fdt_blob, gd->fdt_size);
 		gd->fdt_blob = gd->new_fdt;
@@ -33,6 +33,7 @@
 #endif
 #include <logbuff.h>
 #include <malloc.h>
+#include <mempool.h>
 #ifdef CONFIG_BITBANGMII
 #include <miiphy.h>
 #endif
@@ -273,10 +274,19 @@ static int initr_malloc(void)
 #ifdef CONFIG_DM
 static int initr_dm(void)
 {
+	int ret;
+
 	/* Save the pre-reloc driver model and start a new one */
 	gd->dm_root_f = gd->dm_root;
 	gd->dm_root = NULL;
-	return dm_init_and_scan(false);
+	ret = dm_init_and_scan(false);
+	if (ret)
+		return ret;
+#ifdef CONFIG_DM_PROBE_ASYNC
+	dm_probe_async();
+#endif
+
+	return 0;
 }
 #endif
 
@@ -722,6 +732,9 @@ init_fnc_t init_sequence_r[] = {
 #endif
 	initr_barrier,
 	initr_malloc,
+#ifdef CONFIG_SYS_SCRATCH_SIZE
+	scratch_init,
+#endif
 	bootstage_relocate,
 #ifdef CONFIG_DM
 	initr_dm,
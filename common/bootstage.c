@@ -150,6 +150,25 @@ uint32_t bootstage_accum(enum bootstage_id id)
 	return duration;
 }
 
+uint32_t bootstage_accum_name(const char *name, uint32_t start_us)
+{
+	struct bootstage_record *rec;
+	uint32_t duration;
+	int id = next_id++;
+
+	duration = (uint32_t)timer_get_boot_us() - start_us;
+	if (id < BOOTSTAGE_ID_COUNT) {
+		rec = &record[id];
+		/* A zero start would make this look like a mark */
+		rec->start_us = start_us ? start_us : 1;
+		rec->time_us = duration;
+		rec->name = name;
+		rec->id = id;
+	}
+
+	return duration;
+}
+
 /**
  * Get a record name as a printable string
  *
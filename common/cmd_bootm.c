@@ -568,7 +568,7 @@ static int bootz_start(cmd_tbl_t *cmdtp, int flag, int argc,
 	if (ret != 0)
 		return 1;
 
-	lmb_reserve(&images->lmb, images->ep, zi_end - zi_start);
+	lmb_reserve_named(&images->lmb, images->ep, zi_end - zi_start, "kernel");
 
 	/*
 	 * Handle the BOOTM_STATE_FINDOTHER state ourselves as we do not
@@ -709,7 +709,8 @@ static int booti_start(cmd_tbl_t *cmdtp, int flag, int argc,
 
 	ih = (struct Image_header *)map_sysmem(images->ep, 0);
 
-	lmb_reserve(&images->lmb, images->ep, le32_to_cpu(ih->image_size));
+	lmb_reserve_named(&images->lmb, images->ep, le32_to_cpu(ih->image_size),
+			  "kernel");
 
 	/*
 	 * Handle the BOOTM_STATE_FINDOTHER state ourselves as we do not
@@ -10,6 +10,9 @@
 #include <common.h>
 #include <command.h>
 #include <g_dnl.h>
+#ifdef CONFIG_FASTBOOT_STREAM
+#include <fb_mmc.h>
+#endif
 
 static int do_fastboot(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 {
@@ -23,6 +26,9 @@ static int do_fastboot(cmd_tbl_t *cmdtp, int flag, int argc, char *const argv[])
 		if (ctrlc())
 			break;
 		usb_gadget_handle_interrupts();
+#ifdef CONFIG_FASTBOOT_STREAM
+		fastboot_stream_poll();
+#endif
 	}
 
 	g_dnl_unregister();
@@ -67,9 +67,10 @@ U_BOOT_CMD(
 static int do_fat_fsinfo(cmd_tbl_t *cmdtp, int flag, int argc,
 			 char * const argv[])
 {
-	int dev, part;
+	int dev, part, ret;
 	block_dev_desc_t *dev_desc;
 	disk_partition_t info;
+	const struct fat_read_stats *stats;
 
 	if (argc < 2) {
 		printf("usage: fatinfo <interface> [<dev[:part]>]\n");
@@ -86,7 +87,15 @@ static int do_fat_fsinfo(cmd_tbl_t *cmdtp, int flag, int argc,
 			argv[1], dev, part);
 		return 1;
 	}
-	return file_fat_detectfs();
+	ret = file_fat_detectfs();
+
+	stats = fat_get_read_stats();
+	if (!ret && stats->bytes)
+		printf("Last read: %lu bytes in %lu extents, %lu reads, "
+		       "%lu bytes bounced\n", stats->bytes, stats->extents,
+		       stats->reads, stats->bounced);
+
+	return ret;
 }
 
 U_BOOT_CMD(
@@ -18,19 +18,22 @@
 static int do_hash(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	char *s;
-#ifdef CONFIG_HASH_VERIFY
 	int flags = HASH_FLAG_ENV;
 
 	if (argc < 4)
 		return CMD_RET_USAGE;
+#ifdef CONFIG_HASH_VERIFY
 	if (!strcmp(argv[1], "-v")) {
 		flags |= HASH_FLAG_VERIFY;
 		argc--;
 		argv++;
 	}
-#else
-	const int flags = HASH_FLAG_ENV;
 #endif
+	if (!strcmp(argv[1], "-b")) {
+		flags |= HASH_FLAG_BENCH;
+		argc--;
+		argv++;
+	}
 	/* Move forward to 'algorithm' parameter */
 	argc--;
 	argv++;
@@ -46,13 +49,21 @@ U_BOOT_CMD(
 	"algorithm address count [[*]sum_dest]\n"
 		"    - compute message digest [save to env var / *address]\n"
 	"hash -v algorithm address count [*]sum\n"
-		"    - verify hash of memory area with env var / *address"
+		"    - verify hash of memory area with env var / *address\n"
+	"hash -b algorithm address count\n"
+		"    - compute message digest and report the speed\n"
+	"hash -b all address count\n"
+		"    - report the speed of every hash algorithm"
 );
 #else
 U_BOOT_CMD(
 	hash,	5,	1,	do_hash,
 	"compute message digest",
 	"algorithm address count [[*]sum_dest]\n"
-		"    - compute message digest [save to env var / *address]"
+		"    - compute message digest [save to env var / *address]\n"
+	"hash -b algorithm address count\n"
+		"    - compute message digest and report the speed\n"
+	"hash -b all address count\n"
+		"    - report the speed of every hash algorithm"
 );
 #endif
@@ -0,0 +1,85 @@
+/*
+ * Show who holds the memory in the malloc() area
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+
+static int do_malloc_info(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char * const argv[])
+{
+	malloc_track_info();
+
+	return 0;
+}
+
+static int do_malloc_dump(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char * const argv[])
+{
+	bool since_mark = false;
+
+	if (argc > 1) {
+		if (strcmp(argv[1], "new"))
+			return CMD_RET_USAGE;
+		since_mark = true;
+	}
+	malloc_track_dump(since_mark);
+
+	return 0;
+}
+
+static int do_malloc_top(cmd_tbl_t *cmdtp, int flag, int argc,
+			 char * const argv[])
+{
+	int count = 10;
+
+	if (argc > 1)
+		count = simple_strtoul(argv[1], NULL, 10);
+	if (malloc_track_top(count)) {
+		printf("No memory to sort the allocations\n");
+		return CMD_RET_FAILURE;
+	}
+
+	return 0;
+}
+
+static int do_malloc_mark(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char * const argv[])
+{
+	malloc_track_mark();
+
+	return 0;
+}
+
+static cmd_tbl_t cmd_malloc_sub[] = {
+	U_BOOT_CMD_MKENT(info, 1, 1, do_malloc_info, "", ""),
+	U_BOOT_CMD_MKENT(dump, 2, 1, do_malloc_dump, "", ""),
+	U_BOOT_CMD_MKENT(top, 2, 1, do_malloc_top, "", ""),
+	U_BOOT_CMD_MKENT(mark, 1, 1, do_malloc_mark, "", ""),
+};
+
+static int do_malloc(cmd_tbl_t *cmdtp, int flag, int argc,
+		     char * const argv[])
+{
+	cmd_tbl_t *c;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+
+	c = find_cmd_tbl(argv[1], cmd_malloc_sub, ARRAY_SIZE(cmd_malloc_sub));
+	if (!c)
+		return CMD_RET_USAGE;
+
+	return c->cmd(cmdtp, flag, argc - 1, argv + 1);
+}
+
+U_BOOT_CMD(malloc, 3, 1, do_malloc,
+	"show malloc() usage",
+	"info       - show the size, use and peak use of the malloc() area\n"
+	"malloc dump [new] - list live allocations, or those since 'mark'\n"
+	"malloc top [<n>]  - list the <n> callers holding the most memory\n"
+	"malloc mark       - remember this point for 'malloc dump new'"
+);
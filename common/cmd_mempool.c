@@ -0,0 +1,22 @@
+/*
+ * Show the statistics of the object pools and the scratch arena
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <mempool.h>
+
+static int do_mempool(cmd_tbl_t *cmdtp, int flag, int argc,
+		      char * const argv[])
+{
+	mem_pool_report();
+
+	return 0;
+}
+
+U_BOOT_CMD(mempool, 1, 1, do_mempool,
+	"show object pool statistics",
+	""
+);
@@ -11,6 +11,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <mempool.h>
 #include <linux/ctype.h>
 
 /*
@@ -505,6 +506,7 @@ enum command_ret_t cmd_process(int flag, int argc, char * const argv[],
 {
 	enum command_ret_t rc = CMD_RET_SUCCESS;
 	cmd_tbl_t *cmdtp;
+	ulong mark;
 
 	/* Look up command in command table */
 	cmdtp = find_cmd(argv[0]);
@@ -531,9 +533,13 @@ enum command_ret_t cmd_process(int flag, int argc, char * const argv[],
 
 	/* If OK so far, then do the command */
 	if (!rc) {
+		image_load_cmd(cmdtp->name, argc, argv);
 		if (ticks)
 			*ticks = get_timer(0);
+		/* Free what the command took from the scratch arena */
+		mark = scratch_mark();
 		rc = cmd_call(cmdtp, flag, argc, argv);
+		scratch_release(mark);
 		if (ticks)
 			*ticks = get_timer(*ticks);
 		*repeatable &= cmdtp->repeatable;
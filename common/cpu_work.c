@@ -0,0 +1,184 @@
+/*
+ * Run work on the secondary CPUs, which are otherwise idle in U-Boot.
+ *
+ * Each secondary CPU spins on a mailbox of its own. The boot CPU posts
+ * work there and the secondary clears it again once the work is done,
+ * in the style of a spin table. The CPUs are released the first time
+ * work is handed out and parked again by cpu_work_stop().
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <cpu_work.h>
+#include <malloc.h>
+#include <watchdog.h>
+#include <asm/io.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#ifndef CONFIG_CPU_WORK_STACK_SIZE
+#define CONFIG_CPU_WORK_STACK_SIZE	(16 << 10)
+#endif
+
+/* Read by cpu_work_entry() before the secondary CPU has a stack */
+gd_t *cpu_work_gd;
+ulong cpu_work_stacks[CONFIG_CPU_WORK_CPUS];
+
+static struct cpu_work *volatile cpu_work_mbox[CONFIG_CPU_WORK_CPUS];
+static void *cpu_work_stack_base[CONFIG_CPU_WORK_CPUS];
+static char cpu_work_online[CONFIG_CPU_WORK_CPUS];
+static int cpu_work_released;	/* 1 if released, -1 if that failed */
+
+/* Posted to a mailbox to make the secondary CPU return */
+static struct cpu_work cpu_work_quit;
+
+void cpu_work_secondary(int cpu)
+{
+	struct cpu_work *work;
+
+	for (;;) {
+		work = cpu_work_mbox[cpu];
+		if (!work) {
+			arch_cpu_work_idle();
+			continue;
+		}
+		if (work == &cpu_work_quit)
+			break;
+
+		work->ret = work->func(work->arg);
+		mb();
+		work->busy = 0;
+		cpu_work_mbox[cpu] = NULL;
+	}
+
+	mb();
+	cpu_work_mbox[cpu] = NULL;
+}
+
+__weak int arch_cpu_work_release(int cpu)
+{
+#ifdef CONFIG_MP
+	char addr[20];
+	char *const argv[] = { addr, NULL };
+
+	/* e.g. CPUs 2 and 3 of an i.MX6 DualLite */
+	if (!is_core_valid(cpu))
+		return -ENODEV;
+
+	sprintf(addr, "%lx", (ulong)cpu_work_entry);
+	/* The CPU starts with its caches off */
+	flush_dcache_all();
+
+	return cpu_release(cpu, 1, argv);
+#else
+	return -ENOSYS;
+#endif
+}
+
+__weak void arch_cpu_work_stop(int cpu)
+{
+}
+
+/* Before the first CPU is released, e.g. to make the caches coherent */
+__weak int arch_cpu_work_init(void)
+{
+	return 0;
+}
+
+/* Once all the CPUs are parked again */
+__weak void arch_cpu_work_exit(void)
+{
+}
+
+__weak void arch_cpu_work_idle(void)
+{
+}
+
+static void cpu_work_release(void)
+{
+	void *stack;
+	int cpu;
+
+	if (arch_cpu_work_init()) {
+		/* Do not try again until the next cpu_work_stop() */
+		cpu_work_released = -1;
+		return;
+	}
+	cpu_work_released = 1;
+	cpu_work_gd = (gd_t *)gd;
+	for (cpu = 1; cpu < CONFIG_CPU_WORK_CPUS; cpu++) {
+		stack = memalign(16, CONFIG_CPU_WORK_STACK_SIZE);
+		if (!stack)
+			break;
+		cpu_work_stack_base[cpu] = stack;
+		cpu_work_stacks[cpu] = (ulong)stack +
+			CONFIG_CPU_WORK_STACK_SIZE;
+		mb();
+
+		if (arch_cpu_work_release(cpu)) {
+			debug("%s: cannot release CPU %d\n", __func__, cpu);
+			free(stack);
+			cpu_work_stack_base[cpu] = NULL;
+			continue;
+		}
+		cpu_work_online[cpu] = 1;
+	}
+}
+
+int cpu_work_start(struct cpu_work *work, int (*func)(void *arg), void *arg)
+{
+	int cpu;
+
+	if (!cpu_work_released)
+		cpu_work_release();
+
+	for (cpu = 1; cpu < CONFIG_CPU_WORK_CPUS; cpu++) {
+		if (!cpu_work_online[cpu] || cpu_work_mbox[cpu])
+			continue;
+
+		work->func = func;
+		work->arg = arg;
+		work->ret = 0;
+		work->busy = 1;
+		mb();
+		cpu_work_mbox[cpu] = work;
+
+		return 0;
+	}
+
+	return -EBUSY;
+}
+
+int cpu_work_wait(struct cpu_work *work)
+{
+	while (work->busy)
+		WATCHDOG_RESET();
+	mb();
+
+	return work->ret;
+}
+
+void cpu_work_stop(void)
+{
+	int cpu;
+
+	for (cpu = 1; cpu < CONFIG_CPU_WORK_CPUS; cpu++) {
+		if (!cpu_work_online[cpu])
+			continue;
+
+		while (cpu_work_mbox[cpu])
+			WATCHDOG_RESET();
+		cpu_work_mbox[cpu] = &cpu_work_quit;
+		while (cpu_work_mbox[cpu])
+			;
+		arch_cpu_work_stop(cpu);
+
+		cpu_work_online[cpu] = 0;
+		free(cpu_work_stack_base[cpu]);
+		cpu_work_stack_base[cpu] = NULL;
+	}
+	if (cpu_work_released > 0)
+		arch_cpu_work_exit();
+	cpu_work_released = 0;
+}
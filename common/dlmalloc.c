@@ -878,6 +878,17 @@ extern Void_t*     sbrk();
 #define pvALLOc		dlpvalloc
 #define mALLINFo	dlmallinfo
 #define mALLOPt		dlmallopt
+#elif defined(CONFIG_MALLOC_TRACK) && !defined(CONFIG_SPL_BUILD)
+/* malloc() and friends record each allocation, see common/malloc_track.c */
+#define cALLOc		dlcalloc
+#define fREe		dlfree
+#define mALLOc		dlmalloc
+#define mEMALIGn	dlmemalign
+#define rEALLOc		dlrealloc
+#define vALLOc		dlvalloc
+#define pvALLOc		dlpvalloc
+#define mALLINFo	mallinfo
+#define mALLOPt		mallopt
 #else /* USE_DL_PREFIX */
 #define cALLOc		calloc
 #define fREe		free
@@ -3135,7 +3146,7 @@ size_t malloc_usable_size(mem) Void_t* mem;
 
 /* Utility to update current_mallinfo for malloc_stats and mallinfo() */
 
-#ifdef DEBUG
+#if defined(DEBUG) || defined(CONFIG_MALLOC_TRACK)
 static void malloc_update_mallinfo()
 {
   int i;
@@ -3173,7 +3184,7 @@ static void malloc_update_mallinfo()
   current_mallinfo.keepcost = chunksize(top);
 
 }
-#endif	/* DEBUG */
+#endif	/* DEBUG || CONFIG_MALLOC_TRACK */
 
 
 
@@ -3213,13 +3224,13 @@ void malloc_stats()
   mallinfo returns a copy of updated current mallinfo.
 */
 
-#ifdef DEBUG
+#if defined(DEBUG) || defined(CONFIG_MALLOC_TRACK)
 struct mallinfo mALLINFo()
 {
   malloc_update_mallinfo();
   return current_mallinfo;
 }
-#endif	/* DEBUG */
+#endif	/* DEBUG || CONFIG_MALLOC_TRACK */
 
 
 
@@ -5,6 +5,7 @@
  */
 
 #include <common.h>
+#include <errno.h>
 #include <fb_mmc.h>
 #include <part.h>
 #include <aboot.h>
@@ -59,30 +60,42 @@ static void write_raw_image(block_dev_desc_t *dev_desc, disk_partition_t *info,
 	fastboot_okay("");
 }
 
-void fb_mmc_flash_write(const char *cmd, void *download_buffer,
-			unsigned int download_bytes, char *response)
+static block_dev_desc_t *fb_mmc_get_part(const char *cmd,
+					 disk_partition_t *info)
 {
-	int ret;
 	block_dev_desc_t *dev_desc;
-	disk_partition_t info;
-
-	/* initialize the response buffer */
-	response_str = response;
+	int ret;
 
 	dev_desc = get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
 	if (!dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN) {
 		error("invalid mmc device\n");
 		fastboot_fail("invalid mmc device");
-		return;
+		return NULL;
 	}
 
-	ret = get_partition_info_efi_by_name(dev_desc, cmd, &info);
+	ret = get_partition_info_efi_by_name(dev_desc, cmd, info);
 	if (ret) {
 		error("cannot find partition: '%s'\n", cmd);
 		fastboot_fail("cannot find partition");
-		return;
+		return NULL;
 	}
 
+	return dev_desc;
+}
+
+void fb_mmc_flash_write(const char *cmd, void *download_buffer,
+			unsigned int download_bytes, char *response)
+{
+	block_dev_desc_t *dev_desc;
+	disk_partition_t info;
+
+	/* initialize the response buffer */
+	response_str = response;
+
+	dev_desc = fb_mmc_get_part(cmd, &info);
+	if (!dev_desc)
+		return;
+
 	if (is_sparse_image(download_buffer))
 		write_sparse_image(dev_desc, &info, cmd, download_buffer,
 				   download_bytes);
@@ -90,3 +103,45 @@ void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 		write_raw_image(dev_desc, &info, cmd, download_buffer,
 				download_bytes);
 }
+
+#ifdef CONFIG_FASTBOOT_STREAM
+static struct sparse_stream stream;
+
+int fb_mmc_stream_start(const char *cmd, unsigned int download_size,
+			char *response)
+{
+	block_dev_desc_t *dev_desc;
+	disk_partition_t info;
+
+	/* The response is only sent at the end, so start it empty */
+	response_str = response;
+	memset(response_str, '\0', RESPONSE_LEN);
+
+	dev_desc = fb_mmc_get_part(cmd, &info);
+	if (!dev_desc)
+		return -ENODEV;
+
+	return sparse_stream_start(&stream, dev_desc, &info, cmd,
+				   download_size);
+}
+
+unsigned int fb_mmc_stream_write(const void *data, unsigned int len)
+{
+	return sparse_stream_write(&stream, data, len);
+}
+
+int fb_mmc_stream_poll(void)
+{
+	return sparse_stream_poll(&stream);
+}
+
+void fb_mmc_stream_finish(void)
+{
+	sparse_stream_finish(&stream);
+}
+
+void fb_mmc_stream_abort(void)
+{
+	sparse_stream_abort(&stream);
+}
+#endif
@@ -19,6 +19,7 @@
 #include <u-boot/sha256.h>
 #include <asm/io.h>
 #include <asm/errno.h>
+#include <div64.h>
 
 #ifdef CONFIG_CMD_SHA1SUM
 static int hash_init_sha1(struct hash_algo *algo, void **ctxp)
@@ -342,6 +343,27 @@ int hash_block(const char *algo_name, const void *data, unsigned int len,
 	return 0;
 }
 
+/* Compute the digest of a memory area and report how long it took */
+static void hash_bench(struct hash_algo *algo, ulong addr, ulong len,
+		       uint8_t *output)
+{
+	ulong start, us;
+	u64 rate;
+	void *buf;
+
+	buf = map_sysmem(addr, len);
+	start = timer_get_us();
+	algo->hash_func_ws(buf, len, output, algo->chunk_size);
+	us = timer_get_us() - start;
+	unmap_sysmem(buf);
+
+	/* bytes per microsecond are MB/s */
+	rate = lldiv((u64)len * 100, us ? us : 1);
+	hash_show(algo, addr, len, output);
+	printf("\n%lu bytes in %lu us, %llu.%02llu MB/s\n", len, us,
+	       rate / 100, rate % 100);
+}
+
 int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 		 int argc, char * const argv[])
 {
@@ -358,6 +380,13 @@ int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 		uint8_t output[HASH_MAX_DIGEST_SIZE];
 		uint8_t vsum[HASH_MAX_DIGEST_SIZE];
 		void *buf;
+		int i;
+
+		if ((flags & HASH_FLAG_BENCH) && !strcmp(algo_name, "all")) {
+			for (i = 0; i < ARRAY_SIZE(hash_algo); i++)
+				hash_bench(&hash_algo[i], addr, len, output);
+			return 0;
+		}
 
 		if (hash_lookup_algo(algo_name, &algo)) {
 			printf("Unknown hash algorithm '%s'\n", algo_name);
@@ -370,6 +399,11 @@ int hash_command(const char *algo_name, int flags, cmd_tbl_t *cmdtp, int flag,
 			return 1;
 		}
 
+		if (flags & HASH_FLAG_BENCH) {
+			hash_bench(algo, addr, len, output);
+			return 0;
+		}
+
 		buf = map_sysmem(addr, len);
 		algo->hash_func_ws(buf, len, output, algo->chunk_size);
 		unmap_sysmem(buf);
@@ -87,7 +87,7 @@ void boot_fdt_add_mem_rsv_regions(struct lmb *lmb, void *fdt_blob)
 			continue;
 		printf("   reserving fdt memory region: addr=%llx size=%llx\n",
 		       (unsigned long long)addr, (unsigned long long)size);
-		lmb_reserve(lmb, addr, size);
+		lmb_reserve_named(lmb, addr, size, "fdt-memreserve");
 	}
 }
 
@@ -138,25 +138,26 @@ int boot_relocate_fdt(struct lmb *lmb, char **of_flat_tree, ulong *of_size)
 		if (((ulong) desired_addr) == ~0UL) {
 			/* All ones means use fdt in place */
 			of_start = fdt_blob;
-			lmb_reserve(lmb, (ulong)of_start, of_len);
+			lmb_reserve_named(lmb, (ulong)of_start, of_len, "fdt");
 			disable_relocation = 1;
 		} else if (desired_addr) {
 			of_start =
-			    (void *)(ulong) lmb_alloc_base(lmb, of_len, 0x1000,
-							   (ulong)desired_addr);
+			    (void *)(ulong) lmb_alloc_base_named(lmb, of_len,
+						0x1000, (ulong)desired_addr, "fdt");
 			if (of_start == NULL) {
 				puts("Failed using fdt_high value for Device Tree");
 				goto error;
 			}
 		} else {
 			of_start =
-			    (void *)(ulong) lmb_alloc(lmb, of_len, 0x1000);
+			    (void *)(ulong) lmb_alloc_base_named(lmb, of_len,
+							0x1000, 0, "fdt");
 		}
 	} else {
 		of_start =
-		    (void *)(ulong) lmb_alloc_base(lmb, of_len, 0x1000,
-						   getenv_bootm_mapsize()
-						   + getenv_bootm_low());
+		    (void *)(ulong) lmb_alloc_base_named(lmb, of_len, 0x1000,
+						getenv_bootm_mapsize()
+						+ getenv_bootm_low(), "fdt");
 	}
 
 	if (of_start == NULL) {
@@ -489,7 +490,7 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 		fdt_set_totalsize(blob, of_size);
 	}
 	/* Create a new LMB reservation */
-	lmb_reserve(lmb, (ulong)blob, of_size);
+	lmb_reserve_named(lmb, (ulong)blob, of_size, "fdt");
 
 	fdt_initrd(blob, *initrd_start, *initrd_end);
 	if (!ft_verify_fdt(blob))
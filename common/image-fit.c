@@ -15,6 +15,7 @@
 #include <time.h>
 #else
 #include <common.h>
+#include <cpu_work.h>
 #include <errno.h>
 #include <asm/io.h>
 DECLARE_GLOBAL_DATA_PTR;
@@ -897,6 +898,190 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+#if defined(CONFIG_CPU_WORK) && !defined(USE_HOSTCC)
+#define FIT_HASH_JOBS	8
+
+/* Hashes of the images of a configuration, worked out on other CPUs */
+static struct fit_hash_job {
+	struct cpu_work work;
+	const void *data;
+	size_t size;
+	const char *algo;
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len;
+	int queued;
+} fit_hash_jobs[FIT_HASH_JOBS];
+
+/*
+ * As calculate_hash(), but without the watchdog resets or messages, since
+ * a secondary CPU must keep off the devices
+ */
+static int fit_hash_job_run(void *arg)
+{
+	struct fit_hash_job *job = arg;
+	const uint8_t *data = job->data;
+	sha256_context ctx;
+
+	if (IMAGE_ENABLE_CRC32 && strcmp(job->algo, "crc32") == 0) {
+		*((uint32_t *)job->value) = cpu_to_uimage(crc32(0, data,
+								job->size));
+		job->value_len = 4;
+	} else if (IMAGE_ENABLE_SHA1 && strcmp(job->algo, "sha1") == 0) {
+		sha1_csum(data, job->size, job->value);
+		job->value_len = 20;
+	} else if (IMAGE_ENABLE_SHA256 && strcmp(job->algo, "sha256") == 0) {
+		sha256_starts(&ctx);
+		sha256_update(&ctx, data, job->size);
+		sha256_finish(&ctx, job->value);
+		job->value_len = SHA256_SUM_LEN;
+	} else if (IMAGE_ENABLE_MD5 && strcmp(job->algo, "md5") == 0) {
+		md5((unsigned char *)data, job->size, job->value);
+		job->value_len = 16;
+	} else {
+		return -1;
+	}
+
+	return 0;
+}
+
+void fit_hash_jobs_wait(void)
+{
+	int i;
+
+	for (i = 0; i < FIT_HASH_JOBS; i++) {
+		if (fit_hash_jobs[i].queued) {
+			cpu_work_wait(&fit_hash_jobs[i].work);
+			fit_hash_jobs[i].queued = 0;
+		}
+	}
+}
+
+/*
+ * Wait for the hashes still being worked out before image data is copied
+ * to dst, then drop those of any data that the copy writes over
+ */
+static void fit_hash_jobs_move(const void *dst, size_t len)
+{
+	struct fit_hash_job *job;
+	int i;
+
+	for (i = 0; i < FIT_HASH_JOBS; i++) {
+		job = &fit_hash_jobs[i];
+		if (!job->queued)
+			continue;
+		cpu_work_wait(&job->work);
+		if ((const char *)job->data < (const char *)dst + len &&
+		    (const char *)dst < (const char *)job->data + job->size)
+			job->queued = 0;
+	}
+}
+
+static int fit_hash_jobs_queue(const void *fit, int image_noffset, int *nrp)
+{
+	struct fit_hash_job *job;
+	const void *data;
+	size_t size;
+	char *algo;
+	int noffset;
+	int ignore;
+
+	if (fit_image_get_data(fit, image_noffset, &data, &size))
+		return 0;
+
+	for (noffset = fdt_first_subnode(fit, image_noffset);
+	     noffset >= 0;
+	     noffset = fdt_next_subnode(fit, noffset)) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+
+		if (*nrp == FIT_HASH_JOBS)
+			return -ENOSPC;
+		job = &fit_hash_jobs[*nrp];
+		job->data = data;
+		job->size = size;
+		job->algo = algo;
+		if (cpu_work_start(&job->work, fit_hash_job_run, job))
+			return -EBUSY;
+		job->queued = 1;
+		(*nrp)++;
+	}
+
+	return 0;
+}
+
+/*
+ * Start hashing the images of a configuration on the secondary CPUs, so
+ * that fit_image_check_hash() finds the results ready when it gets to
+ * them. The kernel goes last, as the boot CPU checks it straight away.
+ */
+static void fit_hash_jobs_start(const void *fit, int cfg_noffset)
+{
+	static const char *const props[] = {
+		FIT_RAMDISK_PROP, FIT_FDT_PROP, FIT_KERNEL_PROP
+	};
+	int i, noffset, nr = 0;
+
+	fit_hash_jobs_wait();
+	for (i = 0; i < ARRAY_SIZE(props); i++) {
+		noffset = fit_conf_get_prop_node(fit, cfg_noffset, props[i]);
+		if (noffset < 0)
+			continue;
+		if (fit_hash_jobs_queue(fit, noffset, &nr))
+			break;
+	}
+}
+
+/* Pick up a hash started by fit_hash_jobs_start(), if there is one */
+static int fit_hash_jobs_get(const void *data, size_t size,
+			     const char *algo, uint8_t *value, int *value_len)
+{
+	struct fit_hash_job *job;
+	int i;
+
+	for (i = 0; i < FIT_HASH_JOBS; i++) {
+		job = &fit_hash_jobs[i];
+		if (!job->queued || job->data != data || job->size != size ||
+		    strcmp(job->algo, algo))
+			continue;
+
+		job->queued = 0;
+		if (cpu_work_wait(&job->work))
+			return -1;
+		memcpy(value, job->value, job->value_len);
+		*value_len = job->value_len;
+
+		return 0;
+	}
+
+	return -ENOENT;
+}
+#else
+static inline void fit_hash_jobs_move(const void *dst, size_t len)
+{
+}
+
+static inline void fit_hash_jobs_start(const void *fit, int cfg_noffset)
+{
+}
+
+static inline int fit_hash_jobs_get(const void *data, size_t size,
+				    const char *algo, uint8_t *value,
+				    int *value_len)
+{
+	return -ENOENT;
+}
+#endif
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 				size_t size, char **err_msgp)
 {
@@ -929,7 +1114,8 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	if (fit_hash_jobs_get(data, size, algo, value, &value_len) &&
+	    calculate_hash(data, size, algo, value, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -1559,6 +1745,8 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		if (image_type == IH_TYPE_KERNEL) {
 			/* Remember (and possibly verify) this config */
 			images->fit_uname_cfg = fit_uname_config;
+			if (images->verify)
+				fit_hash_jobs_start(fit, cfg_noffset);
 			if (IMAGE_ENABLE_VERIFY && images->verify) {
 				puts("   Verifying Hash Integrity ... ");
 				if (fit_config_verify(fit, cfg_noffset)) {
@@ -1679,6 +1867,7 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		       prop_name, data, load);
 
 		dst = map_sysmem(load, len);
+		fit_hash_jobs_move(dst, len);
 		memmove(dst, buf, len);
 		data = load;
 	}
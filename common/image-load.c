@@ -0,0 +1,339 @@
+/*
+ * Follow images while they are being loaded, so that a legacy image can
+ * be checked, and its kernel decompressed, as the data arrives rather
+ * than in further passes over memory once the load is done.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <image.h>
+#include <lmb.h>
+#include <malloc.h>
+#include <watchdog.h>
+#include <asm/io.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* The load in progress */
+static struct {
+	const uchar *start;	/* load address, NULL if not following a load */
+	const uchar *pos;	/* end of the data loaded in sequence */
+	const uchar *data;	/* image data, NULL until the header is in */
+	const uchar *end;
+	const uchar *hashed;	/* end of the data hashed so far */
+	struct hash_algo *algo;
+	void *ctx;
+#ifdef CONFIG_IMAGE_LOAD_DECOMP
+	struct gunzip_stream *gs;	/* NULL if not decompressing */
+	uchar *dest;
+	uchar *out;		/* end of the output so far */
+	uint32_t out_crc;	/* CRC of the output so far */
+	int out_done;
+#endif
+} load;
+
+/* The last legacy image loaded completely */
+static struct {
+	const uchar *start;	/* header, NULL if there is none */
+	const uchar *data;
+	const uchar *end;
+	uint32_t hcrc;		/* header CRC and data CRC in the header */
+	uint32_t ih_dcrc;
+	uint32_t dcrc;		/* data CRC computed while loading */
+#ifdef CONFIG_IMAGE_LOAD_DECOMP
+	uchar *dest;		/* decompressed kernel, NULL if there is none */
+	ulong dest_len;
+	uint32_t dest_crc;
+#endif
+} loaded;
+
+static void image_load_stop(void)
+{
+	/* Finishing is the only way to free the context */
+	if (load.ctx) {
+		uint8_t digest[HASH_MAX_DIGEST_SIZE];
+
+		load.algo->hash_finish(load.algo, load.ctx, digest,
+				       sizeof(digest));
+	}
+#ifdef CONFIG_IMAGE_LOAD_DECOMP
+	if (load.gs)
+		gunzip_stream_end(load.gs);
+#endif
+	memset(&load, '\0', sizeof(load));
+}
+
+void image_load_start(const void *buf)
+{
+	image_load_stop();
+	load.start = buf;
+	load.pos = buf;
+}
+
+static int overlaps(const void *buf, ulong len, const void *start,
+		    const void *end)
+{
+	return (const uchar *)buf < (const uchar *)end &&
+		(const uchar *)buf + len > (const uchar *)start;
+}
+
+#ifdef CONFIG_IMAGE_LOAD_DECOMP
+/*
+ * Check that len bytes at dest are in the memory bootm may use and clear
+ * of what the architecture and board keep for themselves, as bootm would
+ * find them.
+ */
+static int image_load_dest_ok(ulong dest, ulong len)
+{
+	ulong low = getenv_bootm_low();
+	phys_size_t size = getenv_bootm_size();
+#ifdef CONFIG_LMB
+	struct lmb lmb;
+	long ret;
+#endif
+
+	if (dest < low || dest - low > size || len > size - (dest - low))
+		return 0;
+#ifdef CONFIG_LMB
+	memset(&lmb, '\0', sizeof(lmb));
+	lmb_add(&lmb, (phys_addr_t)low, size);
+	arch_lmb_reserve(&lmb);
+	board_lmb_reserve(&lmb);
+	ret = lmb_get_reserved(&lmb, (phys_addr_t)dest, len, NULL, NULL, NULL);
+	lmb_init(&lmb);
+
+	return ret != 0;
+#else
+	return dest + len <= gd->start_addr_sp - 4096;
+#endif
+}
+
+/*
+ * Start inflating a gzip compressed kernel to its load address, provided
+ * that neither the image being loaded nor U-Boot itself are in the way.
+ */
+static void image_load_start_decomp(const image_header_t *hdr)
+{
+	ulong dest = image_get_load(hdr);
+	uchar *buf;
+
+	if (!image_check_type(hdr, IH_TYPE_KERNEL) ||
+	    image_get_comp(hdr) != IH_COMP_GZIP)
+		return;
+	if (!image_load_dest_ok(dest, CONFIG_SYS_BOOTM_LEN))
+		return;
+
+	buf = map_sysmem(dest, CONFIG_SYS_BOOTM_LEN);
+	if (overlaps(buf, CONFIG_SYS_BOOTM_LEN, load.start, load.end))
+		return;
+
+	load.gs = gunzip_stream_start(buf, CONFIG_SYS_BOOTM_LEN, load.data);
+	if (!load.gs)
+		return;
+	load.dest = buf;
+	load.out = load.dest;
+}
+
+static void image_load_decomp(void)
+{
+	uchar *out;
+	int ret;
+
+	ret = gunzip_stream_feed(load.gs, load.hashed - load.data, &out);
+	/* The new output is still in the cache, so this costs little */
+	load.out_crc = crc32(load.out_crc, load.out, out - load.out);
+	load.out = out;
+	if (ret == 0 && load.hashed < load.end)
+		return;
+
+	gunzip_stream_end(load.gs);
+	load.gs = NULL;
+	load.out_done = ret == 1;
+	if (!load.out_done)
+		debug("Stopped decompressing while loading\n");
+}
+#endif
+
+static int image_load_header(void)
+{
+	const image_header_t *hdr = (const image_header_t *)load.start;
+
+	if (!image_check_magic(hdr) || !image_check_hcrc(hdr))
+		return -1;
+	if (hash_lookup_algo("crc32", &load.algo) ||
+	    load.algo->hash_init(load.algo, &load.ctx))
+		return -1;
+
+	load.data = (const uchar *)image_get_data(hdr);
+	load.end = load.data + image_get_data_size(hdr);
+	load.hashed = load.data;
+#ifdef CONFIG_IMAGE_LOAD_DECOMP
+	image_load_start_decomp(hdr);
+#endif
+
+	return 0;
+}
+
+static void image_load_done(void)
+{
+	const image_header_t *hdr = (const image_header_t *)load.start;
+
+	load.algo->hash_finish(load.algo, load.ctx, &loaded.dcrc,
+			       sizeof(loaded.dcrc));
+	load.ctx = NULL;
+
+	loaded.start = load.start;
+	loaded.hcrc = image_get_hcrc(hdr);
+	loaded.ih_dcrc = image_get_dcrc(hdr);
+	loaded.data = load.data;
+	loaded.end = load.end;
+#ifdef CONFIG_IMAGE_LOAD_DECOMP
+	loaded.dest = load.out_done ? load.dest : NULL;
+	loaded.dest_len = load.out - load.dest;
+	loaded.dest_crc = load.out_crc;
+#endif
+	image_load_stop();
+}
+
+/* Drop what was recorded for an image that buf to buf + len overlaps */
+static void image_load_invalidate(const void *buf, ulong len)
+{
+	if (loaded.start && overlaps(buf, len, loaded.start, loaded.end))
+		loaded.start = NULL;
+#ifdef CONFIG_IMAGE_LOAD_DECOMP
+	if (loaded.dest &&
+	    overlaps(buf, len, loaded.dest, loaded.dest + loaded.dest_len))
+		loaded.dest = NULL;
+#endif
+}
+
+void image_load_update(const void *buf, ulong len)
+{
+	const uchar *p = buf;
+	ulong n;
+
+	image_load_invalidate(buf, len);
+
+	if (!load.start || p > load.pos || p + len <= load.pos)
+		return;
+	load.pos = p + len;
+
+	if (!load.data) {
+		if (load.pos < load.start + image_get_header_size())
+			return;
+		if (image_load_header()) {
+			/* Not a legacy image, nothing to do for this load */
+			image_load_stop();
+			return;
+		}
+	}
+
+	while (load.hashed < load.pos && load.hashed < load.end) {
+		n = min(load.pos, load.end) - load.hashed;
+		if (n > load.algo->chunk_size)
+			n = load.algo->chunk_size;
+		load.algo->hash_update(load.algo, load.ctx, load.hashed, n,
+				       load.hashed + n == load.end);
+		load.hashed += n;
+		WATCHDOG_RESET();
+	}
+
+#ifdef CONFIG_IMAGE_LOAD_DECOMP
+	if (load.gs)
+		image_load_decomp();
+#endif
+
+	if (load.hashed == load.end)
+		image_load_done();
+}
+
+/*
+ * Commands which keep what was recorded for the last image. The loaders
+ * report everything they write, bootm and iminfo only read the image and
+ * the rest do not write memory at all. A subcommand of NULL allows all
+ * of them.
+ */
+static const struct {
+	const char *name;
+	const char *sub;
+} image_load_cmds[] = {
+	{ "bootm" },
+	{ "iminfo" },
+	{ "bootp" },
+	{ "dhcp" },
+	{ "nfs" },
+	{ "tftpboot" },
+	{ "ext2load" },
+	{ "ext4load" },
+	{ "fatload" },
+	{ "load" },
+	{ "mmc", "read" },
+	{ "sb", "load" },
+	{ "echo" },
+	{ "printenv" },
+	{ "run" },
+	{ "setenv" },
+	{ "test" },
+};
+
+void image_load_cmd(const char *name, int argc, char * const argv[])
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(image_load_cmds); i++) {
+		if (strcmp(name, image_load_cmds[i].name))
+			continue;
+		if (!image_load_cmds[i].sub ||
+		    (argc > 1 && !strcmp(argv[1], image_load_cmds[i].sub)))
+			return;
+	}
+
+	if (loaded.start)
+		debug("'%s' may write memory, dropping the loaded image\n",
+		      name);
+	memset(&loaded, '\0', sizeof(loaded));
+}
+
+int image_load_get_dcrc(const image_header_t *hdr, uint32_t *dcrc)
+{
+	/* The header must still be the one that was loaded */
+	if (!loaded.start || loaded.start != (const uchar *)hdr ||
+	    loaded.hcrc != image_get_hcrc(hdr) ||
+	    loaded.ih_dcrc != image_get_dcrc(hdr) ||
+	    loaded.end - loaded.data != image_get_data_size(hdr))
+		return -1;
+
+	*dcrc = loaded.dcrc;
+	debug("Using data CRC computed while loading\n");
+
+	return 0;
+}
+
+#ifdef CONFIG_IMAGE_LOAD_DECOMP
+int image_load_get_decomp(const void *data, ulong len, void *dest,
+			  ulong *dest_len)
+{
+	if (!loaded.start || !loaded.dest || loaded.data != data ||
+	    loaded.end - loaded.data != len || loaded.dest != dest)
+		return -1;
+
+	/*
+	 * Commands which might write over the output were seen to, but
+	 * bootm itself may have loaded other images into it by now. A CRC
+	 * is still much quicker than decompressing again.
+	 */
+	if (crc32_wd(0, loaded.dest, loaded.dest_len, CHUNKSZ_CRC32) !=
+	    loaded.dest_crc) {
+		debug("Kernel decompressed while loading has changed\n");
+		loaded.dest = NULL;
+		return -1;
+	}
+
+	*dest_len = loaded.dest_len;
+	debug("Using kernel decompressed while loading\n");
+
+	return 0;
+}
+#endif
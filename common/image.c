@@ -177,7 +177,13 @@ int image_check_dcrc(const image_header_t *hdr)
 {
 	ulong data = image_get_data(hdr);
 	ulong len = image_get_data_size(hdr);
-	ulong dcrc = crc32_wd(0, (unsigned char *)data, len, CHUNKSZ_CRC32);
+	ulong dcrc;
+	uint32_t load_dcrc;
+
+	if (!image_load_get_dcrc(hdr, &load_dcrc))
+		return (load_dcrc == image_get_dcrc(hdr));
+
+	dcrc = crc32_wd(0, (unsigned char *)data, len, CHUNKSZ_CRC32);
 
 	return (dcrc == image_get_dcrc(hdr));
 }
@@ -1079,7 +1085,8 @@ int boot_ramdisk_high(struct lmb *lmb, ulong rd_data, ulong rd_len,
 
 #ifdef CONFIG_LOGBUFFER
 	/* Prevent initrd from overwriting logbuffer */
-	lmb_reserve(lmb, logbuffer_base() - LOGBUFF_OVERHEAD, LOGBUFF_RESERVE);
+	lmb_reserve_named(lmb, logbuffer_base() - LOGBUFF_OVERHEAD,
+			  LOGBUFF_RESERVE, "logbuffer");
 #endif
 
 	debug("## initrd_high = 0x%08lx, copy_to_ram = %d\n",
@@ -1090,14 +1097,11 @@ int boot_ramdisk_high(struct lmb *lmb, ulong rd_data, ulong rd_len,
 			debug("   in-place initrd\n");
 			*initrd_start = rd_data;
 			*initrd_end = rd_data + rd_len;
-			lmb_reserve(lmb, rd_data, rd_len);
+			lmb_reserve_named(lmb, rd_data, rd_len, "ramdisk");
 		} else {
-			if (initrd_high)
-				*initrd_start = (ulong)lmb_alloc_base(lmb,
-						rd_len, 0x1000, initrd_high);
-			else
-				*initrd_start = (ulong)lmb_alloc(lmb, rd_len,
-								 0x1000);
+			/* An initrd_high of 0 allocates anywhere */
+			*initrd_start = (ulong)lmb_alloc_base_named(lmb,
+					rd_len, 0x1000, initrd_high, "ramdisk");
 
 			if (*initrd_start == 0) {
 				puts("ramdisk - allocation error\n");
@@ -1157,8 +1161,9 @@ int boot_get_cmdline(struct lmb *lmb, ulong *cmd_start, ulong *cmd_end)
 	char *cmdline;
 	char *s;
 
-	cmdline = (char *)(ulong)lmb_alloc_base(lmb, CONFIG_SYS_BARGSIZE, 0xf,
-				getenv_bootm_mapsize() + getenv_bootm_low());
+	cmdline = (char *)(ulong)lmb_alloc_base_named(lmb, CONFIG_SYS_BARGSIZE,
+				0xf, getenv_bootm_mapsize() + getenv_bootm_low(),
+				"cmdline");
 
 	if (cmdline == NULL)
 		return -1;
@@ -1193,8 +1198,9 @@ int boot_get_cmdline(struct lmb *lmb, ulong *cmd_start, ulong *cmd_end)
  */
 int boot_get_kbd(struct lmb *lmb, bd_t **kbd)
 {
-	*kbd = (bd_t *)(ulong)lmb_alloc_base(lmb, sizeof(bd_t), 0xf,
-				getenv_bootm_mapsize() + getenv_bootm_low());
+	*kbd = (bd_t *)(ulong)lmb_alloc_base_named(lmb, sizeof(bd_t), 0xf,
+				getenv_bootm_mapsize() + getenv_bootm_low(),
+				"bd_info");
 	if (*kbd == NULL)
 		return -1;
 
@@ -0,0 +1,335 @@
+/*
+ * Record each live allocation, to find out who uses the malloc() area
+ *
+ * With CONFIG_MALLOC_TRACK, dlmalloc's routines are renamed dlmalloc(),
+ * dlfree() and so on, and malloc(), free() and friends are the wrappers
+ * here. Each allocation made after relocation is entered in a fixed-size
+ * table keyed by its address, holding the caller, size and time. The
+ * table is open-addressed, so recording and removing an allocation take a
+ * few probes; when it is full, further allocations are only counted.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <malloc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#ifndef CONFIG_MALLOC_TRACK_ENTRIES
+#define CONFIG_MALLOC_TRACK_ENTRIES	1024
+#endif
+
+#define TRACK_MASK	(CONFIG_MALLOC_TRACK_ENTRIES - 1)
+
+#if CONFIG_MALLOC_TRACK_ENTRIES & TRACK_MASK
+#error "CONFIG_MALLOC_TRACK_ENTRIES must be a power of two"
+#endif
+
+/*
+ * Bootstage marks for the heap reaching each eighth of its size. The names
+ * are constant so that bootstage can keep them.
+ */
+static const char * const track_level_name[] = {
+	"malloc 1/8", "malloc 2/8", "malloc 3/8", "malloc 4/8",
+	"malloc 5/8", "malloc 6/8", "malloc 7/8", "malloc full",
+};
+
+struct track_entry {
+	ulong ptr;		/* 0 if the entry is free */
+	ulong caller;		/* return address of the caller */
+	uint32_t size;		/* size asked for */
+	uint32_t seq;		/* allocation number, for malloc_track_mark() */
+	uint32_t time;		/* get_timer() when allocated, in ms */
+};
+
+static struct track_entry track[CONFIG_MALLOC_TRACK_ENTRIES];
+
+static struct {
+	ulong tracked;		/* usable bytes of tracked allocations */
+	ulong top_peak;		/* highest heap top, from the start of the area */
+	unsigned int count;	/* tracked allocations */
+	unsigned int peak_count;
+	unsigned int dropped;	/* allocations the table had no room for */
+	uint32_t seq;
+	uint32_t mark;
+	int level;		/* eighths of the heap reported */
+} stats;
+
+static inline uint32_t track_slot(ulong ptr)
+{
+	return ((ptr >> 3) * 2654435761u) & TRACK_MASK;
+}
+
+/*
+ * Follow the top of dlmalloc's heap, which covers every allocation whether
+ * it is in the table or not, and report each eighth of the area it reaches
+ */
+static void track_heap(void)
+{
+	ulong top = mem_malloc_brk - mem_malloc_start;
+	ulong heap = mem_malloc_end - mem_malloc_start;
+
+	if (top <= stats.top_peak)
+		return;
+	stats.top_peak = top;
+	while (stats.level < ARRAY_SIZE(track_level_name) &&
+	       top >= heap / 8 * (stats.level + 1)) {
+		bootstage_mark_name(BOOTSTAGE_ID_ALLOC,
+				    track_level_name[stats.level]);
+		stats.level++;
+	}
+}
+
+static void track_insert(const struct track_entry *ent)
+{
+	uint32_t slot;
+
+	for (slot = track_slot(ent->ptr); track[slot].ptr;
+	     slot = (slot + 1) & TRACK_MASK)
+		;
+	track[slot] = *ent;
+
+	stats.tracked += malloc_usable_size((void *)ent->ptr);
+	if (++stats.count > stats.peak_count)
+		stats.peak_count = stats.count;
+}
+
+static void track_add(void *mem, size_t size, ulong caller)
+{
+	struct track_entry ent;
+
+	if (!mem || !(gd->flags & GD_FLG_RELOC))
+		return;
+
+	track_heap();
+	stats.seq++;
+	/* Keep the table at most 3/4 full so that probes stay short */
+	if (stats.count >= CONFIG_MALLOC_TRACK_ENTRIES * 3 / 4) {
+		stats.dropped++;
+		return;
+	}
+	ent.ptr = (ulong)mem;
+	ent.caller = caller;
+	ent.size = size;
+	ent.seq = stats.seq;
+	ent.time = get_timer(0);
+	track_insert(&ent);
+}
+
+/*
+ * Take an allocation out of the table, copying its entry to @old. Returns
+ * false if it is not there: made before relocation or when the table was
+ * full.
+ */
+static bool track_del(void *mem, struct track_entry *old)
+{
+	ulong ptr = (ulong)mem;
+	uint32_t slot, next, home;
+
+	if (!mem || !(gd->flags & GD_FLG_RELOC))
+		return false;
+
+	for (slot = track_slot(ptr); track[slot].ptr != ptr;
+	     slot = (slot + 1) & TRACK_MASK) {
+		if (!track[slot].ptr)
+			return false;
+	}
+	*old = track[slot];
+	stats.tracked -= malloc_usable_size(mem);
+	stats.count--;
+
+	/* Move later entries of the probe sequence up into the hole */
+	for (next = (slot + 1) & TRACK_MASK; track[next].ptr;
+	     next = (next + 1) & TRACK_MASK) {
+		home = track_slot(track[next].ptr);
+		/* Only if the hole lies between its home slot and here */
+		if (((next - home) & TRACK_MASK) >=
+		    ((next - slot) & TRACK_MASK)) {
+			track[slot] = track[next];
+			slot = next;
+		}
+	}
+	track[slot].ptr = 0;
+
+	return true;
+}
+
+void *malloc(size_t bytes)
+{
+	void *mem = dlmalloc(bytes);
+
+	track_add(mem, bytes, (ulong)__builtin_return_address(0));
+
+	return mem;
+}
+
+void free(void *mem)
+{
+	struct track_entry old;
+
+	track_del(mem, &old);
+	dlfree(mem);
+}
+
+void *calloc(size_t n, size_t elem_size)
+{
+	void *mem = dlcalloc(n, elem_size);
+
+	track_add(mem, n * elem_size, (ulong)__builtin_return_address(0));
+
+	return mem;
+}
+
+void *realloc(void *oldmem, size_t bytes)
+{
+	struct track_entry old;
+	bool tracked;
+	void *mem;
+
+	/* Take the old block out first, as realloc() may free it */
+	tracked = track_del(oldmem, &old);
+	mem = dlrealloc(oldmem, bytes);
+	if (mem)
+		track_add(mem, bytes, (ulong)__builtin_return_address(0));
+	else if (tracked)
+		track_insert(&old);	/* still allocated, as it was */
+
+	return mem;
+}
+
+void *memalign(size_t alignment, size_t bytes)
+{
+	void *mem = dlmemalign(alignment, bytes);
+
+	track_add(mem, bytes, (ulong)__builtin_return_address(0));
+
+	return mem;
+}
+
+void *valloc(size_t bytes)
+{
+	void *mem = dlvalloc(bytes);
+
+	track_add(mem, bytes, (ulong)__builtin_return_address(0));
+
+	return mem;
+}
+
+void *pvalloc(size_t bytes)
+{
+	void *mem = dlpvalloc(bytes);
+
+	track_add(mem, bytes, (ulong)__builtin_return_address(0));
+
+	return mem;
+}
+
+/* Return the caller as a link-time address, to look up in System.map */
+static ulong track_caller(const struct track_entry *ent)
+{
+	return ent->caller - gd->reloc_off;
+}
+
+void malloc_track_info(void)
+{
+	struct mallinfo info = mallinfo();
+
+	printf("malloc area:  %lu bytes at %08lx\n",
+	       mem_malloc_end - mem_malloc_start, mem_malloc_start);
+	printf("in use:       %d bytes\n", info.uordblks);
+	printf("heap top:     %lu bytes, peak %lu bytes\n",
+	       mem_malloc_brk - mem_malloc_start, stats.top_peak);
+	printf("tracked:      %lu bytes in %u allocations, peak %u\n",
+	       stats.tracked, stats.count, stats.peak_count);
+	if (stats.dropped)
+		printf("not tracked:  %u allocations (table full)\n",
+		       stats.dropped);
+}
+
+void malloc_track_dump(bool since_mark)
+{
+	struct track_entry *ent;
+	ulong now = get_timer(0);
+	int i;
+
+	printf("%-8s %12s %-8s %8s\n", "Address", "Size", "Caller",
+	       "Age(ms)");
+	for (i = 0, ent = track; i < CONFIG_MALLOC_TRACK_ENTRIES; i++, ent++) {
+		if (!ent->ptr || (since_mark && ent->seq <= stats.mark))
+			continue;
+		printf("%08lx %12u %08lx %8lu\n", ent->ptr, ent->size,
+		       track_caller(ent), now - ent->time);
+	}
+}
+
+void malloc_track_mark(void)
+{
+	stats.mark = stats.seq;
+}
+
+struct track_owner {
+	ulong caller;
+	ulong bytes;
+	unsigned int count;
+};
+
+static int h_compare_caller(const void *p1, const void *p2)
+{
+	const struct track_entry *e1 = p1, *e2 = p2;
+
+	if (e1->caller == e2->caller)
+		return 0;
+	return e1->caller > e2->caller ? 1 : -1;
+}
+
+static int h_compare_bytes(const void *p1, const void *p2)
+{
+	const struct track_owner *o1 = p1, *o2 = p2;
+
+	if (o1->bytes == o2->bytes)
+		return 0;
+	return o1->bytes < o2->bytes ? 1 : -1;
+}
+
+int malloc_track_top(int max_owners)
+{
+	struct track_entry *ents;
+	struct track_owner *owners;
+	int count = 0, nowners = 0;
+	int i;
+
+	/* Use dlmalloc() directly so as not to track this */
+	ents = dlmalloc(stats.count * sizeof(*ents) +
+			stats.count * sizeof(*owners) + 1);
+	if (!ents)
+		return -ENOMEM;
+	owners = (struct track_owner *)(ents + stats.count);
+
+	for (i = 0; i < CONFIG_MALLOC_TRACK_ENTRIES; i++) {
+		if (track[i].ptr && count < stats.count)
+			ents[count++] = track[i];
+	}
+	qsort(ents, count, sizeof(*ents), h_compare_caller);
+	for (i = 0; i < count; i++) {
+		if (!nowners || owners[nowners - 1].caller != ents[i].caller) {
+			owners[nowners].caller = ents[i].caller;
+			owners[nowners].bytes = 0;
+			owners[nowners].count = 0;
+			nowners++;
+		}
+		owners[nowners - 1].bytes +=
+			malloc_usable_size((void *)ents[i].ptr);
+		owners[nowners - 1].count++;
+	}
+	qsort(owners, nowners, sizeof(*owners), h_compare_bytes);
+
+	printf("%-8s %12s %8s\n", "Caller", "Bytes", "Count");
+	for (i = 0; i < nowners && i < max_owners; i++) {
+		printf("%08lx %12lu %8u\n", owners[i].caller - gd->reloc_off,
+		       owners[i].bytes, owners[i].count);
+	}
+	dlfree(ents);
+
+	return 0;
+}
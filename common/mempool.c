@@ -0,0 +1,247 @@
+/*
+ * Fixed-size object pools and scratch arenas on top of malloc()
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <mempool.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Pools set up after relocation, for mem_pool_report() */
+static struct mem_pool *mem_pools;
+
+#ifdef CONFIG_SYS_SCRATCH_SIZE
+static struct mem_arena scratch_arena;
+#endif
+
+/* Each chunk starts with this header, followed by the aligned objects */
+struct mem_pool_chunk {
+	struct mem_pool_chunk *next;
+};
+
+static void mem_pool_unlink(struct mem_pool *pool)
+{
+	struct mem_pool **pp;
+
+	/* Pools are only registered after relocation */
+	if (!(gd->flags & GD_FLG_RELOC))
+		return;
+	for (pp = &mem_pools; *pp; pp = &(*pp)->next) {
+		if (*pp == pool) {
+			*pp = pool->next;
+			break;
+		}
+	}
+}
+
+void mem_pool_init(struct mem_pool *pool, const char *name, ulong size,
+		   ulong align, unsigned int per_chunk, unsigned int limit)
+{
+	mem_pool_unlink(pool);
+	memset(pool, '\0', sizeof(*pool));
+	pool->name = name;
+	if (!align)
+		align = sizeof(void *);
+	pool->align = align;
+	/* Free objects hold the free-list link */
+	pool->size = ALIGN(max(size, (ulong)sizeof(void *)), align);
+	pool->per_chunk = per_chunk ? per_chunk : 1;
+	pool->max = limit;
+
+	if (gd->flags & GD_FLG_RELOC) {
+		pool->next = mem_pools;
+		mem_pools = pool;
+	}
+}
+
+void mem_pool_destroy(struct mem_pool *pool)
+{
+	struct mem_pool_chunk *chunk, *next;
+
+	if (pool->in_use)
+		debug("%s: pool '%s' still has %u objects in use\n", __func__,
+		      pool->name, pool->in_use);
+
+	for (chunk = pool->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	pool->chunks = NULL;
+	pool->free_list = NULL;
+	pool->nchunks = 0;
+	pool->in_use = 0;
+	mem_pool_unlink(pool);
+}
+
+static int mem_pool_grow(struct mem_pool *pool)
+{
+	struct mem_pool_chunk *chunk;
+	unsigned int i;
+	char *obj;
+
+	/* memalign() is not available before relocation, so align by hand */
+	chunk = malloc(sizeof(*chunk) + pool->align - 1 +
+		       pool->size * pool->per_chunk);
+	if (!chunk)
+		return -ENOMEM;
+	chunk->next = pool->chunks;
+	pool->chunks = chunk;
+	pool->nchunks++;
+
+	obj = (char *)ALIGN((ulong)(chunk + 1), pool->align);
+	for (i = 0; i < pool->per_chunk; i++, obj += pool->size) {
+		*(void **)obj = pool->free_list;
+		pool->free_list = obj;
+	}
+
+	return 0;
+}
+
+void *mem_pool_alloc(struct mem_pool *pool)
+{
+	void *obj;
+
+	if ((pool->max && pool->in_use >= pool->max) ||
+	    (!pool->free_list && mem_pool_grow(pool))) {
+		pool->fails++;
+		return NULL;
+	}
+
+	obj = pool->free_list;
+	pool->free_list = *(void **)obj;
+	pool->allocs++;
+	if (++pool->in_use > pool->peak)
+		pool->peak = pool->in_use;
+
+	return obj;
+}
+
+void *mem_pool_zalloc(struct mem_pool *pool)
+{
+	void *obj = mem_pool_alloc(pool);
+
+	if (obj)
+		memset(obj, '\0', pool->size);
+
+	return obj;
+}
+
+void mem_pool_free(struct mem_pool *pool, void *ptr)
+{
+	if (!ptr)
+		return;
+
+	*(void **)ptr = pool->free_list;
+	pool->free_list = ptr;
+	pool->in_use--;
+}
+
+void mem_arena_init(struct mem_arena *arena, void *base, ulong size)
+{
+	arena->base = base;
+	arena->size = size;
+	arena->used = 0;
+	arena->peak = 0;
+}
+
+void *mem_arena_alloc(struct mem_arena *arena, ulong size)
+{
+	return mem_arena_memalign(arena, ARCH_DMA_MINALIGN, size);
+}
+
+void *mem_arena_memalign(struct mem_arena *arena, ulong align, ulong size)
+{
+	ulong start;
+
+	/* Keep other allocations out of the cache lines of this one */
+	if (align < ARCH_DMA_MINALIGN)
+		align = ARCH_DMA_MINALIGN;
+	start = ALIGN((ulong)arena->base + arena->used, align) -
+		(ulong)arena->base;
+
+	if (start > arena->size || size > arena->size - start)
+		return NULL;
+	arena->used = start + size;
+	if (arena->used > arena->peak)
+		arena->peak = arena->used;
+
+	return arena->base + start;
+}
+
+void mem_arena_release(struct mem_arena *arena, ulong mark)
+{
+	if (mark < arena->used)
+		arena->used = mark;
+}
+
+void mem_arena_free(struct mem_arena *arena, void *ptr)
+{
+	mem_arena_release(arena, (char *)ptr - arena->base);
+}
+
+#ifdef CONFIG_SYS_SCRATCH_SIZE
+int scratch_init(void)
+{
+	void *base = malloc(CONFIG_SYS_SCRATCH_SIZE);
+
+	if (!base)
+		return -ENOMEM;
+	mem_arena_init(&scratch_arena, base, CONFIG_SYS_SCRATCH_SIZE);
+
+	return 0;
+}
+
+void *scratch_alloc(ulong size)
+{
+	return mem_arena_alloc(&scratch_arena, size);
+}
+
+ulong scratch_mark(void)
+{
+	return mem_arena_mark(&scratch_arena);
+}
+
+void scratch_release(ulong mark)
+{
+	mem_arena_release(&scratch_arena, mark);
+}
+
+void *scratch_memalign(ulong align, ulong size)
+{
+	void *ptr = mem_arena_memalign(&scratch_arena, align, size);
+
+	return ptr ? ptr : memalign(align, size);
+}
+
+void scratch_free(void *ptr)
+{
+	char *p = ptr;
+
+	if (p >= scratch_arena.base &&
+	    p < scratch_arena.base + scratch_arena.size)
+		mem_arena_free(&scratch_arena, ptr);
+	else
+		free(ptr);
+}
+#endif
+
+void mem_pool_report(void)
+{
+	struct mem_pool *pool;
+
+	printf("%-16s %6s %6s %6s %6s %8s %6s\n", "Pool", "Size", "Used",
+	       "Peak", "Chunks", "Allocs", "Fails");
+	for (pool = mem_pools; pool; pool = pool->next) {
+		printf("%-16s %6lu %6u %6u %6u %8lu %6lu\n", pool->name,
+		       pool->size, pool->in_use, pool->peak, pool->nchunks,
+		       pool->allocs, pool->fails);
+	}
+#ifdef CONFIG_SYS_SCRATCH_SIZE
+	printf("\nScratch arena: %lu of %lu bytes used, peak %lu\n",
+	       scratch_arena.used, scratch_arena.size, scratch_arena.peak);
+#endif
+}
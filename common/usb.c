@@ -872,6 +872,14 @@ __weak int usb_alloc_device(struct usb_device *udev)
 {
 	return 0;
 }
+
+__weak int usb_get_max_xfer_size(struct usb_device *dev, size_t *size)
+{
+	*size = USB_DEFAULT_MAX_XFER_SIZE;
+
+	return 0;
+}
+
 /*
  * By the time we get here, the device has gotten a new device ID
  * and is in the default state. We need to identify the thing and
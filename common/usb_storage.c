@@ -33,6 +33,7 @@
 
 #include <common.h>
 #include <command.h>
+#include <errno.h>
 #include <asm/byteorder.h>
 #include <asm/processor.h>
 
@@ -131,16 +132,12 @@ struct us_data {
 	trans_cmnd	transport;		/* transport routine */
 };
 
-#ifdef CONFIG_USB_EHCI
 /*
- * The U-Boot EHCI driver can handle any transfer length as long as there is
- * enough free heap space left, but the SCSI READ(10) and WRITE(10) commands are
- * limited to 65535 blocks.
+ * The SCSI READ(10) and WRITE(10) commands are limited to 65535 blocks. Each
+ * command is further limited to what the host controller can transfer at
+ * once, see usb_stor_max_blks().
  */
 #define USB_MAX_XFER_BLK	65535
-#else
-#define USB_MAX_XFER_BLK	20
-#endif
 
 static struct us_data usb_stor[USB_MAX_STOR_DEV];
 
@@ -472,6 +469,22 @@ static int usb_stor_CB_reset(struct us_data *us)
 	return 0;
 }
 
+/* Fill in the CBW for a command, copying the SCSI command into CBWCDB */
+static void usb_stor_BBB_setup_cbw(ccb *srb, umass_bbb_cbw_t *cbw)
+{
+	int dir_in = US_DIRECTION(srb->cmd[0]);
+
+	cbw->dCBWSignature = cpu_to_le32(CBWSIGNATURE);
+	cbw->dCBWTag = cpu_to_le32(CBWTag++);
+	cbw->dCBWDataTransferLength = cpu_to_le32(srb->datalen);
+	cbw->bCBWFlags = (dir_in ? CBWFLAGS_IN : CBWFLAGS_OUT);
+	cbw->bCBWLUN = srb->lun;
+	cbw->bCDBLength = srb->cmdlen;
+	/* copy the command data into the CBW command data buffer */
+	/* DST SRC LEN!!! */
+	memcpy(cbw->CBWCDB, srb->cmd, srb->cmdlen);
+}
+
 /*
  * Set up the command for a BBB device. Note that the actual SCSI
  * command is copied into cbw.CBWCDB.
@@ -480,15 +493,12 @@ static int usb_stor_BBB_comdat(ccb *srb, struct us_data *us)
 {
 	int result;
 	int actlen;
-	int dir_in;
 	unsigned int pipe;
 	ALLOC_CACHE_ALIGN_BUFFER(umass_bbb_cbw_t, cbw, 1);
 
-	dir_in = US_DIRECTION(srb->cmd[0]);
-
 #ifdef BBB_COMDAT_TRACE
 	printf("dir %d lun %d cmdlen %d cmd %p datalen %lu pdata %p\n",
-		dir_in, srb->lun, srb->cmdlen, srb->cmd, srb->datalen,
+		US_DIRECTION(srb->cmd[0]), srb->lun, srb->cmdlen, srb->cmd, srb->datalen,
 		srb->pdata);
 	if (srb->cmdlen) {
 		for (result = 0; result < srb->cmdlen; result++)
@@ -505,15 +515,7 @@ static int usb_stor_BBB_comdat(ccb *srb, struct us_data *us)
 	/* always OUT to the ep */
 	pipe = usb_sndbulkpipe(us->pusb_dev, us->ep_out);
 
-	cbw->dCBWSignature = cpu_to_le32(CBWSIGNATURE);
-	cbw->dCBWTag = cpu_to_le32(CBWTag++);
-	cbw->dCBWDataTransferLength = cpu_to_le32(srb->datalen);
-	cbw->bCBWFlags = (dir_in ? CBWFLAGS_IN : CBWFLAGS_OUT);
-	cbw->bCBWLUN = srb->lun;
-	cbw->bCDBLength = srb->cmdlen;
-	/* copy the command data into the CBW command data buffer */
-	/* DST SRC LEN!!! */
-	memcpy(cbw->CBWCDB, srb->cmd, srb->cmdlen);
+	usb_stor_BBB_setup_cbw(srb, cbw);
 	result = usb_bulk_msg(us->pusb_dev, pipe, cbw, UMASS_BBB_CBW_SIZE,
 			      &actlen, USB_CNTL_TIMEOUT * 5);
 	if (result < 0)
@@ -979,8 +981,8 @@ static int usb_read_capacity(ccb *srb, struct us_data *ss)
 	return -1;
 }
 
-static int usb_read_10(ccb *srb, struct us_data *ss, unsigned long start,
-		       unsigned short blocks)
+static void usb_setup_read_10(ccb *srb, unsigned long start,
+			      unsigned short blocks)
 {
 	memset(&srb->cmd[0], 0, 12);
 	srb->cmd[0] = SCSI_READ10;
@@ -993,6 +995,12 @@ static int usb_read_10(ccb *srb, struct us_data *ss, unsigned long start,
 	srb->cmd[8] = (unsigned char) blocks & 0xff;
 	srb->cmdlen = 12;
 	debug("read10: start %lx blocks %x\n", start, blocks);
+}
+
+static int usb_read_10(ccb *srb, struct us_data *ss, unsigned long start,
+		       unsigned short blocks)
+{
+	usb_setup_read_10(srb, start, blocks);
 	return ss->transport(srb, ss);
 }
 
@@ -1037,12 +1045,159 @@ static void usb_bin_fixup(struct usb_device_descriptor descriptor,
 }
 #endif /* CONFIG_USB_BIN_FIXUP */
 
+/*
+ * Return the most blocks to move with one command, from what the host
+ * controller can transfer at once.
+ */
+static unsigned short usb_stor_max_blks(struct us_data *ss,
+					unsigned long blksz)
+{
+	size_t size;
+
+	if (usb_get_max_xfer_size(ss->pusb_dev, &size))
+		size = USB_DEFAULT_MAX_XFER_SIZE;
+	if (!blksz || size / blksz >= USB_MAX_XFER_BLK)
+		return USB_MAX_XFER_BLK;
+
+	return size >= blksz ? size / blksz : 1;
+}
+
+#ifdef CONFIG_USB_STORAGE_PIPELINE
+/* Give up on a queued transfer after this long, as EHCI does for bulk */
+#define USB_STOR_QUEUE_TIMEOUT	5000
+
+static int usb_stor_queue_wait(struct us_data *us, struct bulk_queue *queue,
+			       int *actlen)
+{
+	ulong start = get_timer(0);
+	int ret;
+
+	do {
+		ret = bulk_queue_poll(us->pusb_dev, queue, actlen);
+		if (ret != -EINPROGRESS)
+			return ret;
+	} while (get_timer(start) < USB_STOR_QUEUE_TIMEOUT);
+
+	debug("usb_stor_queue_wait: timeout\n");
+	return -ETIMEDOUT;
+}
+
+/* Check a CSW: 0 if the command passed, 1 if it failed, -1 if it is bad */
+static int usb_stor_BBB_csw_status(umass_bbb_csw_t *csw, int actlen)
+{
+	if (actlen != UMASS_BBB_CSW_SIZE ||
+	    le32_to_cpu(csw->dCSWSignature) != CSWSIGNATURE ||
+	    le32_to_cpu(csw->dCSWTag) != CBWTag - 1 ||
+	    csw->bCSWStatus > CSWSTATUS_FAILED)
+		return -1;
+
+	return csw->bCSWStatus == CSWSTATUS_FAILED || csw->dCSWDataResidue;
+}
+
+/*
+ * Read from a BBB device with the bulk endpoints' transfers queued ahead.
+ * Each command's data and CSW are queued with its CBW, and as soon as the
+ * data is in, the next command's data phase is queued behind the CSW, so
+ * the device can send it as soon as it has the next CBW. The CBW itself
+ * still waits for the CSW before it, as Bulk-Only Transport requires.
+ *
+ * Returns the number of blocks read. Whatever is left, including a command
+ * that failed, is then read one command at a time, which also handles the
+ * sense data.
+ */
+static lbaint_t usb_stor_read_pipelined(ccb *srb, struct us_data *ss,
+					lbaint_t start, lbaint_t blks,
+					uintptr_t buf_addr,
+					unsigned long blksz,
+					unsigned short max_blks)
+{
+	struct usb_device *dev = ss->pusb_dev;
+	struct bulk_queue *in, *out = NULL;
+	ALLOC_CACHE_ALIGN_BUFFER(umass_bbb_cbw_t, cbw, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(umass_bbb_csw_t, csw, 1);
+	lbaint_t done = 0;
+	unsigned short cur, next;
+	int actlen, status, reset = 1;
+
+	in = get_bulk_queue(dev, usb_rcvbulkpipe(dev, ss->ep_in), 2,
+			    max_blks * blksz + UMASS_BBB_CSW_SIZE);
+	if (in)
+		out = get_bulk_queue(dev, usb_sndbulkpipe(dev, ss->ep_out),
+				     1, UMASS_BBB_CBW_SIZE);
+	if (!out) {
+		reset = 0;
+		goto out;
+	}
+
+	cur = min(blks, (lbaint_t)max_blks);
+	srb->datalen = blksz * cur;
+	usb_setup_read_10(srb, start, cur);
+	usb_stor_BBB_setup_cbw(srb, cbw);
+	if (bulk_queue_submit(dev, in, (void *)buf_addr, srb->datalen) ||
+	    bulk_queue_submit(dev, in, csw, UMASS_BBB_CSW_SIZE) ||
+	    bulk_queue_submit(dev, out, cbw, UMASS_BBB_CBW_SIZE))
+		goto out;
+
+	for (;;) {
+		if (cur == max_blks)
+			usb_show_progress();
+		if (usb_stor_queue_wait(ss, out, &actlen) ||
+		    actlen != UMASS_BBB_CBW_SIZE)
+			goto out;
+		if (usb_stor_queue_wait(ss, in, &actlen) ||
+		    actlen != srb->datalen)
+			goto out;
+
+		next = min(blks - done - cur, (lbaint_t)max_blks);
+		if (next && bulk_queue_submit(dev, in,
+					      (void *)buf_addr + srb->datalen,
+					      blksz * next))
+			goto out;
+
+		if (usb_stor_queue_wait(ss, in, &actlen))
+			goto out;
+		status = usb_stor_BBB_csw_status(csw, actlen);
+		if (status) {
+			/* The device is in step with us unless the CSW is bad */
+			debug("usb_stor_read_pipelined: CSW status %d\n",
+			      status);
+			reset = status < 0;
+			goto out;
+		}
+
+		done += cur;
+		if (!next)
+			break;
+		start += cur;
+		buf_addr += srb->datalen;
+		cur = next;
+		srb->datalen = blksz * cur;
+		usb_setup_read_10(srb, start, cur);
+		usb_stor_BBB_setup_cbw(srb, cbw);
+		if (bulk_queue_submit(dev, in, csw, UMASS_BBB_CSW_SIZE) ||
+		    bulk_queue_submit(dev, out, cbw, UMASS_BBB_CBW_SIZE))
+			goto out;
+	}
+	reset = 0;
+
+out:
+	if (out)
+		put_bulk_queue(dev, out);
+	if (in)
+		put_bulk_queue(dev, in);
+	if (reset)
+		usb_stor_BBB_reset(ss);
+
+	return done;
+}
+#endif /* CONFIG_USB_STORAGE_PIPELINE */
+
 unsigned long usb_stor_read(int device, lbaint_t blknr,
 			    lbaint_t blkcnt, void *buffer)
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks = 0, max_blks;
 	struct usb_device *dev;
 	struct us_data *ss;
 	int retry, i;
@@ -1070,19 +1225,34 @@ unsigned long usb_stor_read(int device, lbaint_t blknr,
 	start = blknr;
 	blks = blkcnt;
 
+	max_blks = usb_stor_max_blks(ss, usb_dev_desc[device].blksz);
+
 	debug("\nusb_read: dev %d startblk " LBAF ", blccnt " LBAF
 	      " buffer %lx\n", device, start, blks, buf_addr);
 
-	do {
+#ifdef CONFIG_USB_STORAGE_PIPELINE
+	if (ss->protocol == US_PR_BULK) {
+		lbaint_t done;
+
+		done = usb_stor_read_pipelined(srb, ss, start, blks, buf_addr,
+					       usb_dev_desc[device].blksz,
+					       max_blks);
+		start += done;
+		blks -= done;
+		buf_addr += usb_dev_desc[device].blksz * done;
+	}
+#endif
+
+	while (blks != 0) {
 		/* XXX need some comment here */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
+		if (blks > max_blks)
+			smallblks = max_blks;
 		else
 			smallblks = (unsigned short) blks;
 retry_it:
-		if (smallblks == USB_MAX_XFER_BLK)
+		if (smallblks == max_blks)
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
@@ -1097,7 +1267,7 @@ retry_it:
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
-	} while (blks != 0);
+	}
 	ss->flags &= ~USB_READY;
 
 	debug("usb_read: end startblk " LBAF
@@ -1105,7 +1275,7 @@ retry_it:
 	      start, smallblks, buf_addr);
 
 	usb_disable_asynch(0); /* asynch transfer allowed */
-	if (blkcnt >= USB_MAX_XFER_BLK)
+	if (blkcnt >= max_blks)
 		debug("\n");
 	return blkcnt;
 }
@@ -1115,7 +1285,7 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks, max_blks;
 	struct usb_device *dev;
 	struct us_data *ss;
 	int retry, i;
@@ -1144,6 +1314,8 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 	start = blknr;
 	blks = blkcnt;
 
+	max_blks = usb_stor_max_blks(ss, usb_dev_desc[device].blksz);
+
 	debug("\nusb_write: dev %d startblk " LBAF ", blccnt " LBAF
 	      " buffer %lx\n", device, start, blks, buf_addr);
 
@@ -1153,12 +1325,12 @@ unsigned long usb_stor_write(int device, lbaint_t blknr,
 		 */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
-		if (blks > USB_MAX_XFER_BLK)
-			smallblks = USB_MAX_XFER_BLK;
+		if (blks > max_blks)
+			smallblks = max_blks;
 		else
 			smallblks = (unsigned short) blks;
 retry_it:
-		if (smallblks == USB_MAX_XFER_BLK)
+		if (smallblks == max_blks)
 			usb_show_progress();
 		srb->datalen = usb_dev_desc[device].blksz * smallblks;
 		srb->pdata = (unsigned char *)buf_addr;
@@ -1180,7 +1352,7 @@ retry_it:
 	      start, smallblks, buf_addr);
 
 	usb_disable_asynch(0); /* asynch transfer allowed */
-	if (blkcnt >= USB_MAX_XFER_BLK)
+	if (blkcnt >= max_blks)
 		debug("\n");
 	return blkcnt;
 
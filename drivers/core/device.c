@@ -12,10 +12,12 @@
 #include <common.h>
 #include <fdtdec.h>
 #include <malloc.h>
+#include <watchdog.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/platdata.h>
+#include <dm/root.h>
 #include <dm/uclass.h>
 #include <dm/uclass-internal.h>
 #include <dm/util.h>
@@ -175,7 +177,8 @@ int device_unbind(struct udevice *dev)
 	if (!dev)
 		return -EINVAL;
 
-	if (dev->flags & DM_FLAG_ACTIVATED)
+	/* A device that is still probing must be removed first */
+	if (dev->flags & (DM_FLAG_ACTIVATED | DM_FLAG_PROBING | DM_FLAG_POLLING))
 		return -EINVAL;
 
 	drv = dev->driver;
@@ -232,7 +235,33 @@ static void device_free(struct udevice *dev)
 	}
 }
 
-int device_probe(struct udevice *dev)
+/**
+ * device_probe_done() - Finish probing a device once its driver is ready
+ * @dev:	Device that has been probed by its driver
+ * @return 0 on success, -ve on error
+ */
+static int device_probe_done(struct udevice *dev)
+{
+	int ret;
+
+	dev->probe_time = bootstage_accum_name(dev->name, dev->probe_start);
+	dev->flags |= DM_FLAG_ACTIVATED;
+
+	ret = uclass_post_probe_device(dev);
+	if (ret) {
+		dev->flags &= ~DM_FLAG_ACTIVATED;
+		if (device_remove(dev)) {
+			dm_warn("%s: Device '%s' failed to remove on error path\n",
+				__func__, dev->name);
+		}
+		dev->seq = -1;
+		device_free(dev);
+	}
+
+	return ret;
+}
+
+int device_probe_start(struct udevice *dev)
 {
 	struct driver *drv;
 	int size = 0;
@@ -242,7 +271,7 @@ int device_probe(struct udevice *dev)
 	if (!dev)
 		return -EINVAL;
 
-	if (dev->flags & DM_FLAG_ACTIVATED)
+	if (dev->flags & (DM_FLAG_ACTIVATED | DM_FLAG_PROBING))
 		return 0;
 
 	drv = dev->driver;
@@ -308,26 +337,22 @@ int device_probe(struct udevice *dev)
 			goto fail;
 	}
 
+#ifdef CONFIG_BOOTSTAGE
+	dev->probe_start = timer_get_boot_us();
+#endif
 	if (drv->probe) {
 		ret = drv->probe(dev);
 		if (ret)
 			goto fail;
 	}
 
-	dev->flags |= DM_FLAG_ACTIVATED;
-
-	ret = uclass_post_probe_device(dev);
-	if (ret) {
-		dev->flags &= ~DM_FLAG_ACTIVATED;
-		goto fail_uclass;
+	/* The driver finishes off in probe_poll(), see device_probe_poll() */
+	if (drv->probe_poll) {
+		dev->flags |= DM_FLAG_PROBING;
+		return 0;
 	}
 
-	return 0;
-fail_uclass:
-	if (device_remove(dev)) {
-		dm_warn("%s: Device '%s' failed to remove on error path\n",
-			__func__, dev->name);
-	}
+	return device_probe_done(dev);
 fail:
 	dev->seq = -1;
 	device_free(dev);
@@ -335,6 +360,62 @@ fail:
 	return ret;
 }
 
+int device_probe_poll(struct udevice *dev)
+{
+	int ret;
+
+	if (!dev)
+		return -EINVAL;
+
+	if (!(dev->flags & DM_FLAG_PROBING))
+		return device_active(dev) ? 0 : -ENODEV;
+
+	/* Polling this device already, further up the call stack */
+	if (dev->flags & DM_FLAG_POLLING)
+		return -EAGAIN;
+
+	dev->flags |= DM_FLAG_POLLING;
+	ret = dev->driver->probe_poll(dev);
+	dev->flags &= ~DM_FLAG_POLLING;
+	if (ret == -EAGAIN)
+		return ret;
+
+	dev->flags &= ~DM_FLAG_PROBING;
+	if (ret) {
+		dev->seq = -1;
+		device_free(dev);
+		return ret;
+	}
+
+	return device_probe_done(dev);
+}
+
+int device_probe(struct udevice *dev)
+{
+	int ret;
+
+	ret = device_probe_start(dev);
+	if (ret)
+		return ret;
+
+	/* A driver cannot wait for its own device from within probe_poll() */
+	if (dev->flags & DM_FLAG_POLLING)
+		return -EDEADLK;
+
+	/*
+	 * Let other devices make progress while this one finishes. This one
+	 * is only polled here, so that its error comes back to the caller.
+	 */
+	dev->flags |= DM_FLAG_JOINING;
+	while ((ret = device_probe_poll(dev)) == -EAGAIN) {
+		dm_probe_poll();
+		WATCHDOG_RESET();
+	}
+	dev->flags &= ~DM_FLAG_JOINING;
+
+	return ret;
+}
+
 int device_remove(struct udevice *dev)
 {
 	struct driver *drv;
@@ -343,6 +424,10 @@ int device_remove(struct udevice *dev)
 	if (!dev)
 		return -EINVAL;
 
+	/* Let the driver finish probing before it is asked to remove */
+	if (dev->flags & DM_FLAG_PROBING)
+		device_probe(dev);
+
 	if (!(dev->flags & DM_FLAG_ACTIVATED))
 		return 0;
 
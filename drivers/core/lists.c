@@ -104,7 +104,7 @@ static int driver_check_compatible(const void *blob, int offset,
 		return -ENOENT;
 
 	while (of_match->compatible) {
-		ret = fdt_node_check_compatible(blob, offset,
+		ret = fdtdec_node_check_compatible(blob, offset,
 						of_match->compatible);
 		if (!ret)
 			return 0;
@@ -9,6 +9,7 @@
 
 #include <common.h>
 #include <errno.h>
+#include <fdtdec.h>
 #include <malloc.h>
 #include <libfdt.h>
 #include <dm/device.h>
@@ -113,6 +114,46 @@ __weak int dm_scan_other(bool pre_reloc_only)
 	return 0;
 }
 
+static void dm_probe_async_dev(struct udevice *dev)
+{
+	struct udevice *child;
+	int ret;
+
+	if (dev->driver->probe_poll && !device_active(dev)) {
+		ret = device_probe_start(dev);
+		if (ret)
+			dm_warn("%s: Device '%s' failed to start probing: %d\n",
+				__func__, dev->name, ret);
+	}
+
+	list_for_each_entry(child, &dev->child_head, sibling_node)
+		dm_probe_async_dev(child);
+}
+
+void dm_probe_async(void)
+{
+	if (gd->dm_root)
+		dm_probe_async_dev(gd->dm_root);
+}
+
+static void dm_probe_poll_dev(struct udevice *dev)
+{
+	struct udevice *child;
+
+	if ((dev->flags & (DM_FLAG_PROBING | DM_FLAG_JOINING)) ==
+	    DM_FLAG_PROBING)
+		device_probe_poll(dev);
+
+	list_for_each_entry(child, &dev->child_head, sibling_node)
+		dm_probe_poll_dev(child);
+}
+
+void dm_probe_poll(void)
+{
+	if (gd->dm_root)
+		dm_probe_poll_dev(gd->dm_root);
+}
+
 int dm_init_and_scan(bool pre_reloc_only)
 {
 	int ret;
@@ -128,6 +169,8 @@ int dm_init_and_scan(bool pre_reloc_only)
 		return ret;
 	}
 #ifdef CONFIG_OF_CONTROL
+	/* Without an index the lookups just walk the tree */
+	fdtdec_index_build();
 	ret = dm_scan_fdt(gd->fdt_blob, pre_reloc_only);
 	if (ret) {
 		debug("dm_scan_fdt() failed: %d\n", ret);
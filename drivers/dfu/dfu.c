@@ -10,6 +10,7 @@
 #include <common.h>
 #include <errno.h>
 #include <malloc.h>
+#include <div64.h>
 #include <mmc.h>
 #include <fat.h>
 #include <dfu.h>
@@ -91,10 +92,46 @@ int dfu_init_env_entities(char *interface, char *devstr)
 static unsigned char *dfu_buf;
 static unsigned long dfu_buf_size = CONFIG_SYS_DFU_DATA_BUF_SIZE;
 
+/*
+ * Downloads are gathered in CONFIG_SYS_DFU_BUF_COUNT buffers of
+ * dfu_buf_size bytes each, one after the other in dfu_buf. A buffer that
+ * is full is queued and written out a step at a time by dfu_write_poll(),
+ * between USB requests, while the next buffer fills. Only when all of them
+ * are full does dfu_write() wait for the medium.
+ */
+static struct {
+	struct dfu_entity *dfu;		/* entity the queued data is for */
+	unsigned int head;		/* buffer being written out */
+	unsigned int count;		/* full buffers in the queue */
+	long done;			/* bytes of the head buffer written */
+	long len[CONFIG_SYS_DFU_BUF_COUNT];
+	int error;			/* from a write in dfu_write_poll() */
+
+	/* statistics for the transfer */
+	ulong start;			/* get_timer() at the first block */
+	u64 bytes;
+	ulong write_ms;			/* time spent writing the medium */
+	ulong wait_ms;			/* of which, with no free buffer */
+} dfu_queue;
+
+static unsigned char *dfu_queue_buf(unsigned int n)
+{
+	return dfu_buf + (n % CONFIG_SYS_DFU_BUF_COUNT) * dfu_buf_size;
+}
+
+/* Start filling the buffer that follows the queued ones */
+static void dfu_queue_next(struct dfu_entity *dfu)
+{
+	dfu->i_buf_start = dfu_queue_buf(dfu_queue.head + dfu_queue.count);
+	dfu->i_buf_end = dfu->i_buf_start + dfu_buf_size;
+	dfu->i_buf = dfu->i_buf_start;
+}
+
 unsigned char *dfu_free_buf(void)
 {
 	free(dfu_buf);
 	dfu_buf = NULL;
+	memset(&dfu_queue, '\0', sizeof(dfu_queue));
 	return dfu_buf;
 }
 
@@ -116,10 +153,13 @@ unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 	if (dfu->max_buf_size && dfu_buf_size > dfu->max_buf_size)
 		dfu_buf_size = dfu->max_buf_size;
 
-	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size);
+	/* Keep each buffer aligned for DMA */
+	dfu_buf_size = ALIGN(dfu_buf_size, CONFIG_SYS_CACHELINE_SIZE);
+	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE,
+			   dfu_buf_size * CONFIG_SYS_DFU_BUF_COUNT);
 	if (dfu_buf == NULL)
 		printf("%s: Could not memalign 0x%lx bytes\n",
-		       __func__, dfu_buf_size);
+		       __func__, dfu_buf_size * CONFIG_SYS_DFU_BUF_COUNT);
 
 	return dfu_buf;
 }
@@ -141,35 +181,127 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
-static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+/*
+ * Write out the next part of the head buffer of the queue, of up to
+ * dfu->write_step bytes, or all of it if @all is set or the medium has no
+ * step.
+ */
+static int dfu_write_buffer_step(struct dfu_entity *dfu, bool all)
 {
-	long w_size;
+	unsigned char *buf;
+	long w_size, left;
+	ulong start;
 	int ret;
 
-	/* flush size? */
-	w_size = dfu->i_buf - dfu->i_buf_start;
-	if (w_size == 0)
-		return 0;
+	buf = dfu_queue_buf(dfu_queue.head) + dfu_queue.done;
+	left = dfu_queue.len[dfu_queue.head] - dfu_queue.done;
+	w_size = left;
+	if (!all && dfu->write_step && w_size > dfu->write_step)
+		w_size = dfu->write_step;
 
 	if (dfu_hash_algo)
 		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
+					   buf, w_size, 0);
 
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
-	if (ret)
+	start = get_timer(0);
+	ret = dfu->write_medium(dfu, dfu->offset, buf, &w_size);
+	dfu_queue.write_ms += get_timer(start);
+	if (ret) {
 		debug("%s: Write error!\n", __func__);
-
-	/* point back */
-	dfu->i_buf = dfu->i_buf_start;
+		return ret;
+	}
 
 	/* update offset */
 	dfu->offset += w_size;
 
-	puts("#");
+	/* The medium may round the last write of the buffer up */
+	if (w_size >= left) {
+		dfu_queue.head = (dfu_queue.head + 1) % CONFIG_SYS_DFU_BUF_COUNT;
+		dfu_queue.count--;
+		dfu_queue.done = 0;
+		puts("#");
+	} else {
+		dfu_queue.done += w_size;
+	}
+
+	return 0;
+}
+
+/* Write out everything queued */
+static int dfu_write_queue_drain(struct dfu_entity *dfu)
+{
+	int ret = dfu_queue.error;
+
+	while (!ret && dfu_queue.count)
+		ret = dfu_write_buffer_step(dfu, true);
 
 	return ret;
 }
 
+/*
+ * Queue the buffer being filled, if it holds anything, and move on to the
+ * next one. If that one is still queued, it is written out first.
+ */
+static int dfu_write_buffer_queue(struct dfu_entity *dfu)
+{
+	ulong start;
+	int ret;
+
+	if (dfu->i_buf == dfu->i_buf_start)
+		return 0;
+
+	dfu_queue.len[(dfu_queue.head + dfu_queue.count) %
+		      CONFIG_SYS_DFU_BUF_COUNT] = dfu->i_buf - dfu->i_buf_start;
+	dfu_queue.count++;
+	if (dfu_queue.count == CONFIG_SYS_DFU_BUF_COUNT) {
+		start = get_timer(0);
+		ret = dfu_queue.error;
+		if (!ret)
+			ret = dfu_write_buffer_step(dfu, true);
+		dfu_queue.wait_ms += get_timer(start);
+		if (ret)
+			return ret;
+	}
+	dfu_queue_next(dfu);
+
+	return 0;
+}
+
+static int dfu_write_buffer_drain(struct dfu_entity *dfu)
+{
+	int ret;
+
+	ret = dfu_write_buffer_queue(dfu);
+	if (!ret)
+		ret = dfu_write_queue_drain(dfu);
+
+	/* Start again at the first buffer, which callers may fill directly */
+	if (!ret) {
+		dfu_queue.head = 0;
+		dfu_queue_next(dfu);
+	}
+
+	return ret;
+}
+
+void dfu_write_poll(void)
+{
+	if (!dfu_queue.count || dfu_queue.error)
+		return;
+
+	dfu_queue.error = dfu_write_buffer_step(dfu_queue.dfu, false);
+}
+
+static void dfu_write_stats(void)
+{
+	ulong ms = get_timer(dfu_queue.start);
+
+	printf("\nDFU: %llu bytes in %lu ms, %llu KiB/s (writing %lu ms, of which waiting %lu ms)\n",
+	       dfu_queue.bytes, ms,
+	       lldiv((dfu_queue.bytes >> 10) * 1000, ms ? ms : 1),
+	       dfu_queue.write_ms, dfu_queue.wait_ms);
+}
+
 void dfu_write_transaction_cleanup(struct dfu_entity *dfu)
 {
 	/* clear everything */
@@ -198,6 +330,9 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 		printf("\nDFU complete %s: 0x%08x\n", dfu_hash_algo->name,
 		       dfu->crc);
 
+	if (!ret)
+		dfu_write_stats();
+
 	dfu_write_transaction_cleanup(dfu);
 
 	return ret;
@@ -217,11 +352,12 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 		dfu->offset = 0;
 		dfu->bad_skip = 0;
 		dfu->i_blk_seq_num = 0;
-		dfu->i_buf_start = dfu_get_buf(dfu);
-		if (dfu->i_buf_start == NULL)
+		if (dfu_get_buf(dfu) == NULL)
 			return -ENOMEM;
-		dfu->i_buf_end = dfu_get_buf(dfu) + dfu_buf_size;
-		dfu->i_buf = dfu->i_buf_start;
+		memset(&dfu_queue, '\0', sizeof(dfu_queue));
+		dfu_queue.dfu = dfu;
+		dfu_queue.start = get_timer(0);
+		dfu_queue_next(dfu);
 
 		dfu->inited = 1;
 	}
@@ -249,9 +385,9 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	/* handle rollover */
 	dfu->i_blk_seq_num = (dfu->i_blk_seq_num + 1) & 0xffff;
 
-	/* flush buffer if overflow */
+	/* move on to the next buffer if overflow */
 	if ((dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_queue(dfu);
 		if (ret) {
 			dfu_write_transaction_cleanup(dfu);
 			return ret;
@@ -268,14 +404,22 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 	memcpy(dfu->i_buf, buf, size);
 	dfu->i_buf += size;
+	dfu_queue.bytes += size;
 
-	/* if end or if buffer full flush */
-	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
+	/*
+	 * Callers like thor receive straight into dfu_get_buf(), which must
+	 * then be written out before it is filled again.
+	 */
+	if (buf == dfu_buf)
 		ret = dfu_write_buffer_drain(dfu);
-		if (ret) {
-			dfu_write_transaction_cleanup(dfu);
-			return ret;
-		}
+	/* if end or if buffer full queue it */
+	else if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end)
+		ret = dfu_write_buffer_queue(dfu);
+	else
+		ret = dfu_queue.error;
+	if (ret) {
+		dfu_write_transaction_cleanup(dfu);
+		return ret;
 	}
 
 	return 0;
@@ -422,6 +566,7 @@ static int dfu_fill_entity(struct dfu_entity *dfu, char *s, int alt,
 
 	dfu->alt = alt;
 	dfu->max_buf_size = 0;
+	dfu->write_step = 0;
 	dfu->free_entity = NULL;
 
 	/* Specific for mmc device */
@@ -460,6 +605,9 @@ void dfu_free_entities(void)
 		free(t);
 	INIT_LIST_HEAD(&dfu_list);
 
+	/* Drop anything still queued for the entities */
+	dfu_free_buf();
+
 	alt_num_cnt = 0;
 }
 
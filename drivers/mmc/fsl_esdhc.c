@@ -47,24 +47,36 @@ struct fsl_esdhc {
 	uint    fevt;		/* Force event register */
 	uint    admaes;		/* ADMA error status register */
 	uint    adsaddr;	/* ADMA system address register */
-	char    reserved2[160];	/* reserved */
+	char    reserved2[4];	/* reserved */
+	uint    dllctrl;	/* For USDHC */
+	uint    dllstat;	/* For USDHC */
+	uint    clktunectrlstatus;	/* For USDHC */
+	char    reserved3[84];	/* reserved */
+	uint    vendorspec;	/* For USDHC */
+	uint    mmcboot;	/* For USDHC */
+	uint    vendorspec2;	/* For USDHC */
+	char    reserved4[48];	/* reserved */
 	uint    hostver;	/* Host controller version register */
-	char    reserved3[4];	/* reserved */
+	char    reserved5[4];	/* reserved */
 	uint    dmaerraddr;	/* DMA error address register */
-	char    reserved4[4];	/* reserved */
+	char    reserved6[4];	/* reserved */
 	uint    dmaerrattr;	/* DMA error attribute register */
-	char    reserved5[4];	/* reserved */
+	char    reserved7[4];	/* reserved */
 	uint    hostcapblt2;	/* Host controller capabilities register 2 */
-	char    reserved6[8];	/* reserved */
+	char    reserved8[8];	/* reserved */
 	uint    tcr;		/* Tuning control register */
-	char    reserved7[28];	/* reserved */
+	char    reserved9[28];	/* reserved */
 	uint    sddirctl;	/* SD direction control register */
-	char    reserved8[712];	/* reserved */
+	char    reserved10[712];/* reserved */
 	uint    scr;		/* eSDHC control register */
 };
 
-/* Return the XFERTYP flags for a given command and data packet */
-static uint esdhc_xfertyp(struct mmc_cmd *cmd, struct mmc_data *data)
+/*
+ * Return the XFERTYP flags for a given command and data packet. blkcnt_set
+ * tells whether the card was given the block count with SET_BLOCK_COUNT.
+ */
+static uint esdhc_xfertyp(struct mmc_cmd *cmd, struct mmc_data *data,
+			  int blkcnt_set)
 {
 	uint xfertyp = 0;
 
@@ -77,7 +89,9 @@ static uint esdhc_xfertyp(struct mmc_cmd *cmd, struct mmc_data *data)
 			xfertyp |= XFERTYP_MSBSEL;
 			xfertyp |= XFERTYP_BCEN;
 #ifdef CONFIG_SYS_FSL_ERRATUM_ESDHC111
-			xfertyp |= XFERTYP_AC12EN;
+			/* After SET_BLOCK_COUNT the card stops by itself */
+			if (!blkcnt_set)
+				xfertyp |= XFERTYP_AC12EN;
 #endif
 		}
 
@@ -258,23 +272,41 @@ static void check_and_invalidate_dcache_range
 }
 #endif
 
+/* Reset CMD and DATA portions after an error */
+static void esdhc_reset_cmd_data(volatile struct fsl_esdhc *regs,
+				 struct mmc_data *data)
+{
+	esdhc_write32(&regs->sysctl, esdhc_read32(&regs->sysctl) |
+		      SYSCTL_RSTC);
+	while (esdhc_read32(&regs->sysctl) & SYSCTL_RSTC)
+		;
+
+	if (data) {
+		esdhc_write32(&regs->sysctl,
+			      esdhc_read32(&regs->sysctl) |
+			      SYSCTL_RSTD);
+		while ((esdhc_read32(&regs->sysctl) & SYSCTL_RSTD))
+			;
+	}
+}
+
 /*
- * Sends a command out on the bus.  Takes the mmc pointer,
- * a command pointer, and an optional data pointer.
+ * Sends a command out on the bus and starts its data transfer, if any.
+ * Returns once the command has completed; the data transfer is finished
+ * by esdhc_wait_cmd().
  */
 static int
-esdhc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
+esdhc_start_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
 	int	err = 0;
 	uint	xfertyp;
 	uint	irqstat;
 	struct fsl_esdhc_cfg *cfg = mmc->priv;
 	volatile struct fsl_esdhc *regs = (struct fsl_esdhc *)cfg->esdhc_base;
+	int	blkcnt_set = cfg->blkcnt_set;
 
-#ifdef CONFIG_SYS_FSL_ERRATUM_ESDHC111
-	if (cmd->cmdidx == MMC_CMD_STOP_TRANSMISSION)
-		return 0;
-#endif
+	/* A block count only applies to the command that follows it */
+	cfg->blkcnt_set = 0;
 
 	esdhc_write32(&regs->irqstat, -1);
 
@@ -303,7 +335,9 @@ esdhc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 	}
 
 	/* Figure out the transfer arguments */
-	xfertyp = esdhc_xfertyp(cmd, data);
+	xfertyp = esdhc_xfertyp(cmd, data, blkcnt_set);
+	if (data)
+		cfg->auto_stop = !!(xfertyp & XFERTYP_AC12EN);
 
 	/* Mask all irqs */
 	esdhc_write32(&regs->irqsigen, 0);
@@ -367,52 +401,84 @@ esdhc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 	} else
 		cmd->response[0] = esdhc_read32(&regs->cmdrsp0);
 
-	/* Wait until all of the blocks are transferred */
-	if (data) {
+	if (cmd->cmdidx == MMC_CMD_SET_BLOCK_COUNT)
+		cfg->blkcnt_set = 1;
+
+	/* Leave the data status for esdhc_wait_cmd() */
+	if (data)
+		return 0;
+
+out:
+	if (err)
+		esdhc_reset_cmd_data(regs, data);
+
+	esdhc_write32(&regs->irqstat, -1);
+
+	return err;
+}
+
+/* Wait until all of the blocks started by esdhc_start_cmd() are transferred */
+static int
+esdhc_wait_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	int	err = 0;
+	struct fsl_esdhc_cfg *cfg = mmc->priv;
+	volatile struct fsl_esdhc *regs = (struct fsl_esdhc *)cfg->esdhc_base;
 #ifdef CONFIG_SYS_FSL_ESDHC_USE_PIO
-		esdhc_pio_read_write(mmc, data);
+	esdhc_pio_read_write(mmc, data);
 #else
-		do {
-			irqstat = esdhc_read32(&regs->irqstat);
+	uint	irqstat;
 
-			if (irqstat & IRQSTAT_DTOE) {
-				err = TIMEOUT;
-				goto out;
-			}
+	do {
+		irqstat = esdhc_read32(&regs->irqstat);
 
-			if (irqstat & DATA_ERR) {
-				err = COMM_ERR;
-				goto out;
-			}
-		} while ((irqstat & DATA_COMPLETE) != DATA_COMPLETE);
+		if (irqstat & IRQSTAT_DTOE) {
+			err = TIMEOUT;
+			goto out;
+		}
 
-		if (data->flags & MMC_DATA_READ)
-			check_and_invalidate_dcache_range(cmd, data);
-#endif
-	}
+		if (irqstat & DATA_ERR) {
+			err = COMM_ERR;
+			goto out;
+		}
+	} while ((irqstat & DATA_COMPLETE) != DATA_COMPLETE);
 
-out:
-	/* Reset CMD and DATA portions on error */
-	if (err) {
-		esdhc_write32(&regs->sysctl, esdhc_read32(&regs->sysctl) |
-			      SYSCTL_RSTC);
-		while (esdhc_read32(&regs->sysctl) & SYSCTL_RSTC)
-			;
+	if (data->flags & MMC_DATA_READ)
+		check_and_invalidate_dcache_range(cmd, data);
 
-		if (data) {
-			esdhc_write32(&regs->sysctl,
-				      esdhc_read32(&regs->sysctl) |
-				      SYSCTL_RSTD);
-			while ((esdhc_read32(&regs->sysctl) & SYSCTL_RSTD))
-				;
-		}
-	}
+out:
+	if (err)
+		esdhc_reset_cmd_data(regs, data);
+#endif
 
 	esdhc_write32(&regs->irqstat, -1);
 
 	return err;
 }
 
+/*
+ * Sends a command out on the bus.  Takes the mmc pointer,
+ * a command pointer, and an optional data pointer.
+ */
+static int
+esdhc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	int	err;
+#ifdef CONFIG_SYS_FSL_ERRATUM_ESDHC111
+	struct fsl_esdhc_cfg *cfg = mmc->priv;
+
+	/* The controller has already sent it */
+	if (cmd->cmdidx == MMC_CMD_STOP_TRANSMISSION && cfg->auto_stop)
+		return 0;
+#endif
+
+	err = esdhc_start_cmd(mmc, cmd, data);
+	if (err || !data)
+		return err;
+
+	return esdhc_wait_cmd(mmc, cmd, data);
+}
+
 static void set_sysctl(struct mmc *mmc, uint clock)
 {
 	int div, pre_div;
@@ -431,6 +497,12 @@ static void set_sysctl(struct mmc *mmc, uint clock)
 	} else
 		pre_div = 2;
 
+#ifdef CONFIG_FSL_USDHC
+	/* uSDHC can also run the bus at the base clock, e.g. for HS200 */
+	if (clock >= sdhc_clk)
+		pre_div = 1;
+#endif
+
 	for (div = 1; div <= 16; div++)
 		if ((sdhc_clk / (div * pre_div)) <= clock)
 			break;
@@ -534,11 +606,68 @@ static void esdhc_reset(struct fsl_esdhc *regs)
 		printf("MMC/SD: Reset never completed.\n");
 }
 
+#ifdef CONFIG_FSL_USDHC
+/* Sample with the tuned clock, delayed by val cells */
+static void esdhc_set_tuning(struct fsl_esdhc *regs, uint val)
+{
+	esdhc_setbits32(&regs->mixctrl, MIX_CTRL_EXE_TUNE |
+			MIX_CTRL_SMPCLK_SEL | MIX_CTRL_FBCLK_SEL);
+	esdhc_write32(&regs->clktunectrlstatus,
+		      val << CLKTUNE_DLY_CELL_SET_PRE_SHIFT);
+}
+
+/*
+ * Manual tuning, as the uSDHC on i.MX6Q/DL has no working standard
+ * tuning: find the first and last sample clock delays at which the
+ * tuning block reads back intact, and settle in the middle.
+ */
+static int esdhc_execute_tuning(struct mmc *mmc, uint opcode)
+{
+	struct fsl_esdhc_cfg *cfg = mmc->priv;
+	struct fsl_esdhc *regs = (struct fsl_esdhc *)cfg->esdhc_base;
+	uint min, max;
+	int err = TIMEOUT;
+
+	for (min = 0; min <= CLKTUNE_DLY_CELL_MAX; min++) {
+		esdhc_set_tuning(regs, min);
+		if (!mmc_send_tuning(mmc, opcode))
+			break;
+	}
+	if (min > CLKTUNE_DLY_CELL_MAX)
+		goto out;
+
+	for (max = min + 1; max <= CLKTUNE_DLY_CELL_MAX; max++) {
+		esdhc_set_tuning(regs, max);
+		if (mmc_send_tuning(mmc, opcode))
+			break;
+	}
+
+	esdhc_set_tuning(regs, (min + max - 1) / 2);
+	err = mmc_send_tuning(mmc, opcode);
+	debug("%s: delay cells %u to %u, err %d\n", __func__, min, max - 1,
+	      err);
+
+out:
+	esdhc_clrbits32(&regs->mixctrl, MIX_CTRL_EXE_TUNE);
+	/* Back to the fixed sample point if there was no window */
+	if (err)
+		esdhc_clrbits32(&regs->mixctrl, MIX_CTRL_SMPCLK_SEL |
+				MIX_CTRL_FBCLK_SEL);
+
+	return err;
+}
+#endif
+
 static const struct mmc_ops esdhc_ops = {
 	.send_cmd	= esdhc_send_cmd,
 	.set_ios	= esdhc_set_ios,
 	.init		= esdhc_init,
 	.getcd		= esdhc_getcd,
+	.start_cmd	= esdhc_start_cmd,
+	.wait_cmd	= esdhc_wait_cmd,
+#ifdef CONFIG_FSL_USDHC
+	.execute_tuning	= esdhc_execute_tuning,
+#endif
 };
 
 int fsl_esdhc_initialize(bd_t *bis, struct fsl_esdhc_cfg *cfg)
@@ -612,6 +741,13 @@ int fsl_esdhc_initialize(bd_t *bis, struct fsl_esdhc_cfg *cfg)
 	cfg->cfg.f_min = 400000;
 	cfg->cfg.f_max = min(gd->arch.sdhc_clk, 52000000);
 
+#ifdef CONFIG_FSL_USDHC
+	if (cfg->hs200) {
+		cfg->cfg.host_caps |= MMC_MODE_HS200;
+		cfg->cfg.f_max = min(gd->arch.sdhc_clk, 200000000);
+	}
+#endif
+
 	cfg->cfg.b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
 
 	mmc = mmc_create(&cfg->cfg, cfg);
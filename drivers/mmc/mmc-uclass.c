@@ -0,0 +1,98 @@
+/*
+ * Driver model device for each MMC/SD card slot
+ *
+ * Host drivers still register with mmc_create(). Each struct mmc then gets
+ * a device in UCLASS_MMC, whose probe identifies the card. A card that is
+ * powering up keeps it busy for up to a second, which probe_poll() lets
+ * the rest of U-Boot use: see device_probe_start() and dm_probe_async().
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <errno.h>
+#include <mmc.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
+#include "mmc_private.h"
+
+DECLARE_GLOBAL_DATA_PTR;
+
+void mmc_dm_bind(struct mmc *mmc)
+{
+	struct driver *drv;
+
+	drv = lists_driver_lookup_name("mmc_card");
+	if (!gd->dm_root || !drv)
+		return;
+
+	snprintf(mmc->dev_name, sizeof(mmc->dev_name), "mmc%d",
+		 mmc->block_dev.dev);
+	if (device_bind(gd->dm_root, drv, mmc->dev_name, mmc, -1, &mmc->dev))
+		mmc->dev = NULL;
+}
+
+void mmc_dm_unbind(struct mmc *mmc)
+{
+	if (!mmc->dev)
+		return;
+
+	device_remove(mmc->dev);
+	device_unbind(mmc->dev);
+	mmc->dev = NULL;
+}
+
+int mmc_dm_init(struct mmc *mmc)
+{
+	/* The card has been identified before, e.g. ahead of 'mmc rescan' */
+	if (device_active(mmc->dev))
+		device_remove(mmc->dev);
+
+	return device_probe(mmc->dev);
+}
+
+static int mmc_card_probe(struct udevice *dev)
+{
+	struct mmc *mmc = dev_get_platdata(dev);
+	int err;
+
+	/* The card may be powering up already, see mmc_set_preinit() */
+	if (mmc->init_in_progress)
+		return 0;
+
+	err = mmc_start_init(mmc);
+
+	return err == IN_PROGRESS ? 0 : err;
+}
+
+static int mmc_card_probe_poll(struct udevice *dev)
+{
+	int err;
+
+	err = mmc_poll_init(dev_get_platdata(dev));
+
+	return err == IN_PROGRESS ? -EAGAIN : err;
+}
+
+static int mmc_card_remove(struct udevice *dev)
+{
+	struct mmc *mmc = dev_get_platdata(dev);
+
+	mmc->has_init = 0;
+
+	return 0;
+}
+
+U_BOOT_DRIVER(mmc_card) = {
+	.name		= "mmc_card",
+	.id		= UCLASS_MMC,
+	.probe		= mmc_card_probe,
+	.probe_poll	= mmc_card_probe_poll,
+	.remove		= mmc_card_remove,
+};
+
+UCLASS_DRIVER(mmc) = {
+	.id		= UCLASS_MMC,
+	.name		= "mmc",
+};
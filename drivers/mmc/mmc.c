@@ -16,6 +16,7 @@
 #include <malloc.h>
 #include <linux/list.h>
 #include <div64.h>
+#include <dm/root.h>
 #include "mmc_private.h"
 
 static struct list_head mmc_devices;
@@ -169,6 +170,66 @@ int mmc_set_blocklen(struct mmc *mmc, int len)
 	return mmc_send_cmd(mmc, &cmd, NULL);
 }
 
+/* The blocks a card returns for CMD21, see JESD84-B50 6.6.5.1 */
+const u8 tuning_blk_pattern_4bit[64] = {
+	0xff, 0x0f, 0xff, 0x00, 0xff, 0xcc, 0xc3, 0xcc,
+	0xc3, 0x3c, 0xcc, 0xff, 0xfe, 0xff, 0xfe, 0xef,
+	0xff, 0xdf, 0xff, 0xdd, 0xff, 0xfb, 0xff, 0xfb,
+	0xbf, 0xff, 0x7f, 0xff, 0x77, 0xf7, 0xbd, 0xef,
+	0xff, 0xf0, 0xff, 0xf0, 0x0f, 0xfc, 0xcc, 0x3c,
+	0xcc, 0x33, 0xcc, 0xcf, 0xff, 0xef, 0xff, 0xee,
+	0xff, 0xfd, 0xff, 0xfd, 0xdf, 0xff, 0xbf, 0xff,
+	0xbb, 0xff, 0xf7, 0xff, 0xf7, 0x7f, 0x7b, 0xde,
+};
+
+const u8 tuning_blk_pattern_8bit[128] = {
+	0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00, 0x00,
+	0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc, 0xcc,
+	0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff, 0xff,
+	0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee, 0xff,
+	0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd, 0xdd,
+	0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff, 0xbb,
+	0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff, 0xff,
+	0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee, 0xff,
+	0xff, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00,
+	0x00, 0xff, 0xff, 0xcc, 0xcc, 0xcc, 0x33, 0xcc,
+	0xcc, 0xcc, 0x33, 0x33, 0xcc, 0xcc, 0xcc, 0xff,
+	0xff, 0xff, 0xee, 0xff, 0xff, 0xff, 0xee, 0xee,
+	0xff, 0xff, 0xff, 0xdd, 0xff, 0xff, 0xff, 0xdd,
+	0xdd, 0xff, 0xff, 0xff, 0xbb, 0xff, 0xff, 0xff,
+	0xbb, 0xbb, 0xff, 0xff, 0xff, 0x77, 0xff, 0xff,
+	0xff, 0x77, 0x77, 0xff, 0x77, 0xbb, 0xdd, 0xee,
+};
+
+int mmc_send_tuning(struct mmc *mmc, uint opcode)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, buf, sizeof(tuning_blk_pattern_8bit));
+	const u8 *pattern = tuning_blk_pattern_4bit;
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	int err;
+
+	data.blocksize = sizeof(tuning_blk_pattern_4bit);
+	if (mmc->bus_width == 8) {
+		pattern = tuning_blk_pattern_8bit;
+		data.blocksize = sizeof(tuning_blk_pattern_8bit);
+	}
+
+	cmd.cmdidx = opcode;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
+
+	data.dest = (char *)buf;
+	data.blocks = 1;
+	data.flags = MMC_DATA_READ;
+
+	err = mmc_send_cmd(mmc, &cmd, &data);
+	if (err)
+		return err;
+
+	return memcmp(buf, pattern, data.blocksize) ? COMM_ERR : 0;
+}
+
 struct mmc *find_mmc_device(int dev_num)
 {
 	struct mmc *m;
@@ -229,6 +290,108 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 	return blkcnt;
 }
 
+static void mmc_prep_read(struct mmc *mmc, struct mmc_cmd *cmd,
+			  struct mmc_data *data, void *dst, lbaint_t start,
+			  lbaint_t blkcnt)
+{
+	cmd->cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+	if (mmc->high_capacity)
+		cmd->cmdarg = start;
+	else
+		cmd->cmdarg = start * mmc->read_bl_len;
+	cmd->resp_type = MMC_RSP_R1;
+
+	data->dest = dst;
+	data->blocks = blkcnt;
+	data->blocksize = mmc->read_bl_len;
+	data->flags = MMC_DATA_READ;
+}
+
+static int mmc_start_read(struct mmc *mmc, struct mmc_cmd *cmd,
+			  struct mmc_data *data)
+{
+	struct mmc_cmd sbc;
+	int err;
+
+	if (mmc->cmd23) {
+		sbc.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+		sbc.cmdarg = data->blocks;
+		sbc.resp_type = MMC_RSP_R1;
+		err = mmc_send_cmd(mmc, &sbc, NULL);
+		if (err)
+			return err;
+	}
+
+	return mmc->cfg->ops->start_cmd(mmc, cmd, data);
+}
+
+/*
+ * Read blkcnt blocks in b_max sized chunks through the host's queued
+ * transfer ops. The command for the next chunk is prepared while the
+ * current one is in flight, and if the card supports SET_BLOCK_COUNT it
+ * stops by itself at the end of each chunk, so no STOP_TRANSMISSION is
+ * needed between chunks.
+ */
+static ulong mmc_read_blocks_queued(struct mmc *mmc, void *dst,
+				    lbaint_t start, lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd[2], stop;
+	struct mmc_data data[2];
+	lbaint_t cur, blocks_todo = blkcnt;
+	uint b_max = mmc->cfg->b_max;
+	int err, i = 0;
+
+	/* SET_BLOCK_COUNT only has 16 bits for the count */
+	if (mmc->cmd23 && b_max > 0xffff)
+		b_max = 0xffff;
+
+	cur = min(blocks_todo, (lbaint_t)b_max);
+	mmc_prep_read(mmc, &cmd[i], &data[i], dst, start, cur);
+	if (mmc_start_read(mmc, &cmd[i], &data[i]))
+		return 0;
+
+	for (;;) {
+		blocks_todo -= cur;
+		start += cur;
+		dst += cur * mmc->read_bl_len;
+
+		if (blocks_todo) {
+			cur = min(blocks_todo, (lbaint_t)b_max);
+			mmc_prep_read(mmc, &cmd[!i], &data[!i], dst, start, cur);
+		}
+
+		err = mmc->cfg->ops->wait_cmd(mmc, &cmd[i], &data[i]);
+		if (err || !mmc->cmd23) {
+			stop.cmdidx = MMC_CMD_STOP_TRANSMISSION;
+			stop.cmdarg = 0;
+			stop.resp_type = MMC_RSP_R1b;
+			if (mmc_send_cmd(mmc, &stop, NULL)) {
+#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
+				printf("mmc fail to send stop cmd\n");
+#endif
+				return 0;
+			}
+		}
+		if (err)
+			return 0;
+
+		if (!blocks_todo) {
+			image_load_update(data[i].dest,
+					  data[i].blocks * mmc->read_bl_len);
+			break;
+		}
+
+		i = !i;
+		if (mmc_start_read(mmc, &cmd[i], &data[i]))
+			return 0;
+		/* Let the loader look at the last chunk while this one runs */
+		image_load_update(data[!i].dest,
+				  data[!i].blocks * mmc->read_bl_len);
+	}
+
+	return blkcnt;
+}
+
 static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 {
 	lbaint_t cur, blocks_todo = blkcnt;
@@ -251,11 +414,15 @@ static ulong mmc_bread(int dev_num, lbaint_t start, lbaint_t blkcnt, void *dst)
 	if (mmc_set_blocklen(mmc, mmc->read_bl_len))
 		return 0;
 
+	if (blkcnt > 1 && mmc->cfg->ops->start_cmd && mmc->cfg->ops->wait_cmd)
+		return mmc_read_blocks_queued(mmc, dst, start, blkcnt);
+
 	do {
 		cur = (blocks_todo > mmc->cfg->b_max) ?
 			mmc->cfg->b_max : blocks_todo;
 		if(mmc_read_blocks(mmc, dst, start, cur) != cur)
 			return 0;
+		image_load_update(dst, cur * mmc->read_bl_len);
 		blocks_todo -= cur;
 		start += cur;
 		dst += cur * mmc->read_bl_len;
@@ -385,6 +552,7 @@ static int mmc_send_op_cond(struct mmc *mmc)
 
  	/* Asking to the card its capabilities */
 	mmc->op_cond_pending = 1;
+	mmc->op_cond_start = get_timer(0);
 	for (i = 0; i < 2; i++) {
 		err = mmc_send_op_cond_iter(mmc, &cmd, i != 0);
 		if (err)
@@ -397,23 +565,22 @@ static int mmc_send_op_cond(struct mmc *mmc)
 	return IN_PROGRESS;
 }
 
-static int mmc_complete_op_cond(struct mmc *mmc)
+/*
+ * Send the card one more op_cond, and finish off if it is no longer busy.
+ * Returns IN_PROGRESS while it is, until @start is a second ago.
+ */
+static int mmc_poll_op_cond(struct mmc *mmc, uint start)
 {
 	struct mmc_cmd cmd;
-	int timeout = 1000;
-	uint start;
 	int err;
 
+	err = mmc_send_op_cond_iter(mmc, &cmd, 1);
+	if (!err && !(mmc->op_cond_response & OCR_BUSY))
+		err = get_timer(start) > 1000 ? UNUSABLE_ERR : IN_PROGRESS;
+	if (err)
+		return err;
+
 	mmc->op_cond_pending = 0;
-	start = get_timer(0);
-	do {
-		err = mmc_send_op_cond_iter(mmc, &cmd, 1);
-		if (err)
-			return err;
-		if (get_timer(start) > timeout)
-			return UNUSABLE_ERR;
-		udelay(100);
-	} while (!(mmc->op_cond_response & OCR_BUSY));
 
 	if (mmc_host_is_spi(mmc)) { /* read OCR for spi */
 		cmd.cmdidx = MMC_CMD_SPI_READ_OCR;
@@ -435,6 +602,19 @@ static int mmc_complete_op_cond(struct mmc *mmc)
 	return 0;
 }
 
+static int mmc_complete_op_cond(struct mmc *mmc)
+{
+	uint start;
+	int err;
+
+	mmc->op_cond_pending = 0;
+	start = get_timer(0);
+	while ((err = mmc_poll_op_cond(mmc, start)) == IN_PROGRESS)
+		udelay(100);
+
+	return err;
+}
+
 
 static int mmc_send_ext_csd(struct mmc *mmc, u8 *ext_csd)
 {
@@ -500,9 +680,10 @@ static int mmc_change_freq(struct mmc *mmc)
 	if (err)
 		return err;
 
-	cardtype = ext_csd[EXT_CSD_CARD_TYPE] & 0xf;
+	cardtype = ext_csd[EXT_CSD_CARD_TYPE] & 0x3f;
 
-	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING, 1);
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+			 EXT_CSD_TIMING_HS);
 
 	if (err)
 		return err == SWITCH_ERR ? 0 : err;
@@ -521,6 +702,9 @@ static int mmc_change_freq(struct mmc *mmc)
 	if (cardtype & EXT_CSD_CARD_TYPE_52) {
 		if (cardtype & EXT_CSD_CARD_TYPE_DDR_52)
 			mmc->card_caps |= MMC_MODE_DDR_52MHz;
+		/* HS200 is only entered later, see mmc_select_hs200() */
+		if (cardtype & EXT_CSD_CARD_TYPE_HS200)
+			mmc->card_caps |= MMC_MODE_HS200;
 		mmc->card_caps |= MMC_MODE_HS_52MHz | MMC_MODE_HS;
 	} else {
 		mmc->card_caps |= MMC_MODE_HS;
@@ -710,6 +894,9 @@ retry_scr:
 	if (mmc->scr[0] & SD_DATA_4BIT)
 		mmc->card_caps |= MMC_MODE_4BIT;
 
+	if (mmc->scr[0] & SD_CMD23_SUPPORT)
+		mmc->cmd23 = 1;
+
 	/* Version 1.0 doesn't support switching */
 	if (mmc->version == SD_VERSION_1_0)
 		return 0;
@@ -809,6 +996,40 @@ static void mmc_set_bus_width(struct mmc *mmc, uint width)
 	mmc_set_ios(mmc);
 }
 
+/*
+ * Move a card running in high speed mode at an SDR bus width of 4 or 8
+ * bits to HS200 and tune the host to it. If that fails the card is put
+ * back to high speed timing.
+ */
+static int mmc_select_hs200(struct mmc *mmc)
+{
+	int err;
+
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+			 EXT_CSD_TIMING_HS200);
+	if (err)
+		return err == SWITCH_ERR ? 0 : err;
+
+	mmc->card_caps |= MMC_MODE_HS200;
+	mmc_set_clock(mmc, 200000000);
+
+	err = mmc->cfg->ops->execute_tuning(mmc,
+					    MMC_CMD_SEND_TUNING_BLOCK_HS200);
+	if (!err) {
+		mmc->tran_speed = 200000000;
+		return 0;
+	}
+
+#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
+	printf("MMC: HS200 tuning failed, using high speed\n");
+#endif
+	mmc->card_caps &= ~MMC_MODE_HS200;
+	mmc_set_clock(mmc, mmc->tran_speed);
+
+	return mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
+			  EXT_CSD_TIMING_HS);
+}
+
 static int mmc_startup(struct mmc *mmc)
 {
 	int err, i;
@@ -967,6 +1188,8 @@ static int mmc_startup(struct mmc *mmc)
 	 */
 	mmc->erase_grp_size = 1;
 	mmc->part_config = MMCPART_NOAVAILABLE;
+	/* SET_BLOCK_COUNT is mandatory from MMC 3.1, SD has it in the SCR */
+	mmc->cmd23 = !IS_SD(mmc) && (mmc->version >= MMC_VERSION_3);
 	if (!IS_SD(mmc) && (mmc->version >= MMC_VERSION_4)) {
 		/* check  ext_csd version and capacity */
 		err = mmc_send_ext_csd(mmc, ext_csd);
@@ -1091,6 +1314,7 @@ static int mmc_startup(struct mmc *mmc)
 			mmc->tran_speed = 25000000;
 	} else {
 		int idx;
+		uint ddr, hs200;
 
 		/* An array of possible bus widths in order of preference */
 		static unsigned ext_csd_bits[] = {
@@ -1114,6 +1338,17 @@ static int mmc_startup(struct mmc *mmc)
 			8, 4, 8, 4, 1,
 		};
 
+		/*
+		 * DDR is only reported once a DDR bus width has been set,
+		 * and HS200 only once the card has been switched to it.
+		 * HS200 needs an SDR bus and is preferred over DDR.
+		 */
+		hs200 = mmc->card_caps & MMC_MODE_HS200;
+		if (!mmc->cfg->ops->execute_tuning)
+			hs200 = 0;
+		ddr = hs200 ? 0 : mmc->card_caps & MMC_MODE_DDR_52MHz;
+		mmc->card_caps &= ~(MMC_MODE_HS200 | MMC_MODE_DDR_52MHz);
+
 		for (idx=0; idx < ARRAY_SIZE(ext_csd_bits); idx++) {
 			unsigned int extw = ext_csd_bits[idx];
 
@@ -1125,6 +1360,9 @@ static int mmc_startup(struct mmc *mmc)
 					!(mmc->cfg->host_caps & ext_to_hostcaps[extw]))
 				continue;
 
+			if (ext_to_hostcaps[extw] == MMC_MODE_DDR_52MHz && !ddr)
+				continue;
+
 			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
 					EXT_CSD_BUS_WIDTH, extw);
 
@@ -1157,6 +1395,12 @@ static int mmc_startup(struct mmc *mmc)
 			else
 				mmc->tran_speed = 26000000;
 		}
+
+		if (hs200 && mmc->bus_width > 1) {
+			err = mmc_select_hs200(mmc);
+			if (err)
+				return err;
+		}
 	}
 
 	mmc_set_clock(mmc, mmc->tran_speed);
@@ -1257,12 +1501,19 @@ struct mmc *mmc_create(const struct mmc_config *cfg, void *priv)
 
 	list_add_tail(&mmc->link, &mmc_devices);
 
+#ifdef CONFIG_DM_MMC
+	mmc_dm_bind(mmc);
+#endif
+
 	return mmc;
 }
 
 void mmc_destroy(struct mmc *mmc)
 {
-	/* only freeing memory for now */
+#ifdef CONFIG_DM_MMC
+	mmc_dm_unbind(mmc);
+#endif
+	list_del(&mmc->link);
 	free(mmc);
 }
 
@@ -1352,6 +1603,27 @@ static int mmc_complete_init(struct mmc *mmc)
 	return err;
 }
 
+int mmc_poll_init(struct mmc *mmc)
+{
+	int err;
+
+	if (mmc->has_init)
+		return 0;
+
+	if (mmc->op_cond_pending) {
+		err = mmc_poll_op_cond(mmc, mmc->op_cond_start);
+		if (err == IN_PROGRESS)
+			return err;
+		if (err) {
+			mmc->op_cond_pending = 0;
+			mmc->init_in_progress = 0;
+			return err;
+		}
+	}
+
+	return mmc_complete_init(mmc);
+}
+
 int mmc_init(struct mmc *mmc)
 {
 	int err = IN_PROGRESS;
@@ -1360,6 +1632,11 @@ int mmc_init(struct mmc *mmc)
 	if (mmc->has_init)
 		return 0;
 
+#ifdef CONFIG_DM_MMC
+	if (mmc->dev)
+		return mmc_dm_init(mmc);
+#endif
+
 	start = get_timer(0);
 
 	if (!mmc->init_in_progress)
@@ -1449,6 +1726,10 @@ int mmc_initialize(bd_t *bis)
 #endif
 
 	do_preinit();
+#ifdef CONFIG_DM_PROBE_ASYNC
+	/* Identify every card in the background, see mmc-uclass.c */
+	dm_probe_async();
+#endif
 	return 0;
 }
 
@@ -42,4 +42,11 @@ static inline ulong mmc_bwrite(int dev_num, lbaint_t start, lbaint_t blkcnt,
 
 #endif /* CONFIG_SPL_BUILD */
 
+#ifdef CONFIG_DM_MMC
+/* Driver model device for each card, see mmc-uclass.c */
+void mmc_dm_bind(struct mmc *mmc);
+void mmc_dm_unbind(struct mmc *mmc);
+int mmc_dm_init(struct mmc *mmc);
+#endif
+
 #endif /* _MMC_PRIVATE_H_ */
@@ -34,12 +34,16 @@ enum sandbox_sf_state {
 	SF_ERASE, /* erase the flash */
 	SF_READ_STATUS, /* read the flash's status register */
 	SF_READ_STATUS1, /* read the flash's status register upper 8 bits*/
+	SF_WRITE_STATUS, /* write the flash's status register */
+	SF_SFDP,  /* reading the flash's discoverable parameters */
+	SF_BANK,  /* read or write the bank address register */
 };
 
 static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 {
 	static const char * const states[] = {
 		"CMD", "ID", "ADDR", "READ", "WRITE", "ERASE", "READ_STATUS",
+		"READ_STATUS1", "WRITE_STATUS", "SFDP", "BANK",
 	};
 	return states[state];
 }
@@ -48,10 +52,17 @@ static const char *sandbox_sf_state_name(enum sandbox_sf_state state)
 #define STAT_WIP	(1 << 0)
 #define STAT_WEL	(1 << 1)
 
-/* Assume all SPI flashes have 3 byte addresses since they do atm */
+/* Commands have 3 byte addresses, unless they are the 4-byte forms */
 #define SF_ADDR_LEN	3
+#define SF_ADDR_LEN_4B	4
 
 #define IDCODE_LEN 3
+#define IDCODE_EXT_LEN 2
+
+/* Layout of the SFDP data: header, BFPT and 4-byte address table */
+#define SF_SFDP_BFPT		0x30
+#define SF_SFDP_4BAIT		0x70
+#define SF_SFDP_DWORDS		(0x80 / 4)
 
 /* Used to quickly bulk erase backing store */
 static u8 sandbox_sf_0xff[0x1000];
@@ -74,16 +85,76 @@ struct sandbox_spi_flash {
 	uint erase_size;
 	/* Current position in the flash; used when reading/writing/etc... */
 	uint off;
-	/* How many address bytes we've consumed */
-	uint addr_bytes, pad_addr_bytes;
+	/* How many address bytes we've consumed, and how many to expect */
+	uint addr_bytes, pad_addr_bytes, addr_len;
 	/* The current flash status (see STAT_XXX defines above) */
 	u16 status;
+	/* Bank address register, the top byte of 3-byte addresses */
+	u8 bank;
+	/* Discoverable parameters (JESD216) describing the flash */
+	u32 sfdp[SF_SFDP_DWORDS];
 	/* Data describing the flash we're emulating */
 	const struct spi_flash_params *data;
 	/* The file on disk to serv up data from */
 	int fd;
 };
 
+/*
+ * Describe the emulated flash in SFDP: its size, page size and the erase
+ * commands accepted below, and the 4-byte address commands if it has them.
+ */
+static void sandbox_sf_build_sfdp(struct sandbox_spi_flash *sbsf)
+{
+	const struct spi_flash_params *data = sbsf->data;
+	u32 size = data->sector_size * data->nr_sectors;
+	u32 dw[SF_SFDP_DWORDS];
+	u32 *bfpt = &dw[SF_SFDP_BFPT / 4];
+	u32 *bait = &dw[SF_SFDP_4BAIT / 4];
+	bool addr_4b = data->flags & ADDR_4B;
+	int i;
+
+	memset(dw, '\0', sizeof(dw));
+	/* Header: "SFDP", JESD216B, then the parameter headers */
+	dw[0] = 0x50444653;
+	dw[1] = 0xff << 24 | addr_4b << 16 | 1 << 8 | 6;
+	dw[2] = 16 << 24 | 1 << 16 | 6 << 8 | 0x00;
+	dw[3] = 0xff << 24 | SF_SFDP_BFPT;
+	dw[4] = 2 << 24 | 1 << 16 | 0 << 8 | 0x84;
+	dw[5] = 0xff << 24 | SF_SFDP_4BAIT;
+
+	/* Single-line commands only, 64-byte write granularity */
+	bfpt[0] = 1 << 2;
+	if (data->flags & SECT_4K)
+		bfpt[0] |= 1 | CMD_ERASE_4K << 8;
+	else
+		bfpt[0] |= 3 | 0xff << 8;
+	if (addr_4b && size > SPI_FLASH_16MB_BOUN)
+		bfpt[0] |= 1 << 17;
+	bfpt[1] = size * 8 - 1;
+	/* Erase types 1-3, as in sandbox_sf_process_cmd() */
+	if (data->flags & SECT_4K)
+		bfpt[7] |= 12 | CMD_ERASE_4K << 8;
+	if (data->flags & SECT_32K)
+		bfpt[7] |= (15 | CMD_ERASE_32K << 8) << 16;
+	if (!(data->flags & (SECT_4K | SECT_32K)))
+		bfpt[8] |= 16 | CMD_ERASE_64K << 8;
+	/* 256-byte pages */
+	bfpt[10] = 8 << 4;
+
+	if (addr_4b) {
+		/* Slow and fast read and page program, then erase types */
+		bait[0] = 1 << 0 | 1 << 1 | 1 << 6;
+		bait[1] = CMD_ERASE_4K_4B | CMD_ERASE_32K_4B << 8 |
+			  CMD_ERASE_64K_4B << 16 | 0xff << 24;
+		for (i = 0; i < 3; i++)
+			if ((bfpt[7 + i / 2] >> (i % 2 * 16)) & 0xff)
+				bait[0] |= 1 << (9 + i);
+	}
+
+	for (i = 0; i < SF_SFDP_DWORDS; i++)
+		sbsf->sfdp[i] = cpu_to_le32(dw[i]);
+}
+
 static int sandbox_sf_setup(void **priv, const char *spec)
 {
 	/* spec = idcode:file */
@@ -130,6 +201,7 @@ static int sandbox_sf_setup(void **priv, const char *spec)
 	}
 
 	sbsf->data = data;
+	sandbox_sf_build_sfdp(sbsf);
 
 	*priv = sbsf;
 	return 0;
@@ -156,6 +228,7 @@ static void sandbox_sf_cs_activate(void *priv)
 	sbsf->off = 0;
 	sbsf->addr_bytes = 0;
 	sbsf->pad_addr_bytes = 0;
+	sbsf->addr_len = SF_ADDR_LEN;
 	sbsf->state = SF_CMD;
 	sbsf->cmd = SF_CMD;
 }
@@ -186,6 +259,32 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 	case CMD_PAGE_PROGRAM:
 		sbsf->state = SF_ADDR;
 		break;
+	case CMD_READ_ARRAY_FAST_4B:
+		sbsf->pad_addr_bytes = 1;
+	case CMD_READ_ARRAY_SLOW_4B:
+	case CMD_PAGE_PROGRAM_4B:
+		if (!(sbsf->data->flags & ADDR_4B)) {
+			debug(" cmd unknown: %#x\n", sbsf->cmd);
+			return 1;
+		}
+		sbsf->addr_len = SF_ADDR_LEN_4B;
+		sbsf->state = SF_ADDR;
+		break;
+	case CMD_READ_SFDP:
+		sbsf->pad_addr_bytes = 1;
+		sbsf->state = SF_ADDR;
+		break;
+	case CMD_WRITE_STATUS:
+		sbsf->state = SF_WRITE_STATUS;
+		break;
+#ifdef CONFIG_SPI_FLASH_BAR
+	case CMD_BANKADDR_BRRD:
+	case CMD_BANKADDR_BRWR:
+	case CMD_EXTNADDR_RDEAR:
+	case CMD_EXTNADDR_WREAR:
+		sbsf->state = SF_BANK;
+		break;
+#endif
 	case CMD_WRITE_DISABLE:
 		debug(" write disabled\n");
 		sbsf->status &= ~STAT_WEL;
@@ -202,16 +301,29 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 		break;
 	default: {
 		int flags = sbsf->data->flags;
+		uint cmd = sbsf->cmd;
+
+		/* Erases with a 4-byte address, if the flash has them */
+		if (flags & ADDR_4B) {
+			if (cmd == CMD_ERASE_4K_4B)
+				cmd = CMD_ERASE_4K;
+			else if (cmd == CMD_ERASE_32K_4B)
+				cmd = CMD_ERASE_32K;
+			else if (cmd == CMD_ERASE_64K_4B)
+				cmd = CMD_ERASE_64K;
+			if (cmd != sbsf->cmd)
+				sbsf->addr_len = SF_ADDR_LEN_4B;
+		}
 
 		/* we only support erase here */
-		if (sbsf->cmd == CMD_ERASE_CHIP) {
+		if (cmd == CMD_ERASE_CHIP) {
 			sbsf->erase_size = sbsf->data->sector_size *
 				sbsf->data->nr_sectors;
-		} else if (sbsf->cmd == CMD_ERASE_4K && (flags & SECT_4K)) {
+		} else if (cmd == CMD_ERASE_4K && (flags & SECT_4K)) {
 			sbsf->erase_size = 4 << 10;
-		} else if (sbsf->cmd == CMD_ERASE_32K && (flags & SECT_32K)) {
+		} else if (cmd == CMD_ERASE_32K && (flags & SECT_32K)) {
 			sbsf->erase_size = 32 << 10;
-		} else if (sbsf->cmd == CMD_ERASE_64K &&
+		} else if (cmd == CMD_ERASE_64K &&
 			   !(flags & (SECT_4K | SECT_32K))) {
 			sbsf->erase_size = 64 << 10;
 		} else {
@@ -274,6 +386,11 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 				/* Extract correct byte from ID 0x00aabbcc */
 				id = sbsf->data->jedec >>
 					(8 * (IDCODE_LEN - 1 - sbsf->off));
+			} else if (sbsf->off < IDCODE_LEN + IDCODE_EXT_LEN) {
+				/* Then the extended ID 0xddee */
+				id = sbsf->data->ext_jedec >>
+					(8 * (IDCODE_LEN + IDCODE_EXT_LEN - 1 -
+					      sbsf->off));
 			} else {
 				id = 0;
 			}
@@ -286,7 +403,7 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 			debug(" addr: bytes:%u rx:%02x ", sbsf->addr_bytes,
 			      rx[pos]);
 
-			if (sbsf->addr_bytes++ < SF_ADDR_LEN)
+			if (sbsf->addr_bytes++ < sbsf->addr_len)
 				sbsf->off = (sbsf->off << 8) | rx[pos];
 			debug("addr:%06x\n", sbsf->off);
 
@@ -294,10 +411,16 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 
 			/* See if we're done processing */
 			if (sbsf->addr_bytes <
-					SF_ADDR_LEN + sbsf->pad_addr_bytes)
+					sbsf->addr_len + sbsf->pad_addr_bytes)
 				break;
 
 			/* Next state! */
+			if (sbsf->cmd == CMD_READ_SFDP) {
+				sbsf->state = SF_SFDP;
+				break;
+			}
+			if (sbsf->addr_len == SF_ADDR_LEN)
+				sbsf->off |= sbsf->bank << 24;
 			if (os_lseek(sbsf->fd, sbsf->off, OS_SEEK_SET) < 0) {
 				puts("sandbox_sf: os_lseek() failed");
 				return 1;
@@ -305,9 +428,12 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 			switch (sbsf->cmd) {
 			case CMD_READ_ARRAY_FAST:
 			case CMD_READ_ARRAY_SLOW:
+			case CMD_READ_ARRAY_FAST_4B:
+			case CMD_READ_ARRAY_SLOW_4B:
 				sbsf->state = SF_READ;
 				break;
 			case CMD_PAGE_PROGRAM:
+			case CMD_PAGE_PROGRAM_4B:
 				sbsf->state = SF_WRITE;
 				break;
 			default:
@@ -345,6 +471,49 @@ static int sandbox_sf_xfer(void *priv, const u8 *rx, u8 *tx,
 			memset(tx + pos, sbsf->status >> 8, cnt);
 			pos += cnt;
 			break;
+		case SF_WRITE_STATUS:
+			if (!(sbsf->status & STAT_WEL)) {
+				puts("sandbox_sf: write enable not set before writing status\n");
+				goto done;
+			}
+
+			/* Register 1, then optionally register 2 */
+			cnt = bytes - pos;
+			debug(" rx: write status(%u)\n", cnt);
+			sandbox_spi_tristate(&tx[pos], cnt);
+			for (; cnt; cnt--, pos++, sbsf->off++) {
+				if (sbsf->off == 0)
+					sbsf->status = (sbsf->status & 0xff00) |
+						(rx[pos] & ~(STAT_WIP | STAT_WEL));
+				else if (sbsf->off == 1)
+					sbsf->status = (sbsf->status & 0xff) |
+						rx[pos] << 8;
+			}
+			sbsf->status &= ~STAT_WEL;
+			break;
+		case SF_SFDP:
+			cnt = bytes - pos;
+			debug(" tx: sfdp(%u) at %#x\n", cnt, sbsf->off);
+			for (; cnt; cnt--, pos++, sbsf->off++)
+				tx[pos] = sbsf->off < sizeof(sbsf->sfdp) ?
+					((u8 *)sbsf->sfdp)[sbsf->off] : 0xff;
+			break;
+#ifdef CONFIG_SPI_FLASH_BAR
+		case SF_BANK:
+			cnt = bytes - pos;
+			if (sbsf->cmd == CMD_BANKADDR_BRWR ||
+			    sbsf->cmd == CMD_EXTNADDR_WREAR) {
+				sandbox_spi_tristate(&tx[pos], cnt);
+				sbsf->bank = rx[pos];
+				sbsf->status &= ~STAT_WEL;
+				debug(" bank: write %u\n", sbsf->bank);
+			} else {
+				memset(tx + pos, sbsf->bank, cnt);
+				debug(" bank: read %u\n", sbsf->bank);
+			}
+			pos += cnt;
+			break;
+#endif
 		case SF_WRITE:
 			/*
 			 * XXX: need to handle exotic behavior:
@@ -9,6 +9,7 @@
  */
 
 #include <common.h>
+#include <errno.h>
 #include <fdtdec.h>
 #include <malloc.h>
 #include <spi.h>
@@ -72,6 +73,314 @@ static int spi_flash_set_qeb_winspan(struct spi_flash *flash)
 }
 #endif
 
+/* 3-byte address commands and the same commands with a 4-byte address */
+static const struct {
+	u8 cmd;
+	u8 cmd_4b;
+	s8 sfdp_bit;	/* bit in 4BAIT dword 1, -1 if not listed there */
+} spi_flash_4b_cmds[] = {
+	{ CMD_READ_ARRAY_SLOW,		CMD_READ_ARRAY_SLOW_4B,		0 },
+	{ CMD_READ_ARRAY_FAST,		CMD_READ_ARRAY_FAST_4B,		1 },
+	{ CMD_READ_DUAL_OUTPUT_FAST,	CMD_READ_DUAL_OUTPUT_FAST_4B,	2 },
+	{ CMD_READ_DUAL_IO_FAST,	CMD_READ_DUAL_IO_FAST_4B,	3 },
+	{ CMD_READ_QUAD_OUTPUT_FAST,	CMD_READ_QUAD_OUTPUT_FAST_4B,	4 },
+	{ CMD_READ_QUAD_IO_FAST,	CMD_READ_QUAD_IO_FAST_4B,	5 },
+	{ CMD_PAGE_PROGRAM,		CMD_PAGE_PROGRAM_4B,		6 },
+	{ CMD_QUAD_PAGE_PROGRAM,	CMD_QUAD_PAGE_PROGRAM_4B,	7 },
+	{ CMD_ERASE_4K,			CMD_ERASE_4K_4B,		-1 },
+	{ CMD_ERASE_32K,		CMD_ERASE_32K_4B,		-1 },
+	{ CMD_ERASE_64K,		CMD_ERASE_64K_4B,		-1 },
+};
+
+static u8 spi_flash_4b_cmd(u8 cmd, u32 supported)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(spi_flash_4b_cmds); i++) {
+		if (spi_flash_4b_cmds[i].cmd != cmd)
+			continue;
+		if (spi_flash_4b_cmds[i].sfdp_bit >= 0 &&
+		    !(supported & (1 << spi_flash_4b_cmds[i].sfdp_bit)))
+			return 0;
+		return spi_flash_4b_cmds[i].cmd_4b;
+	}
+
+	return 0;
+}
+
+/*
+ * Switch to commands that take a 4-byte address, so that all of a device
+ * beyond 16 MiB is reached without the bank address register. @supported
+ * holds the bits of 4BAIT dword 1, or ~0 if the device has every command;
+ * @erase_cmd is the 4-byte erase command, or 0 to look it up.
+ */
+static void spi_flash_use_4b(struct spi_flash *flash, u32 supported,
+			     u8 erase_cmd)
+{
+	u8 read_cmd, write_cmd;
+
+	if (!flash->spi->addr_4b) {
+		debug("SF: controller cannot send 4-byte addresses\n");
+		return;
+	}
+
+	read_cmd = spi_flash_4b_cmd(flash->read_cmd, supported);
+	write_cmd = spi_flash_4b_cmd(flash->write_cmd, supported);
+	/* Not all devices with 4-byte reads have a 4-byte quad program */
+	if (!write_cmd)
+		write_cmd = spi_flash_4b_cmd(CMD_PAGE_PROGRAM, supported);
+	if (!erase_cmd)
+		erase_cmd = spi_flash_4b_cmd(flash->erase_cmd, supported);
+	if (!read_cmd || !write_cmd || !erase_cmd) {
+		debug("SF: no 4-byte address form of %02x/%02x/%02x\n",
+		      flash->read_cmd, flash->write_cmd, flash->erase_cmd);
+		return;
+	}
+
+	flash->read_cmd = read_cmd;
+	flash->write_cmd = write_cmd;
+	flash->erase_cmd = erase_cmd;
+	flash->addr_width = SPI_FLASH_4B_ADDR_LEN;
+}
+
+static bool spi_flash_is_quad(struct spi_flash *flash)
+{
+	switch (flash->read_cmd) {
+	case CMD_READ_QUAD_OUTPUT_FAST:
+	case CMD_READ_QUAD_IO_FAST:
+	case CMD_READ_QUAD_OUTPUT_FAST_4B:
+	case CMD_READ_QUAD_IO_FAST_4B:
+		return true;
+	}
+
+	return flash->write_cmd == CMD_QUAD_PAGE_PROGRAM ||
+		flash->write_cmd == CMD_QUAD_PAGE_PROGRAM_4B;
+}
+
+#ifdef CONFIG_SPI_FLASH_SFDP
+/* Serial Flash Discoverable Parameters, JESD216B */
+#define SFDP_SIGNATURE		0x50444653	/* "SFDP" */
+#define SFDP_BFPT_ID		0xff00		/* Basic Flash Parameter Table */
+#define SFDP_4BAIT_ID		0xff84		/* 4-byte Address Instructions */
+#define SFDP_BFPT_DWORDS	16
+#define SFDP_4BAIT_DWORDS	2
+
+/* BFPT dword 1 */
+#define BFPT_ADDR_MASK		(3 << 17)
+#define BFPT_ADDR_3B_4B		(1 << 17)
+#define BFPT_ADDR_4B		(2 << 17)
+
+/* Multi-line fast reads described by the BFPT, fastest first */
+static const struct {
+	u8 op_mode;	/* SPI_OPM_RX_* */
+	u8 support;	/* bit in dword 1 */
+	u8 dword;	/* dword with the command and its dummy clocks */
+	u8 shift;	/* of those within the dword */
+	u8 lines;	/* lines that address and dummy clocks go out on */
+} sfdp_reads[] = {
+	{ SPI_OPM_RX_QIOF,	21, 3, 0,  4 },
+	{ SPI_OPM_RX_QOF,	22, 3, 16, 1 },
+	{ SPI_OPM_RX_DIO,	20, 4, 16, 2 },
+	{ SPI_OPM_RX_DOUT,	16, 4, 0,  1 },
+};
+
+static int sfdp_read(struct spi_flash *flash, u32 addr, void *buf, size_t len)
+{
+	u8 cmd[5];
+
+	cmd[0] = CMD_READ_SFDP;
+	cmd[1] = addr >> 16;
+	cmd[2] = addr >> 8;
+	cmd[3] = addr;
+	cmd[4] = 0;		/* 8 dummy clocks */
+
+	return spi_flash_cmd_read(flash->spi, cmd, sizeof(cmd), buf, len);
+}
+
+/*
+ * Read up to @max dwords of the parameter table @id into @dw, zeroing the
+ * rest. Returns the length of the table in dwords, or -ve if not found.
+ */
+static int sfdp_read_table(struct spi_flash *flash, int nph, u16 id, u32 *dw,
+			   int max)
+{
+	u8 ph[8];
+	int i, len, ret;
+
+	for (i = 0; i <= nph; i++) {
+		ret = sfdp_read(flash, 8 + i * sizeof(ph), ph, sizeof(ph));
+		if (ret)
+			return ret;
+		if ((ph[7] << 8 | ph[0]) != id)
+			continue;
+
+		len = min((int)ph[3], max);
+		memset(dw, '\0', max * sizeof(*dw));
+		ret = sfdp_read(flash, ph[6] << 16 | ph[5] << 8 | ph[4], dw,
+				len * sizeof(*dw));
+		if (ret)
+			return ret;
+		for (i = 0; i < len; i++)
+			dw[i] = le32_to_cpu(dw[i]);
+
+		return ph[3];
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * Use the device's own parameters to pick the fastest read the controller
+ * can do, with its dummy clocks, and the page size and address width.
+ * @qer is set to the BFPT quad enable requirements, if the device has them.
+ */
+static int spi_flash_parse_sfdp(struct spi_flash *flash,
+				const struct spi_flash_params *params,
+				u32 chip_size, int *qer)
+{
+	u32 bfpt[SFDP_BFPT_DWORDS], bait[SFDP_4BAIT_DWORDS], hdr[2];
+	u8 modes, clocks, erase_4b = 0;
+	int i, len, nph;
+	u16 half;
+
+	/* Both flashes of a parallel pair would answer at once */
+	if (flash->dual_flash & SF_DUAL_PARALLEL_FLASH)
+		return -EINVAL;
+
+	if (sfdp_read(flash, 0, hdr, sizeof(hdr)) ||
+	    le32_to_cpu(hdr[0]) != SFDP_SIGNATURE)
+		return -ENOENT;
+	nph = (le32_to_cpu(hdr[1]) >> 16) & 0xff;
+
+	len = sfdp_read_table(flash, nph, SFDP_BFPT_ID, bfpt,
+			      SFDP_BFPT_DWORDS);
+	if (len < 9) {
+		debug("SF: no usable SFDP basic parameters\n");
+		return -EINVAL;
+	}
+
+	/* Without its quad enable method, only quad modes the table knows */
+	if (len >= 15)
+		*qer = (bfpt[14] >> 20) & 7;
+	modes = flash->spi->op_mode_rx;
+	if (*qer < 0)
+		modes &= params->e_rd_cmd | ~(SPI_OPM_RX_QOF | SPI_OPM_RX_QIOF);
+
+	for (i = 0; i < ARRAY_SIZE(sfdp_reads); i++) {
+		if (!(modes & sfdp_reads[i].op_mode) ||
+		    !(bfpt[0] & (1 << sfdp_reads[i].support)))
+			continue;
+		half = bfpt[sfdp_reads[i].dword - 1] >> sfdp_reads[i].shift;
+		/* wait states plus mode clocks, sent as whole bytes */
+		clocks = (half & 0x1f) + ((half >> 5) & 7);
+		if (clocks * sfdp_reads[i].lines % 8)
+			continue;
+		flash->read_cmd = half >> 8;
+		flash->dummy_byte = clocks * sfdp_reads[i].lines / 8;
+		break;
+	}
+
+	if (len >= 11)
+		flash->page_size = (1 << ((bfpt[10] >> 4) & 0xf)) <<
+					flash->shift;
+
+	switch (bfpt[0] & BFPT_ADDR_MASK) {
+	case BFPT_ADDR_4B:
+		/* Always in 4-byte address mode */
+		if (!flash->spi->addr_4b) {
+			printf("SF: controller cannot send 4-byte addresses\n");
+			return -EINVAL;
+		}
+		flash->addr_width = SPI_FLASH_4B_ADDR_LEN;
+		break;
+	case BFPT_ADDR_3B_4B:
+		if (chip_size <= SPI_FLASH_16MB_BOUN || !flash->spi->addr_4b ||
+		    sfdp_read_table(flash, nph, SFDP_4BAIT_ID, bait,
+				    SFDP_4BAIT_DWORDS) < SFDP_4BAIT_DWORDS)
+			break;
+		/* Find which of the four erase types is in use */
+		for (i = 0; i < 4; i++) {
+			half = bfpt[7 + i / 2] >> (i % 2 * 16);
+			if ((half & 0xff) && (half >> 8) == flash->erase_cmd &&
+			    (1 << (half & 0xff)) << flash->shift ==
+					flash->erase_size &&
+			    (bait[0] & (1 << (9 + i))))
+				erase_4b = bait[1] >> (i * 8);
+		}
+		if (erase_4b)
+			spi_flash_use_4b(flash, bait[0], erase_4b);
+		break;
+	}
+
+	return 0;
+}
+
+/* Set the quad enable bit the way BFPT dword 15 says */
+static int spi_flash_set_qeb_sfdp(struct spi_flash *flash, int qer)
+{
+	u8 cmd, sr[2];
+	int ret;
+
+	switch (qer) {
+	case 0:
+		/* No quad enable bit */
+		return 0;
+	case 2:
+		/* Bit 6 of status register 1 */
+		ret = spi_flash_cmd_read_status(flash, &sr[0]);
+		if (ret < 0 || sr[0] & STATUS_QEB_MXIC)
+			return ret;
+		return spi_flash_cmd_write_status(flash,
+						  sr[0] | STATUS_QEB_MXIC);
+	case 3:
+		/* Bit 7 of status register 2, with commands of its own */
+		cmd = CMD_READ_STATUS2_QE_BIT7;
+		ret = spi_flash_read_common(flash, &cmd, 1, &sr[1], 1);
+		if (ret < 0 || sr[1] & STATUS_QEB_BIT7)
+			return ret;
+		cmd = CMD_WRITE_STATUS2_QE_BIT7;
+		sr[1] |= STATUS_QEB_BIT7;
+		return spi_flash_write_common(flash, &cmd, 1, &sr[1], 1);
+	case 1:
+	case 4:
+	case 5:
+		/* Bit 1 of status register 2, written after register 1 */
+		ret = spi_flash_cmd_read_status(flash, &sr[0]);
+		if (ret < 0)
+			return ret;
+		cmd = CMD_READ_CONFIG;
+		ret = spi_flash_read_common(flash, &cmd, 1, &sr[1], 1);
+		if (ret < 0 || sr[1] & STATUS_QEB_WINSPAN)
+			return ret;
+		cmd = CMD_WRITE_STATUS;
+		sr[1] |= STATUS_QEB_WINSPAN;
+		return spi_flash_write_common(flash, &cmd, 1, sr, 2);
+	default:
+		debug("SF: Unknown quad enable requirement %d\n", qer);
+		return -ENOENT;
+	}
+}
+
+/* Go back to single-line commands, for a quad mode that cannot be enabled */
+static void spi_flash_no_quad(struct spi_flash *flash)
+{
+	bool cmd_4b = false;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(spi_flash_4b_cmds); i++)
+		if (spi_flash_4b_cmds[i].cmd_4b == flash->read_cmd)
+			cmd_4b = true;
+	flash->read_cmd = cmd_4b ? CMD_READ_ARRAY_FAST_4B :
+				   CMD_READ_ARRAY_FAST;
+	flash->dummy_byte = 1;
+
+	if (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM)
+		flash->write_cmd = CMD_PAGE_PROGRAM;
+	else if (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM_4B)
+		flash->write_cmd = CMD_PAGE_PROGRAM_4B;
+}
+#endif /* CONFIG_SPI_FLASH_SFDP */
+
 static int spi_flash_set_qeb(struct spi_flash *flash, u8 idcode0)
 {
 	switch (idcode0) {
@@ -100,7 +409,12 @@ static struct spi_flash *spi_flash_validate_params(struct spi_slave *spi,
 {
 	const struct spi_flash_params *params;
 	struct spi_flash *flash;
+	u32 chip_size;
+	int ret;
 	u8 cmd;
+#ifdef CONFIG_SPI_FLASH_SFDP
+	int qer = -1;
+#endif
 	u16 jedec = idcode[1] << 8 | idcode[2];
 	u16 ext_jedec = idcode[3] << 8 | idcode[4];
 
@@ -134,6 +448,7 @@ static struct spi_flash *spi_flash_validate_params(struct spi_slave *spi,
 	flash->name = params->name;
 	flash->memory_map = spi->memory_map;
 	flash->dual_flash = flash->spi->option;
+	flash->addr_width = SPI_FLASH_3B_ADDR_LEN;
 
 	/* Assign spi_flash ops */
 	flash->write = spi_flash_cmd_write_ops;
@@ -223,10 +538,22 @@ static struct spi_flash *spi_flash_validate_params(struct spi_slave *spi,
 		flash->poll_cmd = CMD_FLAG_STATUS;
 #endif
 
+	/* Size of one device, of a dual pair */
+	chip_size = params->sector_size * params->nr_sectors;
+#ifdef CONFIG_SPI_FLASH_SFDP
+	if (spi_flash_parse_sfdp(flash, params, chip_size, &qer))
+		debug("SF: no SFDP, using the params table\n");
+#endif
+	/* Reach beyond 16 MiB with 4-byte addresses if the SFDP did not */
+	if (flash->addr_width == SPI_FLASH_3B_ADDR_LEN &&
+	    chip_size > SPI_FLASH_16MB_BOUN && (params->flags & ADDR_4B))
+		spi_flash_use_4b(flash, ~0, 0);
+
 	/* Configure the BAR - discover bank cmds and read current bank */
 #ifdef CONFIG_SPI_FLASH_BAR
 	u8 curr_bank = 0;
-	if (flash->size > SPI_FLASH_16MB_BOUN) {
+	if (flash->size > SPI_FLASH_16MB_BOUN &&
+	    flash->addr_width == SPI_FLASH_3B_ADDR_LEN) {
 		flash->bank_read_cmd = (idcode[0] == 0x01) ?
 					CMD_BANKADDR_BRRD : CMD_EXTNADDR_RDEAR;
 		flash->bank_write_cmd = (idcode[0] == 0x01) ?
@@ -250,6 +577,34 @@ static struct spi_flash *spi_flash_validate_params(struct spi_slave *spi,
 		spi_flash_cmd_write_status(flash, 0);
 #endif
 
+	/*
+	 * Set the quad enable bit - only for quad commands. This comes after
+	 * the BP# clear, which would also clear a QE bit in status register 1.
+	 */
+	if (spi_flash_is_quad(flash)) {
+		ret = -ENOENT;
+#ifdef CONFIG_SPI_FLASH_SFDP
+		if (qer >= 0)
+			ret = spi_flash_set_qeb_sfdp(flash, qer);
+#endif
+		if (ret == -ENOENT)
+			ret = spi_flash_set_qeb(flash, idcode[0]);
+#ifdef CONFIG_SPI_FLASH_SFDP
+		/* The device still works without quad, so do not fail */
+		if (ret && qer >= 0) {
+			debug("SF: no quad enable for %02x, using 1 line\n",
+			      idcode[0]);
+			spi_flash_no_quad(flash);
+			ret = 0;
+		}
+#endif
+		if (ret) {
+			debug("SF: Fail to set QEB for %02x\n", idcode[0]);
+			free(flash);
+			return NULL;
+		}
+	}
+
 	return flash;
 }
 
@@ -345,16 +700,6 @@ static struct spi_flash *spi_flash_probe_slave(struct spi_slave *spi)
 	if (!flash)
 		goto err_read_id;
 
-	/* Set the quad enable bit - only for quad commands */
-	if ((flash->read_cmd == CMD_READ_QUAD_OUTPUT_FAST) ||
-	    (flash->read_cmd == CMD_READ_QUAD_IO_FAST) ||
-	    (flash->write_cmd == CMD_QUAD_PAGE_PROGRAM)) {
-		if (spi_flash_set_qeb(flash, idcode[0])) {
-			debug("SF: Fail to set QEB for %02x\n", idcode[0]);
-			return NULL;
-		}
-	}
-
 #ifdef CONFIG_OF_CONTROL
 	if (spi_flash_decode_fdt(gd->fdt_blob, flash)) {
 		debug("SF: FDT decode error\n");
@@ -371,10 +716,11 @@ static struct spi_flash *spi_flash_probe_slave(struct spi_slave *spi)
 	puts("\n");
 #endif
 #ifndef CONFIG_SPI_FLASH_BAR
-	if (((flash->dual_flash == SF_SINGLE_FLASH) &&
-	     (flash->size > SPI_FLASH_16MB_BOUN)) ||
+	if (flash->addr_width == SPI_FLASH_3B_ADDR_LEN &&
+	    (((flash->dual_flash == SF_SINGLE_FLASH) &&
+	      (flash->size > SPI_FLASH_16MB_BOUN)) ||
 	     ((flash->dual_flash > SF_SINGLE_FLASH) &&
-	     (flash->size > SPI_FLASH_16MB_BOUN << 1))) {
+	      (flash->size > SPI_FLASH_16MB_BOUN << 1)))) {
 		puts("SF: Warning - Only lower 16MiB accessible,");
 		puts(" Full access #define CONFIG_SPI_FLASH_BAR\n");
 	}
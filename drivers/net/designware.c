@@ -336,7 +336,7 @@ static int dw_eth_send(struct eth_device *dev, void *packet, int length)
 	return 0;
 }
 
-static int dw_eth_recv(struct eth_device *dev)
+static int dw_eth_recv_pkt(struct eth_device *dev, uchar **packetp)
 {
 	struct dw_eth_dev *priv = dev->priv;
 	u32 status, desc_num = priv->rx_currdescnum;
@@ -359,22 +359,27 @@ static int dw_eth_recv(struct eth_device *dev)
 		length = (status & DESC_RXSTS_FRMLENMSK) >> \
 			 DESC_RXSTS_FRMLENSHFT;
 
-		/* Invalidate received data */
-		data_end = data_start + roundup(length, ARCH_DMA_MINALIGN);
-		invalidate_dcache_range(data_start, data_end);
-
-		NetReceive(desc_p->dmamac_addr, length);
+		if (!length || (status & DESC_RXSTS_ERROR)) {
+			/*
+			 * Nothing to deliver, so no dw_eth_free_pkt() will
+			 * follow: hand the descriptor straight back to the DMA
+			 */
+			length = 0;
+			desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
+			flush_dcache_range(desc_start, desc_end);
+		} else {
+			/* Invalidate received data */
+			data_end = data_start +
+				roundup(length, ARCH_DMA_MINALIGN);
+			invalidate_dcache_range(data_start, data_end);
+
+			*packetp = desc_p->dmamac_addr;
+		}
 
 		/*
-		 * Make the current descriptor valid again and go to
-		 * the next one
+		 * Go to the next descriptor; a delivered one is handed back
+		 * to the DMA by dw_eth_free_pkt() once it is processed
 		 */
-		desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
-
-		/* Flush only status field - others weren't changed */
-		flush_dcache_range(desc_start, desc_end);
-
-		/* Test the wrap-around condition. */
 		if (++desc_num >= CONFIG_RX_DESCR_NUM)
 			desc_num = 0;
 	}
@@ -384,6 +389,36 @@ static int dw_eth_recv(struct eth_device *dev)
 	return length;
 }
 
+static void dw_eth_free_pkt(struct eth_device *dev, uchar *packet, int length)
+{
+	struct dw_eth_dev *priv = dev->priv;
+	u32 desc_num = ((char *)packet - priv->rxbuffs) / CONFIG_ETH_BUFSIZE;
+	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
+	uint32_t desc_start = (uint32_t)desc_p;
+	uint32_t desc_end = desc_start +
+		roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN);
+
+	/* Make the descriptor valid again */
+	desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
+
+	/* Flush only status field - others weren't changed */
+	flush_dcache_range(desc_start, desc_end);
+}
+
+static int dw_eth_recv(struct eth_device *dev)
+{
+	uchar *packet;
+	int length;
+
+	length = dw_eth_recv_pkt(dev, &packet);
+	if (length > 0) {
+		NetReceive(packet, length);
+		dw_eth_free_pkt(dev, packet, length);
+	}
+
+	return length;
+}
+
 static int dw_phy_init(struct eth_device *dev)
 {
 	struct dw_eth_dev *priv = dev->priv;
@@ -444,6 +479,8 @@ int designware_initialize(ulong base_addr, u32 interface)
 	dev->init = dw_eth_init;
 	dev->send = dw_eth_send;
 	dev->recv = dw_eth_recv;
+	dev->recv_pkt = dw_eth_recv_pkt;
+	dev->free_pkt = dw_eth_free_pkt;
 	dev->halt = dw_eth_halt;
 	dev->write_hwaddr = dw_write_hwaddr;
 
@@ -763,21 +763,51 @@ out:
 }
 
 /**
- * Pull one frame from the card
+ * Give the current receive buffer descriptor back and move to the next one
+ * @param[in] fec all we know about the device yet
+ *
+ * Descriptors are only marked free a whole cache line at a time, once the
+ * last one in the line has been processed: see fec_recv_pkt().
+ */
+static void fec_rbd_release(struct fec_priv *fec)
+{
+	uint32_t addr, size;
+	int i;
+
+	size = RXDESC_PER_CACHELINE - 1;
+	if ((fec->rbd_index & size) == size) {
+		i = fec->rbd_index - size;
+		addr = (uint32_t)&fec->rbd_base[i];
+		for (; i <= fec->rbd_index ; i++) {
+			fec_rbd_clean(i == (FEC_RBD_NUM - 1),
+				      &fec->rbd_base[i]);
+		}
+		flush_dcache_range(addr,
+			addr + ARCH_DMA_MINALIGN);
+	}
+
+	fec_rx_task_enable(fec);
+	fec->rbd_index = (fec->rbd_index + 1) % FEC_RBD_NUM;
+}
+
+/**
+ * Get the next received frame, still in its receive buffer
  * @param[in] dev Our ethernet device to handle
- * @return Length of packet read
+ * @param[out] packetp Set to the frame data
+ * @return Length of the frame, 0 if there is none
+ *
+ * The frame's descriptor stays current until fec_free_pkt(), so until then
+ * each call returns the same frame again.
  */
-static int fec_recv(struct eth_device *dev)
+static int fec_recv_pkt(struct eth_device *dev, uchar **packetp)
 {
 	struct fec_priv *fec = (struct fec_priv *)dev->priv;
 	struct fec_bd *rbd = &fec->rbd_base[fec->rbd_index];
 	unsigned long ievent;
-	int frame_length, len = 0;
+	int frame_length;
 	struct nbuf *frame;
 	uint16_t bd_status;
 	uint32_t addr, size, end;
-	int i;
-	ALLOC_CACHE_ALIGN_BUFFER(uchar, buff, FEC_MAX_PKT_SIZE);
 
 	/*
 	 * Check if any critical events have happened
@@ -827,62 +857,70 @@ static int fec_recv(struct eth_device *dev)
 	bd_status = readw(&rbd->status);
 	debug("fec_recv: status 0x%x\n", bd_status);
 
-	if (!(bd_status & FEC_RBD_EMPTY)) {
-		if ((bd_status & FEC_RBD_LAST) && !(bd_status & FEC_RBD_ERR) &&
-			((readw(&rbd->data_length) - 4) > 14)) {
-			/*
-			 * Get buffer address and size
-			 */
-			frame = (struct nbuf *)readl(&rbd->data_pointer);
-			frame_length = readw(&rbd->data_length) - 4;
-			/*
-			 * Invalidate data cache over the buffer
-			 */
-			addr = (uint32_t)frame;
-			end = roundup(addr + frame_length, ARCH_DMA_MINALIGN);
-			addr &= ~(ARCH_DMA_MINALIGN - 1);
-			invalidate_dcache_range(addr, end);
-
-			/*
-			 *  Fill the buffer and pass it to upper layers
-			 */
-#ifdef CONFIG_FEC_MXC_SWAP_PACKET
-			swap_packet((uint32_t *)frame->data, frame_length);
-#endif
-			memcpy(buff, frame->data, frame_length);
-			NetReceive(buff, frame_length);
-			len = frame_length;
-		} else {
-			if (bd_status & FEC_RBD_ERR)
-				printf("error frame: 0x%08lx 0x%08x\n",
-						(ulong)rbd->data_pointer,
-						bd_status);
-		}
+	if (bd_status & FEC_RBD_EMPTY)
+		return 0;
 
+	if ((bd_status & FEC_RBD_LAST) && !(bd_status & FEC_RBD_ERR) &&
+		((readw(&rbd->data_length) - 4) > 14)) {
 		/*
-		 * Free the current buffer, restart the engine and move forward
-		 * to the next buffer. Here we check if the whole cacheline of
-		 * descriptors was already processed and if so, we mark it free
-		 * as whole.
+		 * Get buffer address and size
 		 */
-		size = RXDESC_PER_CACHELINE - 1;
-		if ((fec->rbd_index & size) == size) {
-			i = fec->rbd_index - size;
-			addr = (uint32_t)&fec->rbd_base[i];
-			for (; i <= fec->rbd_index ; i++) {
-				fec_rbd_clean(i == (FEC_RBD_NUM - 1),
-					      &fec->rbd_base[i]);
-			}
-			flush_dcache_range(addr,
-				addr + ARCH_DMA_MINALIGN);
-		}
+		frame = (struct nbuf *)readl(&rbd->data_pointer);
+		frame_length = readw(&rbd->data_length) - 4;
+		/*
+		 * Invalidate data cache over the buffer
+		 */
+		addr = (uint32_t)frame;
+		end = roundup(addr + frame_length, ARCH_DMA_MINALIGN);
+		addr &= ~(ARCH_DMA_MINALIGN - 1);
+		invalidate_dcache_range(addr, end);
+
+		/*
+		 * Pass the buffer to upper layers, which give it back with
+		 * fec_free_pkt()
+		 */
+#ifdef CONFIG_FEC_MXC_SWAP_PACKET
+		swap_packet((uint32_t *)frame->data, frame_length);
+#endif
+		*packetp = frame->data;
 
-		fec_rx_task_enable(fec);
-		fec->rbd_index = (fec->rbd_index + 1) % FEC_RBD_NUM;
+		return frame_length;
 	}
+
+	if (bd_status & FEC_RBD_ERR)
+		printf("error frame: 0x%08lx 0x%08x\n",
+				(ulong)rbd->data_pointer,
+				bd_status);
+
+	/* Nothing to deliver, so no fec_free_pkt() will follow */
+	fec_rbd_release(fec);
 	debug("fec_recv: stop\n");
 
-	return len;
+	return 0;
+}
+
+static void fec_free_pkt(struct eth_device *dev, uchar *packet, int length)
+{
+	fec_rbd_release((struct fec_priv *)dev->priv);
+}
+
+/**
+ * Pull one frame from the card
+ * @param[in] dev Our ethernet device to handle
+ * @return Length of packet read
+ */
+static int fec_recv(struct eth_device *dev)
+{
+	uchar *packet;
+	int length;
+
+	length = fec_recv_pkt(dev, &packet);
+	if (length > 0) {
+		NetReceive(packet, length);
+		fec_free_pkt(dev, packet, length);
+	}
+
+	return length;
 }
 
 static void fec_set_dev_name(char *dest, int dev_id)
@@ -998,6 +1036,8 @@ static int fec_probe(bd_t *bd, int dev_id, uint32_t base_addr,
 	edev->init = fec_init;
 	edev->send = fec_send;
 	edev->recv = fec_recv;
+	edev->recv_pkt = fec_recv_pkt;
+	edev->free_pkt = fec_free_pkt;
 	edev->halt = fec_halt;
 	edev->write_hwaddr = fec_set_hwaddr;
 
@@ -95,6 +95,9 @@ struct spi_slave *spi_setup_slave(unsigned int bus, unsigned int cs,
 		return NULL;
 	}
 
+	/* Bytes go to the emulated flash as they are */
+	sss->slave.addr_4b = 1;
+
 	spec = state->spi[bus][cs].spec;
 	sss->ops = state->spi[bus][cs].ops;
 	if (!spec || !sss->ops || sss->ops->setup(&sss->priv, spec)) {
@@ -9,6 +9,7 @@
 #include <linux/mii.h>
 #include "usb_ether.h"
 #include <malloc.h>
+#include <errno.h>
 
 
 /* ASIX AX8817X based USB 2.0 Ethernet Devices */
@@ -83,6 +84,8 @@
 #define USB_BULK_RECV_TIMEOUT 5000
 
 #define AX_RX_URB_SIZE 2048
+/* Receive buffers kept queued on the bulk-in endpoint */
+#define AX_RX_QUEUED 2
 #define PHY_CONNECT_TIMEOUT 5000
 
 /* asix_flags defines */
@@ -98,6 +101,11 @@ static int curr_eth_dev; /* index for name of next device detected */
 /* driver private */
 struct asix_private {
 	int flags;
+#ifdef CONFIG_USB_BULK_QUEUE
+	struct bulk_queue *rx_queue;	/* NULL when nothing is queued */
+	unsigned char *rx_buf;		/* AX_RX_QUEUED buffers */
+	int rx_next;			/* buffer that completes next */
+#endif
 };
 
 /*
@@ -481,35 +489,11 @@ static int asix_send(struct eth_device *eth, void *packet, int length)
 	return err;
 }
 
-static int asix_recv(struct eth_device *eth)
+/* Hand each frame in a bulk-in transfer to the network stack */
+static int asix_rx_frames(unsigned char *buf_ptr, int actual_len)
 {
-	struct ueth_data *dev = (struct ueth_data *)eth->priv;
-	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, recv_buf, AX_RX_URB_SIZE);
-	unsigned char *buf_ptr;
-	int err;
-	int actual_len;
 	u32 packet_len;
 
-	debug("** %s()\n", __func__);
-
-	err = usb_bulk_msg(dev->pusb_dev,
-				usb_rcvbulkpipe(dev->pusb_dev, dev->ep_in),
-				(void *)recv_buf,
-				AX_RX_URB_SIZE,
-				&actual_len,
-				USB_BULK_RECV_TIMEOUT);
-	debug("Rx: len = %u, actual = %u, err = %d\n", AX_RX_URB_SIZE,
-		actual_len, err);
-	if (err != 0) {
-		debug("Rx: failed to receive\n");
-		return -1;
-	}
-	if (actual_len > AX_RX_URB_SIZE) {
-		debug("Rx: received too many bytes %d\n", actual_len);
-		return -1;
-	}
-
-	buf_ptr = recv_buf;
 	while (actual_len > 0) {
 		/*
 		 * 1st 4 bytes contain the length of the actual data as two
@@ -543,12 +527,118 @@ static int asix_recv(struct eth_device *eth)
 		buf_ptr += sizeof(packet_len) + packet_len;
 	}
 
+	return 0;
+}
+
+#ifdef CONFIG_USB_BULK_QUEUE
+static void asix_rx_stop(struct ueth_data *dev)
+{
+	struct asix_private *priv = (struct asix_private *)dev->dev_priv;
+
+	if (priv->rx_queue) {
+		put_bulk_queue(dev->pusb_dev, priv->rx_queue);
+		priv->rx_queue = NULL;
+	}
+}
+
+/*
+ * Keep AX_RX_QUEUED buffers queued for the bulk-in endpoint, so that the
+ * adapter can pass on frames while the last ones are being handled, and a
+ * poll with nothing received returns straight away.
+ */
+static int asix_recv(struct eth_device *eth)
+{
+	struct ueth_data *dev = (struct ueth_data *)eth->priv;
+	struct asix_private *priv = (struct asix_private *)dev->dev_priv;
+	unsigned long pipe = usb_rcvbulkpipe(dev->pusb_dev, dev->ep_in);
+	unsigned char *buf;
+	int err, i;
+	int actual_len;
+
+	if (!priv->rx_buf) {
+		priv->rx_buf = memalign(ARCH_DMA_MINALIGN,
+					AX_RX_QUEUED * AX_RX_URB_SIZE);
+		if (!priv->rx_buf)
+			return -1;
+	}
+	if (!priv->rx_queue) {
+		priv->rx_queue = get_bulk_queue(dev->pusb_dev, pipe,
+					AX_RX_QUEUED,
+					AX_RX_QUEUED * AX_RX_URB_SIZE);
+		if (!priv->rx_queue) {
+			debug("Rx: cannot get bulk queue\n");
+			return -1;
+		}
+		for (i = 0; i < AX_RX_QUEUED; i++) {
+			if (bulk_queue_submit(dev->pusb_dev, priv->rx_queue,
+					priv->rx_buf + i * AX_RX_URB_SIZE,
+					AX_RX_URB_SIZE))
+				goto fail;
+		}
+		priv->rx_next = 0;
+	}
+
+	err = bulk_queue_poll(dev->pusb_dev, priv->rx_queue, &actual_len);
+	if (err == -EINPROGRESS)
+		return 0;
+	if (err) {
+		debug("Rx: failed to receive\n");
+		goto fail;
+	}
+	debug("Rx: len = %u, actual = %u\n", AX_RX_URB_SIZE, actual_len);
+
+	buf = priv->rx_buf + priv->rx_next * AX_RX_URB_SIZE;
+	err = asix_rx_frames(buf, actual_len);
+
+	/* Queue the buffer again, behind the others */
+	if (bulk_queue_submit(dev->pusb_dev, priv->rx_queue, buf,
+			      AX_RX_URB_SIZE))
+		goto fail;
+	priv->rx_next = (priv->rx_next + 1) % AX_RX_QUEUED;
+
 	return err;
+
+fail:
+	asix_rx_stop(dev);
+	return -1;
+}
+#else
+static int asix_recv(struct eth_device *eth)
+{
+	struct ueth_data *dev = (struct ueth_data *)eth->priv;
+	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, recv_buf, AX_RX_URB_SIZE);
+	int err;
+	int actual_len;
+
+	debug("** %s()\n", __func__);
+
+	err = usb_bulk_msg(dev->pusb_dev,
+				usb_rcvbulkpipe(dev->pusb_dev, dev->ep_in),
+				(void *)recv_buf,
+				AX_RX_URB_SIZE,
+				&actual_len,
+				USB_BULK_RECV_TIMEOUT);
+	debug("Rx: len = %u, actual = %u, err = %d\n", AX_RX_URB_SIZE,
+		actual_len, err);
+	if (err != 0) {
+		debug("Rx: failed to receive\n");
+		return -1;
+	}
+	if (actual_len > AX_RX_URB_SIZE) {
+		debug("Rx: received too many bytes %d\n", actual_len);
+		return -1;
+	}
+
+	return asix_rx_frames(recv_buf, actual_len);
 }
+#endif
 
 static void asix_halt(struct eth_device *eth)
 {
 	debug("** %s()\n", __func__);
+#ifdef CONFIG_USB_BULK_QUEUE
+	asix_rx_stop((struct ueth_data *)eth->priv);
+#endif
 }
 
 /*
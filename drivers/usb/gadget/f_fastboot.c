@@ -24,6 +24,11 @@
 #include <fb_mmc.h>
 #endif
 
+#if defined(CONFIG_FASTBOOT_STREAM) && \
+	(!defined(CONFIG_FASTBOOT_FLASH) || !defined(CONFIG_FASTBOOT_FLASH_MMC_DEV))
+#error "CONFIG_FASTBOOT_STREAM needs CONFIG_FASTBOOT_FLASH_MMC_DEV"
+#endif
+
 #define FASTBOOT_VERSION		"0.4"
 
 #define FASTBOOT_INTERFACE_CLASS	0xff
@@ -56,6 +61,37 @@ static struct f_fastboot *fastboot_func;
 static unsigned int download_size;
 static unsigned int download_bytes;
 
+#ifdef CONFIG_FASTBOOT_STREAM
+/* What "max-download-size" offers while a partition is set for streaming */
+#define FASTBOOT_STREAM_MAX_DOWNLOAD	0x7ffff000
+/* OUT requests that can be queued at once, out_req being one of them */
+#define FASTBOOT_STREAM_REQS	8
+
+static char stream_part[32];	/* partition set by "oem stream", or "" */
+static bool download_streamed;	/* the last download went to stream_part */
+static char stream_response[RESPONSE_LEN];	/* for the "flash" command */
+static struct usb_request *stream_req[FASTBOOT_STREAM_REQS - 1];
+static unsigned int stream_requested;	/* bytes asked of the host so far */
+/* Requests received, in order, for fastboot_stream_poll() to take in */
+static struct usb_request *stream_rx[FASTBOOT_STREAM_REQS];
+static unsigned int stream_rx_len[FASTBOOT_STREAM_REQS];
+static int stream_rx_head, stream_rx_count;
+static unsigned int stream_rx_taken;	/* of the head request */
+/* Requests taken in and free to be queued again */
+static struct usb_request *stream_idle[FASTBOOT_STREAM_REQS];
+static int stream_idle_count;
+
+static inline bool fastboot_streaming(void)
+{
+	return download_streamed;
+}
+#else
+static inline bool fastboot_streaming(void)
+{
+	return false;
+}
+#endif
+
 static struct usb_endpoint_descriptor fs_ep_in = {
 	.bLength            = USB_DT_ENDPOINT_SIZE,
 	.bDescriptorType    = USB_DT_ENDPOINT,
@@ -177,6 +213,22 @@ static void fastboot_disable(struct usb_function *f)
 	usb_ep_disable(f_fb->in_ep);
 
 	if (f_fb->out_req) {
+#ifdef CONFIG_FASTBOOT_STREAM
+		int i;
+
+		/* Drop a download that was cut short */
+		if (download_streamed)
+			fb_mmc_stream_abort();
+		download_streamed = false;
+		download_size = 0;
+		for (i = 0; i < ARRAY_SIZE(stream_req); i++) {
+			if (!stream_req[i])
+				continue;
+			free(stream_req[i]->buf);
+			usb_ep_free_request(f_fb->out_ep, stream_req[i]);
+			stream_req[i] = NULL;
+		}
+#endif
 		free(f_fb->out_req->buf);
 		usb_ep_free_request(f_fb->out_ep, f_fb->out_req);
 		f_fb->out_req = NULL;
@@ -355,6 +407,12 @@ static void cb_getvar(struct usb_ep *ep, struct usb_request *req)
 		!strcmp_l1("max-download-size", cmd)) {
 		char str_num[12];
 
+#ifdef CONFIG_FASTBOOT_STREAM
+		if (stream_part[0])
+			sprintf(str_num, "0x%08x",
+				FASTBOOT_STREAM_MAX_DOWNLOAD);
+		else
+#endif
 		sprintf(str_num, "0x%08x", CONFIG_USB_FASTBOOT_BUF_SIZE);
 		strncat(response, str_num, chars_left);
 	} else if (!strcmp_l1("serialno", cmd)) {
@@ -381,6 +439,98 @@ static unsigned int rx_bytes_expected(void)
 }
 
 #define BYTES_PER_DOT	0x20000
+
+#ifdef CONFIG_FASTBOOT_STREAM
+static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req);
+
+/* Like rx_bytes_expected(), counting what the queued requests will bring */
+static unsigned int stream_rx_length(struct usb_ep *ep)
+{
+	unsigned int len = download_size - stream_requested;
+
+	if (len > EP_BUFFER_SIZE)
+		len = EP_BUFFER_SIZE;
+	stream_requested += len;
+
+	return len < ep->maxpacket ? ep->maxpacket : len;
+}
+
+static void stream_queue(struct usb_ep *ep, struct usb_request *req)
+{
+	req->complete = rx_handler_dl_image;
+	req->length = stream_rx_length(ep);
+	req->actual = 0;
+	usb_ep_queue(ep, req, 0);
+}
+
+/*
+ * Only note the data here. Writing it can take a while, so that is left to
+ * fastboot_stream_poll(), outside the completion handler, and the request
+ * is not queued again until its data has been taken in.
+ */
+static void rx_handler_dl_stream(struct usb_ep *ep, struct usb_request *req,
+				 unsigned int transfer_size)
+{
+	int i = (stream_rx_head + stream_rx_count) % FASTBOOT_STREAM_REQS;
+
+	download_bytes += transfer_size;
+	stream_rx[i] = req;
+	stream_rx_len[i] = transfer_size;
+	stream_rx_count++;
+}
+
+void fastboot_stream_poll(void)
+{
+	struct usb_request *req;
+	struct usb_ep *ep;
+	unsigned int len;
+
+	if (!download_streamed || !download_size || !fastboot_func ||
+	    !fastboot_func->out_req)
+		return;
+	ep = fastboot_func->out_ep;
+
+	/* Take in what has arrived, as far as there is room for it */
+	while (stream_rx_count) {
+		req = stream_rx[stream_rx_head];
+		len = stream_rx_len[stream_rx_head];
+		stream_rx_taken += fb_mmc_stream_write(req->buf +
+						       stream_rx_taken,
+						       len - stream_rx_taken);
+		if (stream_rx_taken < len)
+			break;
+		stream_rx_taken = 0;
+		stream_rx_head = (stream_rx_head + 1) % FASTBOOT_STREAM_REQS;
+		stream_rx_count--;
+		stream_idle[stream_idle_count++] = req;
+	}
+
+	/* Keep the host sending while the eMMC is written */
+	while (stream_idle_count && stream_requested < download_size)
+		stream_queue(ep, stream_idle[--stream_idle_count]);
+
+	/* One write step per call, so that the USB is seen to in between */
+	if (fb_mmc_stream_poll())
+		return;
+
+	if (download_bytes < download_size || stream_rx_count)
+		return;
+
+	fb_mmc_stream_finish();
+
+	download_size = 0;
+	stream_idle_count = 0;
+	req = fastboot_func->out_req;
+	req->complete = rx_handler_command;
+	req->length = EP_BUFFER_SIZE;
+	fastboot_tx_write_str("OKAY");
+	printf("\ndownloading of %d bytes finished\n", download_bytes);
+
+	req->actual = 0;
+	usb_ep_queue(ep, req, 0);
+}
+#endif
+
 static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 {
 	char response[RESPONSE_LEN];
@@ -397,19 +547,26 @@ static void rx_handler_dl_image(struct usb_ep *ep, struct usb_request *req)
 	if (buffer_size < transfer_size)
 		transfer_size = buffer_size;
 
-	memcpy((void *)CONFIG_USB_FASTBOOT_BUF_ADDR + download_bytes,
-	       buffer, transfer_size);
-
 	pre_dot_num = download_bytes / BYTES_PER_DOT;
-	download_bytes += transfer_size;
-	now_dot_num = download_bytes / BYTES_PER_DOT;
-
+	now_dot_num = (download_bytes + transfer_size) / BYTES_PER_DOT;
 	if (pre_dot_num != now_dot_num) {
 		putc('.');
 		if (!(now_dot_num % 74))
 			putc('\n');
 	}
 
+#ifdef CONFIG_FASTBOOT_STREAM
+	if (download_streamed) {
+		rx_handler_dl_stream(ep, req, transfer_size);
+		return;
+	}
+#endif
+
+	memcpy((void *)CONFIG_USB_FASTBOOT_BUF_ADDR + download_bytes,
+	       buffer, transfer_size);
+
+	download_bytes += transfer_size;
+
 	/* Check if transfer is done */
 	if (download_bytes >= download_size) {
 		/*
@@ -445,14 +602,52 @@ static void cb_download(struct usb_ep *ep, struct usb_request *req)
 
 	printf("Starting download of %d bytes\n", download_size);
 
+#ifdef CONFIG_FASTBOOT_STREAM
+	download_streamed = false;
+	if (download_size && stream_part[0]) {
+		int i;
+
+		for (i = 0; i < ARRAY_SIZE(stream_req); i++) {
+			if (!stream_req[i])
+				stream_req[i] = fastboot_start_ep(ep);
+			if (!stream_req[i]) {
+				download_size = 0;
+				fastboot_tx_write_str("FAILout of memory");
+				return;
+			}
+			/* Queued by fastboot_stream_poll(), after req */
+			stream_idle[i] = stream_req[i];
+		}
+		stream_idle_count = i;
+		stream_rx_count = 0;
+		stream_rx_taken = 0;
+		stream_requested = 0;
+		if (fb_mmc_stream_start(stream_part, download_size,
+					stream_response)) {
+			download_size = 0;
+			snprintf(response, sizeof(response), "%s",
+				 stream_response);
+			fastboot_tx_write_str(response);
+			return;
+		}
+		download_streamed = true;
+	}
+#endif
+
 	if (0 == download_size) {
 		sprintf(response, "FAILdata invalid size");
-	} else if (download_size > CONFIG_USB_FASTBOOT_BUF_SIZE) {
+	} else if (download_size > CONFIG_USB_FASTBOOT_BUF_SIZE &&
+		   !fastboot_streaming()) {
 		download_size = 0;
 		sprintf(response, "FAILdata too large");
 	} else {
 		sprintf(response, "DATA%08x", download_size);
 		req->complete = rx_handler_dl_image;
+#ifdef CONFIG_FASTBOOT_STREAM
+		if (fastboot_streaming())
+			req->length = stream_rx_length(ep);
+		else
+#endif
 		req->length = rx_bytes_expected();
 		if (req->length < ep->maxpacket)
 			req->length = ep->maxpacket;
@@ -493,6 +688,18 @@ static void cb_flash(struct usb_ep *ep, struct usb_request *req)
 		return;
 	}
 
+#ifdef CONFIG_FASTBOOT_STREAM
+	/* The image was written as it was downloaded */
+	if (download_streamed) {
+		download_streamed = false;
+		if (strcmp(cmd, stream_part))
+			fastboot_tx_write_str("FAILimage was streamed elsewhere");
+		else
+			fastboot_tx_write_str(stream_response);
+		return;
+	}
+#endif
+
 	strcpy(response, "FAILno flash device defined");
 #ifdef CONFIG_FASTBOOT_FLASH_MMC_DEV
 	fb_mmc_flash_write(cmd, (void *)CONFIG_USB_FASTBOOT_BUF_ADDR,
@@ -502,6 +709,28 @@ static void cb_flash(struct usb_ep *ep, struct usb_request *req)
 }
 #endif
 
+#ifdef CONFIG_FASTBOOT_STREAM
+/*
+ * "oem stream:<partition>" makes each download after it go straight to the
+ * partition as it arrives, so that images need not fit in the download
+ * buffer. The "flash" command that follows then only reports how it went.
+ * "oem stream" on its own goes back to normal downloads.
+ */
+static void cb_oem_stream(struct usb_ep *ep, struct usb_request *req)
+{
+	char *cmd = req->buf;
+
+	strsep(&cmd, ":");
+	if (cmd && strlen(cmd) >= sizeof(stream_part)) {
+		fastboot_tx_write_str("FAILpartition name too long");
+		return;
+	}
+	strcpy(stream_part, cmd ? cmd : "");
+	download_streamed = false;
+	fastboot_tx_write_str("OKAY");
+}
+#endif
+
 struct cmd_dispatch_info {
 	char *cmd;
 	void (*cb)(struct usb_ep *ep, struct usb_request *req);
@@ -527,6 +756,12 @@ static const struct cmd_dispatch_info cmd_dispatch_info[] = {
 		.cb = cb_flash,
 	},
 #endif
+#ifdef CONFIG_FASTBOOT_STREAM
+	{
+		.cmd = "oem stream",
+		.cb = cb_oem_stream,
+	},
+#endif
 };
 
 static void rx_handler_command(struct usb_ep *ep, struct usb_request *req)
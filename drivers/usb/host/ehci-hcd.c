@@ -27,6 +27,7 @@
 #include <usb.h>
 #include <asm/io.h>
 #include <malloc.h>
+#include <mempool.h>
 #include <watchdog.h>
 #include <linux/compiler.h>
 
@@ -296,6 +297,50 @@ static void ehci_update_endpt2_dev_n_port(struct usb_device *dev,
 				     QH_ENDPT2_HUBADDR(ttdev->parent->devnum));
 }
 
+/* Convert the status of a finished qTD into USB_ST_... flags */
+static unsigned long ehci_token_status(uint32_t token)
+{
+	switch (QT_TOKEN_GET_STATUS(token) &
+		~(QT_TOKEN_STATUS_SPLITXSTATE | QT_TOKEN_STATUS_PERR)) {
+	case 0:
+		return 0;
+	case QT_TOKEN_STATUS_HALTED:
+		return USB_ST_STALLED;
+	case QT_TOKEN_STATUS_ACTIVE | QT_TOKEN_STATUS_DATBUFERR:
+	case QT_TOKEN_STATUS_DATBUFERR:
+		return USB_ST_BUF_ERR;
+	case QT_TOKEN_STATUS_HALTED | QT_TOKEN_STATUS_BABBLEDET:
+	case QT_TOKEN_STATUS_BABBLEDET:
+		return USB_ST_BABBLE_DET;
+	default:
+		if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
+			return USB_ST_CRC_ERR | USB_ST_STALLED;
+		return USB_ST_CRC_ERR;
+	}
+}
+
+/* Wait until the host controller no longer holds a QH taken off the list */
+static int
+ehci_async_advance(struct ehci_ctrl *ctrl)
+{
+	uint32_t cmd;
+	struct ehci_hcor *hcor = ctrl->hcor;
+	int ret;
+
+	cmd = ehci_readl(&hcor->or_usbcmd);
+	cmd |= CMD_IAAD;
+	ehci_writel(&hcor->or_usbcmd, cmd);
+
+	ret = handshake((uint32_t *)&hcor->or_usbsts, STS_IAA, STS_IAA,
+			100 * 1000);
+	ehci_writel(&hcor->or_usbsts, STS_IAA);
+	if (ret < 0) {
+		printf("EHCI fail timeout STS_IAA set\n");
+		return -ETIMEDOUT;
+	}
+	return 0;
+}
+
 static int
 ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		   int length, struct devrequest *req)
@@ -375,14 +420,8 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		 */
 		qtd_count += 2 + length / xfr_sz;
 	}
-/*
- * Threshold value based on the worst-case total size of the allocated qTDs for
- * a mass-storage transfer of 65535 blocks of 512 bytes.
- */
-#if CONFIG_SYS_MALLOC_LEN <= 64 + 128 * 1024
-#warning CONFIG_SYS_MALLOC_LEN may be too small for EHCI
-#endif
-	qtd = memalign(USB_DMA_MINALIGN, qtd_count * sizeof(struct qTD));
+	qtd = scratch_memalign(USB_DMA_MINALIGN,
+			       qtd_count * sizeof(struct qTD));
 	if (qtd == NULL) {
 		printf("unable to allocate TDs\n");
 		return -1;
@@ -403,7 +442,12 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	 *   qh_overlay.qt_next ...... 13-10 H
 	 * - qh_overlay.qt_altnext
 	 */
-	qh->qh_link = cpu_to_hc32((uint32_t)&ctrl->qh_list | QH_LINK_TYPE_QH);
+	if (ctrl->async_queues)
+		/* Go ahead of the bulk queues' QHs */
+		qh->qh_link = ctrl->qh_list.qh_link;
+	else
+		qh->qh_link = cpu_to_hc32((uint32_t)&ctrl->qh_list |
+					  QH_LINK_TYPE_QH);
 	c = (dev->speed != USB_SPEED_HIGH) && !usb_pipeendpoint(pipe);
 	maxpacket = usb_maxpacket(dev, pipe);
 	endpt = QH_ENDPT1_RL(8) | QH_ENDPT1_C(c) |
@@ -546,22 +590,26 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	flush_dcache_range((uint32_t)qtd,
 			   ALIGN_END_ADDR(struct qTD, qtd, qtd_count));
 
-	/* Set async. queue head pointer. */
-	ehci_writel(&ctrl->hcor->or_asynclistaddr, (uint32_t)&ctrl->qh_list);
-
 	usbsts = ehci_readl(&ctrl->hcor->or_usbsts);
 	ehci_writel(&ctrl->hcor->or_usbsts, (usbsts & 0x3f));
 
-	/* Enable async. schedule. */
-	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
-	cmd |= CMD_ASE;
-	ehci_writel(&ctrl->hcor->or_usbcmd, cmd);
+	/* The async. schedule is already running for the bulk queues */
+	if (!ctrl->async_queues) {
+		/* Set async. queue head pointer. */
+		ehci_writel(&ctrl->hcor->or_asynclistaddr,
+			    (uint32_t)&ctrl->qh_list);
 
-	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, STS_ASS,
-			100 * 1000);
-	if (ret < 0) {
-		printf("EHCI fail timeout STS_ASS set\n");
-		goto fail;
+		/* Enable async. schedule. */
+		cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
+		cmd |= CMD_ASE;
+		ehci_writel(&ctrl->hcor->or_usbcmd, cmd);
+
+		ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS,
+				STS_ASS, 100 * 1000);
+		if (ret < 0) {
+			printf("EHCI fail timeout STS_ASS set\n");
+			goto fail;
+		}
 	}
 
 	/* Wait for TDs to be processed. */
@@ -599,45 +647,37 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE)
 		printf("EHCI timed out on TD - token=%#x\n", token);
 
-	/* Disable async schedule. */
-	cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
-	cmd &= ~CMD_ASE;
-	ehci_writel(&ctrl->hcor->or_usbcmd, cmd);
+	if (ctrl->async_queues) {
+		/* Take the QH off the schedule and leave the rest running */
+		ctrl->qh_list.qh_link = qh->qh_link;
+		flush_dcache_range((uint32_t)&ctrl->qh_list,
+			ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
+		if (ehci_async_advance(ctrl) < 0)
+			goto fail;
+		invalidate_dcache_range((uint32_t)qh,
+			ALIGN_END_ADDR(struct QH, qh, 1));
+	} else {
+		/* Disable async schedule. */
+		cmd = ehci_readl(&ctrl->hcor->or_usbcmd);
+		cmd &= ~CMD_ASE;
+		ehci_writel(&ctrl->hcor->or_usbcmd, cmd);
 
-	ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, 0,
-			100 * 1000);
-	if (ret < 0) {
-		printf("EHCI fail timeout STS_ASS reset\n");
-		goto fail;
+		ret = handshake((uint32_t *)&ctrl->hcor->or_usbsts, STS_ASS, 0,
+				100 * 1000);
+		if (ret < 0) {
+			printf("EHCI fail timeout STS_ASS reset\n");
+			goto fail;
+		}
 	}
 
 	token = hc32_to_cpu(qh->qh_overlay.qt_token);
 	if (!(QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_ACTIVE)) {
 		debug("TOKEN=%#x\n", token);
-		switch (QT_TOKEN_GET_STATUS(token) &
-			~(QT_TOKEN_STATUS_SPLITXSTATE | QT_TOKEN_STATUS_PERR)) {
-		case 0:
+		dev->status = ehci_token_status(token);
+		if (!dev->status) {
 			toggle = QT_TOKEN_GET_DT(token);
 			usb_settoggle(dev, usb_pipeendpoint(pipe),
 				       usb_pipeout(pipe), toggle);
-			dev->status = 0;
-			break;
-		case QT_TOKEN_STATUS_HALTED:
-			dev->status = USB_ST_STALLED;
-			break;
-		case QT_TOKEN_STATUS_ACTIVE | QT_TOKEN_STATUS_DATBUFERR:
-		case QT_TOKEN_STATUS_DATBUFERR:
-			dev->status = USB_ST_BUF_ERR;
-			break;
-		case QT_TOKEN_STATUS_HALTED | QT_TOKEN_STATUS_BABBLEDET:
-		case QT_TOKEN_STATUS_BABBLEDET:
-			dev->status = USB_ST_BABBLE_DET;
-			break;
-		default:
-			dev->status = USB_ST_CRC_ERR;
-			if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
-				dev->status |= USB_ST_STALLED;
-			break;
 		}
 		dev->act_len = length - QT_TOKEN_GET_TOTALBYTES(token);
 	} else {
@@ -650,11 +690,11 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 #endif
 	}
 
-	free(qtd);
+	scratch_free(qtd);
 	return (dev->status != USB_ST_NOT_PROC) ? 0 : -1;
 
 fail:
-	free(qtd);
+	scratch_free(qtd);
 	return -1;
 }
 
@@ -939,9 +979,18 @@ unknown:
 	return -1;
 }
 
+#ifdef CONFIG_USB_BULK_QUEUE
+static void ehci_free_bulk_queues(struct ehci_ctrl *ctrl);
+static int ehci_bulk_queue_msg(struct usb_device *dev, unsigned long pipe,
+			       void *buffer, int length);
+#endif
+
 int usb_lowlevel_stop(int index)
 {
 	ehci_shutdown(&ehcic[index]);
+#ifdef CONFIG_USB_BULK_QUEUE
+	ehci_free_bulk_queues(&ehcic[index]);
+#endif
 	return ehci_hcd_stop(index);
 }
 
@@ -1083,7 +1132,26 @@ submit_bulk_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 		debug("non-bulk pipe (type=%lu)", usb_pipetype(pipe));
 		return -1;
 	}
+#ifdef CONFIG_USB_BULK_QUEUE
+	return ehci_bulk_queue_msg(dev, pipe, buffer, length);
+#else
 	return ehci_submit_async(dev, pipe, buffer, length, NULL);
+#endif
+}
+
+/*
+ * ehci_submit_async() allocates the qTDs for each transfer, so let them take
+ * up to a sixteenth of the malloc() area. Whatever the alignment of the
+ * buffer, each qTD carries at least QT_BUFFER_CNT - 1 full pages.
+ */
+#define EHCI_MAX_XFER_TDS	min((size_t)4096, CONFIG_SYS_MALLOC_LEN / 16 / \
+				    sizeof(struct qTD))
+
+int usb_get_max_xfer_size(struct usb_device *dev, size_t *size)
+{
+	*size = EHCI_MAX_XFER_TDS * (QT_BUFFER_CNT - 1) * EHCI_PAGE_SIZE;
+
+	return 0;
 }
 
 int
@@ -1425,3 +1493,671 @@ submit_int_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 	/* everything worked out fine */
 	return result;
 }
+
+#ifdef CONFIG_USB_BULK_QUEUE
+/*
+ * A bulk queue keeps one QH for its endpoint on the async schedule, so that
+ * the next transfer can be queued while the host controller is still busy
+ * with the last one. Each endpoint gets its queue the first time it is used
+ * and keeps it until the controller is stopped, so bulk transfers made with
+ * submit_bulk_msg() go through it as well and the QH and qTDs are not set
+ * up again for each one.
+ *
+ * The QH keeps the data toggle in its overlay, and its qTDs come from a ring
+ * that always ends with an inactive qTD. A transfer is added by filling in
+ * the qTDs after that one and then the inactive qTD itself, which the host
+ * controller looks at again each time it visits the QH. Each qTD has its own
+ * cache line, since the host controller writes to the one it is working on
+ * while later ones are filled in.
+ */
+#define BULK_TD_SIZE	ALIGN(sizeof(struct qTD), USB_DMA_MINALIGN)
+#define BULK_TD_BYTES	((QT_BUFFER_CNT - 1) * EHCI_PAGE_SIZE)
+
+/* submit_bulk_msg() does its transfers in pieces of at least this size */
+#define BULK_QUEUE_MSG_LEN	(64 * BULK_TD_BYTES)
+
+struct bulk_queue_xfer {
+	int length;
+	int first;		/* ring slot of the first qTD */
+	int ntds;
+};
+
+/* The part of a buffer that each qTD in the ring covers */
+struct bulk_queue_buf {
+	void *buffer;
+	int length;
+};
+
+struct bulk_queue {
+	struct bulk_queue *next;	/* next queue of the controller */
+	struct usb_device *dev;
+	unsigned long pipe;
+	struct QH *qh;
+	char *tds;		/* ring of qTDs, BULK_TD_SIZE bytes apart */
+	struct bulk_queue_buf *bufs;
+	int ntds;
+	int tail;		/* slot of the inactive qTD ending the queue */
+	int used;		/* qTDs of the transfers in flight */
+	struct bulk_queue_xfer *xfers;
+	int queuesize;
+	int head;		/* oldest transfer in flight */
+	int count;		/* transfers in flight */
+	int toggle;		/* last data toggle passed to usb_settoggle() */
+};
+
+static struct qTD *bulk_queue_td(struct bulk_queue *queue, int slot)
+{
+	return (struct qTD *)(queue->tds + slot * BULK_TD_SIZE);
+}
+
+static inline int bulk_queue_next(struct bulk_queue *queue, int slot)
+{
+	return slot + 1 < queue->ntds ? slot + 1 : 0;
+}
+
+static void bulk_queue_flush(struct qTD *td)
+{
+	flush_dcache_range((uint32_t)td, (uint32_t)td + BULK_TD_SIZE);
+}
+
+static int
+enable_async(struct ehci_ctrl *ctrl)
+{
+	uint32_t cmd;
+	struct ehci_hcor *hcor = ctrl->hcor;
+	int ret;
+
+	ehci_writel(&hcor->or_asynclistaddr, (uint32_t)&ctrl->qh_list);
+	cmd = ehci_readl(&hcor->or_usbcmd);
+	cmd |= CMD_ASE;
+	ehci_writel(&hcor->or_usbcmd, cmd);
+
+	ret = handshake((uint32_t *)&hcor->or_usbsts, STS_ASS, STS_ASS,
+			100 * 1000);
+	if (ret < 0) {
+		printf("EHCI fail timeout STS_ASS set\n");
+		return -ETIMEDOUT;
+	}
+	return 0;
+}
+
+static int
+disable_async(struct ehci_ctrl *ctrl)
+{
+	uint32_t cmd;
+	struct ehci_hcor *hcor = ctrl->hcor;
+	int ret;
+
+	cmd = ehci_readl(&hcor->or_usbcmd);
+	cmd &= ~CMD_ASE;
+	ehci_writel(&hcor->or_usbcmd, cmd);
+
+	ret = handshake((uint32_t *)&hcor->or_usbsts, STS_ASS, 0, 100 * 1000);
+	if (ret < 0) {
+		printf("EHCI fail timeout STS_ASS reset\n");
+		return -ETIMEDOUT;
+	}
+	return 0;
+}
+
+/* Empty the ring and point the QH at its first qTD */
+static void bulk_queue_reset(struct bulk_queue *queue)
+{
+	struct QH *qh = queue->qh;
+	struct qTD *td = bulk_queue_td(queue, 0);
+
+	memset(queue->tds, 0, queue->ntds * BULK_TD_SIZE);
+	td->qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+	td->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+
+	queue->toggle = usb_gettoggle(queue->dev,
+				      usb_pipeendpoint(queue->pipe),
+				      usb_pipeout(queue->pipe));
+	qh->qh_curtd = 0;
+	memset(&qh->qh_overlay, 0, sizeof(qh->qh_overlay));
+	qh->qh_overlay.qt_next = cpu_to_hc32((uint32_t)td);
+	qh->qh_overlay.qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	qh->qh_overlay.qt_token = cpu_to_hc32(QT_TOKEN_DT(queue->toggle));
+
+	queue->tail = 0;
+	queue->used = 0;
+	queue->head = 0;
+	queue->count = 0;
+
+	flush_dcache_range((uint32_t)queue->tds,
+			   (uint32_t)queue->tds + queue->ntds * BULK_TD_SIZE);
+	flush_dcache_range((uint32_t)qh, ALIGN_END_ADDR(struct QH, qh, 1));
+}
+
+static void bulk_queue_free(struct bulk_queue *queue)
+{
+	free(queue->tds);
+	free(queue->bufs);
+	free(queue->qh);
+	free(queue->xfers);
+	free(queue);
+}
+
+static struct bulk_queue *
+bulk_queue_alloc(struct usb_device *dev, unsigned long pipe, int queuesize,
+		 int ntds)
+{
+	struct bulk_queue *queue;
+	struct QH *qh;
+	uint32_t endpt;
+
+	queue = calloc(1, sizeof(*queue));
+	if (!queue) {
+		debug("ehci bulk queue: out of memory\n");
+		return NULL;
+	}
+	queue->dev = dev;
+	queue->pipe = pipe;
+	queue->queuesize = queuesize;
+	queue->ntds = ntds;
+	queue->xfers = calloc(queuesize, sizeof(*queue->xfers));
+	queue->bufs = calloc(ntds, sizeof(*queue->bufs));
+	queue->qh = memalign(USB_DMA_MINALIGN, sizeof(struct QH));
+	queue->tds = memalign(USB_DMA_MINALIGN, ntds * BULK_TD_SIZE);
+	if (!queue->xfers || !queue->bufs || !queue->qh || !queue->tds) {
+		debug("ehci bulk queue: out of memory\n");
+		bulk_queue_free(queue);
+		return NULL;
+	}
+
+	qh = queue->qh;
+	memset(qh, 0, sizeof(struct QH));
+	endpt = QH_ENDPT1_RL(8) | QH_ENDPT1_C(0) |
+		QH_ENDPT1_MAXPKTLEN(usb_maxpacket(dev, pipe)) | QH_ENDPT1_H(0) |
+		QH_ENDPT1_DTC(QH_ENDPT1_DTC_IGNORE_QTD_TD) |
+		QH_ENDPT1_EPS(ehci_encode_speed(dev->speed)) |
+		QH_ENDPT1_ENDPT(usb_pipeendpoint(pipe)) | QH_ENDPT1_I(0) |
+		QH_ENDPT1_DEVADDR(usb_pipedevice(pipe));
+	qh->qh_endpt1 = cpu_to_hc32(endpt);
+	endpt = QH_ENDPT2_MULT(1) | QH_ENDPT2_UFCMASK(0) | QH_ENDPT2_UFSMASK(0);
+	qh->qh_endpt2 = cpu_to_hc32(endpt);
+	ehci_update_endpt2_dev_n_port(dev, qh);
+	bulk_queue_reset(queue);
+
+	return queue;
+}
+
+/* Put the queue's QH on the async schedule, starting it if need be */
+static int bulk_queue_link(struct ehci_ctrl *ctrl, struct bulk_queue *queue)
+{
+	struct QH *qh = queue->qh;
+
+	/* The list may still point at the last ehci_submit_async() QH */
+	if (!ctrl->async_queues)
+		ctrl->qh_list.qh_link = cpu_to_hc32((uint32_t)&ctrl->qh_list |
+						    QH_LINK_TYPE_QH);
+	qh->qh_link = ctrl->qh_list.qh_link;
+	flush_dcache_range((uint32_t)qh, ALIGN_END_ADDR(struct QH, qh, 1));
+
+	ctrl->qh_list.qh_link = cpu_to_hc32((uint32_t)qh | QH_LINK_TYPE_QH);
+	flush_dcache_range((uint32_t)&ctrl->qh_list,
+			   ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
+
+	if (!ctrl->async_queues && enable_async(ctrl) < 0) {
+		ctrl->qh_list.qh_link = qh->qh_link;
+		flush_dcache_range((uint32_t)&ctrl->qh_list,
+				   ALIGN_END_ADDR(struct QH, &ctrl->qh_list, 1));
+		return -ETIMEDOUT;
+	}
+	ctrl->async_queues++;
+
+	return 0;
+}
+
+/* Record the data toggle the QH has got to, unless the endpoint halted */
+static void bulk_queue_save_toggle(struct bulk_queue *queue)
+{
+	uint32_t token;
+
+	invalidate_dcache_range((uint32_t)queue->qh,
+				ALIGN_END_ADDR(struct QH, queue->qh, 1));
+	token = hc32_to_cpu(queue->qh->qh_overlay.qt_token);
+	if (QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED)
+		return;
+	queue->toggle = QT_TOKEN_GET_DT(token);
+	usb_settoggle(queue->dev, usb_pipeendpoint(queue->pipe),
+		      usb_pipeout(queue->pipe), queue->toggle);
+}
+
+/*
+ * Take the queue's QH off the async schedule, stopping the schedule if it
+ * was the last one, and wait until the host controller has let go of it.
+ */
+static int bulk_queue_unlink(struct ehci_ctrl *ctrl, struct bulk_queue *queue)
+{
+	struct QH *prev = &ctrl->qh_list;
+	int ret = 0;
+
+	while (NEXT_QH(prev) != queue->qh) {
+		prev = NEXT_QH(prev);
+		if (prev == &ctrl->qh_list) {
+			printf("ehci bulk queue: QH not on the async list\n");
+			return -EINVAL;
+		}
+	}
+
+	if (--ctrl->async_queues == 0)
+		ret = disable_async(ctrl);
+	prev->qh_link = queue->qh->qh_link;
+	flush_dcache_range((uint32_t)prev, ALIGN_END_ADDR(struct QH, prev, 1));
+	if (ctrl->async_queues && ehci_async_advance(ctrl) < 0)
+		ret = -ETIMEDOUT;
+
+	return ret;
+}
+
+/* Drop whatever is queued and start again from an empty ring */
+static int bulk_queue_restart(struct bulk_queue *queue)
+{
+	struct ehci_ctrl *ctrl = queue->dev->controller;
+	int ret;
+
+	ret = bulk_queue_unlink(ctrl, queue);
+	/*
+	 * When transfers are dropped, the QH has the toggle the device
+	 * expects. Otherwise usb_settoggle() already has it, unless it has
+	 * been reset on purpose since.
+	 */
+	if (queue->count)
+		bulk_queue_save_toggle(queue);
+	bulk_queue_reset(queue);
+	if (ret != -EINVAL) {
+		int err = bulk_queue_link(ctrl, queue);
+
+		if (!ret)
+			ret = err;
+	}
+
+	return ret;
+}
+
+static struct bulk_queue **
+bulk_queue_find(struct ehci_ctrl *ctrl, struct usb_device *dev,
+		unsigned long pipe)
+{
+	struct bulk_queue **pp;
+
+	for (pp = &ctrl->bulk_queues; *pp; pp = &(*pp)->next) {
+		if ((*pp)->dev == dev &&
+		    usb_pipedevice((*pp)->pipe) == usb_pipedevice(pipe) &&
+		    usb_pipeendpoint((*pp)->pipe) == usb_pipeendpoint(pipe) &&
+		    usb_pipein((*pp)->pipe) == usb_pipein(pipe))
+			break;
+	}
+
+	return pp;
+}
+
+struct bulk_queue *
+get_bulk_queue(struct usb_device *dev, unsigned long pipe, int queuesize,
+	       int maxlen)
+{
+	struct ehci_ctrl *ctrl = dev->controller;
+	struct bulk_queue **pp, *queue;
+	int ntds;
+
+	if (usb_pipetype(pipe) != PIPE_BULK) {
+		debug("non-bulk pipe (type=%lu)", usb_pipetype(pipe));
+		return NULL;
+	}
+
+	/*
+	 * A transfer takes a qTD for each BULK_TD_BYTES, one more for the
+	 * part before the first page boundary and one for the end of the
+	 * ring.
+	 */
+	ntds = maxlen / BULK_TD_BYTES + 2 * queuesize + 1;
+
+	pp = bulk_queue_find(ctrl, dev, pipe);
+	queue = *pp;
+	if (queue) {
+		if (queue->ntds >= ntds && queue->queuesize >= queuesize)
+			return queue;
+		if (queue->count) {
+			debug("ehci bulk queue: busy, cannot grow it\n");
+			return NULL;
+		}
+		/* Replace it with a larger one, which then stays */
+		ntds = max(ntds, queue->ntds);
+		queuesize = max(queuesize, queue->queuesize);
+		*pp = queue->next;
+		bulk_queue_unlink(ctrl, queue);
+		bulk_queue_free(queue);
+	}
+
+	queue = bulk_queue_alloc(dev, pipe, queuesize, ntds);
+	if (!queue)
+		return NULL;
+	if (bulk_queue_link(ctrl, queue) < 0) {
+		bulk_queue_free(queue);
+		return NULL;
+	}
+	queue->next = ctrl->bulk_queues;
+	ctrl->bulk_queues = queue;
+
+	return queue;
+}
+
+int put_bulk_queue(struct usb_device *dev, struct bulk_queue *queue)
+{
+	if (!queue->count)
+		return 0;
+
+	debug("ehci bulk queue: dropping %d transfers\n", queue->count);
+	return bulk_queue_restart(queue);
+}
+
+static void ehci_free_bulk_queues(struct ehci_ctrl *ctrl)
+{
+	struct bulk_queue *queue, *next;
+
+	/* The controller has been stopped, so it holds none of them */
+	for (queue = ctrl->bulk_queues; queue; queue = next) {
+		next = queue->next;
+		bulk_queue_free(queue);
+	}
+	ctrl->bulk_queues = NULL;
+	ctrl->async_queues = 0;
+}
+
+/* Return the size of the qTD transfer that starts at @buf */
+static int bulk_queue_td_bytes(uint8_t *buf, int left_length)
+{
+	int xfr_bytes = QT_BUFFER_CNT * EHCI_PAGE_SIZE;
+
+	/* As in ehci_submit_async(), keep each packet within a qTD */
+	xfr_bytes -= (uint32_t)buf & (EHCI_PAGE_SIZE - 1);
+	xfr_bytes &= ~(PKT_ALIGN - 1);
+
+	return min(xfr_bytes, left_length);
+}
+
+/* Return the number of qTDs needed for @length bytes at @buf */
+static int bulk_queue_count_tds(uint8_t *buf, int length)
+{
+	int xfr_bytes, ntds = 0;
+
+	do {
+		xfr_bytes = bulk_queue_td_bytes(buf, length);
+		buf += xfr_bytes;
+		length -= xfr_bytes;
+		ntds++;
+	} while (length > 0);
+
+	return ntds;
+}
+
+/* Return how much of @length bytes at @buf the ring has room for */
+static int bulk_queue_fit(struct bulk_queue *queue, uint8_t *buf, int length)
+{
+	int room = queue->ntds - queue->used - 1;
+	int len = 0;
+
+	do {
+		len += bulk_queue_td_bytes(buf + len, length - len);
+	} while (--room > 0 && len < length);
+
+	return len;
+}
+
+int bulk_queue_submit_sg(struct usb_device *dev, struct bulk_queue *queue,
+			 struct bulk_sg *sg, int nents)
+{
+	struct bulk_queue_xfer *xfer;
+	struct qTD *td, *first, *end;
+	uint8_t *buf_ptr;
+	uint32_t token, altnext;
+	int maxpacket = usb_maxpacket(dev, queue->pipe);
+	int length, left_length, xfr_bytes, ntds, slot, i, n;
+
+	ntds = 0;
+	length = 0;
+	for (n = 0; n < nents; n++) {
+		/* Only the last entry may end with a short packet */
+		if (n < nents - 1 &&
+		    (sg[n].length <= 0 || sg[n].length % maxpacket)) {
+			debug("ehci bulk queue: bad s/g entry %d\n", n);
+			return -EINVAL;
+		}
+		ntds += bulk_queue_count_tds(sg[n].buffer, sg[n].length);
+		length += sg[n].length;
+	}
+
+	if (queue->count == queue->queuesize ||
+	    queue->used + ntds >= queue->ntds) {
+		debug("ehci bulk queue: no room for %d bytes\n", length);
+		return -ENOSPC;
+	}
+
+	/*
+	 * Start afresh if the endpoint halted, or if its toggle was reset
+	 * behind our back, as usb_clear_halt() does.
+	 */
+	if (!queue->count) {
+		invalidate_dcache_range((uint32_t)queue->qh,
+				ALIGN_END_ADDR(struct QH, queue->qh, 1));
+		token = hc32_to_cpu(queue->qh->qh_overlay.qt_token);
+		if ((QT_TOKEN_GET_STATUS(token) & QT_TOKEN_STATUS_HALTED) ||
+		    usb_gettoggle(dev, usb_pipeendpoint(queue->pipe),
+				  usb_pipeout(queue->pipe)) != queue->toggle) {
+			if (bulk_queue_restart(queue) < 0)
+				return -EIO;
+		}
+	}
+
+	/* The slot after the transfer becomes the end of the queue */
+	slot = queue->tail;
+	for (i = 0; i < ntds; i++)
+		slot = bulk_queue_next(queue, slot);
+	end = bulk_queue_td(queue, slot);
+	memset(end, 0, sizeof(*end));
+	end->qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+	end->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
+	bulk_queue_flush(end);
+
+	/* After a short packet, go straight on to the next transfer */
+	altnext = usb_pipein(queue->pipe) ? (uint32_t)end : QT_NEXT_TERMINATE;
+
+	first = bulk_queue_td(queue, queue->tail);
+	slot = queue->tail;
+	i = 0;
+	for (n = 0; n < nents; n++) {
+		buf_ptr = sg[n].buffer;
+		left_length = sg[n].length;
+		do {
+			td = bulk_queue_td(queue, slot);
+			xfr_bytes = bulk_queue_td_bytes(buf_ptr, left_length);
+			queue->bufs[slot].buffer = buf_ptr;
+			queue->bufs[slot].length = xfr_bytes;
+			slot = bulk_queue_next(queue, slot);
+
+			if (td != first)
+				memset(td, 0, sizeof(*td));
+			td->qt_next = cpu_to_hc32((uint32_t)bulk_queue_td(queue,
+									  slot));
+			td->qt_altnext = cpu_to_hc32(altnext);
+			if (ehci_td_buffer(td, buf_ptr, xfr_bytes)) {
+				printf("unable to construct DATA TD\n");
+				return -EINVAL;
+			}
+			token = QT_TOKEN_TOTALBYTES(xfr_bytes) |
+				QT_TOKEN_IOC(i == ntds - 1) | QT_TOKEN_CPAGE(0) |
+				QT_TOKEN_CERR(3) |
+				QT_TOKEN_PID(usb_pipein(queue->pipe) ?
+					QT_TOKEN_PID_IN : QT_TOKEN_PID_OUT);
+			/* The first qTD is made active last, once all are set */
+			if (td != first) {
+				token |= QT_TOKEN_STATUS(QT_TOKEN_STATUS_ACTIVE);
+				td->qt_token = cpu_to_hc32(token);
+				bulk_queue_flush(td);
+			} else {
+				first->qt_token = cpu_to_hc32(token);
+			}
+			buf_ptr += xfr_bytes;
+			left_length -= xfr_bytes;
+			i++;
+		} while (left_length > 0);
+	}
+	bulk_queue_flush(first);
+	first->qt_token = cpu_to_hc32(hc32_to_cpu(first->qt_token) |
+				QT_TOKEN_STATUS(QT_TOKEN_STATUS_ACTIVE));
+	bulk_queue_flush(first);
+
+	xfer = &queue->xfers[(queue->head + queue->count) % queue->queuesize];
+	xfer->length = length;
+	xfer->first = queue->tail;
+	xfer->ntds = ntds;
+	queue->count++;
+	queue->used += ntds;
+	queue->tail = slot;
+
+	return 0;
+}
+
+int bulk_queue_submit(struct usb_device *dev, struct bulk_queue *queue,
+		      void *buffer, int length)
+{
+	struct bulk_sg sg = { .buffer = buffer, .length = length };
+
+	return bulk_queue_submit_sg(dev, queue, &sg, 1);
+}
+
+/* Invalidate the buffers of an IN transfer, a run of adjacent qTDs at once */
+static void bulk_queue_invalidate(struct bulk_queue *queue,
+				  struct bulk_queue_xfer *xfer)
+{
+	struct bulk_queue_buf *buf;
+	uint32_t start = 0, end = 0;
+	int slot, i;
+
+	for (i = 0, slot = xfer->first; i < xfer->ntds; i++) {
+		buf = &queue->bufs[slot];
+		slot = bulk_queue_next(queue, slot);
+		if ((uint32_t)buf->buffer != end) {
+			if (end != start)
+				invalidate_dcache_range(start,
+					ALIGN(end, ARCH_DMA_MINALIGN));
+			start = (uint32_t)buf->buffer;
+		}
+		end = (uint32_t)buf->buffer + buf->length;
+	}
+	if (end != start)
+		invalidate_dcache_range(start, ALIGN(end, ARCH_DMA_MINALIGN));
+}
+
+int bulk_queue_poll(struct usb_device *dev, struct bulk_queue *queue,
+		    int *act_len)
+{
+	struct bulk_queue_xfer *xfer = &queue->xfers[queue->head];
+	struct qTD *td;
+	unsigned long status = 0;
+	uint32_t token;
+	int remaining = 0, short_packet = 0, slot, i;
+
+	if (!queue->count)
+		return -ENOENT;
+
+	for (i = 0, slot = xfer->first; i < xfer->ntds; i++) {
+		td = bulk_queue_td(queue, slot);
+		slot = bulk_queue_next(queue, slot);
+		invalidate_dcache_range((uint32_t)td,
+					(uint32_t)td + BULK_TD_SIZE);
+		token = hc32_to_cpu(td->qt_token);
+		/* The qTDs after a short packet are skipped */
+		if (!short_packet) {
+			if (QT_TOKEN_GET_STATUS(token) &
+			    QT_TOKEN_STATUS_ACTIVE)
+				return -EINPROGRESS;
+			status = ehci_token_status(token);
+			if (status)
+				break;
+			short_packet = QT_TOKEN_GET_TOTALBYTES(token) != 0;
+		}
+		remaining += QT_TOKEN_GET_TOTALBYTES(token);
+	}
+
+	if (usb_pipein(queue->pipe))
+		bulk_queue_invalidate(queue, xfer);
+
+	dev->status = status;
+	dev->act_len = status ? 0 : xfer->length - remaining;
+	*act_len = dev->act_len;
+	queue->head = (queue->head + 1) % queue->queuesize;
+	queue->count--;
+	queue->used -= xfer->ntds;
+
+	if (status) {
+		/* The QH has stopped, so the transfers behind are dropped */
+		bulk_queue_restart(queue);
+		return -EIO;
+	}
+	if (!queue->count)
+		bulk_queue_save_toggle(queue);
+
+	return 0;
+}
+
+/*
+ * Do a bulk transfer through the endpoint's queue, in pieces that fit in its
+ * ring, waiting for each as ehci_submit_async() would.
+ */
+static int ehci_bulk_queue_msg(struct usb_device *dev, unsigned long pipe,
+			       void *buffer, int length)
+{
+	struct ehci_ctrl *ctrl = dev->controller;
+	struct bulk_queue *queue;
+	uint8_t *buf_ptr = buffer;
+	int left_length = length, done = 0, xfr_len, act_len, ret;
+	unsigned long ts;
+
+	queue = *bulk_queue_find(ctrl, dev, pipe);
+	if (queue && queue->count) {
+		printf("EHCI bulk queue busy\n");
+		return -1;
+	}
+	queue = get_bulk_queue(dev, pipe, 1, BULK_QUEUE_MSG_LEN);
+	if (!queue)
+		return ehci_submit_async(dev, pipe, buffer, length, NULL);
+
+	do {
+		xfr_len = bulk_queue_fit(queue, buf_ptr, left_length);
+		ret = bulk_queue_submit(dev, queue, buf_ptr, xfr_len);
+		if (ret)
+			break;
+
+		ts = get_timer(0);
+		do {
+			ret = bulk_queue_poll(dev, queue, &act_len);
+			if (ret != -EINPROGRESS)
+				break;
+			WATCHDOG_RESET();
+		} while (get_timer(ts) < USB_TIMEOUT_MS(pipe));
+		if (ret)
+			break;
+
+		done += act_len;
+		buf_ptr += xfr_len;
+		left_length -= xfr_len;
+	} while (left_length > 0 && act_len == xfr_len);
+
+	if (ret == -EIO)
+		/* dev->status says what went wrong */
+		return 0;
+	if (ret) {
+		if (ret == -EINPROGRESS) {
+			printf("EHCI timed out on bulk queue\n");
+			put_bulk_queue(dev, queue);
+		}
+		dev->act_len = 0;
+		return -1;
+	}
+	dev->act_len = done;
+
+	return 0;
+}
+#endif /* CONFIG_USB_BULK_QUEUE */
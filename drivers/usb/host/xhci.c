@@ -890,6 +890,24 @@ submit_bulk_msg(struct usb_device *udev, unsigned long pipe, void *buffer,
 	return xhci_bulk_tx(udev, pipe, length, buffer);
 }
 
+/**
+ * Return the largest bulk transfer that fits on an endpoint's ring
+ *
+ * Each ring has a single segment, ending in a link TRB, and each TRB
+ * carries up to 64KB without crossing a 64KB boundary. Leave room for the
+ * TRB before the first boundary and for the link TRB.
+ *
+ * @param udev	pointer to the USB device
+ * @param size	returns the size in bytes
+ * @return returns 0
+ */
+int usb_get_max_xfer_size(struct usb_device *udev, size_t *size)
+{
+	*size = (TRBS_PER_SEGMENT - 4) * TRB_MAX_BUFF_SIZE;
+
+	return 0;
+}
+
 /**
  * submit the control type of request to the Root hub/Device based on the devnum
  *
@@ -23,6 +23,7 @@
 #include <ext_common.h>
 #include <ext4fs.h>
 #include <malloc.h>
+#include <mempool.h>
 #include <stddef.h>
 #include <linux/stat.h>
 #include <linux/time.h>
@@ -31,16 +32,76 @@
 
 struct ext2_data *ext4fs_root;
 struct ext2fs_node *ext4fs_file;
-uint32_t *ext4fs_indir1_block;
-int ext4fs_indir1_size;
-int ext4fs_indir1_blkno = -1;
-uint32_t *ext4fs_indir2_block;
-int ext4fs_indir2_size;
-int ext4fs_indir2_blkno = -1;
-
-uint32_t *ext4fs_indir3_block;
-int ext4fs_indir3_size;
-int ext4fs_indir3_blkno = -1;
+
+#ifdef CONFIG_MEMPOOL
+/* Directory nodes, one of which is allocated for each lookup */
+static struct mem_pool ext4fs_node_pool;
+#endif
+
+struct ext2fs_node *ext4fs_node_alloc(void)
+{
+#ifdef CONFIG_MEMPOOL
+	if (!ext4fs_node_pool.size)
+		mem_pool_init(&ext4fs_node_pool, "ext4-node",
+			      sizeof(struct ext2fs_node), 0, 16, 0);
+	return mem_pool_zalloc(&ext4fs_node_pool);
+#else
+	return zalloc(sizeof(struct ext2fs_node));
+#endif
+}
+
+void ext4fs_node_free(struct ext2fs_node *node)
+{
+#ifdef CONFIG_MEMPOOL
+	mem_pool_free(&ext4fs_node_pool, node);
+#else
+	free(node);
+#endif
+}
+
+/* Number of extent tree and indirect blocks kept by ext4fs_cache_read() */
+#ifndef CONFIG_EXT4_BLOCK_CACHE_SIZE
+#define CONFIG_EXT4_BLOCK_CACHE_SIZE	8
+#endif
+
+struct ext4_cache_entry {
+	lbaint_t	block;	/* Device sector the block starts at */
+	int		size;	/* Size of buf in bytes, 0 if unused */
+	unsigned long	lru;	/* Tick of the last access */
+	char		*buf;
+};
+
+static struct ext4_cache_entry ext4fs_cache[CONFIG_EXT4_BLOCK_CACHE_SIZE];
+static unsigned long ext4fs_cache_tick;
+
+/* Number of name lookups remembered by the dentry cache */
+#ifndef CONFIG_EXT4_DENTRY_CACHE_SIZE
+#define CONFIG_EXT4_DENTRY_CACHE_SIZE	32
+#endif
+/* Longer names are not cached */
+#define EXT4_DCACHE_NAME_LEN		48
+
+struct ext4_dentry {
+	int		dir;	/* Inode of the directory, 0 if unused */
+	int		ino;
+	int		type;
+	unsigned long	lru;	/* Tick of the last access */
+	char		name[EXT4_DCACHE_NAME_LEN];
+};
+
+/* Identifies the filesystem the dentry cache belongs to */
+struct ext4_dcache_id {
+	block_dev_desc_t *dev_desc;
+	lbaint_t	part_start;
+	uint32_t	unique_id[4];
+	uint32_t	utime;
+	uint32_t	free_blocks;
+	uint32_t	free_inodes;
+};
+
+static struct ext4_dentry ext4fs_dcache[CONFIG_EXT4_DENTRY_CACHE_SIZE];
+static struct ext4_dcache_id ext4fs_dcache_id;
+static unsigned long ext4fs_dcache_tick;
 struct ext2_inode *g_parent_inode;
 static int symlinknest;
 
@@ -1403,9 +1464,65 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 
 #endif
 
+/*
+ * Return the 'size' bytes of metadata (an extent tree node or an indirect
+ * block) at device sector 'block', reading them into the least recently
+ * used cache entry on a miss. The data stay valid at least until the next
+ * call. On failure NULL is returned.
+ */
+static char *ext4fs_cache_read(lbaint_t block, int size)
+{
+	struct ext4_cache_entry *ent, *victim = &ext4fs_cache[0];
+	int i;
+
+	ext4fs_cache_tick++;
+	for (i = 0; i < CONFIG_EXT4_BLOCK_CACHE_SIZE; i++) {
+		ent = &ext4fs_cache[i];
+		if (ent->size == size && ent->block == block) {
+			ent->lru = ext4fs_cache_tick;
+			return ent->buf;
+		}
+		if (ent->lru < victim->lru)
+			victim = ent;
+	}
+
+	if (victim->size != size) {
+		free(victim->buf);
+		victim->buf = memalign(ARCH_DMA_MINALIGN, size);
+		if (!victim->buf) {
+			victim->size = 0;
+			victim->lru = 0;
+			return NULL;
+		}
+	}
+	victim->size = 0;
+	victim->lru = 0;
+
+	if (!ext4fs_devread(block, 0, size, victim->buf))
+		return NULL;
+
+	victim->block = block;
+	victim->size = size;
+	victim->lru = ext4fs_cache_tick;
+
+	return victim->buf;
+}
+
+static void ext4fs_cache_flush(void)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_EXT4_BLOCK_CACHE_SIZE; i++) {
+		free(ext4fs_cache[i].buf);
+		ext4fs_cache[i].buf = NULL;
+		ext4fs_cache[i].size = 0;
+		ext4fs_cache[i].lru = 0;
+	}
+	ext4fs_cache_tick = 0;
+}
+
 static struct ext4_extent_header *ext4fs_get_extent_block
-	(struct ext2_data *data, char *buf,
-		struct ext4_extent_header *ext_block,
+	(struct ext2_data *data, struct ext4_extent_header *ext_block,
 		uint32_t fileblock, int log2_blksz)
 {
 	struct ext4_extent_idx *index;
@@ -1434,10 +1551,9 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
 
-		if (ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
-				   buf))
-			ext_block = (struct ext4_extent_header *)buf;
-		else
+		ext_block = (struct ext4_extent_header *)
+			ext4fs_cache_read((lbaint_t)block << log2_blksz, blksz);
+		if (!ext_block)
 			return 0;
 	}
 }
@@ -1495,348 +1611,164 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	return 1;
 }
 
-long int read_allocated_block(struct ext2_inode *inode, int fileblock)
+/*
+ * Look up entry 'index' of the indirect block 'blkno'.
+ * Return the entry, or -1 if the indirect block cannot be read.
+ */
+static long int read_indirect_entry(uint32_t blkno, long int index)
 {
+	int blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
+		- get_fs()->dev_desc->log2blksz;
+	uint32_t *block;
+
+	/* an unallocated indirect block only maps holes */
+	if (!blkno)
+		return 0;
+
+	block = (uint32_t *)ext4fs_cache_read((lbaint_t)
+					      __le32_to_cpu(blkno) <<
+					      log2_blksz, blksz);
+	if (!block) {
+		printf("** ext2fs read indirect block %u failed. **\n",
+		       __le32_to_cpu(blkno));
+		return -1;
+	}
+
+	return __le32_to_cpu(block[index]);
+}
+
+static long int read_indirect_block(struct ext2_inode *inode, int fileblock)
+{
+	long int perblock = EXT2_BLOCK_SIZE(ext4fs_root) / 4;
+	long int rblock;
 	long int blknr;
-	int blksz;
+
+	/* Direct blocks. */
+	if (fileblock < INDIRECT_BLOCKS)
+		return __le32_to_cpu(inode->b.blocks.dir_blocks[fileblock]);
+
+	/* Indirect. */
+	rblock = fileblock - INDIRECT_BLOCKS;
+	if (rblock < perblock)
+		return read_indirect_entry(inode->b.blocks.indir_block,
+					   rblock);
+
+	/* Double indirect. */
+	rblock -= perblock;
+	if (rblock < perblock * perblock) {
+		blknr = read_indirect_entry(inode->b.blocks.double_indir_block,
+					    rblock / perblock);
+		if (blknr < 0)
+			return blknr;
+
+		return read_indirect_entry(__cpu_to_le32(blknr),
+					   rblock % perblock);
+	}
+
+	/* Tripple indirect. */
+	rblock -= perblock * perblock;
+	blknr = read_indirect_entry(inode->b.blocks.triple_indir_block,
+				    rblock / (perblock * perblock));
+	if (blknr < 0)
+		return blknr;
+
+	blknr = read_indirect_entry(__cpu_to_le32(blknr),
+				    (rblock / perblock) % perblock);
+	if (blknr < 0)
+		return blknr;
+
+	return read_indirect_entry(__cpu_to_le32(blknr), rblock % perblock);
+}
+
+/*
+ * Map 'fileblock' of 'inode' to a filesystem block and store in '*count'
+ * how many file blocks from 'fileblock' on (at most 'maxcount') map to
+ * consecutive filesystem blocks, or are all holes if 0 is returned.
+ * Return the filesystem block, 0 for a hole or a negative value on error.
+ */
+long int read_allocated_run(struct ext2_inode *inode, int fileblock,
+			    int maxcount, int *count)
+{
+	long int blknr, next;
 	int log2_blksz;
-	int status;
-	long int rblock;
-	long int perblock_parent;
-	long int perblock_child;
 	unsigned long long start;
-	/* get the blocksize of the filesystem */
-	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
+	int n;
+
 	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
 		- get_fs()->dev_desc->log2blksz;
+	*count = 1;
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		char *buf = zalloc(blksz);
-		if (!buf)
-			return -ENOMEM;
 		struct ext4_extent_header *ext_block;
 		struct ext4_extent *extent;
 		int i = -1;
+		int entries;
+
 		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, buf,
+			ext4fs_get_extent_block(ext4fs_root,
 						(struct ext4_extent_header *)
 						inode->b.blocks.dir_blocks,
 						fileblock, log2_blksz);
 		if (!ext_block) {
 			printf("invalid extent block\n");
-			free(buf);
 			return -EINVAL;
 		}
 
 		extent = (struct ext4_extent *)(ext_block + 1);
+		entries = le16_to_cpu(ext_block->eh_entries);
 
 		do {
 			i++;
-			if (i >= le16_to_cpu(ext_block->eh_entries))
+			if (i >= entries)
 				break;
 		} while (fileblock >= le32_to_cpu(extent[i].ee_block));
 		if (--i >= 0) {
 			fileblock -= le32_to_cpu(extent[i].ee_block);
 			if (fileblock >= le16_to_cpu(extent[i].ee_len)) {
-				free(buf);
+				/* a hole, up to the next extent of this leaf */
+				if (i + 1 < entries) {
+					n = le32_to_cpu(extent[i + 1].ee_block)
+					    - le32_to_cpu(extent[i].ee_block)
+					    - fileblock;
+					*count = min(maxcount, n);
+				}
 				return 0;
 			}
 
 			start = le16_to_cpu(extent[i].ee_start_hi);
 			start = (start << 32) +
 					le32_to_cpu(extent[i].ee_start_lo);
-			free(buf);
+			n = le16_to_cpu(extent[i].ee_len) - fileblock;
+			*count = min(maxcount, n);
 			return fileblock + start;
 		}
 
 		printf("Extent Error\n");
-		free(buf);
 		return -1;
 	}
 
-	/* Direct blocks. */
-	if (fileblock < INDIRECT_BLOCKS)
-		blknr = __le32_to_cpu(inode->b.blocks.dir_blocks[fileblock]);
+	blknr = read_indirect_block(inode, fileblock);
+	if (blknr < 0)
+		return blknr;
 
-	/* Indirect. */
-	else if (fileblock < (INDIRECT_BLOCKS + (blksz / 4))) {
-		if (ext4fs_indir1_block == NULL) {
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** SI ext2fs read block (indir 1)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-			ext4fs_indir1_blkno = -1;
-		}
-		if (blksz != ext4fs_indir1_size) {
-			free(ext4fs_indir1_block);
-			ext4fs_indir1_block = NULL;
-			ext4fs_indir1_size = 0;
-			ext4fs_indir1_blkno = -1;
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** SI ext2fs read block (indir 1):"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-		}
-		if ((__le32_to_cpu(inode->b.blocks.indir_block) <<
-		     log2_blksz) != ext4fs_indir1_blkno) {
-			status =
-			    ext4fs_devread((lbaint_t)__le32_to_cpu
-					   (inode->b.blocks.
-					    indir_block) << log2_blksz, 0,
-					   blksz, (char *)ext4fs_indir1_block);
-			if (status == 0) {
-				printf("** SI ext2fs read block (indir 1)"
-					"failed. **\n");
-				return 0;
-			}
-			ext4fs_indir1_blkno =
-				__le32_to_cpu(inode->b.blocks.
-					       indir_block) << log2_blksz;
-		}
-		blknr = __le32_to_cpu(ext4fs_indir1_block
-				      [fileblock - INDIRECT_BLOCKS]);
+	/* the indirect blocks are cached, so this costs no extra reads */
+	for (n = 1; n < maxcount; n++) {
+		next = read_indirect_block(inode, fileblock + n);
+		if (next != (blknr ? blknr + n : 0))
+			break;
 	}
-	/* Double indirect. */
-	else if (fileblock < (INDIRECT_BLOCKS + (blksz / 4 *
-					(blksz / 4 + 1)))) {
-
-		long int perblock = blksz / 4;
-		long int rblock = fileblock - (INDIRECT_BLOCKS + blksz / 4);
-
-		if (ext4fs_indir1_block == NULL) {
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** DI ext2fs read block (indir 2 1)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-			ext4fs_indir1_blkno = -1;
-		}
-		if (blksz != ext4fs_indir1_size) {
-			free(ext4fs_indir1_block);
-			ext4fs_indir1_block = NULL;
-			ext4fs_indir1_size = 0;
-			ext4fs_indir1_blkno = -1;
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** DI ext2fs read block (indir 2 1)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-		}
-		if ((__le32_to_cpu(inode->b.blocks.double_indir_block) <<
-		     log2_blksz) != ext4fs_indir1_blkno) {
-			status =
-			    ext4fs_devread((lbaint_t)__le32_to_cpu
-					   (inode->b.blocks.
-					    double_indir_block) << log2_blksz,
-					   0, blksz,
-					   (char *)ext4fs_indir1_block);
-			if (status == 0) {
-				printf("** DI ext2fs read block (indir 2 1)"
-					"failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_blkno =
-			    __le32_to_cpu(inode->b.blocks.double_indir_block) <<
-			    log2_blksz;
-		}
+	*count = n;
+	debug("read_allocated_run %ld+%d\n", blknr, n);
 
-		if (ext4fs_indir2_block == NULL) {
-			ext4fs_indir2_block = zalloc(blksz);
-			if (ext4fs_indir2_block == NULL) {
-				printf("** DI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_size = blksz;
-			ext4fs_indir2_blkno = -1;
-		}
-		if (blksz != ext4fs_indir2_size) {
-			free(ext4fs_indir2_block);
-			ext4fs_indir2_block = NULL;
-			ext4fs_indir2_size = 0;
-			ext4fs_indir2_blkno = -1;
-			ext4fs_indir2_block = zalloc(blksz);
-			if (ext4fs_indir2_block == NULL) {
-				printf("** DI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_size = blksz;
-		}
-		if ((__le32_to_cpu(ext4fs_indir1_block[rblock / perblock]) <<
-		     log2_blksz) != ext4fs_indir2_blkno) {
-			status = ext4fs_devread((lbaint_t)__le32_to_cpu
-						(ext4fs_indir1_block
-						 [rblock /
-						  perblock]) << log2_blksz, 0,
-						blksz,
-						(char *)ext4fs_indir2_block);
-			if (status == 0) {
-				printf("** DI ext2fs read block (indir 2 2)"
-					"failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_blkno =
-			    __le32_to_cpu(ext4fs_indir1_block[rblock
-							      /
-							      perblock]) <<
-			    log2_blksz;
-		}
-		blknr = __le32_to_cpu(ext4fs_indir2_block[rblock % perblock]);
-	}
-	/* Tripple indirect. */
-	else {
-		rblock = fileblock - (INDIRECT_BLOCKS + blksz / 4 +
-				      (blksz / 4 * blksz / 4));
-		perblock_child = blksz / 4;
-		perblock_parent = ((blksz / 4) * (blksz / 4));
-
-		if (ext4fs_indir1_block == NULL) {
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 1)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-			ext4fs_indir1_blkno = -1;
-		}
-		if (blksz != ext4fs_indir1_size) {
-			free(ext4fs_indir1_block);
-			ext4fs_indir1_block = NULL;
-			ext4fs_indir1_size = 0;
-			ext4fs_indir1_blkno = -1;
-			ext4fs_indir1_block = zalloc(blksz);
-			if (ext4fs_indir1_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 1)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_size = blksz;
-		}
-		if ((__le32_to_cpu(inode->b.blocks.triple_indir_block) <<
-		     log2_blksz) != ext4fs_indir1_blkno) {
-			status = ext4fs_devread
-			    ((lbaint_t)
-			     __le32_to_cpu(inode->b.blocks.triple_indir_block)
-			     << log2_blksz, 0, blksz,
-			     (char *)ext4fs_indir1_block);
-			if (status == 0) {
-				printf("** TI ext2fs read block (indir 2 1)"
-					"failed. **\n");
-				return -1;
-			}
-			ext4fs_indir1_blkno =
-			    __le32_to_cpu(inode->b.blocks.triple_indir_block) <<
-			    log2_blksz;
-		}
-
-		if (ext4fs_indir2_block == NULL) {
-			ext4fs_indir2_block = zalloc(blksz);
-			if (ext4fs_indir2_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_size = blksz;
-			ext4fs_indir2_blkno = -1;
-		}
-		if (blksz != ext4fs_indir2_size) {
-			free(ext4fs_indir2_block);
-			ext4fs_indir2_block = NULL;
-			ext4fs_indir2_size = 0;
-			ext4fs_indir2_blkno = -1;
-			ext4fs_indir2_block = zalloc(blksz);
-			if (ext4fs_indir2_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_size = blksz;
-		}
-		if ((__le32_to_cpu(ext4fs_indir1_block[rblock /
-						       perblock_parent]) <<
-		     log2_blksz)
-		    != ext4fs_indir2_blkno) {
-			status = ext4fs_devread((lbaint_t)__le32_to_cpu
-						(ext4fs_indir1_block
-						 [rblock /
-						  perblock_parent]) <<
-						log2_blksz, 0, blksz,
-						(char *)ext4fs_indir2_block);
-			if (status == 0) {
-				printf("** TI ext2fs read block (indir 2 2)"
-					"failed. **\n");
-				return -1;
-			}
-			ext4fs_indir2_blkno =
-			    __le32_to_cpu(ext4fs_indir1_block[rblock /
-							      perblock_parent])
-			    << log2_blksz;
-		}
-
-		if (ext4fs_indir3_block == NULL) {
-			ext4fs_indir3_block = zalloc(blksz);
-			if (ext4fs_indir3_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir3_size = blksz;
-			ext4fs_indir3_blkno = -1;
-		}
-		if (blksz != ext4fs_indir3_size) {
-			free(ext4fs_indir3_block);
-			ext4fs_indir3_block = NULL;
-			ext4fs_indir3_size = 0;
-			ext4fs_indir3_blkno = -1;
-			ext4fs_indir3_block = zalloc(blksz);
-			if (ext4fs_indir3_block == NULL) {
-				printf("** TI ext2fs read block (indir 2 2)"
-					"malloc failed. **\n");
-				return -1;
-			}
-			ext4fs_indir3_size = blksz;
-		}
-		if ((__le32_to_cpu(ext4fs_indir2_block[rblock
-						       /
-						       perblock_child]) <<
-		     log2_blksz) != ext4fs_indir3_blkno) {
-			status =
-			    ext4fs_devread((lbaint_t)__le32_to_cpu
-					   (ext4fs_indir2_block
-					    [(rblock / perblock_child)
-					     % (blksz / 4)]) << log2_blksz, 0,
-					   blksz, (char *)ext4fs_indir3_block);
-			if (status == 0) {
-				printf("** TI ext2fs read block (indir 2 2)"
-				       "failed. **\n");
-				return -1;
-			}
-			ext4fs_indir3_blkno =
-			    __le32_to_cpu(ext4fs_indir2_block[(rblock /
-							       perblock_child) %
-							      (blksz /
-							       4)]) <<
-			    log2_blksz;
-		}
+	return blknr;
+}
 
-		blknr = __le32_to_cpu(ext4fs_indir3_block
-				      [rblock % perblock_child]);
-	}
-	debug("read_allocated_block %ld\n", blknr);
+long int read_allocated_block(struct ext2_inode *inode, int fileblock)
+{
+	int count;
 
-	return blknr;
+	return read_allocated_run(inode, fileblock, 1, &count);
 }
 
 /**
@@ -1853,24 +1785,7 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
  */
 void ext4fs_reinit_global(void)
 {
-	if (ext4fs_indir1_block != NULL) {
-		free(ext4fs_indir1_block);
-		ext4fs_indir1_block = NULL;
-		ext4fs_indir1_size = 0;
-		ext4fs_indir1_blkno = -1;
-	}
-	if (ext4fs_indir2_block != NULL) {
-		free(ext4fs_indir2_block);
-		ext4fs_indir2_block = NULL;
-		ext4fs_indir2_size = 0;
-		ext4fs_indir2_blkno = -1;
-	}
-	if (ext4fs_indir3_block != NULL) {
-		free(ext4fs_indir3_block);
-		ext4fs_indir3_block = NULL;
-		ext4fs_indir3_size = 0;
-		ext4fs_indir3_blkno = -1;
-	}
+	ext4fs_cache_flush();
 }
 void ext4fs_close(void)
 {
@@ -1886,6 +1801,195 @@ void ext4fs_close(void)
 	ext4fs_reinit_global();
 }
 
+void ext4fs_dcache_flush(void)
+{
+	memset(ext4fs_dcache, 0, sizeof(ext4fs_dcache));
+	ext4fs_dcache_tick = 0;
+}
+
+/*
+ * The dentry cache outlives a mount, so that path lookups made by
+ * consecutive commands can share it. Drop it whenever a different or
+ * modified filesystem is mounted.
+ */
+static void ext4fs_dcache_check(struct ext2_data *data)
+{
+	struct ext4_dcache_id id;
+
+	memset(&id, 0, sizeof(id));
+	id.dev_desc = get_fs()->dev_desc;
+	id.part_start = part_offset;
+	memcpy(id.unique_id, data->sblock.unique_id, sizeof(id.unique_id));
+	id.utime = data->sblock.utime;
+	id.free_blocks = data->sblock.free_blocks;
+	id.free_inodes = data->sblock.free_inodes;
+
+	if (memcmp(&id, &ext4fs_dcache_id, sizeof(id))) {
+		ext4fs_dcache_flush();
+		ext4fs_dcache_id = id;
+	}
+}
+
+static int ext4fs_dcache_find(int dir, const char *name, int *ino, int *type)
+{
+	struct ext4_dentry *dent;
+	int i;
+
+	for (i = 0; i < CONFIG_EXT4_DENTRY_CACHE_SIZE; i++) {
+		dent = &ext4fs_dcache[i];
+		if (dent->dir == dir && !strcmp(dent->name, name)) {
+			dent->lru = ++ext4fs_dcache_tick;
+			*ino = dent->ino;
+			*type = dent->type;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void ext4fs_dcache_add(int dir, const char *name, int ino, int type)
+{
+	struct ext4_dentry *dent = &ext4fs_dcache[0];
+	int i;
+
+	if (strlen(name) >= EXT4_DCACHE_NAME_LEN)
+		return;
+
+	for (i = 1; i < CONFIG_EXT4_DENTRY_CACHE_SIZE; i++) {
+		if (ext4fs_dcache[i].lru < dent->lru)
+			dent = &ext4fs_dcache[i];
+	}
+
+	dent->dir = dir;
+	dent->ino = ino;
+	dent->type = type;
+	dent->lru = ++ext4fs_dcache_tick;
+	strcpy(dent->name, name);
+}
+
+/*
+ * Search the directory block 'buf' of 'blksz' bytes for 'name'.
+ * Return 1 and fill in '*ino' and the raw directory entry file type
+ * '*type' if found, 0 if not and -1 if the block is corrupted.
+ */
+int ext4fs_dirblock_lookup(char *buf, int blksz, const char *name,
+			   int *ino, int *type)
+{
+	struct ext2_dirent *dirent;
+	int namelen = strlen(name);
+	int direntlen;
+	int fpos = 0;
+
+	while (fpos + (int)sizeof(struct ext2_dirent) <= blksz) {
+		dirent = (struct ext2_dirent *)(buf + fpos);
+		direntlen = __le16_to_cpu(dirent->direntlen);
+		if (direntlen < sizeof(struct ext2_dirent) ||
+		    fpos + direntlen > blksz)
+			return -1;
+
+		if (dirent->inode && dirent->namelen == namelen &&
+		    !memcmp(dirent + 1, name, namelen)) {
+			*ino = __le32_to_cpu(dirent->inode);
+			*type = dirent->filetype;
+			return 1;
+		}
+		fpos += direntlen;
+	}
+
+	return 0;
+}
+
+/* Search all of the directory 'diro' for 'name' one block at a time */
+static int ext4fs_dir_scan(struct ext2fs_node *diro, const char *name,
+			   int *ino, int *type)
+{
+	unsigned int size = __le32_to_cpu(diro->inode.size);
+	int blksz = EXT2_BLOCK_SIZE(diro->data);
+	unsigned int fpos;
+	char *buf;
+	int ret = 0;
+	int len;
+
+	buf = zalloc(blksz);
+	if (!buf)
+		return 0;
+
+	for (fpos = 0; fpos < size; fpos += blksz) {
+		len = min(size - fpos, (unsigned int)blksz);
+		if (ext4fs_read_file(diro, fpos, len, buf) != len)
+			break;
+		ret = ext4fs_dirblock_lookup(buf, len, name, ino, type);
+		if (ret)
+			break;
+	}
+	free(buf);
+
+	return ret > 0;
+}
+
+/*
+ * Find 'name' in the directory 'diro', through the dentry cache, the hashed
+ * index of the directory if it has one, or else a linear search.
+ */
+static int ext4fs_lookup(struct ext2fs_node *diro, const char *name,
+			 struct ext2fs_node **fnode, int *ftype)
+{
+	struct ext2fs_node *fdiro;
+	int ino, type, status;
+	int cached, unknown;
+
+	cached = ext4fs_dcache_find(diro->ino, name, &ino, &type);
+	if (!cached) {
+		status = ext4fs_htree_lookup(diro, name, &ino, &type);
+		if (status < 0)
+			status = ext4fs_dir_scan(diro, name, &ino, &type);
+		if (status != 1)
+			return 0;
+	}
+
+	fdiro = ext4fs_node_alloc();
+	if (!fdiro)
+		return 0;
+
+	fdiro->data = diro->data;
+	fdiro->ino = ino;
+
+	unknown = type == FILETYPE_UNKNOWN;
+	if (type != FILETYPE_DIRECTORY && type != FILETYPE_SYMLINK &&
+	    type != FILETYPE_REG)
+		type = FILETYPE_UNKNOWN;
+
+	if (unknown) {
+		status = ext4fs_read_inode(diro->data, ino, &fdiro->inode);
+		if (status == 0) {
+			ext4fs_node_free(fdiro);
+			return 0;
+		}
+		fdiro->inode_read = 1;
+
+		switch (__le16_to_cpu(fdiro->inode.mode) & FILETYPE_INO_MASK) {
+		case FILETYPE_INO_DIRECTORY:
+			type = FILETYPE_DIRECTORY;
+			break;
+		case FILETYPE_INO_SYMLINK:
+			type = FILETYPE_SYMLINK;
+			break;
+		case FILETYPE_INO_REG:
+			type = FILETYPE_REG;
+			break;
+		}
+	}
+
+	if (!cached)
+		ext4fs_dcache_add(diro->ino, name, ino, type);
+
+	*fnode = fdiro;
+	*ftype = type;
+
+	return 1;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -1902,7 +2006,11 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (status == 0)
 			return 0;
 	}
-	/* Search the file.  */
+
+	if ((name != NULL) && (fnode != NULL) && (ftype != NULL))
+		return ext4fs_lookup(diro, name, fnode, ftype);
+
+	/* List the directory.  */
 	while (fpos < __le32_to_cpu(diro->inode.size)) {
 		struct ext2_dirent dirent;
 
@@ -1924,7 +2032,7 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			if (status < 1)
 				return 0;
 
-			fdiro = zalloc(sizeof(struct ext2fs_node));
+			fdiro = ext4fs_node_alloc();
 			if (!fdiro)
 				return 0;
 
@@ -1948,7 +2056,7 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 							   (dirent.inode),
 							   &fdiro->inode);
 				if (status == 0) {
-					free(fdiro);
+					ext4fs_node_free(fdiro);
 					return 0;
 				}
 				fdiro->inode_read = 1;
@@ -1984,7 +2092,7 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 								 dirent.inode),
 								 &fdiro->inode);
 					if (status == 0) {
-						free(fdiro);
+						ext4fs_node_free(fdiro);
 						return 0;
 					}
 					fdiro->inode_read = 1;
@@ -2007,7 +2115,7 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 					__le32_to_cpu(fdiro->inode.size),
 					filename);
 			}
-			free(fdiro);
+			ext4fs_node_free(fdiro);
 		}
 		fpos += __le16_to_cpu(dirent.direntlen);
 	}
@@ -2236,6 +2344,7 @@ int ext4fs_mount(unsigned part_length)
 	if (status == 0)
 		goto fail;
 
+	ext4fs_dcache_check(data);
 	ext4fs_root = data;
 
 	return 1;
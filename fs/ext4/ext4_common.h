@@ -56,6 +56,13 @@ int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
 			struct ext2fs_node **foundnode, int expecttype);
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node **fnode, int *ftype);
+int ext4fs_dirblock_lookup(char *buf, int blksz, const char *name,
+			   int *ino, int *type);
+int ext4fs_htree_lookup(struct ext2fs_node *dir, const char *name,
+			int *ino, int *type);
+void ext4fs_dcache_flush(void);
+struct ext2fs_node *ext4fs_node_alloc(void);
+void ext4fs_node_free(struct ext2fs_node *node);
 
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n);
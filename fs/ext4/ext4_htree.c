@@ -0,0 +1,420 @@
+/*
+ * Hashed (dx_dir / htree) directory lookup for ext2/3/4.
+ *
+ * The hash functions are taken from the Linux kernel, fs/ext4/hash.c:
+ * Copyright (C) 2002 by Theodore Ts'o
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <ext_common.h>
+#include <ext4fs.h>
+#include "ext4_common.h"
+
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_LEGACY_UNSIGNED		3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED		5
+
+#define EXT4_HTREE_EOF_32BIT		0x7fffffff
+/* Depth of the index, the root block being the first level */
+#define EXT4_HTREE_LEVEL		3
+
+struct dx_root_info {
+	__le32 reserved_zero;
+	__u8 hash_version;
+	__u8 info_length;	/* 8 */
+	__u8 indirect_levels;
+	__u8 unused_flags;
+};
+
+/* entries[0] holds the limit and count of the entries in its block */
+struct dx_entry {
+	__le32 hash;
+	__le32 block;
+};
+
+struct dx_countlimit {
+	__le16 limit;
+	__le16 count;
+};
+
+/* Offset of the entries in the root ("." + ".." + dx_root_info) */
+#define DX_ROOT_ENTRIES		(2 * 12 + sizeof(struct dx_root_info))
+/* Offset of the entries in an interior node (one empty dirent) */
+#define DX_NODE_ENTRIES		sizeof(struct ext2_dirent)
+
+struct dx_frame {
+	char *buf;
+	struct dx_entry *entries;
+	int count;
+	int at;
+};
+
+#define DELTA 0x9E3779B9
+
+static void TEA_transform(__u32 buf[4], __u32 const in[])
+{
+	__u32 sum = 0;
+	__u32 b0 = buf[0], b1 = buf[1];
+	__u32 a = in[0], b = in[1], c = in[2], d = in[3];
+	int n = 16;
+
+	do {
+		sum += DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	} while (--n);
+
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+/* F, G and H are basic MD4 functions: selection, majority, parity */
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+
+#define ROL32(x, s)	(((x) << (s)) | ((x) >> (32 - (s))))
+#define MD4_ROUND(f, a, b, c, d, x, s)	\
+	(a += f(b, c, d) + x, a = ROL32(a, s))
+#define K1 0
+#define K2 013240474631UL
+#define K3 015666365641UL
+
+/* Basic cut-down MD4 transform, see lib/halfmd4.c in Linux */
+static void half_md4_transform(__u32 buf[4], __u32 const in[8])
+{
+	__u32 a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	/* Round 1 */
+	MD4_ROUND(F, a, b, c, d, in[0] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[1] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[2] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[3] + K1, 19);
+	MD4_ROUND(F, a, b, c, d, in[4] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[5] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[6] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+	/* Round 2 */
+	MD4_ROUND(G, a, b, c, d, in[1] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[3] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[5] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[7] + K2, 13);
+	MD4_ROUND(G, a, b, c, d, in[0] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[2] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[4] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+	/* Round 3 */
+	MD4_ROUND(H, a, b, c, d, in[3] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[7] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[2] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[6] + K3, 15);
+	MD4_ROUND(H, a, b, c, d, in[1] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[5] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[0] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+/* The old legacy hash */
+static __u32 dx_hack_hash(const char *name, int len, int unsigned_char)
+{
+	__u32 hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	int c;
+
+	while (len--) {
+		c = unsigned_char ? (int)(unsigned char)*name :
+				    (int)(signed char)*name;
+		name++;
+		hash = hash1 + (hash0 ^ (c * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 << 1;
+}
+
+static void str2hashbuf(const char *msg, int len, __u32 *buf, int num,
+			int unsigned_char)
+{
+	__u32 pad, val;
+	int i, c;
+
+	pad = (__u32)len | ((__u32)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		c = unsigned_char ? (int)(unsigned char)msg[i] :
+				    (int)(signed char)msg[i];
+		val = c + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+/*
+ * Compute the major hash of 'name' the way ext4fs_dirhash() in Linux does.
+ * Return 0 on success, -1 for an unknown hash version.
+ */
+static int ext4fs_dirhash(const char *name, int len, int version,
+			  const __u32 *seed, __u32 *hashp)
+{
+	__u32 hash;
+	__u32 in[8], buf[4];
+	int unsigned_char = 0;
+	int i;
+
+	/* Initialize the default seed for the hash checksum functions */
+	buf[0] = 0x67452301;
+	buf[1] = 0xefcdab89;
+	buf[2] = 0x98badcfe;
+	buf[3] = 0x10325476;
+
+	/* Check to see if the seed is all zero's */
+	for (i = 0; i < 4; i++) {
+		if (seed[i]) {
+			memcpy(buf, seed, sizeof(buf));
+			break;
+		}
+	}
+
+	switch (version) {
+	case DX_HASH_LEGACY_UNSIGNED:
+		unsigned_char = 1;
+		/* fall through */
+	case DX_HASH_LEGACY:
+		hash = dx_hack_hash(name, len, unsigned_char);
+		break;
+	case DX_HASH_HALF_MD4_UNSIGNED:
+		unsigned_char = 1;
+		/* fall through */
+	case DX_HASH_HALF_MD4:
+		while (len > 0) {
+			str2hashbuf(name, len, in, 8, unsigned_char);
+			half_md4_transform(buf, in);
+			len -= 32;
+			name += 32;
+		}
+		hash = buf[1];
+		break;
+	case DX_HASH_TEA_UNSIGNED:
+		unsigned_char = 1;
+		/* fall through */
+	case DX_HASH_TEA:
+		while (len > 0) {
+			str2hashbuf(name, len, in, 4, unsigned_char);
+			TEA_transform(buf, in);
+			len -= 16;
+			name += 16;
+		}
+		hash = buf[0];
+		break;
+	default:
+		return -1;
+	}
+
+	hash = hash & ~1;
+	if (hash == (EXT4_HTREE_EOF_32BIT << 1))
+		hash = (EXT4_HTREE_EOF_32BIT - 1) << 1;
+	*hashp = hash;
+
+	return 0;
+}
+
+/* Read directory block 'block' of 'dir' into 'buf', return 0 on success */
+static int dx_read_block(struct ext2fs_node *dir, __u32 block, char *buf)
+{
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+
+	block &= 0x0fffffff;
+	if ((__u64)(block + 1) * blksz > __le32_to_cpu(dir->inode.size))
+		return -1;
+
+	return ext4fs_read_file(dir, block * blksz, blksz, buf) == blksz ?
+		0 : -1;
+}
+
+/* Select the entry of 'frame' whose hash range covers 'hash' */
+static int dx_set_frame(struct dx_frame *frame, struct dx_entry *entries,
+			int limit, __u32 hash)
+{
+	struct dx_countlimit *cl = (struct dx_countlimit *)entries;
+	int lo, hi, mid;
+
+	frame->entries = entries;
+	frame->count = __le16_to_cpu(cl->count);
+	if (!frame->count || frame->count > __le16_to_cpu(cl->limit) ||
+	    __le16_to_cpu(cl->limit) > limit)
+		return -1;
+
+	/* find the last entry with a hash <= 'hash', entries[0] has none */
+	lo = 1;
+	hi = frame->count - 1;
+	while (lo <= hi) {
+		mid = lo + (hi - lo) / 2;
+		if (__le32_to_cpu(entries[mid].hash) > hash)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+	frame->at = lo - 1;
+
+	return 0;
+}
+
+/*
+ * Advance to the next leaf if it may still hold names with 'hash' (hash
+ * collisions spill over into the following leaves).
+ * Return 1 if there is such a leaf, 0 if not and -1 on errors.
+ */
+static int dx_next_leaf(struct ext2fs_node *dir, struct dx_frame *frames,
+			int levels, __u32 hash)
+{
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	struct dx_frame *p = &frames[levels];
+
+	while (1) {
+		if (++p->at < p->count)
+			break;
+		if (p == frames)
+			return 0;
+		p--;
+	}
+
+	if ((__le32_to_cpu(p->entries[p->at].hash) & ~1) != hash)
+		return 0;
+
+	while (p < &frames[levels]) {
+		if (dx_read_block(dir, __le32_to_cpu(p->entries[p->at].block),
+				  p[1].buf))
+			return -1;
+		p++;
+		p->entries = (struct dx_entry *)(p->buf + DX_NODE_ENTRIES);
+		p->count = __le16_to_cpu(((struct dx_countlimit *)
+					  p->entries)->count);
+		if (!p->count ||
+		    p->count > (blksz - DX_NODE_ENTRIES) /
+		    sizeof(struct dx_entry))
+			return -1;
+		p->at = 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Look 'name' up in the hashed directory 'dir'.
+ * Return 1 and fill in '*ino' and '*type' if found, 0 if the name does not
+ * exist and -1 if 'dir' cannot be searched through its index.
+ */
+int ext4fs_htree_lookup(struct ext2fs_node *dir, const char *name,
+			int *ino, int *type)
+{
+	struct ext2_sblock *sblock = &dir->data->sblock;
+	struct dx_frame frames[EXT4_HTREE_LEVEL];
+	struct dx_root_info *info;
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	int version, levels, i;
+	__u32 hash, seed[4];
+	char *leaf = NULL;
+	int ret = -1;
+
+	if (!(__le32_to_cpu(dir->inode.flags) & EXT2_INDEX_FL) ||
+	    !(__le32_to_cpu(sblock->feature_compatibility) &
+	      EXT4_FEATURE_COMPAT_DIR_INDEX))
+		return -1;
+
+	/* "." and ".." live in the root block, outside of the index */
+	if (!strcmp(name, ".") || !strcmp(name, ".."))
+		return -1;
+
+	memset(frames, 0, sizeof(frames));
+	frames[0].buf = zalloc(blksz);
+	if (!frames[0].buf || dx_read_block(dir, 0, frames[0].buf))
+		goto out;
+
+	info = (struct dx_root_info *)(frames[0].buf + 2 * 12);
+	levels = info->indirect_levels;
+	if (info->reserved_zero || info->info_length != sizeof(*info) ||
+	    levels >= EXT4_HTREE_LEVEL)
+		goto out;
+
+	version = info->hash_version;
+	if (version <= DX_HASH_TEA &&
+	    (__le32_to_cpu(sblock->flags) & EXT2_FLAGS_UNSIGNED_HASH))
+		version += DX_HASH_LEGACY_UNSIGNED;
+	for (i = 0; i < 4; i++)
+		seed[i] = __le32_to_cpu(sblock->hash_seed[i]);
+	if (ext4fs_dirhash(name, strlen(name), version, seed, &hash))
+		goto out;
+
+	debug("htree lookup %s: hash %08x, version %d, levels %d\n", name,
+	      hash, version, levels);
+
+	/* walk down the index to the leaf covering the hash */
+	if (dx_set_frame(&frames[0],
+			 (struct dx_entry *)(frames[0].buf + DX_ROOT_ENTRIES),
+			 (blksz - DX_ROOT_ENTRIES) / sizeof(struct dx_entry),
+			 hash))
+		goto out;
+	for (i = 1; i <= levels; i++) {
+		frames[i].buf = zalloc(blksz);
+		if (!frames[i].buf ||
+		    dx_read_block(dir, __le32_to_cpu(frames[i - 1].entries
+						     [frames[i - 1].at].block),
+				  frames[i].buf))
+			goto out;
+		if (dx_set_frame(&frames[i],
+				 (struct dx_entry *)(frames[i].buf +
+						     DX_NODE_ENTRIES),
+				 (blksz - DX_NODE_ENTRIES) /
+				 sizeof(struct dx_entry), hash))
+			goto out;
+	}
+
+	leaf = zalloc(blksz);
+	if (!leaf)
+		goto out;
+
+	do {
+		if (dx_read_block(dir, __le32_to_cpu(frames[levels].entries
+						     [frames[levels].at].block),
+				  leaf))
+			goto out;
+		ret = ext4fs_dirblock_lookup(leaf, blksz, name, ino, type);
+		if (ret)
+			goto out;
+	} while ((ret = dx_next_leaf(dir, frames, levels, hash)) == 1);
+
+out:
+	free(leaf);
+	for (i = 0; i < EXT4_HTREE_LEVEL; i++)
+		free(frames[i].buf);
+	if (ret < 0)
+		debug("htree lookup %s: falling back to linear search\n",
+		      name);
+
+	return ret;
+}
@@ -850,6 +850,7 @@ int ext4fs_write(const char *fname, unsigned char *buffer,
 		printf("error in File System init\n");
 		return -1;
 	}
+	ext4fs_dcache_flush();
 	inodes_per_block = fs->blksz / fs->inodesz;
 	parent_inodeno = ext4fs_get_parent_inode_num(fname, filename, F_FILE);
 	if (parent_inodeno == -1)
@@ -925,6 +926,11 @@ int ext4fs_write(const char *fname, unsigned char *buffer,
 		printf("Error in copying content\n");
 		goto fail;
 	}
+	/*
+	 * The new entry was not added to the hashed index of the parent, so
+	 * stop using it (like the Linux ext2 driver does)
+	 */
+	g_parent_inode->flags &= __cpu_to_le32(~EXT2_INDEX_FL);
 	ibmap_idx = parent_inodeno / ext4fs_root->sblock.inodes_per_group;
 	parent_inodeno--;
 	parent_itable_blkno = __le32_to_cpu(fs->bgd[ibmap_idx].inode_table_id) +
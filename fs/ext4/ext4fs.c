@@ -37,13 +37,13 @@ struct ext_filesystem *get_fs(void)
 void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 {
 	if ((node != &ext4fs_root->diropen) && (node != currroot))
-		free(node);
+		ext4fs_node_free(node);
 }
 
 /*
- * Taken from openmoko-kernel mailing list: By Andy green
- * Optimized read file API : collects and defers contiguous sector
- * reads into one potentially more efficient larger sequential read action
+ * Read 'len' bytes from 'pos' in the file. The file is mapped one run of
+ * physically contiguous blocks at a time, and each run is fetched with a
+ * single device read.
  */
 int ext4fs_read_file(struct ext2fs_node *node, int pos,
 		unsigned int len, char *buf)
@@ -55,13 +55,8 @@ int ext4fs_read_file(struct ext2fs_node *node, int pos,
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = __le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
-	lbaint_t delayed_start = 0;
-	lbaint_t delayed_extent = 0;
-	lbaint_t delayed_skipfirst = 0;
-	lbaint_t delayed_next = 0;
-	char *delayed_buf = NULL;
-	short status;
+	int count;
+	int status;
 
 	/* Adjust len so it we can't read past the end of the file. */
 	if (len > filesize)
@@ -69,85 +64,37 @@ int ext4fs_read_file(struct ext2fs_node *node, int pos,
 
 	blockcnt = ((len + pos) + blocksize - 1) / blocksize;
 
-	for (i = pos / blocksize; i < blockcnt; i++) {
+	for (i = pos / blocksize; i < blockcnt; i += count) {
 		lbaint_t blknr;
-		int blockoff = pos % blocksize;
-		int blockend = blocksize;
 		int skipfirst = 0;
-		blknr = read_allocated_block(&(node->inode), i);
-		if (blknr < 0)
-			return -1;
+		int runlen;
 
-		blknr = blknr << log2_fs_blocksize;
+		blknr = read_allocated_run(&(node->inode), i, blockcnt - i,
+					   &count);
+		if ((long int)blknr < 0)
+			return -1;
 
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) % blocksize;
+		runlen = count * blocksize;
 
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+		/* Last block. */
+		if (i + count == blockcnt && (len + pos) % blocksize)
+			runlen -= blocksize - (len + pos) % blocksize;
 
 		/* First block. */
 		if (i == pos / blocksize) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
+			skipfirst = pos % blocksize;
+			runlen -= skipfirst;
 		}
+
 		if (blknr) {
-			int status;
-
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-					if (status == 0)
-						return -1;
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
-				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
-				delayed_skipfirst = skipfirst;
-				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
-			}
+			status = ext4fs_devread(blknr << log2_fs_blocksize,
+						skipfirst, runlen, buf);
+			if (status == 0)
+				return -1;
 		} else {
-			if (previous_block_number != -1) {
-				/* spill */
-				status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-				if (status == 0)
-					return -1;
-				previous_block_number = -1;
-			}
-			memset(buf, 0, blocksize - skipfirst);
+			memset(buf, 0, runlen);
 		}
-		buf += blocksize - skipfirst;
-	}
-	if (previous_block_number != -1) {
-		/* spill */
-		status = ext4fs_devread(delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
-		if (status == 0)
-			return -1;
-		previous_block_number = -1;
+		buf += runlen;
 	}
 
 	return len;
@@ -16,6 +16,7 @@
 #include <asm/byteorder.h>
 #include <part.h>
 #include <malloc.h>
+#include <mempool.h>
 #include <linux/compiler.h>
 #include <linux/ctype.h>
 
@@ -154,6 +155,64 @@ static void get_name(dir_entry *dirent, char *s_name)
 	downcase(s_name);
 }
 
+/*
+ * Initialise the read-side FAT cache on top of 'fatbuf', which must hold
+ * FATCACHEWINDOWS windows of FATBUFSIZE bytes each.
+ */
+static void init_fatcache(fsdata *mydata)
+{
+	int i;
+
+	for (i = 0; i < FATCACHEWINDOWS; i++) {
+		mydata->fatcache[i].buf = mydata->fatbuf + i * FATBUFSIZE;
+		mydata->fatcache[i].bufnum = -1;
+		mydata->fatcache[i].lru = 0;
+	}
+	mydata->fatcache_tick = 0;
+}
+
+/*
+ * Return the cached copy of FAT window 'bufnum', reading it into the least
+ * recently used window on a miss.
+ * On failure NULL is returned.
+ */
+static __u8 *get_fatwindow(fsdata *mydata, __u32 bufnum)
+{
+	fat_window *win, *victim = &mydata->fatcache[0];
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	int i;
+
+	mydata->fatcache_tick++;
+	for (i = 0; i < FATCACHEWINDOWS; i++) {
+		win = &mydata->fatcache[i];
+		if (win->bufnum == (int)bufnum) {
+			win->lru = mydata->fatcache_tick;
+			return win->buf;
+		}
+		if (win->lru < victim->lru)
+			victim = win;
+	}
+
+	if (startblock + getsize > mydata->fatlength)
+		getsize = mydata->fatlength - startblock;
+
+	startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+	debug("FAT window %d -> slot %d\n", bufnum,
+	      (int)(victim - mydata->fatcache));
+	if (disk_read(startblock, getsize, victim->buf) < 0) {
+		debug("Error reading FAT blocks\n");
+		victim->bufnum = -1;
+		victim->lru = 0;
+		return NULL;
+	}
+	victim->bufnum = bufnum;
+	victim->lru = mydata->fatcache_tick;
+
+	return victim->buf;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -164,6 +223,7 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	__u32 off16, offset;
 	__u32 ret = 0x00;
 	__u16 val1, val2;
+	__u8 *fatbuf;
 
 	switch (mydata->fatsize) {
 	case 32:
@@ -187,57 +247,43 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%04x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	/* Look the block of FAT entries up in the cache. */
+	fatbuf = get_fatwindow(mydata, bufnum);
+	if (!fatbuf)
+		return ret;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *) fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *) fatbuf)[offset]);
 		break;
 	case 12:
 		off16 = (offset * 3) / 4;
 
 		switch (offset & 0x3) {
 		case 0:
-			ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[off16]);
+			ret = FAT2CPU16(((__u16 *) fatbuf)[off16]);
 			ret &= 0xfff;
 			break;
 		case 1:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			val1 = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			val1 &= 0xf000;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
+			val2 = FAT2CPU16(((__u16 *)fatbuf)[off16 + 1]);
 			val2 &= 0x00ff;
 			ret = (val2 << 4) | (val1 >> 12);
 			break;
 		case 2:
-			val1 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			val1 = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			val1 &= 0xff00;
-			val2 = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16 + 1]);
+			val2 = FAT2CPU16(((__u16 *)fatbuf)[off16 + 1]);
 			val2 &= 0x000f;
 			ret = (val2 << 8) | (val1 >> 8);
 			break;
 		case 3:
-			ret = FAT2CPU16(((__u16 *)mydata->fatbuf)[off16]);
+			ret = FAT2CPU16(((__u16 *)fatbuf)[off16]);
 			ret = (ret & 0xfff0) >> 4;
 			break;
 		default:
@@ -251,6 +297,34 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	return ret;
 }
 
+/*
+ * Follow the cluster chain from 'clust' for as long as it stays physically
+ * contiguous, visiting at most 'maxclust' clusters.  The cluster following
+ * the run is stored in '*next' (it is not validated).
+ * Return the number of clusters in the run, or 0 on an invalid FAT entry.
+ */
+static __u32
+get_clustrun(fsdata *mydata, __u32 clust, __u32 maxclust, __u32 *next)
+{
+	__u32 count = 1;
+	__u32 newclust;
+
+	newclust = get_fatent(mydata, clust);
+	while (count < maxclust && newclust == clust + 1) {
+		if (CHECK_CLUST(newclust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", newclust);
+			debug("Invalid FAT entry\n");
+			return 0;
+		}
+		clust = newclust;
+		newclust = get_fatent(mydata, clust);
+		count++;
+	}
+
+	*next = newclust;
+	return count;
+}
+
 /*
  * Read at most 'size' bytes from the specified cluster into 'buffer'.
  * Return 0 on success, -1 otherwise.
@@ -314,23 +388,127 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+__u8 get_contents_vfatname_block[MAX_CLUSTSIZE]
+	__aligned(ARCH_DMA_MINALIGN);
+
+/* Maximum number of extents planned ahead by get_contents() */
+#define FAT_MAX_EXTENTS	16
+
+/*
+ * A run of physically contiguous data sectors of a file
+ */
+struct fat_extent {
+	__u32		sect;	/* First sector of the extent */
+	unsigned long	size;	/* Size of the extent in bytes */
+};
+
+static struct fat_read_stats fat_stats;
+
+/*
+ * Read 'size' bytes starting 'offset' bytes into the data at sector 'sect'
+ * into 'buffer'. Whole sectors are read straight into 'buffer' when it is
+ * suitably aligned; only partial sectors at the edges and misaligned
+ * destinations go through the bounce buffer.
+ * Return 0 on success, -1 otherwise.
+ */
+static int read_extent(fsdata *mydata, __u32 sect, unsigned long offset,
+		       __u8 *buffer, unsigned long size)
+{
+	__u8 *bounce = get_contents_vfatname_block;
+	unsigned long sect_size = mydata->sect_size;
+	unsigned long actsize;
+	__u32 nsect;
+	int ret;
+
+	sect += offset / sect_size;
+	offset %= sect_size;
+
+	/* leading partial sector */
+	if (offset) {
+		actsize = min(size, sect_size - offset);
+		ret = disk_read(sect, 1, bounce);
+		fat_stats.reads++;
+		if (ret != 1) {
+			debug("Error reading data (got %d)\n", ret);
+			return -1;
+		}
+		memcpy(buffer, bounce + offset, actsize);
+		fat_stats.bounced += actsize;
+		sect++;
+		buffer += actsize;
+		size -= actsize;
+	}
+
+	if (!((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1))) {
+		nsect = size / sect_size;
+		if (nsect) {
+			ret = disk_read(sect, nsect, buffer);
+			fat_stats.reads++;
+			if (ret != nsect) {
+				debug("Error reading data (got %d)\n", ret);
+				return -1;
+			}
+			actsize = nsect * sect_size;
+			sect += nsect;
+			buffer += actsize;
+			size -= actsize;
+		}
+	} else {
+		debug("FAT: Misaligned buffer address (%p)\n", buffer);
+
+		while (size >= sect_size) {
+			nsect = min(size, (unsigned long)MAX_CLUSTSIZE) /
+				sect_size;
+			ret = disk_read(sect, nsect, bounce);
+			fat_stats.reads++;
+			if (ret != nsect) {
+				debug("Error reading data (got %d)\n", ret);
+				return -1;
+			}
+			actsize = nsect * sect_size;
+			memcpy(buffer, bounce, actsize);
+			fat_stats.bounced += actsize;
+			sect += nsect;
+			buffer += actsize;
+			size -= actsize;
+		}
+	}
+
+	/* trailing partial sector */
+	if (size) {
+		ret = disk_read(sect, 1, bounce);
+		fat_stats.reads++;
+		if (ret != 1) {
+			debug("Error reading data (got %d)\n", ret);
+			return -1;
+		}
+		memcpy(buffer, bounce, size);
+		fat_stats.bounced += size;
+	}
+
+	return 0;
+}
+
 /*
  * Read at most 'maxsize' bytes from 'pos' in the file associated with 'dentptr'
  * into 'buffer'.
+ * The extents covering the requested range are resolved from the FAT first
+ * (up to FAT_MAX_EXTENTS at a time) and then read with one disk access each.
  * Return the number of bytes read or -1 on fatal errors.
  */
-__u8 get_contents_vfatname_block[MAX_CLUSTSIZE]
-	__aligned(ARCH_DMA_MINALIGN);
-
 static long
 get_contents(fsdata *mydata, dir_entry *dentptr, unsigned long pos,
 	     __u8 *buffer, unsigned long maxsize)
 {
 	unsigned long filesize = FAT2CPU32(dentptr->size), gotsize = 0;
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
+	struct fat_extent extents[FAT_MAX_EXTENTS];
 	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
-	unsigned long actsize;
+	__u32 newclust, nclust;
+	unsigned long actsize, len;
+	int i, n, invalid = 0;
+
+	memset(&fat_stats, 0, sizeof(fat_stats));
 
 	debug("Filesize: %ld bytes\n", filesize);
 
@@ -362,74 +540,62 @@ get_contents(fsdata *mydata, dir_entry *dentptr, unsigned long pos,
 	filesize -= actsize;
 	pos -= actsize;
 
-	/* align to beginning of next cluster if any */
-	if (pos) {
-		actsize = min(filesize, bytesperclust);
-		if (get_cluster(mydata, curclust, get_contents_vfatname_block,
-				(int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, get_contents_vfatname_block + pos, actsize);
-		gotsize += actsize;
-		if (!filesize)
-			return gotsize;
-		buffer += actsize;
-
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			debug("Invalid FAT entry\n");
-			return gotsize;
-		}
-	}
-
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				debug("Invalid FAT entry\n");
-				return gotsize;
+	while (filesize && !invalid) {
+		/* plan: resolve the extents ahead of the reads */
+		actsize = 0;
+		for (n = 0; n < FAT_MAX_EXTENTS && actsize < filesize; ) {
+			nclust = get_clustrun(mydata, curclust,
+					DIV_ROUND_UP(filesize - actsize,
+						     bytesperclust),
+					&newclust);
+			if (!nclust) {
+				invalid = 1;
+				break;
 			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
+			extents[n].sect = mydata->data_begin +
+					  curclust * mydata->clust_size;
+			extents[n].size = min(filesize - actsize,
+					(unsigned long)nclust * bytesperclust);
+			actsize += extents[n++].size;
+
+			curclust = newclust;
+			if (actsize < filesize &&
+			    CHECK_CLUST(curclust, mydata->fatsize)) {
+				debug("curclust: 0x%x\n", curclust);
+				invalid = 1;
+				break;
+			}
 		}
-		gotsize += actsize;
-		return gotsize;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
+		fat_stats.extents += n;
+
+		/* issue one read per extent */
+		for (i = 0; i < n; i++) {
+			len = extents[i].size - pos;
+			debug("extent %d: sect %u, %lu bytes\n", i,
+			      extents[i].sect, len);
+			if (read_extent(mydata, extents[i].sect, pos, buffer,
+					len) != 0) {
+				printf("Error reading cluster\n");
+				return -1;
+			}
+			gotsize += len;
+			fat_stats.bytes += len;
+			buffer += len;
+			pos = 0;
 		}
-		gotsize += (int)actsize;
 		filesize -= actsize;
-		buffer += actsize;
+	}
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return gotsize;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	if (invalid)
+		printf("Invalid FAT entry\n");
+
+	return gotsize;
+}
+
+const struct fat_read_stats *fat_get_read_stats(void)
+{
+	return &fat_stats;
 }
 
 /*
@@ -747,7 +913,7 @@ read_bootsectandvi(boot_sector *bs, volume_info *volinfo, int *fatsize)
 		return -1;
 	}
 
-	block = memalign(ARCH_DMA_MINALIGN, cur_dev->blksz);
+	block = scratch_memalign(ARCH_DMA_MINALIGN, cur_dev->blksz);
 	if (block == NULL) {
 		debug("Error: allocating block\n");
 		return -1;
@@ -799,7 +965,7 @@ read_bootsectandvi(boot_sector *bs, volume_info *volinfo, int *fatsize)
 fail:
 	ret = -1;
 exit:
-	free(block);
+	scratch_free(block);
 	return ret;
 }
 
@@ -866,11 +1032,13 @@ do_fat_read_at(const char *filename, unsigned long pos, void *buffer,
 	}
 
 	mydata->fatbufnum = -1;
-	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
+	mydata->fatbuf = scratch_memalign(ARCH_DMA_MINALIGN,
+					  FATBUFSIZE * FATCACHEWINDOWS);
 	if (mydata->fatbuf == NULL) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
+	init_fatcache(mydata);
 
 	if (vfat_enabled)
 		debug("VFAT Support enabled\n");
@@ -1159,7 +1327,7 @@ rootdir_done:
 	debug("Size: %d, got: %ld\n", FAT2CPU32(dentptr->size), ret);
 
 exit:
-	free(mydata->fatbuf);
+	scratch_free(mydata->fatbuf);
 	return ret;
 }
 
@@ -979,7 +979,7 @@ static int do_fat_write(const char *filename, void *buffer,
 	}
 
 	mydata->fatbufnum = -1;
-	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
+	mydata->fatbuf = scratch_memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
 	if (mydata->fatbuf == NULL) {
 		debug("Error: allocating memory\n");
 		return -1;
@@ -1095,7 +1095,7 @@ static int do_fat_write(const char *filename, void *buffer,
 	}
 
 exit:
-	free(mydata->fatbuf);
+	scratch_free(mydata->fatbuf);
 	return ret < 0 ? ret : write_size;
 }
 
@@ -257,7 +257,11 @@ int fs_read(const char *filename, ulong addr, int offset, int len)
 	 * means read the whole file.
 	 */
 	buf = map_sysmem(addr, len);
+	if (!offset)
+		image_load_start(buf);
 	ret = info->read(filename, buf, offset, len);
+	if (ret > 0)
+		image_load_update(buf, ret);
 	unmap_sysmem(buf);
 
 	/* If we requested a specific number of bytes, check we got it */
@@ -26,3 +26,70 @@ static inline int is_sparse_image(void *buf)
 void write_sparse_image(block_dev_desc_t *dev_desc,
 		disk_partition_t *info, const char *part_name,
 		void *data, unsigned sz);
+
+#ifdef CONFIG_FASTBOOT_STREAM
+/* Batches of downloaded data: one being filled while the other is written */
+#define STREAM_BATCHES	2
+
+/*
+ * An image being written as it is downloaded, rather than from a buffer
+ * holding all of it. A sparse image is parsed as it arrives; anything else
+ * is written as a raw image. Data is gathered in batches of up to
+ * CONFIG_FASTBOOT_STREAM_BATCH bytes, DONT_CARE chunks are skipped, and
+ * sparse_stream_poll() writes the batches and FILL chunks out
+ * CONFIG_FASTBOOT_STREAM_WRITE_STEP bytes at a time.
+ */
+struct sparse_stream {
+	block_dev_desc_t *dev_desc;
+	disk_partition_t info;
+	const char *part_name;
+	unsigned int size;		/* bytes in the download */
+	int state;
+	int sparse;			/* 0 for a raw image */
+	int error;			/* fastboot_fail() has been called */
+	sparse_header_t sparse_header;
+	chunk_header_t chunk_header;
+	u8 hdr[sizeof(sparse_header_t)];	/* header gathered so far */
+	unsigned int hdr_len;
+	u64 skip;			/* bytes to drop before going on */
+	u64 chunk_left;			/* raw data still to come */
+	unsigned int chunk;		/* chunks started */
+	uint32_t total_blocks;
+	lbaint_t blk;			/* where the batch filling goes */
+	char *batch[STREAM_BATCHES];
+	lbaint_t batch_blk[STREAM_BATCHES];
+	lbaint_t batch_blkcnt[STREAM_BATCHES];
+	int head;			/* oldest queued batch */
+	int count;			/* batches queued for writing */
+	lbaint_t done;			/* blocks of the head batch written */
+	unsigned int batch_len;		/* bytes in the batch filling */
+	unsigned int batch_size;
+	lbaint_t step_blks;		/* most blocks in one write */
+	uint32_t *fill_buf;		/* one step of the FILL value */
+	lbaint_t fill_blk;
+	lbaint_t fill_left;		/* blocks of the FILL chunk to write */
+	u64 bytes_written;
+};
+
+/*
+ * Start writing a download of @size bytes to a partition. The name is not
+ * copied. Returns 0, or -ve after calling fastboot_fail().
+ */
+int sparse_stream_start(struct sparse_stream *ss, block_dev_desc_t *dev_desc,
+			disk_partition_t *info, const char *part_name,
+			unsigned int size);
+/*
+ * Take the next part of the download, without writing it out. Returns how
+ * much was taken, which is less than @len once every batch is full: call
+ * sparse_stream_poll() and offer the rest again. Errors are kept until the
+ * end.
+ */
+unsigned int sparse_stream_write(struct sparse_stream *ss, const void *data,
+				 unsigned int len);
+/* Write one step of what has been taken. Returns 0 if there was nothing */
+int sparse_stream_poll(struct sparse_stream *ss);
+/* Write what is left and call fastboot_okay() or fastboot_fail() */
+void sparse_stream_finish(struct sparse_stream *ss);
+/* Free the buffers of a download that will not be finished */
+void sparse_stream_abort(struct sparse_stream *ss);
+#endif
@@ -72,6 +72,9 @@ typedef struct global_data {
 
 	const void *fdt_blob;	/* Our device tree, NULL if none */
 	void *new_fdt;		/* Relocated FDT */
+#ifdef CONFIG_FDTDEC_INDEX
+	void *fdt_index;	/* Index of fdt_blob, see fdtdec_index_build() */
+#endif
 	unsigned long fdt_size;	/* Space reserved for relocated FDT */
 	void **jt;		/* jump table */
 	char env_buf[32];	/* buffer for getenv() before reloc. */
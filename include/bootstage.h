@@ -291,6 +291,19 @@ uint32_t bootstage_start(enum bootstage_id id, const char *name);
  */
 uint32_t bootstage_accum(enum bootstage_id id);
 
+/**
+ * Record the time taken by a named activity
+ *
+ * This adds a new accumulator record, for activities which happen once and
+ * do not have a bootstage id of their own, such as probing a device.
+ *
+ * @param name		Name to display in the report, which must stay valid
+ * @param start_us	Time at which the activity started, from
+ *			timer_get_boot_us()
+ * @return time spent in the activity
+ */
+uint32_t bootstage_accum_name(const char *name, uint32_t start_us);
+
 /* Print a report about boot time */
 void bootstage_report(void);
 
@@ -373,6 +386,12 @@ static inline uint32_t bootstage_accum(enum bootstage_id id)
 	return 0;
 }
 
+static inline uint32_t bootstage_accum_name(const char *name,
+					    uint32_t start_us)
+{
+	return 0;
+}
+
 static inline int bootstage_stash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
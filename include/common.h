@@ -786,6 +786,13 @@ int	init_timebase (void);
 int gunzip(void *, int, unsigned char *, unsigned long *);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 						int stoponerr, int offset);
+int gzip_parse_header(const unsigned char *src, unsigned long len);
+struct gunzip_stream;
+struct gunzip_stream *gunzip_stream_start(void *dst, int dstlen,
+					  const unsigned char *src);
+int gunzip_stream_feed(struct gunzip_stream *gs, unsigned long avail,
+		       unsigned char **outp);
+void gunzip_stream_end(struct gunzip_stream *gs);
 
 /* lib/qsort.c */
 void qsort(void *base, size_t nmemb, size_t size,
@@ -71,6 +71,24 @@
 #define CONFIG_LIB_RAND
 #endif
 
+#if defined(CONFIG_CMD_MALLOC) && !defined(CONFIG_MALLOC_TRACK)
+#define CONFIG_MALLOC_TRACK
+#endif
+
+#if (defined(CONFIG_SYS_SCRATCH_SIZE) || defined(CONFIG_CMD_MEMPOOL)) && \
+	!defined(CONFIG_MEMPOOL)
+#define CONFIG_MEMPOOL
+#endif
+
+#if defined(CONFIG_USB_STORAGE_PIPELINE) && !defined(CONFIG_USB_BULK_QUEUE)
+#define CONFIG_USB_BULK_QUEUE
+#endif
+
+/* The LMB keeps its regions in an rbtree */
+#if defined(CONFIG_LMB) && !defined(CONFIG_RBTREE)
+#define CONFIG_RBTREE
+#endif
+
 #if defined(CONFIG_API) && defined(CONFIG_LCD)
 #define CONFIG_CMD_BMP
 #endif
@@ -32,6 +32,8 @@
 #define CONFIG_DM_GPIO
 #define CONFIG_DM_TEST
 #define CONFIG_DM_SERIAL
+#define CONFIG_DM_MMC
+#define CONFIG_DM_PROBE_ASYNC
 
 #define CONFIG_SYS_STDIO_DEREGISTER
 
@@ -39,12 +41,18 @@
 #define CONFIG_SANDBOX_BITS_PER_LONG	64
 
 #define CONFIG_OF_LIBFDT
+#define CONFIG_FDTDEC_INDEX
 #define CONFIG_LMB
 #define CONFIG_FIT
 #define CONFIG_FIT_SIGNATURE
 #define CONFIG_RSA
 #define CONFIG_CMD_FDT
 #define CONFIG_ANDROID_BOOT_IMAGE
+#define CONFIG_IMAGE_LOAD_HASH
+
+/* Secondary CPUs are host threads, used to hash FIT images */
+#define CONFIG_CPU_WORK
+#define CONFIG_CPU_WORK_CPUS		4
 
 #define CONFIG_FS_FAT
 #define CONFIG_FS_EXT4
@@ -57,6 +65,13 @@
 #define CONFIG_HOST_MAX_DEVICES 4
 #define CONFIG_CMD_FS_GENERIC
 
+#define CONFIG_MMC
+#define CONFIG_GENERIC_MMC
+
+#define CONFIG_CMD_MEMPOOL
+#define CONFIG_SYS_SCRATCH_SIZE	(256 << 10)
+#define CONFIG_CMD_MALLOC
+
 #define CONFIG_SYS_VSNPRINTF
 
 #define CONFIG_CMD_GPIO
@@ -100,10 +115,12 @@
 #define CONFIG_OF_SPI
 #define CONFIG_OF_SPI_FLASH
 #define CONFIG_SPI_FLASH_ATMEL
+#define CONFIG_SPI_FLASH_BAR
 #define CONFIG_SPI_FLASH_EON
 #define CONFIG_SPI_FLASH_GIGADEVICE
 #define CONFIG_SPI_FLASH_MACRONIX
 #define CONFIG_SPI_FLASH_SANDBOX
+#define CONFIG_SPI_FLASH_SFDP
 #define CONFIG_SPI_FLASH_SPANSION
 #define CONFIG_SPI_FLASH_SST
 #define CONFIG_SPI_FLASH_STMICRO
@@ -23,6 +23,9 @@
 #define CONFIG_DM_GPIO
 #ifndef CONFIG_SPL_BUILD
 #define CONFIG_DM_SERIAL
+#define CONFIG_DM_MMC
+/* Let eMMC and SD cards power up while the rest of U-Boot starts */
+#define CONFIG_DM_PROBE_ASYNC
 #endif
 
 #define CONFIG_SYS_TIMER_RATE		1000000
@@ -0,0 +1,88 @@
+/*
+ * Run work on the secondary CPUs, which are otherwise idle in U-Boot
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __CPU_WORK_H
+#define __CPU_WORK_H
+
+#include <errno.h>
+
+/**
+ * struct cpu_work - a piece of work for a secondary CPU
+ *
+ * The function runs while the boot CPU carries on, so it must not print,
+ * allocate memory or access devices; hashing a buffer is fine.
+ *
+ * @func:	Function to run
+ * @arg:	Argument to pass to @func
+ * @ret:	Return value of @func, valid once @busy is clear
+ * @busy:	Non-zero until @func has returned
+ */
+struct cpu_work {
+	int (*func)(void *arg);
+	void *arg;
+	int ret;
+	volatile int busy;
+};
+
+#ifdef CONFIG_CPU_WORK
+/**
+ * cpu_work_start() - hand work to an idle secondary CPU
+ *
+ * The secondary CPUs are released the first time this is called.
+ *
+ * @work:	Work to set up, which must stay valid until cpu_work_wait()
+ * @func:	Function to run
+ * @arg:	Argument to pass to @func
+ * @return 0 if a secondary CPU is running the work, -EBUSY if none is
+ * free, in which case the caller should do the work itself
+ */
+int cpu_work_start(struct cpu_work *work, int (*func)(void *arg), void *arg);
+
+/**
+ * cpu_work_wait() - wait for work started by cpu_work_start() to finish
+ *
+ * @work:	Work to wait for
+ * @return the value returned by the work function
+ */
+int cpu_work_wait(struct cpu_work *work);
+
+/**
+ * cpu_work_stop() - wait for all work and park the secondary CPUs
+ *
+ * This must be called before handing the secondary CPUs over to an OS.
+ */
+void cpu_work_stop(void);
+#else
+static inline int cpu_work_start(struct cpu_work *work,
+				 int (*func)(void *arg), void *arg)
+{
+	return -EBUSY;
+}
+
+static inline int cpu_work_wait(struct cpu_work *work)
+{
+	return work->ret;
+}
+
+static inline void cpu_work_stop(void)
+{
+}
+#endif
+
+/* Main loop of a secondary CPU, returns when asked to stop */
+void cpu_work_secondary(int cpu);
+
+/* Architecture hooks, see common/cpu_work.c for the defaults */
+int arch_cpu_work_init(void);
+int arch_cpu_work_release(int cpu);
+void arch_cpu_work_stop(int cpu);
+void arch_cpu_work_exit(void);
+void arch_cpu_work_idle(void);
+
+/* Where arch_cpu_work_release() starts a secondary CPU by default */
+void cpu_work_entry(void);
+
+#endif /* __CPU_WORK_H */
@@ -88,6 +88,12 @@ struct sf_internal_data {
 #ifndef CONFIG_SYS_DFU_MAX_FILE_SIZE
 #define CONFIG_SYS_DFU_MAX_FILE_SIZE CONFIG_SYS_DFU_DATA_BUF_SIZE
 #endif
+#ifndef CONFIG_SYS_DFU_BUF_COUNT
+#define CONFIG_SYS_DFU_BUF_COUNT	1
+#endif
+#ifndef CONFIG_SYS_DFU_WRITE_STEP
+#define CONFIG_SYS_DFU_WRITE_STEP	(128 * 1024)
+#endif
 #ifndef DFU_DEFAULT_POLL_TIMEOUT
 #define DFU_DEFAULT_POLL_TIMEOUT 0
 #endif
@@ -102,6 +108,8 @@ struct dfu_entity {
 	enum dfu_device_type    dev_type;
 	enum dfu_layout         layout;
 	unsigned long           max_buf_size;
+	/* most bytes to write at a time in dfu_write_poll(), 0 for no limit */
+	unsigned long           write_step;
 
 	union {
 		struct mmc_internal_data mmc;
@@ -162,6 +170,11 @@ bool dfu_usb_get_reset(void);
 int dfu_read(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_write(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
 int dfu_flush(struct dfu_entity *de, void *buf, int size, int blk_seq_num);
+/*
+ * Write out part of a full download buffer, if there is one. Called between
+ * USB requests so that the medium is written while the next buffer fills.
+ */
+void dfu_write_poll(void);
 /* Device specific */
 #ifdef CONFIG_DFU_MMC
 extern int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s);
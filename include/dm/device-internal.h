@@ -65,6 +65,32 @@ int device_bind_by_name(struct udevice *parent, bool pre_reloc_only,
  */
 int device_probe(struct udevice *dev);
 
+/**
+ * device_probe_start() - Start probing a device, without waiting for it
+ *
+ * This is like device_probe(), except that a device whose driver has a
+ * probe_poll() method is left with DM_FLAG_PROBING set once probe() has
+ * returned. It is finished off by device_probe_poll(), or by device_probe()
+ * when the device is first needed.
+ *
+ * @dev: Pointer to device to probe
+ * @return 0 if OK (the device is active or being probed), -ve on error
+ */
+int device_probe_start(struct udevice *dev);
+
+/**
+ * device_probe_poll() - Check whether a device has finished probing
+ *
+ * This calls the driver's probe_poll() method for a device that
+ * device_probe_start() has left probing, and activates the device once the
+ * driver is ready.
+ *
+ * @dev: Pointer to device to check
+ * @return 0 if the device is active, -EAGAIN if it is still being probed,
+ * -ENODEV if it is not being probed, other -ve value if probing failed
+ */
+int device_probe_poll(struct udevice *dev);
+
 /**
  * device_remove() - Remove a device, de-activating it
  *
@@ -79,10 +105,12 @@ int device_remove(struct udevice *dev);
 /**
  * device_unbind() - Unbind a device, destroying it
  *
- * Unbind a device and remove all memory used by it
+ * Unbind a device and remove all memory used by it. The device must have
+ * been removed first, including one that is still being probed.
  *
  * @dev: Pointer to device to unbind
- * @return 0 if OK, -ve on error
+ * @return 0 if OK, -EINVAL if the device is active or probing, other -ve on
+ * error
  */
 int device_unbind(struct udevice *dev);
 
@@ -26,6 +26,15 @@ struct driver_info;
 /* DM should init this device prior to relocation */
 #define DM_FLAG_PRE_RELOC	(1 << 2)
 
+/* Driver probe() has returned but probe_poll() has not finished yet */
+#define DM_FLAG_PROBING		(1 << 3)
+
+/* The driver's probe_poll() method is running */
+#define DM_FLAG_POLLING		(1 << 4)
+
+/* device_probe() is waiting for this device, so dm_probe_poll() skips it */
+#define DM_FLAG_JOINING		(1 << 5)
+
 /**
  * struct udevice - An instance of a driver
  *
@@ -58,6 +67,9 @@ struct driver_info;
  * @flags: Flags for this device DM_FLAG_...
  * @req_seq: Requested sequence number for this device (-1 = any)
  * @seq: Allocated sequence number for this device (-1 = none)
+ * @probe_start: Time at which probing started, in microseconds since boot
+ * @probe_time: Time the last probe took in microseconds, including any
+ * time spent in probe_poll(), for the bootstage report and 'dm tree'
  */
 struct udevice {
 	struct driver *driver;
@@ -75,6 +87,8 @@ struct udevice {
 	uint32_t flags;
 	int req_seq;
 	int seq;
+	ulong probe_start;
+	ulong probe_time;
 };
 
 /* Maximum sequence number supported */
@@ -115,6 +129,12 @@ struct udevice_id {
  * for each.
  * @bind: Called to bind a device to its driver
  * @probe: Called to probe a device, i.e. activate it
+ * @probe_poll: If provided, called after @probe until it returns something
+ * other than -EAGAIN, and only then is the device active. This lets slow
+ * hardware set-up, such as card identification, PHY auto-negotiation or bus
+ * enumeration, carry on while other devices are probed: @probe starts it
+ * and @probe_poll checks on it without waiting. On error @probe_poll must
+ * undo what @probe did, since @remove is not called.
  * @remove: Called to remove a device, i.e. de-activate it
  * @unbind: Called to unbind a device from its driver
  * @ofdata_to_platdata: Called before probe to decode device tree data
@@ -144,6 +164,7 @@ struct driver {
 	const struct udevice_id *of_match;
 	int (*bind)(struct udevice *dev);
 	int (*probe)(struct udevice *dev);
+	int (*probe_poll)(struct udevice *dev);
 	int (*remove)(struct udevice *dev);
 	int (*unbind)(struct udevice *dev);
 	int (*ofdata_to_platdata)(struct udevice *dev);
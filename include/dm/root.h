@@ -74,6 +74,26 @@ int dm_scan_fdt_node(struct udevice *parent, const void *blob, int offset,
  */
 int dm_scan_other(bool pre_reloc_only);
 
+/**
+ * dm_probe_async() - Start probing all devices with slow set-up
+ *
+ * This starts probing every bound device whose driver has a probe_poll()
+ * method, so that the slow parts of setting them up overlap with each other
+ * and with the rest of U-Boot's start-up. Each device is finished off when
+ * it is first used, or by dm_probe_poll() in the meantime. Errors are
+ * reported then.
+ */
+void dm_probe_async(void);
+
+/**
+ * dm_probe_poll() - Make progress with devices that are still probing
+ *
+ * This calls device_probe_poll() once for each device that
+ * dm_probe_async() or device_probe_start() left probing. It is also
+ * called while device_probe() waits for a device to finish.
+ */
+void dm_probe_poll(void);
+
 /**
  * dm_init_and_scan() - Initialise Driver Model structures and scan for devices
  *
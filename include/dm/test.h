@@ -38,6 +38,7 @@ enum {
 	DM_TEST_OP_BIND = 0,
 	DM_TEST_OP_UNBIND,
 	DM_TEST_OP_PROBE,
+	DM_TEST_OP_PROBE_POLL,
 	DM_TEST_OP_REMOVE,
 
 	/* For uclass */
@@ -60,6 +61,9 @@ enum {
 /* The number added to the ping total on each probe */
 #define DM_TEST_START_TOTAL	5
 
+/* The number of times the asynchronous test driver is polled while probing */
+#define DM_TEST_PROBE_POLLS	3
+
 /**
  * struct dm_test_priv - private data for the test devices
  */
@@ -22,6 +22,7 @@ enum uclass_id {
 	/* U-Boot uclasses start here */
 	UCLASS_GPIO,		/* Bank of general-purpose I/O pins */
 	UCLASS_SERIAL,		/* Serial UART */
+	UCLASS_MMC,		/* MMC/SD card slot */
 
 	UCLASS_COUNT,
 	UCLASS_INVALID = -1,
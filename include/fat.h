@@ -33,6 +33,12 @@
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
 
+/* Number of FATBUFBLOCKS windows kept in the read-side FAT cache */
+#ifndef CONFIG_FS_FAT_CACHE_WINDOWS
+#define CONFIG_FS_FAT_CACHE_WINDOWS	4
+#endif
+#define FATCACHEWINDOWS	CONFIG_FS_FAT_CACHE_WINDOWS
+
 
 /* Filesystem identifiers */
 #define FAT12_SIGN	"FAT12   "
@@ -158,6 +164,15 @@ typedef struct dir_slot {
 	__u8	name11_12[4];	/* Last 2 characters in name */
 } dir_slot;
 
+/*
+ * One FATBUFBLOCKS sized window of the FAT, as cached by get_fatent()
+ */
+typedef struct {
+	__u8	*buf;		/* Window contents, FATBUFSIZE bytes */
+	int	bufnum;		/* Window number in the FAT, -1 if unused */
+	__u32	lru;		/* Tick of the last access, 0 if unused */
+} fat_window;
+
 /*
  * Private filesystem parameters
  *
@@ -173,9 +188,21 @@ typedef struct {
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
-	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	int	fatbufnum;	/* Used by get_fatent_value, init to -1 */
+	fat_window fatcache[FATCACHEWINDOWS]; /* Used by get_fatent */
+	__u32	fatcache_tick;	/* LRU clock for fatcache */
 } fsdata;
 
+/*
+ * Statistics about the last file read
+ */
+struct fat_read_stats {
+	unsigned long	extents;	/* Contiguous extents read */
+	unsigned long	reads;		/* Block device reads issued */
+	unsigned long	bytes;		/* Bytes returned to the caller */
+	unsigned long	bounced;	/* Bytes copied via the bounce buffer */
+};
+
 typedef int	(file_detectfs_func)(void);
 typedef int	(file_ls_func)(const char *dir);
 typedef long	(file_read_func)(const char *filename, void *buffer,
@@ -209,4 +236,5 @@ int fat_register_device(block_dev_desc_t *dev_desc, int part_no);
 int file_fat_write(const char *filename, void *buffer, unsigned long maxsize);
 int fat_read_file(const char *filename, void *buf, int offset, int len);
 void fat_close(void);
+const struct fat_read_stats *fat_get_read_stats(void);
 #endif /* _FAT_H_ */
@@ -6,3 +6,26 @@
 
 void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 			unsigned int download_bytes, char *response);
+
+/*
+ * Write a download to the partition named @cmd as it arrives. The response
+ * buffer, of 64 + 1 bytes, must last until fb_mmc_stream_finish() has
+ * filled it in. fb_mmc_stream_start() returns 0, or -ve with the response
+ * filled in. fb_mmc_stream_write() returns how much of the data it took,
+ * and fb_mmc_stream_poll() writes one step of it out, as for
+ * sparse_stream_write() and sparse_stream_poll().
+ */
+int fb_mmc_stream_start(const char *cmd, unsigned int download_size,
+			char *response);
+unsigned int fb_mmc_stream_write(const void *data, unsigned int len);
+int fb_mmc_stream_poll(void);
+void fb_mmc_stream_finish(void);
+/* Drop a download that has been started but will not be finished */
+void fb_mmc_stream_abort(void);
+
+/*
+ * Take in what has been received of a streamed download and write out one
+ * step of it. This is called from the fastboot command loop, so that eMMC
+ * writes are not made from within a USB completion handler.
+ */
+void fastboot_stream_poll(void);
@@ -597,4 +597,91 @@ struct fmap_entry {
  */
 int fdtdec_read_fmap_entry(const void *blob, int node, const char *name,
 			   struct fmap_entry *entry);
+
+/**
+ * Check whether a node is compatible with the given string, as
+ * fdt_node_check_compatible() does, using the index if there is one
+ *
+ * @param blob		FDT blob
+ * @param node		Node to check
+ * @param compat	Compatible string to look for
+ * @return 0 if compatible, 1 if not, -ve FDT_ERR_... on error
+ */
+int fdtdec_node_check_compatible(const void *blob, int node,
+				 const char *compat);
+
+/**
+ * Find the next node with the given compatible string, as
+ * fdt_node_offset_by_compatible() does, using the index if there is one
+ *
+ * @param blob		FDT blob
+ * @param node		Node to start after, -1 to start at the root
+ * @param compat	Compatible string to look for
+ * @return node offset, or -ve FDT_ERR_... if there is none
+ */
+int fdtdec_node_offset_by_compatible(const void *blob, int node,
+				     const char *compat);
+
+/**
+ * Find the offset of a node from its path or alias, as fdt_path_offset()
+ * does, using the index if there is one
+ *
+ * @param blob		FDT blob
+ * @param path		Full path or alias of the node
+ * @return node offset, or -ve FDT_ERR_... if there is none
+ */
+int fdtdec_path_offset(const void *blob, const char *path);
+
+#ifdef CONFIG_FDTDEC_INDEX
+/**
+ * Build an index of the nodes of gd->fdt_blob by phandle, compatible
+ * string and path, so that the fdtdec functions do not need to walk the
+ * tree for each lookup. The index is dropped when the blob is relocated.
+ *
+ * @return 0 if ok, -ve on error, in which case lookups use libfdt alone
+ */
+int fdtdec_index_build(void);
+
+/*
+ * Lookups in the index. These return false if the index cannot answer,
+ * in which case the caller must use libfdt.
+ */
+bool fdtdec_index_check_compatible(const void *blob, int node,
+				   const char *compat, int *retp);
+bool fdtdec_index_offset_by_compatible(const void *blob, int node,
+				       const char *compat, int *offsetp);
+bool fdtdec_index_offset_by_phandle(const void *blob, uint32_t phandle,
+				    int *offsetp);
+bool fdtdec_index_path_offset(const void *blob, const char *path,
+			      int *offsetp);
+#else
+static inline int fdtdec_index_build(void)
+{
+	return 0;
+}
+
+static inline bool fdtdec_index_check_compatible(const void *blob, int node,
+						 const char *compat, int *retp)
+{
+	return false;
+}
+
+static inline bool fdtdec_index_offset_by_compatible(const void *blob,
+		int node, const char *compat, int *offsetp)
+{
+	return false;
+}
+
+static inline bool fdtdec_index_offset_by_phandle(const void *blob,
+		uint32_t phandle, int *offsetp)
+{
+	return false;
+}
+
+static inline bool fdtdec_index_path_offset(const void *blob,
+					    const char *path, int *offsetp)
+{
+	return false;
+}
+#endif
 #endif
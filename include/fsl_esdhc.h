@@ -154,11 +154,22 @@
 #define ESDHC_HOSTCAPBLT_DMAS	0x00400000
 #define ESDHC_HOSTCAPBLT_HSS	0x00200000
 
+#define MIX_CTRL_EXE_TUNE	0x00400000
+#define MIX_CTRL_SMPCLK_SEL	0x00800000
+#define MIX_CTRL_FBCLK_SEL	0x02000000
+
+#define CLKTUNE_DLY_CELL_SET_PRE_SHIFT	8
+#define CLKTUNE_DLY_CELL_MAX		0x7f
+
 struct fsl_esdhc_cfg {
 	u32	esdhc_base;
 	u32	sdhc_clk;
 	u8	max_bus_width;
+	u8	hs200;		/* uSDHC: I/O at 1.8V, eMMC may run HS200 */
 	struct mmc_config cfg;
+	/* Driver state */
+	u8	blkcnt_set;	/* SET_BLOCK_COUNT was the last command */
+	u8	auto_stop;	/* the last transfer ended with an auto CMD12 */
 };
 
 /* Select the correct accessors depending on endianess */
@@ -15,6 +15,7 @@
 enum {
 	HASH_FLAG_VERIFY	= 1 << 0,	/* Enable verify mode */
 	HASH_FLAG_ENV		= 1 << 1,	/* Allow env vars */
+	HASH_FLAG_BENCH		= 1 << 2,	/* Report hashing speed */
 };
 
 #ifndef USE_HOSTCC
@@ -364,6 +364,11 @@ extern bootm_headers_t images;
 #define CHUNKSZ_SHA1 (64 * 1024)
 #endif
 
+#ifndef CONFIG_SYS_BOOTM_LEN
+/* use 8MByte as default max gunzip size */
+#define CONFIG_SYS_BOOTM_LEN	0x800000
+#endif
+
 #define uimage_to_cpu(x)		be32_to_cpu(x)
 #define cpu_to_uimage(x)		cpu_to_be32(x)
 
@@ -473,6 +478,22 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		   int arch, int image_type, int bootstage_id,
 		   enum fit_load_op load_op, ulong *datap, ulong *lenp);
 
+#if defined(CONFIG_FIT) && defined(CONFIG_CPU_WORK) && !defined(USE_HOSTCC)
+/**
+ * fit_hash_jobs_wait() - finish with hashes started by fit_image_load()
+ *
+ * When it picks a configuration, fit_image_load() starts hashing the
+ * images of that configuration on the secondary CPUs. This waits for any
+ * hashes that have not been used yet and drops them, e.g. when bootm
+ * fails before it gets to those images.
+ */
+void fit_hash_jobs_wait(void);
+#else
+static inline void fit_hash_jobs_wait(void)
+{
+}
+#endif
+
 #ifndef USE_HOSTCC
 /**
  * fit_get_node_from_config() - Look up an image a FIT by type
@@ -614,6 +635,95 @@ static inline void image_set_name(image_header_t *hdr, const char *name)
 
 int image_check_hcrc(const image_header_t *hdr);
 int image_check_dcrc(const image_header_t *hdr);
+
+#if defined(CONFIG_IMAGE_LOAD_HASH) && !defined(USE_HOSTCC)
+/**
+ * image_load_start() - Follow a load so its image is verified as it arrives
+ *
+ * Loaders call this before writing a file to memory at @buf, and then
+ * report the data they have written with image_load_update(). If the file
+ * turns out to be a legacy image, its data CRC is computed from those
+ * reports while the data is still in the cache, and image_check_dcrc()
+ * uses the result instead of reading the whole image again.
+ *
+ * @buf:	Address the file is loaded to
+ */
+void image_load_start(const void *buf);
+
+/**
+ * image_load_update() - Report data written by a loader
+ *
+ * Reports which do not continue the data seen so far are ignored, as
+ * are reports after the image has been completed. Data written over an
+ * image loaded before drops what was recorded for it.
+ *
+ * @buf:	Start of the data written
+ * @len:	Number of bytes written
+ */
+void image_load_update(const void *buf, ulong len);
+
+/**
+ * image_load_cmd() - Drop the last image before a command that may change it
+ *
+ * cmd_process() calls this before each command. Unless the command is
+ * known to report what it writes (the loaders) or to leave memory alone
+ * (e.g. bootm, setenv), the CRC and decompressed kernel recorded for the
+ * last image are dropped, since the command may write over either of
+ * them without telling us.
+ *
+ * @name:	Full name of the command
+ * @argc:	Number of arguments, including the command itself
+ * @argv:	Arguments, argv[1] being the subcommand if there is one
+ */
+void image_load_cmd(const char *name, int argc, char * const argv[]);
+
+/**
+ * image_load_get_dcrc() - Get the data CRC computed while loading an image
+ *
+ * The CRC is only returned while the header is still the one that was
+ * loaded, so an image put there by some other means is checked as usual.
+ *
+ * @hdr:	Header of the image, at the address it was loaded to
+ * @dcrc:	Returns the CRC
+ * @return 0 if ok, -1 if it is not known
+ */
+int image_load_get_dcrc(const image_header_t *hdr, uint32_t *dcrc);
+#else
+static inline void image_load_start(const void *buf) {}
+static inline void image_load_update(const void *buf, ulong len) {}
+static inline void image_load_cmd(const char *name, int argc,
+				  char * const argv[]) {}
+static inline int image_load_get_dcrc(const image_header_t *hdr,
+				      uint32_t *dcrc)
+{
+	return -1;
+}
+#endif
+
+#if defined(CONFIG_IMAGE_LOAD_DECOMP) && !defined(USE_HOSTCC)
+/**
+ * image_load_get_decomp() - Get a kernel decompressed while it was loaded
+ *
+ * The output is only returned if no loader has written over it, or over
+ * the compressed image, and no other command that may write memory has
+ * run since it was produced. Its CRC must also still be the one taken as
+ * it was produced, which catches writes by bootm itself.
+ *
+ * @data:	Compressed image data
+ * @len:	Length of the compressed data
+ * @dest:	Where the data should have been decompressed to
+ * @dest_len:	Returns the length of the decompressed data
+ * @return 0 if ok, -1 if the data has to be decompressed now
+ */
+int image_load_get_decomp(const void *data, ulong len, void *dest,
+			  ulong *dest_len);
+#else
+static inline int image_load_get_decomp(const void *data, ulong len,
+					void *dest, ulong *dest_len)
+{
+	return -1;
+}
+#endif
 #ifndef USE_HOSTCC
 ulong getenv_bootm_low(void);
 phys_size_t getenv_bootm_size(void);
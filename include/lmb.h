@@ -3,6 +3,7 @@
 #ifdef __KERNEL__
 
 #include <asm/types.h>
+#include <linux/rbtree.h>
 /*
  * Logical memory blocks.
  *
@@ -11,17 +12,23 @@
  * SPDX-License-Identifier:	GPL-2.0+
  */
 
-#define MAX_LMB_REGIONS 8
-
+/*
+ * A region of memory, kept in an interval tree ordered by base address.
+ * Each node also holds the last address covered by any region in its
+ * subtree, so that overlapping regions are found in O(log n).
+ */
 struct lmb_property {
+	struct rb_node node;
 	phys_addr_t base;
 	phys_size_t size;
+	phys_addr_t subtree_last;
+	const char *name;	/* owner of a reservation, or NULL */
 };
 
 struct lmb_region {
+	struct rb_root root;
 	unsigned long cnt;
 	phys_size_t size;
-	struct lmb_property region[MAX_LMB_REGIONS+1];
 };
 
 struct lmb {
@@ -31,25 +38,33 @@ struct lmb {
 
 extern struct lmb lmb;
 
+/* The lmb must be zeroed or initialised before, since its regions are freed */
 extern void lmb_init(struct lmb *lmb);
 extern long lmb_add(struct lmb *lmb, phys_addr_t base, phys_size_t size);
 extern long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size);
+/* The name is not copied, so it must stay valid while the lmb is used */
+extern long lmb_reserve_named(struct lmb *lmb, phys_addr_t base,
+			      phys_size_t size, const char *name);
 extern phys_addr_t lmb_alloc(struct lmb *lmb, phys_size_t size, ulong align);
 extern phys_addr_t lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align,
 			    phys_addr_t max_addr);
+extern phys_addr_t lmb_alloc_base_named(struct lmb *lmb, phys_size_t size,
+					ulong align, phys_addr_t max_addr,
+					const char *name);
 extern phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align,
 			      phys_addr_t max_addr);
 extern int lmb_is_reserved(struct lmb *lmb, phys_addr_t addr);
+/*
+ * Find the lowest reservation overlapping base..base + size - 1, returning
+ * its range and name (NULL if unnamed). Returns 0 if found, -1 if none.
+ */
+extern long lmb_get_reserved(struct lmb *lmb, phys_addr_t base,
+			     phys_size_t size, phys_addr_t *rbase,
+			     phys_size_t *rsize, const char **name);
 extern long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size);
 
 extern void lmb_dump_all(struct lmb *lmb);
 
-static inline phys_size_t
-lmb_size_bytes(struct lmb_region *type, unsigned long region_nr)
-{
-	return type->region[region_nr].size;
-}
-
 void board_lmb_reserve(struct lmb *lmb);
 void arch_lmb_reserve(struct lmb *lmb);
 
@@ -882,6 +882,17 @@ extern Void_t*     sbrk();
 #define pvALLOc		dlpvalloc
 #define mALLINFo	dlmallinfo
 #define mALLOPt		dlmallopt
+#elif defined(CONFIG_MALLOC_TRACK) && !defined(CONFIG_SPL_BUILD)
+/* malloc() and friends record each allocation, see common/malloc_track.c */
+#define cALLOc		dlcalloc
+#define fREe		dlfree
+#define mALLOc		dlmalloc
+#define mEMALIGn	dlmemalign
+#define rEALLOc		dlrealloc
+#define vALLOc		dlvalloc
+#define pvALLOc		dlpvalloc
+#define mALLINFo	mallinfo
+#define mALLOPt		mallopt
 #else /* USE_DL_PREFIX */
 #define cALLOc		calloc
 #define fREe		free
@@ -938,6 +949,38 @@ extern ulong mem_malloc_brk;
 
 void mem_malloc_init(ulong start, ulong size);
 
+#if defined(CONFIG_MALLOC_TRACK) && !defined(CONFIG_SPL_BUILD)
+/* Wrappers around dlmalloc() and friends, in common/malloc_track.c */
+void *malloc(size_t bytes);
+void free(void *mem);
+void *calloc(size_t n, size_t elem_size);
+void *realloc(void *oldmem, size_t bytes);
+void *memalign(size_t alignment, size_t bytes);
+void *valloc(size_t bytes);
+void *pvalloc(size_t bytes);
+
+/* Print the malloc() area's size, use and peak use */
+void malloc_track_info(void);
+
+/**
+ * malloc_track_dump() - list the live allocations
+ *
+ * @since_mark:	Only list those made since malloc_track_mark() was called
+ */
+void malloc_track_dump(bool since_mark);
+
+/* Remember the current point, for finding leaks with malloc_track_dump() */
+void malloc_track_mark(void);
+
+/**
+ * malloc_track_top() - list the callers that hold the most memory
+ *
+ * @max_owners:	Number of callers to list
+ * @return 0 if OK, -ENOMEM if there was no memory to sort the allocations
+ */
+int malloc_track_top(int max_owners);
+#endif
+
 #ifdef __cplusplus
 };  /* end of extern "C" */
 #endif
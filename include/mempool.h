@@ -0,0 +1,225 @@
+/*
+ * Fixed-size object pools and scratch arenas on top of malloc()
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef __MEMPOOL_H
+#define __MEMPOOL_H
+
+#include <linux/types.h>
+#include <malloc.h>
+
+/**
+ * struct mem_pool - a pool of objects of one size
+ *
+ * Objects are carved out of chunks taken from malloc() and go back on the
+ * pool's free list when freed, so hot callers that allocate and free the
+ * same kind of object over and over do not fragment the heap. Chunks are
+ * only given back by mem_pool_destroy(). Before relocation, when free()
+ * does nothing, a pool also lets freed objects be used again.
+ *
+ * @name:	Name shown by the 'mempool' command
+ * @size:	Object size, rounded up to @align
+ * @align:	Alignment of each object
+ * @per_chunk:	Number of objects in each chunk
+ * @max:	Most objects that may be in use, 0 for no limit
+ * @free_list:	Free objects, linked through their first word
+ * @chunks:	Chunks taken from malloc()
+ * @next:	Next registered pool
+ * @in_use:	Objects currently allocated
+ * @peak:	Most objects allocated at once
+ * @nchunks:	Number of chunks
+ * @allocs:	Number of successful mem_pool_alloc() calls
+ * @fails:	Number of mem_pool_alloc() calls that returned NULL
+ */
+struct mem_pool {
+	const char *name;
+	ulong size;
+	ulong align;
+	unsigned int per_chunk;
+	unsigned int max;
+	void *free_list;
+	void *chunks;
+	struct mem_pool *next;
+	unsigned int in_use;
+	unsigned int peak;
+	unsigned int nchunks;
+	ulong allocs;
+	ulong fails;
+};
+
+/**
+ * struct mem_arena - a scratch area that is allocated from by bumping
+ *
+ * Memory is not freed one piece at a time. Instead the caller takes a mark
+ * and later releases everything allocated since then in one go.
+ *
+ * @base:	Start of the area
+ * @size:	Size of the area in bytes
+ * @used:	Bytes allocated so far
+ * @peak:	Most bytes allocated at once
+ */
+struct mem_arena {
+	char *base;
+	ulong size;
+	ulong used;
+	ulong peak;
+};
+
+#ifdef CONFIG_MEMPOOL
+/**
+ * mem_pool_init() - set up a pool
+ *
+ * No memory is taken until the first object is allocated. After
+ * relocation the pool is also added to the list shown by 'mempool'. A pool
+ * that is set up again must have been destroyed first.
+ *
+ * @pool:	Pool to set up
+ * @name:	Name of the pool, which is not copied
+ * @size:	Size of each object in bytes
+ * @align:	Alignment of each object, a power of two, or 0 for the
+ *		alignment of a pointer
+ * @per_chunk:	Number of objects to take from malloc() at a time
+ * @limit:	Most objects that may be in use at once, 0 for no limit
+ */
+void mem_pool_init(struct mem_pool *pool, const char *name, ulong size,
+		   ulong align, unsigned int per_chunk, unsigned int limit);
+
+/**
+ * mem_pool_destroy() - give all of a pool's memory back to malloc()
+ *
+ * Any objects still allocated from the pool become invalid.
+ *
+ * @pool:	Pool to destroy
+ */
+void mem_pool_destroy(struct mem_pool *pool);
+
+/**
+ * mem_pool_alloc() - allocate an object from a pool
+ *
+ * @pool:	Pool to allocate from
+ * @return pointer to the object, or NULL if out of memory or the pool
+ * already has its limit of objects in use
+ */
+void *mem_pool_alloc(struct mem_pool *pool);
+
+/**
+ * mem_pool_zalloc() - allocate a zeroed object from a pool
+ *
+ * @pool:	Pool to allocate from
+ * @return pointer to the object, or NULL as for mem_pool_alloc()
+ */
+void *mem_pool_zalloc(struct mem_pool *pool);
+
+/**
+ * mem_pool_free() - give an object back to its pool
+ *
+ * @pool:	Pool the object came from
+ * @ptr:	Object to free, or NULL to do nothing
+ */
+void mem_pool_free(struct mem_pool *pool, void *ptr);
+
+/* Print the statistics of each registered pool and the scratch arena */
+void mem_pool_report(void);
+
+/**
+ * mem_arena_init() - set up an arena on a caller-supplied area
+ *
+ * @arena:	Arena to set up
+ * @base:	Start of the area
+ * @size:	Size of the area in bytes
+ */
+void mem_arena_init(struct mem_arena *arena, void *base, ulong size);
+
+/**
+ * mem_arena_alloc() - allocate from an arena
+ *
+ * @arena:	Arena to allocate from
+ * @size:	Number of bytes needed
+ * @return pointer aligned to ARCH_DMA_MINALIGN, or NULL if the arena is
+ * full
+ */
+void *mem_arena_alloc(struct mem_arena *arena, ulong size);
+
+/**
+ * mem_arena_memalign() - allocate from an arena with a given alignment
+ *
+ * @arena:	Arena to allocate from
+ * @align:	Alignment, a power of two; never less than ARCH_DMA_MINALIGN
+ * @size:	Number of bytes needed
+ * @return pointer, or NULL if the arena is full
+ */
+void *mem_arena_memalign(struct mem_arena *arena, ulong align, ulong size);
+
+/* Return a mark for mem_arena_release() */
+static inline ulong mem_arena_mark(struct mem_arena *arena)
+{
+	return arena->used;
+}
+
+/**
+ * mem_arena_release() - free everything allocated since a mark was taken
+ *
+ * @arena:	Arena to release
+ * @mark:	Value returned by mem_arena_mark()
+ */
+void mem_arena_release(struct mem_arena *arena, ulong mark);
+
+/**
+ * mem_arena_free() - free an allocation and everything allocated after it
+ *
+ * @arena:	Arena to release
+ * @ptr:	Pointer returned by mem_arena_alloc()
+ */
+void mem_arena_free(struct mem_arena *arena, void *ptr);
+#endif
+
+#ifdef CONFIG_SYS_SCRATCH_SIZE
+/*
+ * The scratch arena holds CONFIG_SYS_SCRATCH_SIZE bytes from the malloc()
+ * area after relocation. Each command releases whatever it allocated from
+ * it when it returns, so callers that only need memory while a command runs
+ * can use it without freeing anything.
+ */
+int scratch_init(void);
+void *scratch_alloc(ulong size);
+ulong scratch_mark(void);
+void scratch_release(ulong mark);
+
+/*
+ * scratch_memalign() takes memory with at least the given alignment from
+ * the scratch arena, or from memalign() once the arena is full. Callers that
+ * free their buffer before returning give it back with scratch_free(),
+ * which releases an arena allocation together with everything allocated
+ * from the arena after it, as obstack_free() does.
+ */
+void *scratch_memalign(ulong align, ulong size);
+void scratch_free(void *ptr);
+#else
+static inline void *scratch_alloc(ulong size)
+{
+	return NULL;
+}
+
+static inline void *scratch_memalign(ulong align, ulong size)
+{
+	return memalign(align, size);
+}
+
+static inline void scratch_free(void *ptr)
+{
+	free(ptr);
+}
+
+static inline ulong scratch_mark(void)
+{
+	return 0;
+}
+
+static inline void scratch_release(ulong mark)
+{
+}
+#endif
+
+#endif /* __MEMPOOL_H */
@@ -39,8 +39,10 @@
 #define MMC_MODE_SPI		(1 << 4)
 #define MMC_MODE_HC		(1 << 5)
 #define MMC_MODE_DDR_52MHz	(1 << 6)
+#define MMC_MODE_HS200		(1 << 7)
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_CMD23_SUPPORT	0x00000002
 
 #define IS_SD(x) (x->version & SD_VERSION_SD)
 
@@ -69,6 +71,7 @@
 #define MMC_CMD_SET_BLOCKLEN		16
 #define MMC_CMD_READ_SINGLE_BLOCK	17
 #define MMC_CMD_READ_MULTIPLE_BLOCK	18
+#define MMC_CMD_SEND_TUNING_BLOCK_HS200	21
 #define MMC_CMD_SET_BLOCK_COUNT         23
 #define MMC_CMD_WRITE_SINGLE_BLOCK	24
 #define MMC_CMD_WRITE_MULTIPLE_BLOCK	25
@@ -177,6 +180,14 @@
 #define EXT_CSD_CARD_TYPE_DDR_1_2V	(1 << 3)
 #define EXT_CSD_CARD_TYPE_DDR_52	(EXT_CSD_CARD_TYPE_DDR_1_8V \
 					| EXT_CSD_CARD_TYPE_DDR_1_2V)
+#define EXT_CSD_CARD_TYPE_HS200_1_8V	(1 << 4)
+#define EXT_CSD_CARD_TYPE_HS200_1_2V	(1 << 5)
+#define EXT_CSD_CARD_TYPE_HS200		(EXT_CSD_CARD_TYPE_HS200_1_8V \
+					| EXT_CSD_CARD_TYPE_HS200_1_2V)
+
+#define EXT_CSD_TIMING_LEGACY	0	/* Backward compatible timing */
+#define EXT_CSD_TIMING_HS	1	/* High speed timing */
+#define EXT_CSD_TIMING_HS200	2	/* HS200 timing */
 
 #define EXT_CSD_BUS_WIDTH_1	0	/* Card is in 1 bit mode */
 #define EXT_CSD_BUS_WIDTH_4	1	/* Card is in 4 bit mode */
@@ -267,6 +278,25 @@ struct mmc_ops {
 	int (*init)(struct mmc *mmc);
 	int (*getcd)(struct mmc *mmc);
 	int (*getwp)(struct mmc *mmc);
+	/*
+	 * Optional queued data transfers. start_cmd() sends the command,
+	 * starts its data transfer and returns as soon as the card has
+	 * accepted the command. wait_cmd() then waits for the transfer to
+	 * complete. mmc_bread() uses these to set up the next chunk of a
+	 * large read while the current one is still in flight.
+	 */
+	int (*start_cmd)(struct mmc *mmc,
+			 struct mmc_cmd *cmd, struct mmc_data *data);
+	int (*wait_cmd)(struct mmc *mmc,
+			struct mmc_cmd *cmd, struct mmc_data *data);
+	/*
+	 * Sample point tuning with the given tuning command, required for
+	 * HS200. It is called with MMC_MODE_HS200 set in card_caps and the
+	 * bus clock already raised; the host must also have switched its
+	 * I/O lines to the signalling voltage it advertises HS200 for.
+	 * mmc_send_tuning() tells whether a sample point works.
+	 */
+	int (*execute_tuning)(struct mmc *mmc, uint opcode);
 };
 
 struct mmc_config {
@@ -300,6 +330,7 @@ struct mmc {
 	ushort rca;
 	char part_config;
 	char part_num;
+	char cmd23;		/* 1 if the card supports SET_BLOCK_COUNT */
 	uint tran_speed;
 	uint read_bl_len;
 	uint write_bl_len;
@@ -314,6 +345,11 @@ struct mmc {
 	char init_in_progress;	/* 1 if we have done mmc_start_init() */
 	char preinit;		/* start init as early as possible */
 	uint op_cond_response;	/* the response byte from the last op_cond */
+	uint op_cond_start;	/* get_timer() at the first op_cond */
+#ifdef CONFIG_DM_MMC
+	struct udevice *dev;	/* the card's device, see mmc-uclass.c */
+	char dev_name[8];
+#endif
 };
 
 int mmc_register(struct mmc *mmc);
@@ -323,6 +359,13 @@ int mmc_initialize(bd_t *bis);
 int mmc_init(struct mmc *mmc);
 int mmc_read(struct mmc *mmc, u64 src, uchar *dst, int size);
 void mmc_set_clock(struct mmc *mmc, uint clock);
+/*
+ * Read the tuning block with the given command (CMD21 for HS200) and
+ * check it. Returns 0 if it came back intact.
+ */
+int mmc_send_tuning(struct mmc *mmc, uint opcode);
+extern const u8 tuning_blk_pattern_4bit[64];
+extern const u8 tuning_blk_pattern_8bit[128];
 struct mmc *find_mmc_device(int dev_num);
 int mmc_set_dev(int dev_num);
 void print_mmc_devices(char separator);
@@ -374,6 +417,18 @@ int mmc_start_init(struct mmc *mmc);
  */
 void mmc_set_preinit(struct mmc *mmc, int preinit);
 
+/**
+ * Make progress with the initialization of a card without waiting.
+ *
+ * This is what mmc_init() does after mmc_start_init(), except that it
+ * sends a card which is still busy powering up a single op_cond, and
+ * returns.
+ *
+ * @param mmc	Pointer to a MMC device struct
+ * @return 0 on success, IN_PROGRESS while the card is busy, <0 on error.
+ */
+int mmc_poll_init(struct mmc *mmc);
+
 #ifdef CONFIG_GENERIC_MMC
 #ifdef CONFIG_MMC_SPI
 #define mmc_host_is_spi(mmc)	((mmc)->cfg->host_caps & MMC_MODE_SPI)
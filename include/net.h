@@ -87,6 +87,18 @@ struct eth_device {
 	int  (*init) (struct eth_device *, bd_t *);
 	int  (*send) (struct eth_device *, void *packet, int length);
 	int  (*recv) (struct eth_device *);
+	/*
+	 * Optional batched receive. recv_pkt() points *packetp at the next
+	 * received frame, still in the driver's buffer, and returns its
+	 * length (0 if there is none). Once the frame has been processed
+	 * it is given back with free_pkt(). Nothing is given back when
+	 * recv_pkt() returns 0, so a buffer holding an empty or bad frame
+	 * must be recycled by recv_pkt() itself. When set, eth_rx() uses
+	 * these instead of recv() to handle a burst of frames per poll.
+	 * A negative return is an error and ends the burst like 0 does.
+	 */
+	int  (*recv_pkt) (struct eth_device *, uchar **packetp);
+	void (*free_pkt) (struct eth_device *, uchar *packet, int length);
 	void (*halt) (struct eth_device *);
 #ifdef CONFIG_MCAST_TFTP
 	int (*mcast) (struct eth_device *, const u8 *enetaddr, u8 set);
@@ -138,7 +150,13 @@ extern int eth_send(void *packet, int length);	   /* Send a packet */
 extern int eth_receive(void *packet, int length); /* Receive a packet*/
 extern void (*push_packet)(void *packet, int length);
 #endif
-extern int eth_rx(void);			/* Check for received packets */
+/*
+ * Check for received packets and pass them to NetReceive(). With a
+ * recv_pkt() driver this returns the number of frames handled, 0 if there
+ * were none; otherwise it returns whatever the driver's recv() does, which
+ * is not consistent across drivers. Returns -1 if there is no device.
+ */
+extern int eth_rx(void);
 extern void eth_halt(void);			/* stop SCC */
 extern char *eth_get_name(void);		/* get name of current device */
 
@@ -276,4 +276,16 @@ int os_read_ram_buf(const char *fname);
  */
 int os_jump_to_image(const void *dest, int size);
 
+/**
+ * Start a host thread, which stands in for a secondary CPU
+ *
+ * @param func		Function to run in the thread
+ * @param arg		Argument to pass to func
+ * @return 0 if OK, -ve on error
+ */
+int os_thread_create(void (*func)(int arg), int arg);
+
+/* Let other host threads run */
+void os_thread_yield(void);
+
 #endif
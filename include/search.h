@@ -53,6 +53,9 @@ struct hsearch_data {
 	struct _ENTRY *table;
 	unsigned int size;
 	unsigned int filled;
+	unsigned int deleted;	/* slots left behind by deleted entries */
+	ENTRY **sorted;		/* entries in key order, NULL if out of date */
+	int busy;		/* change_ok() or a callback is running */
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
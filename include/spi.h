@@ -63,6 +63,8 @@
  * @cs:			ID of the chip select connected to the slave.
  * @op_mode_rx:		SPI RX operation mode.
  * @op_mode_tx:		SPI TX operation mode.
+ * @addr_4b:		The controller can send 4-byte flash addresses. Not
+ *			all can, as some build the command themselves.
  * @wordlen:		Size of SPI word in number of bits
  * @max_write_size:	If non-zero, the maximum number of bytes which can
  *			be written at once, excluding command bytes.
@@ -75,6 +77,7 @@ struct spi_slave {
 	unsigned int cs;
 	u8 op_mode_rx;
 	u8 op_mode_tx;
+	u8 addr_4b;
 	unsigned int wordlen;
 	unsigned int max_write_size;
 	void *memory_map;
@@ -37,6 +37,7 @@
 #define SECT_32K	1 << 2
 #define E_FSR		1 << 3
 #define WR_QPP		1 << 4
+#define ADDR_4B		1 << 5	/* has 4-byte address read/program/erase */
 
 /* Enum list - Full read commands */
 enum spi_read_cmds {
@@ -90,6 +91,7 @@ extern const struct spi_flash_params spi_flash_params_table[];
  * @page_size:		Write (page) size
  * @sector_size:	Sector size
  * @erase_size:		Erase size
+ * @addr_width:		Address bytes sent with each cmd, 3 or 4
  * @bank_read_cmd:	Bank read cmd
  * @bank_write_cmd:	Bank write cmd
  * @bank_curr:		Current flash bank
@@ -117,6 +119,7 @@ struct spi_flash {
 	u32 page_size;
 	u32 sector_size;
 	u32 erase_size;
+	u8 addr_width;
 #ifdef CONFIG_SPI_FLASH_BAR
 	u8 bank_read_cmd;
 	u8 bank_write_cmd;
@@ -14,6 +14,12 @@ uint32_t crc32 (uint32_t, const unsigned char *, uint);
 uint32_t crc32_wd (uint32_t, const unsigned char *, uint, uint);
 uint32_t crc32_no_comp (uint32_t, const unsigned char *, uint);
 
+/*
+ * With CONFIG_CRC32_ARCH the architecture provides crc32_no_comp() on top
+ * of its CRC instructions (same arguments, no ones complement).
+ */
+uint32_t arch_crc32_no_comp(uint32_t, const unsigned char *, uint);
+
 /**
  * crc32_wd_buf - Perform CRC32 on a buffer and return result in buffer
  *
@@ -19,4 +19,12 @@ void sha256_finish(sha256_context * ctx, uint8_t digest[SHA256_SUM_LEN]);
 void sha256_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/*
+ * With CONFIG_SHA256_ARCH the architecture provides the block function,
+ * e.g. on top of the ARMv8 crypto extensions. It updates state[] with
+ * the given number of 64-byte blocks.
+ */
+void arch_sha256_process(uint32_t state[8], const uint8_t *data,
+			 uint32_t blocks);
+
 #endif /* _SHA256_H */
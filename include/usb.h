@@ -162,6 +162,59 @@ int submit_control_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 int submit_int_msg(struct usb_device *dev, unsigned long pipe, void *buffer,
 			int transfer_len, int interval);
 
+/*
+ * Return the largest number of bytes the host controller can move in one
+ * submit_bulk_msg() call. The default covers controllers that have not been
+ * looked at; it is the 20 blocks of 512 bytes usb_storage always used.
+ */
+#define USB_DEFAULT_MAX_XFER_SIZE	(20 * 512)
+int usb_get_max_xfer_size(struct usb_device *dev, size_t *size);
+
+#ifdef CONFIG_USB_BULK_QUEUE
+/*
+ * Bulk queues let a driver queue the next transfer on a bulk endpoint
+ * before the last one is finished, so that the bus is not left idle
+ * between them. Transfers on a queue complete in the order they were
+ * submitted. Each endpoint has one queue, which lasts until the controller
+ * is stopped, and plain bulk transfers on the endpoint go through it too
+ * when it is idle. Only the EHCI driver provides them.
+ */
+struct bulk_queue;
+
+/* One piece of a scattered buffer */
+struct bulk_sg {
+	void *buffer;
+	int length;
+};
+
+/*
+ * Get the endpoint's queue, with room for at least @queuesize transfers of
+ * up to @maxlen bytes between them. Returns NULL on error, or if the queue
+ * must grow while transfers are still queued on it.
+ */
+struct bulk_queue *get_bulk_queue(struct usb_device *dev, unsigned long pipe,
+				  int queuesize, int maxlen);
+/* Queue a transfer. Returns 0, or -ENOSPC if the queue is full */
+int bulk_queue_submit(struct usb_device *dev, struct bulk_queue *queue,
+		      void *buffer, int length);
+/*
+ * Queue one transfer made up of @nents pieces. Each piece but the last must
+ * be a whole number of packets long. The @sg array need not be kept.
+ */
+int bulk_queue_submit_sg(struct usb_device *dev, struct bulk_queue *queue,
+			 struct bulk_sg *sg, int nents);
+/*
+ * Check whether the oldest transfer has finished. Returns -EINPROGRESS if
+ * not, -ENOENT if nothing is queued, or else 0 with the number of bytes
+ * transferred in @act_len. On error, -EIO is returned with dev->status
+ * set, and the transfers queued after it are dropped.
+ */
+int bulk_queue_poll(struct usb_device *dev, struct bulk_queue *queue,
+		    int *act_len);
+/* Finish with the queue for now, dropping any transfers still queued */
+int put_bulk_queue(struct usb_device *dev, struct bulk_queue *queue);
+#endif
+
 /* Defines */
 #define USB_UHCI_VEND_ID	0x8086
 #define USB_UHCI_DEV_ID		0x7112
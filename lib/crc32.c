@@ -151,6 +151,17 @@ tole(0xb40bbe37L), tole(0xc30c8ea1L), tole(0x5a05df1bL), tole(0x2d02ef8dL)
 };
 #endif
 
+/*
+ * Slicing-by-8 consumes 8 bytes per step with 8 table lookups instead of
+ * 8 dependent ones, at the cost of another 7 KiB of tables. The host
+ * tools always use it.
+ */
+#if (defined(CONFIG_CRC32_SLICE_BY_8) || defined(USE_HOSTCC)) && \
+	!defined(DYNAMIC_CRC_TABLE)
+#define CRC32_SLICE_BY_8
+#include "crc32table.h"
+#endif
+
 #if 0
 /* =========================================================================
  * This function can be used by asm versions of crc32()
@@ -167,8 +178,16 @@ const uint32_t * ZEXPORT get_crc_table()
 /* ========================================================================= */
 # if __BYTE_ORDER == __LITTLE_ENDIAN
 #  define DO_CRC(x) crc = tab[(crc ^ (x)) & 255] ^ (crc >> 8)
+#  define DO_CRC4(q) (st[2][(q) & 255] ^ st[1][((q) >> 8) & 255] ^ \
+		      st[0][((q) >> 16) & 255] ^ tab[((q) >> 24) & 255])
+#  define DO_CRC8(q) (st[6][(q) & 255] ^ st[5][((q) >> 8) & 255] ^ \
+		      st[4][((q) >> 16) & 255] ^ st[3][((q) >> 24) & 255])
 # else
 #  define DO_CRC(x) crc = tab[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+#  define DO_CRC4(q) (tab[(q) & 255] ^ st[0][((q) >> 8) & 255] ^ \
+		      st[1][((q) >> 16) & 255] ^ st[2][((q) >> 24) & 255])
+#  define DO_CRC8(q) (st[3][(q) & 255] ^ st[4][((q) >> 8) & 255] ^ \
+		      st[5][((q) >> 16) & 255] ^ st[6][((q) >> 24) & 255])
 # endif
 
 /* ========================================================================= */
@@ -178,9 +197,16 @@ const uint32_t * ZEXPORT get_crc_table()
  */
 uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 {
+#if defined(CONFIG_CRC32_ARCH) && !defined(USE_HOSTCC)
+    return arch_crc32_no_comp(crc, buf, len);
+#else
     const uint32_t *tab = crc_table;
     const uint32_t *b =(const uint32_t *)buf;
     size_t rem_len;
+#ifdef CRC32_SLICE_BY_8
+    const uint32_t (*st)[256] = crc_slice_table;
+    uint32_t q;
+#endif
 #ifdef DYNAMIC_CRC_TABLE
     if (crc_table_empty)
       make_crc_table();
@@ -195,6 +221,17 @@ uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 	 b = (uint32_t *)p;
     }
 
+#ifdef CRC32_SLICE_BY_8
+    rem_len = len & 7;
+    len = len >> 3;
+    for (--b; len; --len) {
+	 /* two 32 bit loads, all eight table lookups independent */
+	 q = crc ^ *++b; /* use pre increment for speed */
+	 crc = DO_CRC8(q);
+	 q = *++b;
+	 crc ^= DO_CRC4(q);
+    }
+#else
     rem_len = len & 3;
     len = len >> 2;
     for (--b; len; --len) {
@@ -205,6 +242,7 @@ uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 	 DO_CRC(0);
 	 DO_CRC(0);
     }
+#endif
     len = rem_len;
     /* And the last few bytes */
     if (len) {
@@ -215,8 +253,11 @@ uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
     }
 
     return le32_to_cpu(crc);
+#endif
 }
 #undef DO_CRC
+#undef DO_CRC4
+#undef DO_CRC8
 
 uint32_t ZEXPORT crc32 (uint32_t crc, const Bytef *p, uInt len)
 {
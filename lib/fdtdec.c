@@ -145,13 +145,53 @@ int fdtdec_get_is_enabled(const void *blob, int node)
 	return 1;
 }
 
+int fdtdec_node_check_compatible(const void *blob, int node,
+				 const char *compat)
+{
+	int ret;
+
+	if (fdtdec_index_check_compatible(blob, node, compat, &ret))
+		return ret;
+
+	return fdt_node_check_compatible(blob, node, compat);
+}
+
+int fdtdec_node_offset_by_compatible(const void *blob, int node,
+				     const char *compat)
+{
+	int offset;
+
+	if (fdtdec_index_offset_by_compatible(blob, node, compat, &offset))
+		return offset;
+
+	return fdt_node_offset_by_compatible(blob, node, compat);
+}
+
+int fdtdec_path_offset(const void *blob, const char *path)
+{
+	const char *alias;
+	int offset;
+
+	if (fdtdec_index_path_offset(blob, path, &offset))
+		return offset;
+
+	/* An alias for a full path, which the index can then find */
+	if (*path != '/' && !strchr(path, '/')) {
+		alias = fdt_get_alias(blob, path);
+		if (alias && fdtdec_index_path_offset(blob, alias, &offset))
+			return offset;
+	}
+
+	return fdt_path_offset(blob, path);
+}
+
 enum fdt_compat_id fdtdec_lookup(const void *blob, int node)
 {
 	enum fdt_compat_id id;
 
 	/* Search our drivers */
 	for (id = COMPAT_UNKNOWN; id < COMPAT_COUNT; id++)
-		if (0 == fdt_node_check_compatible(blob, node,
+		if (0 == fdtdec_node_check_compatible(blob, node,
 				compat_names[id]))
 			return id;
 	return COMPAT_UNKNOWN;
@@ -160,7 +200,7 @@ enum fdt_compat_id fdtdec_lookup(const void *blob, int node)
 int fdtdec_next_compatible(const void *blob, int node,
 		enum fdt_compat_id id)
 {
-	return fdt_node_offset_by_compatible(blob, node, compat_names[id]);
+	return fdtdec_node_offset_by_compatible(blob, node, compat_names[id]);
 }
 
 int fdtdec_next_compatible_subnode(const void *blob, int node,
@@ -171,7 +211,7 @@ int fdtdec_next_compatible_subnode(const void *blob, int node,
 	} while (*depthp > 1);
 
 	/* If this is a direct subnode, and compatible, return it */
-	if (*depthp == 1 && 0 == fdt_node_check_compatible(
+	if (*depthp == 1 && 0 == fdtdec_node_check_compatible(
 						blob, node, compat_names[id]))
 		return node;
 
@@ -188,10 +228,10 @@ int fdtdec_next_alias(const void *blob, const char *name,
 	/* snprintf() is not available */
 	assert(strlen(name) < MAX_STR_LEN);
 	sprintf(str, "%.*s%d", MAX_STR_LEN, name, *upto);
-	node = fdt_path_offset(blob, str);
+	node = fdtdec_path_offset(blob, str);
 	if (node < 0)
 		return node;
-	err = fdt_node_check_compatible(blob, node, compat_names[id]);
+	err = fdtdec_node_check_compatible(blob, node, compat_names[id]);
 	if (err < 0)
 		return err;
 	if (err)
@@ -221,7 +261,7 @@ int fdtdec_add_aliases_for_id(const void *blob, const char *name,
 	int i, j;
 
 	/* find the alias node if present */
-	alias_node = fdt_path_offset(blob, "/aliases");
+	alias_node = fdtdec_path_offset(blob, "/aliases");
 
 	/*
 	 * start with nothing, and we can assume that the root node can't
@@ -252,7 +292,7 @@ int fdtdec_add_aliases_for_id(const void *blob, const char *name,
 		prop = fdt_get_property_by_offset(blob, offset, NULL);
 		path = fdt_string(blob, fdt32_to_cpu(prop->nameoff));
 		if (prop->len && 0 == strncmp(path, name, name_len))
-			node = fdt_path_offset(blob, prop->data);
+			node = fdtdec_path_offset(blob, prop->data);
 		if (node <= 0)
 			continue;
 
@@ -335,7 +375,7 @@ int fdtdec_get_alias_seq(const void *blob, const char *base, int offset,
 	find_name = fdt_get_name(blob, offset, &find_namelen);
 	debug("Looking for '%s' at %d, name %s\n", base, offset, find_name);
 
-	aliases = fdt_path_offset(blob, "/aliases");
+	aliases = fdtdec_path_offset(blob, "/aliases");
 	for (prop_offset = fdt_first_property_offset(blob, aliases);
 	     prop_offset > 0;
 	     prop_offset = fdt_next_property_offset(blob, prop_offset)) {
@@ -375,11 +415,11 @@ int fdtdec_get_alias_node(const void *blob, const char *name)
 
 	if (!blob)
 		return -FDT_ERR_NOTFOUND;
-	alias_node = fdt_path_offset(blob, "/aliases");
+	alias_node = fdtdec_path_offset(blob, "/aliases");
 	prop = fdt_getprop(blob, alias_node, name, &len);
 	if (!prop)
 		return -FDT_ERR_NOTFOUND;
-	return fdt_path_offset(blob, prop);
+	return fdtdec_path_offset(blob, prop);
 }
 
 int fdtdec_get_chosen_node(const void *blob, const char *name)
@@ -390,11 +430,11 @@ int fdtdec_get_chosen_node(const void *blob, const char *name)
 
 	if (!blob)
 		return -FDT_ERR_NOTFOUND;
-	chosen_node = fdt_path_offset(blob, "/chosen");
+	chosen_node = fdtdec_path_offset(blob, "/chosen");
 	prop = fdt_getprop(blob, chosen_node, name, &len);
 	if (!prop)
 		return -FDT_ERR_NOTFOUND;
-	return fdt_path_offset(blob, prop);
+	return fdtdec_path_offset(blob, prop);
 }
 
 int fdtdec_check_fdt(void)
@@ -436,6 +476,9 @@ int fdtdec_lookup_phandle(const void *blob, int node, const char *prop_name)
 	if (!phandle)
 		return -FDT_ERR_NOTFOUND;
 
+	if (fdtdec_index_offset_by_phandle(blob, fdt32_to_cpu(*phandle),
+					   &lookup))
+		return lookup;
 	lookup = fdt_node_offset_by_phandle(blob, fdt32_to_cpu(*phandle));
 	return lookup;
 }
@@ -630,7 +673,7 @@ int fdtdec_get_config_int(const void *blob, const char *prop_name,
 	int config_node;
 
 	debug("%s: %s\n", __func__, prop_name);
-	config_node = fdt_path_offset(blob, "/config");
+	config_node = fdtdec_path_offset(blob, "/config");
 	if (config_node < 0)
 		return default_val;
 	return fdtdec_get_int(blob, config_node, prop_name, default_val);
@@ -642,7 +685,7 @@ int fdtdec_get_config_bool(const void *blob, const char *prop_name)
 	const void *prop;
 
 	debug("%s: %s\n", __func__, prop_name);
-	config_node = fdt_path_offset(blob, "/config");
+	config_node = fdtdec_path_offset(blob, "/config");
 	if (config_node < 0)
 		return 0;
 	prop = fdt_get_property(blob, config_node, prop_name, NULL);
@@ -657,7 +700,7 @@ char *fdtdec_get_config_string(const void *blob, const char *prop_name)
 	int len;
 
 	debug("%s: %s\n", __func__, prop_name);
-	nodeoffset = fdt_path_offset(blob, "/config");
+	nodeoffset = fdtdec_path_offset(blob, "/config");
 	if (nodeoffset < 0)
 		return NULL;
 
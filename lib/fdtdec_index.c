@@ -0,0 +1,390 @@
+/*
+ * Index of the control device tree, so that looking nodes up by phandle,
+ * compatible string or path does not walk the flat tree every time.
+ *
+ * The index is built in one pass over the tree and lives in the malloc()
+ * area (the early one before relocation). It only holds node offsets and
+ * pointers into the blob, so it is only valid for the blob it was built
+ * from, and only as long as that blob is not changed. Every lookup falls
+ * back to libfdt when there is no index or it cannot answer.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <fdtdec.h>
+#include <libfdt.h>
+#include <malloc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define FDT_INDEX_MAX_DEPTH	32
+
+/* One string of the compatible property of a node */
+struct fdt_index_compat {
+	const char *str;
+	uint32_t hash;
+	int node;		/* index of the node */
+	int next;		/* next entry with this string, or -1 */
+};
+
+struct fdt_index {
+	const void *blob;
+	int node_count;
+	int *offset;		/* node offsets, in tree order */
+	int *parent;		/* parent node index, -1 for the root */
+	uint32_t *path_hash;	/* hash of the full path of each node */
+	int *compat_first;	/* first compatible entry of each node */
+	struct fdt_index_compat *compat;
+	int *path_tab;		/* node index by path hash */
+	uint32_t path_mask;
+	int *compat_tab;	/* first compatible entry by string hash */
+	uint32_t compat_mask;
+	int *phandle;		/* node index by phandle, NULL if sparse */
+	uint32_t max_phandle;
+};
+
+/* FNV-1a */
+static uint32_t fdt_index_hash(uint32_t hash, const char *s, int len)
+{
+	while (len--) {
+		hash ^= (uint8_t)*s++;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+#define FDT_INDEX_HASH_INIT	2166136261u
+
+static uint32_t fdt_index_tab_size(int count)
+{
+	uint32_t size = 16;
+
+	while (size < count * 2)
+		size <<= 1;
+
+	return size;
+}
+
+static struct fdt_index *fdt_index_get(const void *blob)
+{
+	struct fdt_index *idx = gd->fdt_index;
+
+	if (!idx || idx->blob != blob)
+		return NULL;
+
+	return idx;
+}
+
+/* Find the index of the node at @offset, -1 if none */
+static int fdt_index_node(const struct fdt_index *idx, int offset)
+{
+	int lo = 0, hi = idx->node_count - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (idx->offset[mid] == offset)
+			return mid;
+		if (idx->offset[mid] < offset)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return -1;
+}
+
+static void fdt_index_add_compat(struct fdt_index *idx, int entry)
+{
+	struct fdt_index_compat *ent = &idx->compat[entry];
+	uint32_t slot = ent->hash & idx->compat_mask;
+	int i;
+
+	for (;; slot = (slot + 1) & idx->compat_mask) {
+		i = idx->compat_tab[slot];
+		if (i < 0) {
+			idx->compat_tab[slot] = entry;
+			return;
+		}
+		if (idx->compat[i].hash == ent->hash &&
+		    !strcmp(idx->compat[i].str, ent->str))
+			break;
+	}
+
+	/* Keep each string's nodes in tree order */
+	while (idx->compat[i].next >= 0)
+		i = idx->compat[i].next;
+	idx->compat[i].next = entry;
+}
+
+static void fdt_index_add_path(struct fdt_index *idx, int node)
+{
+	uint32_t slot = idx->path_hash[node] & idx->path_mask;
+
+	while (idx->path_tab[slot] >= 0)
+		slot = (slot + 1) & idx->path_mask;
+	idx->path_tab[slot] = node;
+}
+
+static int fdt_index_fill(struct fdt_index *idx)
+{
+	const void *blob = idx->blob;
+	int stack[FDT_INDEX_MAX_DEPTH];
+	int offset, depth = 0, node = 0, entry = 0;
+	const char *name, *str;
+	uint32_t phandle, hash;
+	int len, slen;
+
+	for (offset = 0; offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(blob, offset, &depth), node++) {
+		if (depth >= FDT_INDEX_MAX_DEPTH)
+			return -E2BIG;
+		stack[depth] = node;
+		idx->offset[node] = offset;
+		idx->parent[node] = depth ? stack[depth - 1] : -1;
+
+		if (!depth) {
+			idx->path_hash[node] = fdt_index_hash(
+					FDT_INDEX_HASH_INIT, "/", 1);
+		} else {
+			hash = depth > 1 ? idx->path_hash[stack[depth - 1]] :
+				FDT_INDEX_HASH_INIT;
+			name = fdt_get_name(blob, offset, &len);
+			hash = fdt_index_hash(hash, "/", 1);
+			idx->path_hash[node] = fdt_index_hash(hash, name, len);
+			fdt_index_add_path(idx, node);
+		}
+
+		idx->compat_first[node] = entry;
+		str = fdt_getprop(blob, offset, "compatible", &len);
+		while (str && len > 0) {
+			slen = strnlen(str, len);
+			idx->compat[entry].str = str;
+			idx->compat[entry].hash = fdt_index_hash(
+					FDT_INDEX_HASH_INIT, str, slen);
+			idx->compat[entry].node = node;
+			idx->compat[entry].next = -1;
+			fdt_index_add_compat(idx, entry++);
+			str += slen + 1;
+			len -= slen + 1;
+		}
+
+		phandle = fdt_get_phandle(blob, offset);
+		if (idx->phandle && phandle && phandle != -1)
+			idx->phandle[phandle] = node;
+	}
+	idx->compat_first[node] = entry;
+
+	return 0;
+}
+
+int fdtdec_index_build(void)
+{
+	const void *blob = gd->fdt_blob;
+	struct fdt_index *idx;
+	int nodes = 0, compats = 0;
+	uint32_t max_phandle = 0, phandle;
+	int offset, depth = 0, len, slen;
+	ulong path_size, compat_size, phandle_size;
+	const char *str;
+	void *buf;
+	int ret;
+
+	gd->fdt_index = NULL;
+	if (!blob)
+		return -ENOENT;
+
+	for (offset = 0; offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(blob, offset, &depth)) {
+		nodes++;
+		str = fdt_getprop(blob, offset, "compatible", &len);
+		while (str && len > 0) {
+			compats++;
+			slen = strnlen(str, len);
+			str += slen + 1;
+			len -= slen + 1;
+		}
+		phandle = fdt_get_phandle(blob, offset);
+		if (phandle != -1 && phandle > max_phandle)
+			max_phandle = phandle;
+	}
+
+	path_size = fdt_index_tab_size(nodes);
+	compat_size = fdt_index_tab_size(compats);
+	/* dtc numbers phandles from 1, so a table is usually dense */
+	phandle_size = max_phandle <= nodes * 2 ? max_phandle + 1 : 0;
+
+	buf = malloc(sizeof(*idx) +
+		     nodes * (3 * sizeof(int) + sizeof(uint32_t)) +
+		     sizeof(int) +
+		     compats * sizeof(struct fdt_index_compat) +
+		     (path_size + compat_size + phandle_size) * sizeof(int));
+	if (!buf) {
+		debug("%s: no memory for %d nodes\n", __func__, nodes);
+		return -ENOMEM;
+	}
+
+	idx = buf;
+	memset(idx, '\0', sizeof(*idx));
+	idx->blob = blob;
+	idx->node_count = nodes;
+	idx->compat = (struct fdt_index_compat *)(idx + 1);
+	idx->offset = (int *)(idx->compat + compats);
+	idx->parent = idx->offset + nodes;
+	idx->compat_first = idx->parent + nodes;
+	idx->path_tab = idx->compat_first + nodes + 1;
+	idx->path_mask = path_size - 1;
+	idx->compat_tab = idx->path_tab + path_size;
+	idx->compat_mask = compat_size - 1;
+	idx->path_hash = (uint32_t *)(idx->compat_tab + compat_size);
+	if (phandle_size) {
+		idx->phandle = (int *)(idx->path_hash + nodes);
+		idx->max_phandle = max_phandle;
+		memset(idx->phandle, 0xff, phandle_size * sizeof(int));
+	}
+	memset(idx->path_tab, 0xff, path_size * sizeof(int));
+	memset(idx->compat_tab, 0xff, compat_size * sizeof(int));
+
+	ret = fdt_index_fill(idx);
+	if (ret) {
+		debug("%s: cannot index the tree: %d\n", __func__, ret);
+		free(buf);
+		return ret;
+	}
+	gd->fdt_index = idx;
+	debug("%s: %d nodes, %d compatible strings\n", __func__, nodes,
+	      compats);
+
+	return 0;
+}
+
+bool fdtdec_index_check_compatible(const void *blob, int offset,
+				   const char *compat, int *retp)
+{
+	struct fdt_index *idx = fdt_index_get(blob);
+	int node, i;
+
+	if (!idx || !*compat)
+		return false;
+	node = fdt_index_node(idx, offset);
+	/* libfdt tells a missing property from an empty one */
+	if (node < 0 || idx->compat_first[node] == idx->compat_first[node + 1])
+		return false;
+
+	*retp = 1;
+	for (i = idx->compat_first[node]; i < idx->compat_first[node + 1]; i++) {
+		if (!strcmp(idx->compat[i].str, compat)) {
+			*retp = 0;
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool fdtdec_index_offset_by_compatible(const void *blob, int startoffset,
+				       const char *compat, int *offsetp)
+{
+	struct fdt_index *idx = fdt_index_get(blob);
+	uint32_t hash, slot;
+	int i;
+
+	if (!idx || !*compat)
+		return false;
+
+	hash = fdt_index_hash(FDT_INDEX_HASH_INIT, compat, strlen(compat));
+	for (slot = hash & idx->compat_mask; ;
+	     slot = (slot + 1) & idx->compat_mask) {
+		i = idx->compat_tab[slot];
+		if (i < 0) {
+			*offsetp = -FDT_ERR_NOTFOUND;
+			return true;
+		}
+		if (idx->compat[i].hash == hash &&
+		    !strcmp(idx->compat[i].str, compat))
+			break;
+	}
+
+	for (; i >= 0; i = idx->compat[i].next) {
+		if (idx->offset[idx->compat[i].node] > startoffset) {
+			*offsetp = idx->offset[idx->compat[i].node];
+			return true;
+		}
+	}
+	*offsetp = -FDT_ERR_NOTFOUND;
+
+	return true;
+}
+
+bool fdtdec_index_offset_by_phandle(const void *blob, uint32_t phandle,
+				    int *offsetp)
+{
+	struct fdt_index *idx = fdt_index_get(blob);
+
+	if (!idx || !idx->phandle)
+		return false;
+
+	if (!phandle || phandle == -1)
+		*offsetp = -FDT_ERR_BADPHANDLE;
+	else if (phandle > idx->max_phandle || idx->phandle[phandle] < 0)
+		*offsetp = -FDT_ERR_NOTFOUND;
+	else
+		*offsetp = idx->offset[idx->phandle[phandle]];
+
+	return true;
+}
+
+/* Check that @node has the path @path, going up through its parents */
+static bool fdt_index_path_is(const struct fdt_index *idx, int node,
+			      const char *path, int len)
+{
+	const char *name;
+	int nlen;
+
+	for (; idx->parent[node] >= 0; node = idx->parent[node]) {
+		name = fdt_get_name(idx->blob, idx->offset[node], &nlen);
+		if (!name || len < nlen + 1 || path[len - nlen - 1] != '/' ||
+		    memcmp(path + len - nlen, name, nlen))
+			return false;
+		len -= nlen + 1;
+	}
+
+	return !len;
+}
+
+bool fdtdec_index_path_offset(const void *blob, const char *path,
+			      int *offsetp)
+{
+	struct fdt_index *idx = fdt_index_get(blob);
+	uint32_t hash, slot;
+	int len, node;
+
+	/* Leave aliases and anything unusual to libfdt */
+	if (!idx || *path != '/')
+		return false;
+
+	len = strlen(path);
+	while (len > 1 && path[len - 1] == '/')
+		len--;
+	if (len == 1) {
+		*offsetp = 0;
+		return true;
+	}
+
+	hash = fdt_index_hash(FDT_INDEX_HASH_INIT, path, len);
+	for (slot = hash & idx->path_mask; ;
+	     slot = (slot + 1) & idx->path_mask) {
+		node = idx->path_tab[slot];
+		if (node < 0)
+			break;
+		if (idx->path_hash[node] == hash &&
+		    fdt_index_path_is(idx, node, path, len)) {
+			*offsetp = idx->offset[node];
+			return true;
+		}
+	}
+
+	/* libfdt also matches a name without its unit address */
+	return false;
+}
@@ -37,28 +37,55 @@ void gzfree(void *x, void *addr, unsigned nb)
 	free (addr);
 }
 
-int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+/*
+ * Return the length of the gzip header at src, 0 if the first len bytes
+ * do not hold all of it, or -1 if it is not a header we can handle
+ */
+int gzip_parse_header(const unsigned char *src, unsigned long len)
 {
 	int i, flags;
 
+	if (len < 10)
+		return 0;
+
 	/* skip header */
 	i = 10;
 	flags = src[3];
-	if (src[2] != DEFLATED || (flags & RESERVED) != 0) {
-		puts ("Error: Bad gzipped data\n");
-		return (-1);
-	}
-	if ((flags & EXTRA_FIELD) != 0)
+	if (src[2] != DEFLATED || (flags & RESERVED) != 0)
+		return -1;
+	if ((flags & EXTRA_FIELD) != 0) {
+		if (len < 12)
+			return 0;
 		i = 12 + src[10] + (src[11] << 8);
+	}
 	if ((flags & ORIG_NAME) != 0)
-		while (src[i++] != 0)
-			;
+		do {
+			if (i >= len)
+				return 0;
+		} while (src[i++] != 0);
 	if ((flags & COMMENT) != 0)
-		while (src[i++] != 0)
-			;
+		do {
+			if (i >= len)
+				return 0;
+		} while (src[i++] != 0);
 	if ((flags & HEAD_CRC) != 0)
 		i += 2;
-	if (i >= *lenp) {
+	if (i >= len)
+		return 0;
+
+	return i;
+}
+
+int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+{
+	int i;
+
+	i = gzip_parse_header(src, *lenp);
+	if (i < 0) {
+		puts ("Error: Bad gzipped data\n");
+		return (-1);
+	}
+	if (i == 0) {
 		puts ("Error: gunzip out of data in header\n");
 		return (-1);
 	}
@@ -66,6 +93,74 @@ int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
 	return zunzip(dst, dstlen, src, lenp, 1, i);
 }
 
+struct gunzip_stream {
+	z_stream s;
+	const unsigned char *src;
+	int started;
+};
+
+/*
+ * Start decompressing gzip data at src, which is still being loaded,
+ * into dst. Call gunzip_stream_feed() whenever more of it is in memory.
+ */
+struct gunzip_stream *gunzip_stream_start(void *dst, int dstlen,
+					  const unsigned char *src)
+{
+	struct gunzip_stream *gs;
+
+	gs = malloc(sizeof(*gs));
+	if (!gs)
+		return NULL;
+
+	gs->s.zalloc = gzalloc;
+	gs->s.zfree = gzfree;
+	if (inflateInit2(&gs->s, -MAX_WBITS) != Z_OK) {
+		free(gs);
+		return NULL;
+	}
+	gs->s.next_out = dst;
+	gs->s.avail_out = dstlen;
+	gs->src = src;
+	gs->started = 0;
+
+	return gs;
+}
+
+/*
+ * Decompress what can be decompressed from the first avail bytes of the
+ * source. Returns 1 at the end of the stream, 0 if more data is needed
+ * or -1 on error. *outp is set to the end of the output so far.
+ */
+int gunzip_stream_feed(struct gunzip_stream *gs, unsigned long avail,
+		       unsigned char **outp)
+{
+	int r;
+
+	if (!gs->started) {
+		r = gzip_parse_header(gs->src, avail);
+		if (r <= 0)
+			return r;
+		gs->s.next_in = (unsigned char *)gs->src + r;
+		gs->started = 1;
+	}
+
+	gs->s.avail_in = gs->src + avail - gs->s.next_in;
+	r = inflate(&gs->s, Z_NO_FLUSH);
+	*outp = gs->s.next_out;
+	if (r == Z_STREAM_END)
+		return 1;
+	if (r == Z_OK || (r == Z_BUF_ERROR && gs->s.avail_out))
+		return 0;
+
+	return -1;
+}
+
+void gunzip_stream_end(struct gunzip_stream *gs)
+{
+	inflateEnd(&gs->s);
+	free(gs);
+}
+
 /*
  * Uncompress blocks compressed with zlib without headers
  */
@@ -116,6 +116,8 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 
 	htab->size = nel;
 	htab->filled = 0;
+	htab->deleted = 0;
+	htab->sorted = NULL;
 
 	/* allocate memory and zero out */
 	htab->table = (_ENTRY *) calloc(htab->size + 1, sizeof(_ENTRY));
@@ -156,11 +158,91 @@ void hdestroy_r(struct hsearch_data *htab)
 		}
 	}
 	free(htab->table);
+	free(htab->sorted);
+	htab->sorted = NULL;
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
 }
 
+/*
+ * Hash a key (FNV-1a). The first hash function below used to shift each
+ * character in by 4 bits, so that only the first 8 characters counted,
+ * and names like "script_0001" ... "script_9999" all collided.
+ */
+static unsigned int hkey(const char *key)
+{
+	unsigned int hval = 2166136261u;
+
+	while (*key) {
+		hval ^= (unsigned char)*key++;
+		hval *= 16777619;
+	}
+
+	return hval;
+}
+
+/* First hash function: simply take the modulus but prevent zero */
+static unsigned int hfirst(unsigned int hval, unsigned int size)
+{
+	hval %= size;
+
+	return hval ? hval : 1;
+}
+
+/* Second hash function, as suggested in [Knuth] */
+static unsigned int hnext(unsigned int idx, unsigned int hval,
+			  unsigned int size)
+{
+	unsigned int hval2 = 1 + hval % (size - 2);
+
+	/* Because SIZE is prime this steps through all available indices */
+	return idx <= hval2 ? size + idx - hval2 : idx - hval2;
+}
+
+/* The sorted list of entries is only kept while no keys are added or removed */
+static void hunsort(struct hsearch_data *htab)
+{
+	free(htab->sorted);
+	htab->sorted = NULL;
+}
+
+/*
+ * Move all entries to a new table with room for NEL elements, which also
+ * gets rid of the slots left behind by deleted entries. The entries move,
+ * so this must not happen while anyone may be holding on to an ENTRY.
+ */
+static int hresize_r(size_t nel, struct hsearch_data *htab)
+{
+	struct hsearch_data new = { .change_ok = htab->change_ok };
+	unsigned int i, idx, hval;
+
+	if (!hcreate_r(nel, &new))
+		return 0;
+
+	for (i = 1; i <= htab->size; ++i) {
+		if (htab->table[i].used <= 0)
+			continue;
+
+		hval = hfirst(hkey(htab->table[i].entry.key), new.size);
+		for (idx = hval; new.table[idx].used;
+		     idx = hnext(idx, hval, new.size))
+			;
+		new.table[idx] = htab->table[i];
+		new.table[idx].used = hval;
+	}
+
+	debug("hresize: %u -> %u entries, %u filled, %u deleted\n",
+	      htab->size, new.size, htab->filled, htab->deleted);
+	free(htab->table);
+	hunsort(htab);
+	htab->table = new.table;
+	htab->size = new.size;
+	htab->deleted = 0;
+
+	return 1;
+}
+
 /*
  * hsearch()
  */
@@ -230,10 +312,15 @@ static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
 	    && strcmp(item.key, htab->table[idx].entry.key) == 0) {
 		/* Overwrite existing value? */
 		if ((action == ENTER) && (item.data != NULL)) {
+			int rejected;
+
 			/* check for permission */
-			if (htab->change_ok != NULL && htab->change_ok(
+			htab->busy++;
+			rejected = htab->change_ok != NULL && htab->change_ok(
 			    &htab->table[idx].entry, item.data,
-			    env_op_overwrite, flag)) {
+			    env_op_overwrite, flag);
+			htab->busy--;
+			if (rejected) {
 				debug("change_ok() rejected setting variable "
 					"%s, skipping it!\n", item.key);
 				__set_errno(EPERM);
@@ -242,9 +329,12 @@ static inline int _compare_and_overwrite_entry(ENTRY item, ACTION action,
 			}
 
 			/* If there is a callback, call it */
-			if (htab->table[idx].entry.callback &&
+			htab->busy++;
+			rejected = htab->table[idx].entry.callback &&
 			    htab->table[idx].entry.callback(item.key,
-			    item.data, env_op_overwrite, flag)) {
+			    item.data, env_op_overwrite, flag);
+			htab->busy--;
+			if (rejected) {
 				debug("callback() rejected setting variable "
 					"%s, skipping it!\n", item.key);
 				__set_errno(EINVAL);
@@ -272,27 +362,12 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 	      struct hsearch_data *htab, int flag)
 {
 	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
 	unsigned int idx;
 	unsigned int first_deleted = 0;
+	int rejected;
 	int ret;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
-	}
-
-	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
-	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
+	hval = hfirst(hkey(item.key), htab->size);
 
 	/* The first index tried. */
 	idx = hval;
@@ -302,8 +377,6 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		 * Further action might be required according to the
 		 * action value.
 		 */
-		unsigned hval2;
-
 		if (htab->table[idx].used == -1
 		    && !first_deleted)
 			first_deleted = idx;
@@ -313,21 +386,8 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		if (ret != -1)
 			return ret;
 
-		/*
-		 * Second hash function:
-		 * as suggested in [Knuth]
-		 */
-		hval2 = 1 + hval % (htab->size - 2);
-
 		do {
-			/*
-			 * Because SIZE is prime this guarantees to
-			 * step through all available indices.
-			 */
-			if (idx <= hval2)
-				idx = htab->size + idx - hval2;
-			else
-				idx -= hval2;
+			idx = hnext(idx, hval, htab->size);
 
 			/*
 			 * If we visited all entries leave the loop
@@ -336,6 +396,10 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 			if (idx == hval)
 				break;
 
+			if (htab->table[idx].used == -1
+			    && !first_deleted)
+				first_deleted = idx;
+
 			/* If entry is found use it. */
 			ret = _compare_and_overwrite_entry(item, action, retval,
 				htab, flag, hval, idx);
@@ -347,6 +411,25 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 
 	/* An empty bucket has been found. */
 	if (action == ENTER) {
+		/*
+		 * Keep the table at most 3/4 full, counting the slots of
+		 * deleted entries, which lengthen searches as much as
+		 * live ones. Grow it once half of it holds live entries,
+		 * otherwise just clear out the deleted ones. This cannot
+		 * be done while a callback may hold on to an entry; the
+		 * table then fills up further and is resized next time.
+		 */
+		if (!htab->busy && (htab->filled + htab->deleted + 1) * 4 >
+		    htab->size * 3) {
+			size_t nel = htab->size;
+
+			if ((htab->filled + 1) * 2 > htab->size)
+				nel = htab->size * 2;
+			if (hresize_r(nel, htab))
+				return hsearch_r(item, action, retval, htab,
+						 flag);
+		}
+
 		/*
 		 * If table is full and another entry should be
 		 * entered return with error.
@@ -361,8 +444,10 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		 * Create new entry;
 		 * create copies of item.key and item.data
 		 */
-		if (first_deleted)
+		if (first_deleted) {
 			idx = first_deleted;
+			--htab->deleted;
+		}
 
 		htab->table[idx].used = hval;
 		htab->table[idx].entry.key = strdup(item.key);
@@ -375,6 +460,7 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		}
 
 		++htab->filled;
+		hunsort(htab);
 
 		/* This is a new entry, so look up a possible callback */
 		env_callback_init(&htab->table[idx].entry);
@@ -382,8 +468,11 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		env_flags_init(&htab->table[idx].entry);
 
 		/* check for permission */
-		if (htab->change_ok != NULL && htab->change_ok(
-		    &htab->table[idx].entry, item.data, env_op_create, flag)) {
+		htab->busy++;
+		rejected = htab->change_ok != NULL && htab->change_ok(
+		    &htab->table[idx].entry, item.data, env_op_create, flag);
+		htab->busy--;
+		if (rejected) {
 			debug("change_ok() rejected setting variable "
 				"%s, skipping it!\n", item.key);
 			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
@@ -393,9 +482,12 @@ int hsearch_r(ENTRY item, ACTION action, ENTRY ** retval,
 		}
 
 		/* If there is a callback, call it */
-		if (htab->table[idx].entry.callback &&
+		htab->busy++;
+		rejected = htab->table[idx].entry.callback &&
 		    htab->table[idx].entry.callback(item.key, item.data,
-		    env_op_create, flag)) {
+		    env_op_create, flag);
+		htab->busy--;
+		if (rejected) {
 			debug("callback() rejected setting variable "
 				"%s, skipping it!\n", item.key);
 			_hdelete(item.key, htab, &htab->table[idx].entry, idx);
@@ -437,11 +529,14 @@ static void _hdelete(const char *key, struct hsearch_data *htab, ENTRY *ep,
 	htab->table[idx].used = -1;
 
 	--htab->filled;
+	++htab->deleted;
+	hunsort(htab);
 }
 
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 {
 	ENTRY e, *ep;
+	int rejected;
 	int idx;
 
 	debug("hdelete: DELETE key \"%s\"\n", key);
@@ -455,8 +550,11 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 	}
 
 	/* Check for permission */
-	if (htab->change_ok != NULL &&
-	    htab->change_ok(ep, NULL, env_op_delete, flag)) {
+	htab->busy++;
+	rejected = htab->change_ok != NULL &&
+	    htab->change_ok(ep, NULL, env_op_delete, flag);
+	htab->busy--;
+	if (rejected) {
 		debug("change_ok() rejected deleting variable "
 			"%s, skipping it!\n", key);
 		__set_errno(EPERM);
@@ -464,8 +562,11 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 	}
 
 	/* If there is a callback, call it */
-	if (htab->table[idx].entry.callback &&
-	    htab->table[idx].entry.callback(key, NULL, env_op_delete, flag)) {
+	htab->busy++;
+	rejected = htab->table[idx].entry.callback &&
+	    htab->table[idx].entry.callback(key, NULL, env_op_delete, flag);
+	htab->busy--;
+	if (rejected) {
 		debug("callback() rejected deleting variable "
 			"%s, skipping it!\n", key);
 		__set_errno(EINVAL);
@@ -587,14 +688,49 @@ static int match_entry(ENTRY *ep, int flag,
 	return 0;
 }
 
+/* Whether an entry should be exported, see hexport_r() */
+static int export_entry(ENTRY *ep, int flag, int argc, char * const argv[])
+{
+	if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
+		return 0;
+
+	return argc == 0 || match_entry(ep, flag, argc, argv);
+}
+
+/*
+ * Get the entries sorted by key. The list is kept until an entry is added
+ * or deleted, so that exporting an unchanged environment again, e.g. for
+ * a further saveenv or printenv, does not sort it again.
+ */
+static ENTRY **hsort_r(struct hsearch_data *htab)
+{
+	int i, n;
+
+	if (htab->sorted)
+		return htab->sorted;
+
+	htab->sorted = malloc((htab->filled + 1) * sizeof(ENTRY *));
+	if (!htab->sorted)
+		return NULL;
+
+	for (i = 1, n = 0; i <= htab->size; ++i) {
+		if (htab->table[i].used > 0)
+			htab->sorted[n++] = &htab->table[i].entry;
+	}
+	qsort(htab->sorted, n, sizeof(ENTRY *), cmpkey);
+	htab->sorted[n] = NULL;
+
+	return htab->sorted;
+}
+
 ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 char **resp, size_t size,
 		 int argc, char * const argv[])
 {
-	ENTRY *list[htab->size];
+	ENTRY **list;
 	char *res, *p;
 	size_t totlen;
-	int i, n;
+	int i;
 
 	/* Test for correct arguments.  */
 	if ((resp == NULL) || (htab == NULL)) {
@@ -604,56 +740,41 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 
 	debug("EXPORT  table = %p, htab.size = %d, htab.filled = %d, "
 		"size = %zu\n", htab, htab->size, htab->filled, size);
+
+	list = hsort_r(htab);
+	if (!list) {
+		__set_errno(ENOMEM);
+		return (-1);
+	}
+
 	/*
 	 * Pass 1:
-	 * search used entries,
-	 * save addresses and compute total length
+	 * compute total length of the entries to export
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
-
-		if (htab->table[i].used > 0) {
-			ENTRY *ep = &htab->table[i].entry;
-			int found = match_entry(ep, flag, argc, argv);
+	for (i = 0, totlen = 0; list[i]; ++i) {
+		ENTRY *ep = list[i];
 
-			if ((argc > 0) && (found == 0))
-				continue;
-
-			if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
-				continue;
-
-			list[n++] = ep;
+		if (!export_entry(ep, flag, argc, argv))
+			continue;
 
-			totlen += strlen(ep->key) + 2;
+		totlen += strlen(ep->key) + 2;
 
-			if (sep == '\0') {
-				totlen += strlen(ep->data);
-			} else {	/* check if escapes are needed */
-				char *s = ep->data;
+		if (sep == '\0') {
+			totlen += strlen(ep->data);
+		} else {	/* check if escapes are needed */
+			char *s = ep->data;
 
-				while (*s) {
+			while (*s) {
+				++totlen;
+				/* add room for needed escape chars */
+				if ((*s == sep) || (*s == '\\'))
 					++totlen;
-					/* add room for needed escape chars */
-					if ((*s == sep) || (*s == '\\'))
-						++totlen;
-					++s;
-				}
+				++s;
 			}
-			totlen += 2;	/* for '=' and 'sep' char */
 		}
+		totlen += 2;	/* for '=' and 'sep' char */
 	}
 
-#ifdef DEBUG
-	/* Pass 1a: print unsorted list */
-	printf("Unsorted: n=%d\n", n);
-	for (i = 0; i < n; ++i) {
-		printf("\t%3d: %p ==> %-10s => %s\n",
-		       i, list[i], list[i]->key, list[i]->data);
-	}
-#endif
-
-	/* Sort list by keys */
-	qsort(list, n, sizeof(ENTRY *), cmpkey);
-
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
 		if (size < totlen + 1) {	/* provided buffer too small */
@@ -683,9 +804,12 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 	 * Pass 2:
 	 * export sorted list of result data
 	 */
-	for (i = 0, p = res; i < n; ++i) {
+	for (i = 0, p = res; list[i]; ++i) {
 		const char *s;
 
+		if (!export_entry(list[i], flag, argc, argv))
+			continue;
+
 		s = list[i]->key;
 		while (*s)
 			*p++ = *s++;
@@ -821,7 +945,8 @@ int himport_r(struct hsearch_data *htab,
 	 * (CONFIG_ENV_SIZE).  This heuristics will result in
 	 * unreasonably large numbers (and thus memory footprint) for
 	 * big flash environments (>8,000 entries for 64 KB
-	 * envrionment size), so we clip it to a reasonable value.
+	 * envrionment size), so we clip it to a reasonable value; the
+	 * table grows when it fills up anyway.
 	 * On the other hand we need to add some more entries for free
 	 * space when importing very small buffers. Both boundaries can
 	 * be overwritten in the board config file if needed.
@@ -9,165 +9,250 @@
 
 #include <common.h>
 #include <lmb.h>
+#include <malloc.h>
+#include <linux/rbtree_augmented.h>
 
 #define LMB_ALLOC_ANYWHERE	0
 
-void lmb_dump_all(struct lmb *lmb)
+#define lmb_entry(rb)	rb_entry(rb, struct lmb_property, node)
+
+static void lmb_dump_region(const char *type, struct lmb_region *rgn)
 {
 #ifdef DEBUG
-	unsigned long i;
+	struct rb_node *rb;
+	struct lmb_property *p;
+	unsigned long i = 0;
+
+	debug("    %s.cnt		   = 0x%lx\n", type, rgn->cnt);
+	for (rb = rb_first(&rgn->root); rb; rb = rb_next(rb), i++) {
+		p = lmb_entry(rb);
+		debug("    %s.reg[0x%lx].base   = 0x%llx\n", type, i,
+		      (unsigned long long)p->base);
+		debug("		   .size   = 0x%llx%s%s\n",
+		      (unsigned long long)p->size, p->name ? " " : "",
+		      p->name ? p->name : "");
+	}
+#endif /* DEBUG */
+}
 
+void lmb_dump_all(struct lmb *lmb)
+{
 	debug("lmb_dump_all:\n");
-	debug("    memory.cnt		   = 0x%lx\n", lmb->memory.cnt);
-	debug("    memory.size		   = 0x%llx\n",
-	      (unsigned long long)lmb->memory.size);
-	for (i=0; i < lmb->memory.cnt ;i++) {
-		debug("    memory.reg[0x%lx].base   = 0x%llx\n", i,
-			(long long unsigned)lmb->memory.region[i].base);
-		debug("		   .size   = 0x%llx\n",
-			(long long unsigned)lmb->memory.region[i].size);
-	}
+	lmb_dump_region("memory", &lmb->memory);
+	debug("\n");
+	lmb_dump_region("reserved", &lmb->reserved);
+}
 
-	debug("\n    reserved.cnt	   = 0x%lx\n",
-		lmb->reserved.cnt);
-	debug("    reserved.size	   = 0x%llx\n",
-		(long long unsigned)lmb->reserved.size);
-	for (i=0; i < lmb->reserved.cnt ;i++) {
-		debug("    reserved.reg[0x%lx].base = 0x%llx\n", i,
-			(long long unsigned)lmb->reserved.region[i].base);
-		debug("		     .size = 0x%llx\n",
-			(long long unsigned)lmb->reserved.region[i].size);
-	}
-#endif /* DEBUG */
+/* Last address in a region, which unlike the end does not overflow */
+static phys_addr_t lmb_last(const struct lmb_property *p)
+{
+	return p->base + p->size - 1;
 }
 
-static long lmb_addrs_overlap(phys_addr_t base1,
-		phys_size_t size1, phys_addr_t base2, phys_size_t size2)
+static phys_addr_t lmb_compute_subtree_last(struct lmb_property *p)
 {
-	return ((base1 < (base2+size2)) && (base2 < (base1+size1)));
+	phys_addr_t max = lmb_last(p);
+
+	if (p->node.rb_left && lmb_entry(p->node.rb_left)->subtree_last > max)
+		max = lmb_entry(p->node.rb_left)->subtree_last;
+	if (p->node.rb_right && lmb_entry(p->node.rb_right)->subtree_last > max)
+		max = lmb_entry(p->node.rb_right)->subtree_last;
+
+	return max;
 }
 
-static long lmb_addrs_adjacent(phys_addr_t base1, phys_size_t size1,
-		phys_addr_t base2, phys_size_t size2)
+RB_DECLARE_CALLBACKS(static, lmb_augment, struct lmb_property, node,
+		     phys_addr_t, subtree_last, lmb_compute_subtree_last)
+
+static void lmb_insert(struct lmb_region *rgn, struct lmb_property *new)
 {
-	if (base2 == base1 + size1)
-		return 1;
-	else if (base1 == base2 + size2)
-		return -1;
+	struct rb_node **link = &rgn->root.rb_node, *parent = NULL;
+	phys_addr_t last = lmb_last(new);
+	struct lmb_property *p;
+
+	while (*link) {
+		parent = *link;
+		p = lmb_entry(parent);
+		if (p->subtree_last < last)
+			p->subtree_last = last;
+		if (new->base < p->base)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
 
-	return 0;
+	new->subtree_last = last;
+	rb_link_node(&new->node, parent, link);
+	rb_insert_augmented(&new->node, &rgn->root, &lmb_augment);
+	rgn->cnt++;
 }
 
-static long lmb_regions_adjacent(struct lmb_region *rgn,
-		unsigned long r1, unsigned long r2)
+static void lmb_remove(struct lmb_region *rgn, struct lmb_property *p)
 {
-	phys_addr_t base1 = rgn->region[r1].base;
-	phys_size_t size1 = rgn->region[r1].size;
-	phys_addr_t base2 = rgn->region[r2].base;
-	phys_size_t size2 = rgn->region[r2].size;
+	rb_erase_augmented(&p->node, &rgn->root, &lmb_augment);
+	rgn->cnt--;
+}
 
-	return lmb_addrs_adjacent(base1, size1, base2, size2);
+/* Call after changing the size, but not the base, of a region */
+static void lmb_resized(struct lmb_property *p)
+{
+	lmb_augment_propagate(&p->node, NULL);
 }
 
-static void lmb_remove_region(struct lmb_region *rgn, unsigned long r)
+/* Find the lowest region in a subtree overlapping start..last */
+static struct lmb_property *lmb_subtree_search(struct lmb_property *p,
+					       phys_addr_t start,
+					       phys_addr_t last)
 {
-	unsigned long i;
+	for (;;) {
+		if (p->node.rb_left) {
+			struct lmb_property *left = lmb_entry(p->node.rb_left);
+
+			if (start <= left->subtree_last) {
+				p = left;
+				continue;
+			}
+		}
+		if (p->base <= last) {
+			if (start <= lmb_last(p))
+				return p;
+			if (p->node.rb_right) {
+				p = lmb_entry(p->node.rb_right);
+				if (start <= p->subtree_last)
+					continue;
+			}
+		}
 
-	for (i = r; i < rgn->cnt - 1; i++) {
-		rgn->region[i].base = rgn->region[i + 1].base;
-		rgn->region[i].size = rgn->region[i + 1].size;
+		return NULL;
 	}
-	rgn->cnt--;
 }
 
-/* Assumption: base addr of region 1 < base addr of region 2 */
-static void lmb_coalesce_regions(struct lmb_region *rgn,
-		unsigned long r1, unsigned long r2)
+static struct lmb_property *lmb_first_overlap(struct lmb_region *rgn,
+					      phys_addr_t start,
+					      phys_addr_t last)
 {
-	rgn->region[r1].size += rgn->region[r2].size;
-	lmb_remove_region(rgn, r2);
+	struct lmb_property *p;
+
+	if (!rgn->root.rb_node)
+		return NULL;
+	p = lmb_entry(rgn->root.rb_node);
+	if (p->subtree_last < start)
+		return NULL;
+
+	return lmb_subtree_search(p, start, last);
 }
 
-void lmb_init(struct lmb *lmb)
+static struct lmb_property *lmb_next_overlap(struct lmb_property *p,
+					     phys_addr_t start,
+					     phys_addr_t last)
 {
-	/* Create a dummy zero size LMB which will get coalesced away later.
-	 * This simplifies the lmb_add() code below...
-	 */
-	lmb->memory.region[0].base = 0;
-	lmb->memory.region[0].size = 0;
-	lmb->memory.cnt = 1;
-	lmb->memory.size = 0;
-
-	/* Ditto. */
-	lmb->reserved.region[0].base = 0;
-	lmb->reserved.region[0].size = 0;
-	lmb->reserved.cnt = 1;
-	lmb->reserved.size = 0;
+	struct rb_node *rb = p->node.rb_right, *prev;
+
+	for (;;) {
+		if (rb && start <= lmb_entry(rb)->subtree_last)
+			return lmb_subtree_search(lmb_entry(rb), start, last);
+
+		/* Move up the tree until we come from a node's left child */
+		do {
+			rb = rb_parent(&p->node);
+			if (!rb)
+				return NULL;
+			prev = &p->node;
+			p = lmb_entry(rb);
+			rb = p->node.rb_right;
+		} while (prev == rb);
+
+		if (last < p->base)
+			return NULL;
+		if (start <= lmb_last(p))
+			return p;
+	}
 }
 
-/* This routine called with relocation disabled. */
-static long lmb_add_region(struct lmb_region *rgn, phys_addr_t base, phys_size_t size)
+static void lmb_free_all(struct lmb_region *rgn)
 {
-	unsigned long coalesced = 0;
-	long adjacent, i;
+	struct rb_node *rb;
 
-	if ((rgn->cnt == 1) && (rgn->region[0].size == 0)) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
-		return 0;
+	while ((rb = rb_first(&rgn->root))) {
+		rb_erase(rb, &rgn->root);
+		free(lmb_entry(rb));
 	}
+	rgn->cnt = 0;
+	rgn->size = 0;
+}
 
-	/* First try and coalesce this LMB with another. */
-	for (i=0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
+void lmb_init(struct lmb *lmb)
+{
+	lmb_free_all(&lmb->memory);
+	lmb_free_all(&lmb->reserved);
+}
 
-		if ((rgnbase == base) && (rgnsize == size))
-			/* Already have this region, so we're done */
-			return 0;
+static int lmb_names_match(const char *name1, const char *name2)
+{
+	if (!name1 || !name2)
+		return name1 == name2;
 
-		adjacent = lmb_addrs_adjacent(base,size,rgnbase,rgnsize);
-		if ( adjacent > 0 ) {
-			rgn->region[i].base -= size;
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		}
-		else if ( adjacent < 0 ) {
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		}
-	}
+	return !strcmp(name1, name2);
+}
 
-	if ((i < rgn->cnt-1) && lmb_regions_adjacent(rgn, i, i+1) ) {
-		lmb_coalesce_regions(rgn, i, i+1);
-		coalesced++;
-	}
+/* This routine called with relocation disabled. */
+static long lmb_add_region(struct lmb_region *rgn, phys_addr_t base,
+			   phys_size_t size, const char *name)
+{
+	struct lmb_property *p, *prev = NULL, *next = NULL;
+	phys_addr_t last = base + size - 1;
+	phys_addr_t start, end;
 
-	if (coalesced)
-		return coalesced;
-	if (rgn->cnt >= MAX_LMB_REGIONS)
-		return -1;
+	if (!size)
+		return 0;
 
-	/* Couldn't coalesce the LMB, so add it to the sorted table. */
-	for (i = rgn->cnt-1; i >= 0; i--) {
-		if (base < rgn->region[i].base) {
-			rgn->region[i+1].base = rgn->region[i].base;
-			rgn->region[i+1].size = rgn->region[i].size;
-		} else {
-			rgn->region[i+1].base = base;
-			rgn->region[i+1].size = size;
-			break;
+	/* Look at the regions overlapping this one or next to it */
+	start = base ? base - 1 : base;
+	end = last + 1 ? last + 1 : last;
+	for (p = lmb_first_overlap(rgn, start, end); p;
+	     p = lmb_next_overlap(p, start, end)) {
+		if ((p->base == base) && (p->size == size)) {
+			/* Already have this region, so we're done */
+			if (!p->name)
+				p->name = name;
+			return 0;
 		}
+
+		/* Only coalesce regions with the same owner */
+		if (!lmb_names_match(p->name, name))
+			continue;
+		if (base && lmb_last(p) == base - 1)
+			prev = p;
+		else if (last + 1 && p->base == last + 1)
+			next = p;
 	}
 
-	if (base < rgn->region[0].base) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
+	if (prev && next) {
+		prev->size += size + next->size;
+		lmb_remove(rgn, next);
+		free(next);
+		lmb_resized(prev);
+		return 2;
+	} else if (prev) {
+		prev->size += size;
+		lmb_resized(prev);
+		return 1;
+	} else if (next) {
+		lmb_remove(rgn, next);
+		next->base = base;
+		next->size += size;
+		lmb_insert(rgn, next);
+		return 1;
 	}
 
-	rgn->cnt++;
+	/* Couldn't coalesce the LMB, so add it to the tree. */
+	p = malloc(sizeof(*p));
+	if (!p)
+		return -1;
+	p->base = base;
+	p->size = size;
+	p->name = name;
+	lmb_insert(rgn, p);
 
 	return 0;
 }
@@ -177,47 +262,51 @@ long lmb_add(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 {
 	struct lmb_region *_rgn = &(lmb->memory);
 
-	return lmb_add_region(_rgn, base, size);
+	return lmb_add_region(_rgn, base, size, NULL);
 }
 
 long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 {
 	struct lmb_region *rgn = &(lmb->reserved);
-	phys_addr_t rgnbegin, rgnend;
-	phys_addr_t end = base + size;
-	int i;
+	phys_addr_t last = base + size - 1;
+	phys_addr_t rgnlast;
+	struct lmb_property *p;
 
-	rgnbegin = rgnend = 0; /* supress gcc warnings */
+	if (!size)
+		return 0;
 
 	/* Find the region where (base, size) belongs to */
-	for (i=0; i < rgn->cnt; i++) {
-		rgnbegin = rgn->region[i].base;
-		rgnend = rgnbegin + rgn->region[i].size;
-
-		if ((rgnbegin <= base) && (end <= rgnend))
+	for (p = lmb_first_overlap(rgn, base, last); p;
+	     p = lmb_next_overlap(p, base, last)) {
+		if ((p->base <= base) && (last <= lmb_last(p)))
 			break;
 	}
 
 	/* Didn't find the region */
-	if (i == rgn->cnt)
+	if (!p)
 		return -1;
+	rgnlast = lmb_last(p);
 
 	/* Check to see if we are removing entire region */
-	if ((rgnbegin == base) && (rgnend == end)) {
-		lmb_remove_region(rgn, i);
+	if ((p->base == base) && (rgnlast == last)) {
+		lmb_remove(rgn, p);
+		free(p);
 		return 0;
 	}
 
 	/* Check to see if region is matching at the front */
-	if (rgnbegin == base) {
-		rgn->region[i].base = end;
-		rgn->region[i].size -= size;
+	if (p->base == base) {
+		lmb_remove(rgn, p);
+		p->base = last + 1;
+		p->size -= size;
+		lmb_insert(rgn, p);
 		return 0;
 	}
 
 	/* Check to see if the region is matching at the end */
-	if (rgnend == end) {
-		rgn->region[i].size -= size;
+	if (rgnlast == last) {
+		p->size -= size;
+		lmb_resized(p);
 		return 0;
 	}
 
@@ -225,49 +314,46 @@ long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 	 * We need to split the entry -  adjust the current one to the
 	 * beginging of the hole and add the region after hole.
 	 */
-	rgn->region[i].size = base - rgn->region[i].base;
-	return lmb_add_region(rgn, end, rgnend - end);
+	p->size = base - p->base;
+	lmb_resized(p);
+	return lmb_add_region(rgn, last + 1, rgnlast - last, p->name);
 }
 
-long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size)
+long lmb_reserve_named(struct lmb *lmb, phys_addr_t base, phys_size_t size,
+		       const char *name)
 {
 	struct lmb_region *_rgn = &(lmb->reserved);
 
-	return lmb_add_region(_rgn, base, size);
+	return lmb_add_region(_rgn, base, size, name);
 }
 
-long lmb_overlaps_region(struct lmb_region *rgn, phys_addr_t base,
-				phys_size_t size)
+long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 {
-	unsigned long i;
-
-	for (i=0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
-		if ( lmb_addrs_overlap(base,size,rgnbase,rgnsize) ) {
-			break;
-		}
-	}
-
-	return (i < rgn->cnt) ? i : -1;
+	return lmb_reserve_named(lmb, base, size, NULL);
 }
 
-phys_addr_t lmb_alloc(struct lmb *lmb, phys_size_t size, ulong align)
+long lmb_get_reserved(struct lmb *lmb, phys_addr_t base, phys_size_t size,
+		      phys_addr_t *rbase, phys_size_t *rsize, const char **name)
 {
-	return lmb_alloc_base(lmb, size, align, LMB_ALLOC_ANYWHERE);
-}
+	struct lmb_property *p;
 
-phys_addr_t lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phys_addr_t max_addr)
-{
-	phys_addr_t alloc;
+	p = lmb_first_overlap(&lmb->reserved, base, base + size - 1);
+	if (!p)
+		return -1;
 
-	alloc = __lmb_alloc_base(lmb, size, align, max_addr);
+	if (rbase)
+		*rbase = p->base;
+	if (rsize)
+		*rsize = p->size;
+	if (name)
+		*name = p->name;
 
-	if (alloc == 0)
-		printf("ERROR: Failed to allocate 0x%lx bytes below 0x%lx.\n",
-		      (ulong)size, (ulong)max_addr);
+	return 0;
+}
 
-	return alloc;
+phys_addr_t lmb_alloc(struct lmb *lmb, phys_size_t size, ulong align)
+{
+	return lmb_alloc_base(lmb, size, align, LMB_ALLOC_ANYWHERE);
 }
 
 static phys_addr_t lmb_align_down(phys_addr_t addr, phys_size_t size)
@@ -280,15 +366,21 @@ static phys_addr_t lmb_align_up(phys_addr_t addr, ulong size)
 	return (addr + (size - 1)) & ~(size - 1);
 }
 
-phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phys_addr_t max_addr)
+static phys_addr_t lmb_alloc_region(struct lmb *lmb, phys_size_t size,
+				    ulong align, phys_addr_t max_addr,
+				    const char *name)
 {
-	long i, j;
+	struct lmb_property *mem, *res;
+	struct rb_node *rb;
 	phys_addr_t base = 0;
-	phys_addr_t res_base;
 
-	for (i = lmb->memory.cnt-1; i >= 0; i--) {
-		phys_addr_t lmbbase = lmb->memory.region[i].base;
-		phys_size_t lmbsize = lmb->memory.region[i].size;
+	for (rb = rb_last(&lmb->memory.root); rb; rb = rb_prev(rb)) {
+		phys_addr_t lmbbase;
+		phys_size_t lmbsize;
+
+		mem = lmb_entry(rb);
+		lmbbase = mem->base;
+		lmbsize = mem->size;
 
 		if (lmbsize < size)
 			continue;
@@ -304,35 +396,52 @@ phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phy
 			continue;
 
 		while (base && lmbbase <= base) {
-			j = lmb_overlaps_region(&lmb->reserved, base, size);
-			if (j < 0) {
+			res = lmb_first_overlap(&lmb->reserved, base,
+						base + size - 1);
+			if (!res) {
 				/* This area isn't reserved, take it */
 				if (lmb_add_region(&lmb->reserved, base,
-							lmb_align_up(size,
-								align)) < 0)
+						   lmb_align_up(size, align),
+						   name) < 0)
 					return 0;
 				return base;
 			}
-			res_base = lmb->reserved.region[j].base;
-			if (res_base < size)
+			if (res->base < size)
 				break;
-			base = lmb_align_down(res_base - size, align);
+			base = lmb_align_down(res->base - size, align);
 		}
 	}
 	return 0;
 }
 
-int lmb_is_reserved(struct lmb *lmb, phys_addr_t addr)
+phys_addr_t lmb_alloc_base_named(struct lmb *lmb, phys_size_t size,
+				 ulong align, phys_addr_t max_addr,
+				 const char *name)
 {
-	int i;
+	phys_addr_t alloc;
 
-	for (i = 0; i < lmb->reserved.cnt; i++) {
-		phys_addr_t upper = lmb->reserved.region[i].base +
-			lmb->reserved.region[i].size - 1;
-		if ((addr >= lmb->reserved.region[i].base) && (addr <= upper))
-			return 1;
-	}
-	return 0;
+	alloc = lmb_alloc_region(lmb, size, align, max_addr, name);
+
+	if (alloc == 0)
+		printf("ERROR: Failed to allocate 0x%lx bytes below 0x%lx.\n",
+		      (ulong)size, (ulong)max_addr);
+
+	return alloc;
+}
+
+phys_addr_t lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phys_addr_t max_addr)
+{
+	return lmb_alloc_base_named(lmb, size, align, max_addr, NULL);
+}
+
+phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phys_addr_t max_addr)
+{
+	return lmb_alloc_region(lmb, size, align, max_addr, NULL);
+}
+
+int lmb_is_reserved(struct lmb *lmb, phys_addr_t addr)
+{
+	return lmb_first_overlap(&lmb->reserved, addr, addr) != NULL;
 }
 
 __weak void board_lmb_reserve(struct lmb *lmb)
@@ -432,11 +432,63 @@ int eth_send(void *packet, int length)
 	return eth_current->send(eth_current, packet, length);
 }
 
+/* Most frames handled by one eth_rx() call on a batching driver */
+#ifndef CONFIG_ETH_RX_BURST
+#define CONFIG_ETH_RX_BURST	32
+#endif
+
+#ifdef CONFIG_API
+static void eth_save_packet(void *packet, int length);
+#endif
+
+/*
+ * Hand a burst of frames straight from the driver's buffers to
+ * NetReceive(). Stop early if a frame ends the current net operation,
+ * as the following ones belong to whatever runs next.
+ */
+static int eth_rx_burst(struct eth_device *dev)
+{
+	uchar *packet;
+	int i, length, max = CONFIG_ETH_RX_BURST;
+
+#ifdef CONFIG_API
+	/*
+	 * eth_receive() saves the frames in its ring rather than handling
+	 * them, so take no more than it has room for: the rest stay in the
+	 * driver's ring instead of being dropped.
+	 */
+	if (push_packet == eth_save_packet) {
+		max = ((int)(eth_rcv_current - eth_rcv_last) - 1 +
+		       PKTBUFSRX) % PKTBUFSRX;
+		if (max > CONFIG_ETH_RX_BURST)
+			max = CONFIG_ETH_RX_BURST;
+	}
+#endif
+
+	for (i = 0; i < max; i++) {
+		length = dev->recv_pkt(dev, &packet);
+		if (length <= 0)
+			break;
+		NetReceive(packet, length);
+		if (dev->free_pkt)
+			dev->free_pkt(dev, packet, length);
+		if (net_state != NETLOOP_CONTINUE || eth_current != dev) {
+			i++;
+			break;
+		}
+	}
+
+	return i;
+}
+
 int eth_rx(void)
 {
 	if (!eth_current)
 		return -1;
 
+	if (eth_current->recv_pkt)
+		return eth_rx_burst(eth_current);
+
 	return eth_current->recv(eth_current);
 }
 
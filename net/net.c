@@ -747,13 +747,19 @@ int NetSendUDPPacket(uchar *ether, IPaddr_t dest, int dport, int sport,
 
 #ifdef CONFIG_IP_DEFRAG
 /*
- * This function collects fragments in a single packet, according
- * to the algorithm in RFC815. It returns NULL or the pointer to
- * a complete packet, in static storage
+ * These functions collect fragments into whole packets, according
+ * to the algorithm in RFC815. Several datagrams may be in flight at
+ * once (e.g. a TFTP window of large blocks), so each one is assembled
+ * in its own slot of a small static pool.
  */
 #ifndef CONFIG_NET_MAXDEFRAG
 #define CONFIG_NET_MAXDEFRAG 16384
 #endif
+#ifndef CONFIG_NET_DEFRAG_SLOTS
+#define CONFIG_NET_DEFRAG_SLOTS 4
+#endif
+/* A datagram which has not progressed in this long is given up (ms) */
+#define DEFRAG_TIMEOUT	2000
 /*
  * MAXDEFRAG, above, is chosen in the config file and  is real data
  * so we need to add the NFS overhead, which is more than TFTP.
@@ -778,36 +784,86 @@ struct hole {
 	u16 unused;
 };
 
+/* One datagram being reassembled */
+struct defrag_slot {
+	uchar pkt_buff[IP_PKTSIZE] __aligned(PKTALIGN);
+	u16 first_hole;
+	u16 total_len;		/* 0 == slot is free */
+	ulong stamp;		/* get_timer() of the last fragment */
+};
+
+static struct defrag_slot defrag_slots[CONFIG_NET_DEFRAG_SLOTS];
+
+/*
+ * Find the slot assembling the datagram this fragment belongs to, or
+ * start a new one. A free slot is used first, then one whose datagram
+ * timed out, and failing that the one left alone for longest.
+ */
+static struct defrag_slot *defrag_find_slot(struct ip_udp_hdr *ip)
+{
+	struct defrag_slot *slot, *victim = NULL;
+	struct ip_udp_hdr *localip;
+	struct hole *payload;
+	ulong now = get_timer(0);
+
+	for (slot = defrag_slots;
+	     slot < defrag_slots + CONFIG_NET_DEFRAG_SLOTS; slot++) {
+		localip = (struct ip_udp_hdr *)slot->pkt_buff;
+		if (slot->total_len && localip->ip_id == ip->ip_id &&
+		    localip->ip_p == ip->ip_p &&
+		    NetReadIP(&localip->ip_src) == NetReadIP(&ip->ip_src)) {
+			slot->stamp = now;
+			return slot;
+		}
+		if (slot->total_len && now - slot->stamp > DEFRAG_TIMEOUT)
+			slot->total_len = 0;
+		if (!victim || (victim->total_len &&
+				(!slot->total_len ||
+				 now - slot->stamp > now - victim->stamp)))
+			victim = slot;
+	}
+
+	/* new packet, reset structs */
+	slot = victim;
+	payload = (struct hole *)(slot->pkt_buff + IP_HDR_SIZE);
+	slot->total_len = 0xffff;
+	slot->stamp = now;
+	payload[0].last_byte = ~0;
+	payload[0].next_hole = 0;
+	payload[0].prev_hole = 0;
+	slot->first_hole = 0;
+	/* any IP header will work, copy the first we received */
+	memcpy(slot->pkt_buff, ip, IP_HDR_SIZE);
+
+	return slot;
+}
+
+/*
+ * Add a fragment to its datagram. It returns NULL or the pointer to
+ * a complete packet, in static storage
+ */
 static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 {
-	static uchar pkt_buff[IP_PKTSIZE] __aligned(PKTALIGN);
-	static u16 first_hole, total_len;
+	struct defrag_slot *slot;
 	struct hole *payload, *thisfrag, *h, *newh;
-	struct ip_udp_hdr *localip = (struct ip_udp_hdr *)pkt_buff;
+	struct ip_udp_hdr *localip;
 	uchar *indata = (uchar *)ip;
 	int offset8, start, len, done = 0;
 	u16 ip_off = ntohs(ip->ip_off);
 
-	/* payload starts after IP header, this fragment is in there */
-	payload = (struct hole *)(pkt_buff + IP_HDR_SIZE);
 	offset8 =  (ip_off & IP_OFFS);
-	thisfrag = payload + offset8;
 	start = offset8 * 8;
 	len = ntohs(ip->ip_len) - IP_HDR_SIZE;
 
 	if (start + len > IP_MAXUDP) /* fragment extends too far */
 		return NULL;
 
-	if (!total_len || localip->ip_id != ip->ip_id) {
-		/* new (or different) packet, reset structs */
-		total_len = 0xffff;
-		payload[0].last_byte = ~0;
-		payload[0].next_hole = 0;
-		payload[0].prev_hole = 0;
-		first_hole = 0;
-		/* any IP header will work, copy the first we received */
-		memcpy(localip, ip, IP_HDR_SIZE);
-	}
+	slot = defrag_find_slot(ip);
+	localip = (struct ip_udp_hdr *)slot->pkt_buff;
+
+	/* payload starts after IP header, this fragment is in there */
+	payload = (struct hole *)(slot->pkt_buff + IP_HDR_SIZE);
+	thisfrag = payload + offset8;
 
 	/*
 	 * What follows is the reassembly algorithm. We use the payload
@@ -816,7 +872,7 @@ static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 	 * so it is represented as byte count, not as 8-byte blocks.
 	 */
 
-	h = payload + first_hole;
+	h = payload + slot->first_hole;
 	while (h->last_byte < start) {
 		if (!h->next_hole) {
 			/* no hole that far away */
@@ -833,7 +889,7 @@ static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 
 	if (!(ip_off & IP_FLAGS_MFRAG)) {
 		/* no more fragmentss: truncate this (last) hole */
-		total_len = start + len;
+		slot->total_len = start + len;
 		h->last_byte = start + len;
 	}
 
@@ -850,7 +906,7 @@ static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 			done = 1;
 		} else if (!h->prev_hole) {
 			/* first hole */
-			first_hole = h->next_hole;
+			slot->first_hole = h->next_hole;
 			payload[h->next_hole].prev_hole = 0;
 		} else if (!h->next_hole) {
 			/* last hole */
@@ -875,7 +931,7 @@ static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 		if (h->prev_hole)
 			payload[h->prev_hole].next_hole = (h - payload);
 		else
-			first_hole = (h - payload);
+			slot->first_hole = (h - payload);
 
 	} else {
 		/* fragment sits in the middle: split the hole */
@@ -893,8 +949,10 @@ static struct ip_udp_hdr *__NetDefragment(struct ip_udp_hdr *ip, int *lenp)
 	if (!done)
 		return NULL;
 
-	localip->ip_len = htons(total_len);
-	*lenp = total_len + IP_HDR_SIZE;
+	/* the packet is handed over; the slot can take a new datagram */
+	localip->ip_len = htons(slot->total_len);
+	*lenp = slot->total_len + IP_HDR_SIZE;
+	slot->total_len = 0;
 	return localip;
 }
 
@@ -94,6 +94,7 @@ store_block(uchar *src, unsigned offset, unsigned len)
 #endif /* CONFIG_SYS_DIRECT_FLASH_NFS */
 	{
 		(void)memcpy((void *)(load_addr + offset), src, len);
+		image_load_update((void *)(load_addr + offset), len);
 	}
 
 	if (NetBootFileXferSize < (offset+len))
@@ -769,6 +770,7 @@ NfsStart(void)
 	}
 	printf("\nLoad address: 0x%lx\n"
 		"Loading: *\b", load_addr);
+	image_load_start((void *)load_addr);
 
 	NetSetTimeout(nfs_timeout, NfsTimeout);
 	net_set_udp_handler(NfsHandler);
@@ -130,6 +130,30 @@ static char tftp_filename[MAX_LEN];
 static unsigned short TftpBlkSize = TFTP_BLOCK_SIZE;
 static unsigned short TftpBlkSizeOption = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * RFC 7440 windowsize: the server sends this many blocks before waiting
+ * for an ACK. Blocks inside the window are stored as they arrive, even
+ * out of order, but TftpLastBlock only advances once every block before
+ * it is in. Bit n of TftpWindowMap says that block TftpLastBlock + 1 + n
+ * has already been stored.
+ */
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+/* largest window we are able to keep track of */
+#define TFTP_MAX_WINDOWSIZE	64
+
+static unsigned short TftpWindowSize = 1;
+static unsigned short TftpWindowSizeOption = TFTP_WINDOWSIZE;
+/* last block we acknowledged; the window starts just after it */
+static ulong TftpAckBlock;
+static u32 TftpWindowMap[TFTP_MAX_WINDOWSIZE / 32];
+/* the final (short) block, once it has been seen */
+static ulong TftpEndBlock;
+static int TftpEndSeen;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -201,6 +225,9 @@ static void new_transfer(void)
 	TftpLastBlock = 0;
 	TftpBlockWrap = 0;
 	TftpBlockWrapOffset = 0;
+	TftpAckBlock = 0;
+	TftpEndSeen = 0;
+	memset(TftpWindowMap, 0, sizeof(TftpWindowMap));
 #ifdef CONFIG_CMD_TFTPPUT
 	TftpFinalBlock = 0;
 #endif
@@ -310,6 +337,84 @@ static void tftp_complete(void)
 	net_set_state(NETLOOP_SUCCESS);
 }
 
+static inline int window_test(unsigned n)
+{
+	return TftpWindowMap[n / 32] & (1U << (n % 32));
+}
+
+/* Drop the first entry of the window map, after TftpLastBlock advanced */
+static void window_shift(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(TftpWindowMap) - 1; i++)
+		TftpWindowMap[i] = (TftpWindowMap[i] >> 1) |
+				   (TftpWindowMap[i + 1] << 31);
+	TftpWindowMap[i] >>= 1;
+}
+
+/**
+ * Accept data block TftpBlock into the receive window
+ *
+ * The block is stored if it lies within the current window. The window is
+ * acknowledged once it is complete, or as soon as its last block (or the
+ * final block of the file) shows up with a hole before it, in which case
+ * the remote resends from the first missing block.
+ *
+ * @param src	Block data
+ * @param len	Number of bytes in the block
+ */
+static void window_receive(uchar *src, unsigned len)
+{
+	unsigned limit = (unsigned short)(TftpAckBlock + TftpWindowSize -
+					  TftpLastBlock);
+	unsigned pos = (unsigned short)(TftpBlock - TftpLastBlock);
+
+	if (pos == 0 || pos > limit || window_test(pos - 1)) {
+		/*
+		 *	Same block again, or not in this window; ignore it.
+		 */
+		TftpBlock = TftpLastBlock;
+		return;
+	}
+
+	TftpTimeoutCountMax = TIMEOUT_COUNT;
+	NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
+
+	store_block(TftpLastBlock + pos - 1, src, len);
+	TftpWindowMap[(pos - 1) / 32] |= 1U << ((pos - 1) % 32);
+	if (len < TftpBlkSize) {
+		TftpEndBlock = TftpBlock;
+		TftpEndSeen = 1;
+	}
+
+	/* Move past every block that is now in sequence */
+	while (window_test(0)) {
+		window_shift();
+		TftpBlock = (unsigned short)(TftpLastBlock + 1);
+		update_block_number();
+		TftpLastBlock = TftpBlock;
+	}
+	TftpBlock = TftpLastBlock;
+
+	image_load_update((void *)load_addr,
+			  min(TftpLastBlock * TftpBlkSize + TftpBlockWrapOffset,
+			      NetBootFileXferSize));
+
+	if (TftpEndSeen && TftpLastBlock == TftpEndBlock) {
+		TftpSend();
+		tftp_complete();
+	} else if (TftpLastBlock == (unsigned short)(TftpAckBlock +
+						     TftpWindowSize) ||
+		   pos == limit || len < TftpBlkSize) {
+		/*
+		 *	Acknowledge the blocks received in sequence, which will
+		 *	prompt the remote for the next window.
+		 */
+		TftpSend();
+	}
+}
+
 static void
 TftpSend(void)
 {
@@ -359,6 +464,10 @@ TftpSend(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, TftpBlkSizeOption, 0);
+		/* Windows are only supported when receiving */
+		if (TftpState == STATE_SEND_RRQ && TftpWindowSizeOption > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, TftpWindowSizeOption, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!ProhibitMcast) {
@@ -390,6 +499,8 @@ TftpSend(void)
 		s[0] = htons(TFTP_ACK);
 		s[1] = htons(TftpBlock);
 		pkt = (uchar *)(s + 2);
+		/* The remote sends its next window from here */
+		TftpAckBlock = TftpBlock;
 #ifdef CONFIG_CMD_TFTPPUT
 		if (TftpWriting) {
 			int toload = TftpBlkSize;
@@ -528,6 +639,16 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 				debug("Blocksize ack: %s, %d\n",
 					(char *)pkt+i+8, TftpBlkSize);
 			}
+			if (strcmp((char *)pkt+i, "windowsize") == 0) {
+				TftpWindowSize = (unsigned short)
+					simple_strtoul((char *)pkt+i+11, NULL,
+						       10);
+				if (TftpWindowSize < 1 ||
+				    TftpWindowSize > TftpWindowSizeOption)
+					TftpWindowSize = 1;
+				debug("Windowsize ack: %s, %d\n",
+					(char *)pkt+i+11, TftpWindowSize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				TftpTsize = simple_strtoul((char *)pkt+i+6,
@@ -539,6 +660,8 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		}
 #ifdef CONFIG_MCAST_TFTP
 		parse_multicast_oack((char *)pkt, len-1);
+		if (Multicast)
+			TftpWindowSize = 1;
 		if ((Multicast) && (!MasterClient))
 			TftpState = STATE_DATA;	/* passive.. */
 		else
@@ -558,8 +681,6 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 		len -= 2;
 		TftpBlock = ntohs(*(__be16 *)pkt);
 
-		update_block_number();
-
 		if (TftpState == STATE_SEND_RRQ)
 			debug("Server did not acknowledge timeout option!\n");
 
@@ -575,9 +696,10 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 				TftpLastBlock = TftpBlock - 1;
 			} else
 #endif
-			if (TftpBlock != 1) {	/* Assertion */
+			if (TftpBlock == 0 ||
+			    TftpBlock > TftpWindowSize) {	/* Assertion */
 				printf("\nTFTP error: "
-				       "First block is not block 1 (%ld)\n"
+				       "First block is not in first window (%ld)\n"
 				       "Starting again\n\n",
 					TftpBlock);
 				NetStartAgain();
@@ -585,28 +707,26 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 			}
 		}
 
-		if (TftpBlock == TftpLastBlock) {
-			/*
-			 *	Same block again; ignore it.
-			 */
-			break;
-		}
+#ifdef CONFIG_MCAST_TFTP
+		if (Multicast) {
+			update_block_number();
 
-		TftpLastBlock = TftpBlock;
-		TftpTimeoutCountMax = TIMEOUT_COUNT;
-		NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
+			if (TftpBlock == TftpLastBlock) {
+				/*
+				 *	Same block again; ignore it.
+				 */
+				break;
+			}
 
-		store_block(TftpBlock - 1, pkt + 2, len);
+			TftpLastBlock = TftpBlock;
+			TftpTimeoutCountMax = TIMEOUT_COUNT;
+			NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
 
-		/*
-		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
-		 */
-#ifdef CONFIG_MCAST_TFTP
-		/* if I am the MasterClient, actively calculate what my next
-		 * needed block is; else I'm passive; not ACKING
-		 */
-		if (Multicast) {
+			store_block(TftpBlock - 1, pkt + 2, len);
+
+			/* if I am the MasterClient, actively calculate what my
+			 * next needed block is; else I'm passive; not ACKING
+			 */
 			if (len < TftpBlkSize)  {
 				TftpEndingBlock = TftpBlock;
 			} else if (MasterClient) {
@@ -625,21 +745,17 @@ TftpHandler(uchar *pkt, unsigned dest, IPaddr_t sip, unsigned src,
 				}
 				TftpLastBlock = TftpBlock;
 			}
-		}
-#endif
-		TftpSend();
+			TftpSend();
 
-#ifdef CONFIG_MCAST_TFTP
-		if (Multicast) {
 			if (MasterClient && (TftpBlock >= TftpEndingBlock)) {
 				puts("\nMulticast tftp done\n");
 				mcast_cleanup();
 				net_set_state(NETLOOP_SUCCESS);
 			}
-		} else
+			break;
+		}
 #endif
-		if (len < TftpBlkSize)
-			tftp_complete();
+		window_receive(pkt + 2, len);
 		break;
 
 	case TFTP_ERROR:
@@ -697,6 +813,14 @@ void TftpStart(enum proto_t protocol)
 	if (ep != NULL)
 		TftpBlkSizeOption = simple_strtol(ep, NULL, 10);
 
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		TftpWindowSizeOption = simple_strtol(ep, NULL, 10);
+	if (TftpWindowSizeOption < 1)
+		TftpWindowSizeOption = 1;
+	else if (TftpWindowSizeOption > TFTP_MAX_WINDOWSIZE)
+		TftpWindowSizeOption = TFTP_MAX_WINDOWSIZE;
+
 	ep = getenv("tftptimeout");
 	if (ep != NULL)
 		TftpTimeoutMSecs = simple_strtol(ep, NULL, 10);
@@ -708,8 +832,8 @@ void TftpStart(enum proto_t protocol)
 		TftpTimeoutMSecs = 1000;
 	}
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-		TftpBlkSizeOption, TftpTimeoutMSecs);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+		TftpBlkSizeOption, TftpWindowSizeOption, TftpTimeoutMSecs);
 
 	TftpRemoteIP = NetServerIP;
 	if (BootFile[0] == '\0') {
@@ -780,6 +904,7 @@ void TftpStart(enum proto_t protocol)
 		printf("Load address: 0x%lx\n", load_addr);
 		puts("Loading: *\b");
 		TftpState = STATE_SEND_RRQ;
+		image_load_start((void *)load_addr);
 	}
 
 	time_start = get_timer(0);
@@ -807,8 +932,9 @@ void TftpStart(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(NetServerEther, 0, 6);
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -837,8 +963,9 @@ TftpStartServer(void)
 	TftpTimeoutMSecs = TIMEOUT;
 	NetSetTimeout(TftpTimeoutMSecs, TftpTimeout);
 
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 	TftpBlock = 0;
 	TftpOurPort = WELL_KNOWN_PORT;
 
@@ -0,0 +1,144 @@
+/*
+ * Tests for the secondary CPU work queue in common/cpu_work.c
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <cpu_work.h>
+#include <dm/test.h>
+#include <dm/ut.h>
+
+#define WORK_SECONDARIES	(CONFIG_CPU_WORK_CPUS - 1)
+#define WORK_BUF_SIZE		4096
+
+struct work_sum {
+	const u8 *buf;
+	int len;
+};
+
+static u8 work_buf[WORK_BUF_SIZE];
+static volatile int work_hold;
+
+/* Static, since a secondary CPU may still write to it if a check fails */
+static struct cpu_work work[WORK_SECONDARIES + 1];
+
+static int work_sum(void *arg)
+{
+	struct work_sum *sum = arg;
+	int i, total = 0;
+
+	for (i = 0; i < sum->len; i++)
+		total += sum->buf[i];
+
+	return total;
+}
+
+/* Keeps its CPU busy until work_hold is cleared */
+static int work_spin(void *arg)
+{
+	while (work_hold)
+		;
+
+	return (ulong)arg;
+}
+
+static int test_work_run(struct dm_test_state *dms)
+{
+	static struct work_sum sum[WORK_SECONDARIES];
+	int i, part, total = 0;
+
+	for (i = 0; i < WORK_BUF_SIZE; i++)
+		work_buf[i] = i * 7;
+
+	/* Each secondary CPU sums a part of the buffer */
+	part = WORK_BUF_SIZE / WORK_SECONDARIES;
+	for (i = 0; i < WORK_SECONDARIES; i++) {
+		sum[i].buf = work_buf + i * part;
+		sum[i].len = part;
+		ut_assertok(cpu_work_start(&work[i], work_sum, &sum[i]));
+	}
+	for (i = 0; i < WORK_SECONDARIES; i++) {
+		ut_asserteq(work_sum(&sum[i]), cpu_work_wait(&work[i]));
+		ut_asserteq(0, work[i].busy);
+		total += work[i].ret;
+	}
+	sum[0].buf = work_buf;
+	sum[0].len = part * WORK_SECONDARIES;
+	ut_asserteq(work_sum(&sum[0]), total);
+
+	return 0;
+}
+
+static int test_work_busy(struct dm_test_state *dms)
+{
+	int i;
+
+	work_hold = 1;
+	for (i = 0; i < WORK_SECONDARIES; i++)
+		ut_assertok(cpu_work_start(&work[i], work_spin,
+					    (void *)(ulong)i));
+
+	/* Every secondary CPU is taken, so the caller does it itself */
+	ut_asserteq(-EBUSY, cpu_work_start(&work[i], work_spin, NULL));
+	for (i = 0; i < WORK_SECONDARIES; i++)
+		ut_assert(work[i].busy);
+
+	work_hold = 0;
+	for (i = 0; i < WORK_SECONDARIES; i++)
+		ut_asserteq(i, cpu_work_wait(&work[i]));
+
+	/* A free CPU takes work again */
+	work_hold = 1;
+	ut_assertok(cpu_work_start(&work[0], work_spin, (void *)5));
+	work_hold = 0;
+	ut_asserteq(5, cpu_work_wait(&work[0]));
+
+	return 0;
+}
+
+static int test_work_stop(struct dm_test_state *dms)
+{
+	static struct work_sum sum = { work_buf, WORK_BUF_SIZE };
+
+	/* Stopping waits for work still running */
+	work_hold = 1;
+	ut_assertok(cpu_work_start(&work[0], work_spin, (void *)3));
+	work_hold = 0;
+	cpu_work_stop();
+	ut_asserteq(0, work[0].busy);
+	ut_asserteq(3, work[0].ret);
+
+	/* The CPUs come back for the next work */
+	ut_assertok(cpu_work_start(&work[0], work_sum, &sum));
+	ut_asserteq(work_sum(&sum), cpu_work_wait(&work[0]));
+	cpu_work_stop();
+	cpu_work_stop();
+
+	return 0;
+}
+
+static int do_ut_cpu_work(cmd_tbl_t *cmdtp, int flag, int argc,
+			  char * const argv[])
+{
+	struct dm_test_state state, *dms = &state;
+
+	memset(dms, '\0', sizeof(*dms));
+	test_work_run(dms);
+	test_work_busy(dms);
+	test_work_stop(dms);
+
+	/* Leave the CPUs parked, even after a failed check */
+	work_hold = 0;
+	cpu_work_stop();
+
+	printf("ut_cpu_work %s\n", dms->fail_count ? "FAILED" : "ok");
+
+	return dms->fail_count ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_cpu_work,	1,	1,	do_ut_cpu_work,
+	"Basic test of the secondary CPU work queue", ""
+);
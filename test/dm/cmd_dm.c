@@ -31,6 +31,8 @@ static void dm_display_line(struct udevice *dev, char *buf)
 	       dev->name, (ulong)map_to_sysmem(dev));
 	if (dev->req_seq != -1)
 		printf(", %d", dev->req_seq);
+	if (device_active(dev) && dev->probe_time)
+		printf(" (probed in %luus)", dev->probe_time);
 	puts("\n");
 }
 
@@ -62,6 +62,11 @@ static struct driver_info driver_info_manual = {
 	.platdata = &test_pdata_manual,
 };
 
+static struct driver_info driver_info_async = {
+	.name = "test_async_drv",
+	.platdata = &test_pdata_manual,
+};
+
 static struct driver_info driver_info_pre_reloc = {
 	.name = "test_pre_reloc_drv",
 	.platdata = &test_pdata_manual,
@@ -571,6 +576,82 @@ static int dm_test_pre_reloc(struct dm_test_state *dms)
 }
 DM_TEST(dm_test_pre_reloc, 0);
 
+/* Test that a device can finish probing after probe() returns */
+static int dm_test_probe_async(struct dm_test_state *dms)
+{
+	struct dm_test_priv *priv, *priv2;
+	struct udevice *dev, *dev2;
+	int polls;
+
+	ut_assertok(device_bind_by_name(dms->root, false, &driver_info_async,
+					&dev));
+	ut_assertok(device_bind_by_name(dms->root, false, &driver_info_async,
+					&dev2));
+
+	/* Starting runs probe() but leaves the device inactive */
+	ut_assertok(device_probe_start(dev));
+	ut_asserteq(1, dm_testdrv_op_count[DM_TEST_OP_PROBE]);
+	ut_assert(dev->flags & DM_FLAG_PROBING);
+	ut_assert(!device_active(dev));
+	priv = dev->priv;
+
+	/* Starting again does nothing */
+	ut_assertok(device_probe_start(dev));
+	ut_asserteq(1, dm_testdrv_op_count[DM_TEST_OP_PROBE]);
+
+	ut_asserteq(-EAGAIN, device_probe_poll(dev));
+	ut_asserteq(1, priv->op_count[DM_TEST_OP_PROBE_POLL]);
+	ut_asserteq(-ENODEV, device_probe_poll(dev2));
+
+	/* A probing device cannot be unbound */
+	ut_asserteq(-EINVAL, device_unbind(dev));
+	ut_asserteq(0, dm_testdrv_op_count[DM_TEST_OP_UNBIND]);
+
+	/* Probing waits for the device to finish */
+	ut_assertok(device_probe(dev));
+	ut_assert(device_active(dev));
+	ut_assert(!(dev->flags & DM_FLAG_PROBING));
+	ut_asserteq(DM_TEST_PROBE_POLLS, priv->op_count[DM_TEST_OP_PROBE_POLL]);
+	ut_assertok(device_probe_poll(dev));
+
+	/* Both devices start together and each is polled to completion */
+	ut_assertok(device_remove(dev));
+	memset(dm_testdrv_op_count, '\0', sizeof(dm_testdrv_op_count));
+	dm_probe_async();
+	ut_asserteq(2, dm_testdrv_op_count[DM_TEST_OP_PROBE]);
+	ut_assert(dev->flags & DM_FLAG_PROBING);
+	ut_assert(dev2->flags & DM_FLAG_PROBING);
+	priv = dev->priv;
+	priv2 = dev2->priv;
+	for (polls = 1; polls < DM_TEST_PROBE_POLLS; polls++) {
+		dm_probe_poll();
+		ut_asserteq(polls, priv->op_count[DM_TEST_OP_PROBE_POLL]);
+		ut_asserteq(polls, priv2->op_count[DM_TEST_OP_PROBE_POLL]);
+		ut_assert(!device_active(dev));
+		ut_assert(!device_active(dev2));
+	}
+	dm_probe_poll();
+	ut_assert(device_active(dev));
+	ut_assert(device_active(dev2));
+	ut_asserteq(DM_TEST_PROBE_POLLS, priv->op_count[DM_TEST_OP_PROBE_POLL]);
+	ut_asserteq(DM_TEST_PROBE_POLLS,
+		    priv2->op_count[DM_TEST_OP_PROBE_POLL]);
+
+	/* Removing a device that is still probing waits for it first */
+	ut_assertok(device_remove(dev));
+	ut_assertok(device_remove(dev2));
+	memset(dm_testdrv_op_count, '\0', sizeof(dm_testdrv_op_count));
+	ut_assertok(device_probe_start(dev));
+	ut_assertok(device_remove(dev));
+	ut_assert(!(dev->flags & DM_FLAG_PROBING));
+	ut_asserteq(1, dm_testdrv_op_count[DM_TEST_OP_REMOVE]);
+	ut_assertok(device_unbind(dev));
+	ut_asserteq(1, dm_testdrv_op_count[DM_TEST_OP_UNBIND]);
+
+	return 0;
+}
+DM_TEST(dm_test_probe_async, 0);
+
 static int dm_test_uclass_before_ready(struct dm_test_state *dms)
 {
 	struct uclass *uc;
@@ -145,6 +145,28 @@ U_BOOT_DRIVER(test_manual_drv) = {
 	.unbind	= test_manual_unbind,
 };
 
+static int test_async_probe_poll(struct udevice *dev)
+{
+	struct dm_test_priv *priv = dev->priv;
+
+	dm_testdrv_op_count[DM_TEST_OP_PROBE_POLL]++;
+	if (++priv->op_count[DM_TEST_OP_PROBE_POLL] < DM_TEST_PROBE_POLLS)
+		return -EAGAIN;
+
+	return 0;
+}
+
+U_BOOT_DRIVER(test_async_drv) = {
+	.name	= "test_async_drv",
+	.id	= UCLASS_TEST,
+	.ops	= &test_manual_ops,
+	.bind	= test_manual_bind,
+	.probe	= test_manual_probe,
+	.probe_poll = test_async_probe_poll,
+	.remove	= test_manual_remove,
+	.unbind	= test_manual_unbind,
+};
+
 U_BOOT_DRIVER(test_pre_reloc_drv) = {
 	.name	= "test_pre_reloc_drv",
 	.id	= UCLASS_TEST,
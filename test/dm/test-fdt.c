@@ -258,3 +258,81 @@ static int dm_test_fdt_offset(struct dm_test_state *dms)
 	return 0;
 }
 DM_TEST(dm_test_fdt_offset, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_FDTDEC_INDEX
+/* Test that lookups through the FDT index agree with libfdt */
+static int dm_test_fdt_index(struct dm_test_state *dms)
+{
+	static const char * const compats[] = {
+		"denx,u-boot-fdt-test", "denx,u-boot-test-bus",
+		"google,another-fdt-test", "sandbox,gpio", "no,such-device",
+	};
+	const void *blob = gd->fdt_blob;
+	void *old_index = gd->fdt_index;
+	char path[256];
+	int node, depth, offset, i;
+	uint32_t phandle;
+
+	ut_assertok(fdtdec_index_build());
+	ut_assert(gd->fdt_index != NULL);
+
+	/* Every node can be found from its path, and its phandle if any */
+	for (node = 0, depth = 0; node >= 0 && depth >= 0;
+	     node = fdt_next_node(blob, node, &depth)) {
+		ut_assertok(fdt_get_path(blob, node, path, sizeof(path)));
+		ut_assert(fdtdec_index_path_offset(blob, path, &offset));
+		ut_asserteq(node, offset);
+
+		phandle = fdt_get_phandle(blob, node);
+		if (!phandle)
+			continue;
+		ut_assert(fdtdec_index_offset_by_phandle(blob, phandle,
+							 &offset));
+		ut_asserteq(node, offset);
+	}
+
+	/* Compatible lookups return the same nodes, in the same order */
+	for (i = 0; i < ARRAY_SIZE(compats); i++) {
+		node = -1;
+		do {
+			offset = fdt_node_offset_by_compatible(blob, node,
+							       compats[i]);
+			ut_assert(fdtdec_index_offset_by_compatible(blob, node,
+						compats[i], &node));
+			ut_asserteq(offset, node);
+		} while (node >= 0);
+	}
+
+	node = fdt_path_offset(blob, "/d-test");
+	ut_assert(node > 0);
+	ut_asserteq(0, fdtdec_node_check_compatible(blob, node,
+						    "google,another-fdt-test"));
+	ut_asserteq(1, fdtdec_node_check_compatible(blob, node,
+						    "denx,u-boot-fdt-test"));
+	ut_asserteq(fdt_path_offset(blob, "/some-bus"),
+		    fdtdec_lookup_phandle(blob, node, "test-bus"));
+
+	/* The index leaves these to libfdt */
+	ut_assert(!fdtdec_index_path_offset(blob, "testfdt6", &offset));
+	ut_asserteq(fdt_path_offset(blob, "/e-test"),
+		    fdtdec_path_offset(blob, "testfdt6"));
+	ut_assert(!fdtdec_index_path_offset(blob, "/some-bus/c-test",
+					    &offset));
+	ut_asserteq(fdt_path_offset(blob, "/some-bus/c-test"),
+		    fdtdec_path_offset(blob, "/some-bus/c-test"));
+	node = fdt_path_offset(blob, "/no-compatible");
+	ut_assert(!fdtdec_index_check_compatible(blob, node, "sandbox",
+						 &offset));
+	ut_asserteq(-FDT_ERR_NOTFOUND,
+		    fdtdec_path_offset(blob, "/some-bus/no-such-node"));
+
+	/* An index built for another blob is not used */
+	ut_assert(!fdtdec_index_path_offset(blob + 1, "/e-test", &offset));
+
+	free(gd->fdt_index);
+	gd->fdt_index = old_index;
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_index, 0);
+#endif
@@ -0,0 +1,143 @@
+/*
+ * Tests for the object pools in common/mempool.c
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <mempool.h>
+#include <dm/test.h>
+#include <dm/ut.h>
+
+#define POOL_OBJ_SIZE	5
+#define POOL_ALIGN	16
+#define POOL_PER_CHUNK	4
+#define POOL_LIMIT	6
+
+static int test_pool_alloc(struct dm_test_state *dms,
+			   struct mem_pool *pool)
+{
+	void *obj[POOL_LIMIT];
+	int i, j;
+
+	mem_pool_init(pool, "test", POOL_OBJ_SIZE, POOL_ALIGN,
+		      POOL_PER_CHUNK, POOL_LIMIT);
+	ut_asserteq(POOL_ALIGN, pool->size);
+	ut_asserteq(0, pool->nchunks);
+
+	for (i = 0; i < POOL_LIMIT; i++) {
+		obj[i] = mem_pool_alloc(pool);
+		ut_assert(obj[i]);
+		ut_assert(!((ulong)obj[i] & (POOL_ALIGN - 1)));
+		for (j = 0; j < i; j++)
+			ut_assert(obj[i] != obj[j]);
+		memset(obj[i], i, POOL_OBJ_SIZE);
+	}
+	ut_asserteq(POOL_LIMIT, pool->in_use);
+	ut_asserteq(POOL_LIMIT, pool->peak);
+	ut_asserteq(DIV_ROUND_UP(POOL_LIMIT, POOL_PER_CHUNK), pool->nchunks);
+
+	/* Objects do not overlap */
+	for (i = 0; i < POOL_LIMIT; i++)
+		ut_asserteq(i, *(u8 *)obj[i]);
+
+	/* The limit holds even though the last chunk has room */
+	ut_assert(!mem_pool_alloc(pool));
+	ut_asserteq(1, pool->fails);
+
+	/* Freed objects are used again before the pool grows */
+	mem_pool_free(pool, obj[1]);
+	mem_pool_free(pool, obj[3]);
+	mem_pool_free(pool, NULL);
+	ut_asserteq(POOL_LIMIT - 2, pool->in_use);
+	ut_asserteq_ptr(obj[3], mem_pool_alloc(pool));
+	ut_asserteq_ptr(obj[1], mem_pool_zalloc(pool));
+	for (j = 0; j < POOL_OBJ_SIZE; j++)
+		ut_assert(!((u8 *)obj[1])[j]);
+	ut_asserteq(DIV_ROUND_UP(POOL_LIMIT, POOL_PER_CHUNK), pool->nchunks);
+	ut_asserteq(POOL_LIMIT, pool->peak);
+	ut_asserteq(POOL_LIMIT + 2, pool->allocs);
+
+	mem_pool_destroy(pool);
+	ut_asserteq(0, pool->in_use);
+	ut_asserteq(0, pool->nchunks);
+
+	/* A destroyed pool grows again from scratch */
+	ut_assert(mem_pool_alloc(pool));
+	ut_asserteq(1, pool->nchunks);
+	mem_pool_destroy(pool);
+
+	return 0;
+}
+
+static int test_pool_unlimited(struct dm_test_state *dms,
+			       struct mem_pool *pool)
+{
+	int i;
+
+	/* Objects are at least a pointer, which holds the free-list link */
+	mem_pool_init(pool, "test", 1, 0, 0, 0);
+	ut_asserteq(sizeof(void *), pool->size);
+	ut_asserteq(1, pool->per_chunk);
+
+	for (i = 0; i < POOL_LIMIT * 2; i++)
+		ut_assert(mem_pool_alloc(pool));
+	ut_asserteq(POOL_LIMIT * 2, pool->nchunks);
+	ut_asserteq(0, pool->fails);
+	mem_pool_destroy(pool);
+
+	return 0;
+}
+
+static int test_arena(struct dm_test_state *dms)
+{
+	static char buf[4 * ARCH_DMA_MINALIGN] __aligned(ARCH_DMA_MINALIGN);
+	struct mem_arena arena;
+	char *a, *b, *c;
+	ulong mark;
+
+	mem_arena_init(&arena, buf, sizeof(buf));
+	a = mem_arena_alloc(&arena, 1);
+	ut_asserteq_ptr(buf, a);
+
+	/* Each allocation starts on a fresh cache line */
+	b = mem_arena_memalign(&arena, 1, 1);
+	ut_asserteq_ptr(buf + ARCH_DMA_MINALIGN, b);
+	mark = mem_arena_mark(&arena);
+	c = mem_arena_memalign(&arena, 2 * ARCH_DMA_MINALIGN, 1);
+	ut_asserteq_ptr(buf + 2 * ARCH_DMA_MINALIGN, c);
+	ut_assert(!mem_arena_alloc(&arena, 2 * ARCH_DMA_MINALIGN));
+
+	mem_arena_release(&arena, mark);
+	ut_asserteq_ptr(c, mem_arena_alloc(&arena, 2 * ARCH_DMA_MINALIGN));
+
+	/* Freeing b also frees what came after it */
+	mem_arena_free(&arena, b);
+	ut_asserteq(ARCH_DMA_MINALIGN, arena.used);
+	ut_asserteq(4 * ARCH_DMA_MINALIGN, arena.peak);
+
+	return 0;
+}
+
+static int do_ut_mempool(cmd_tbl_t *cmdtp, int flag, int argc,
+			 char * const argv[])
+{
+	/* Static, since a pool stays registered if a check fails */
+	static struct mem_pool pool;
+	struct dm_test_state state, *dms = &state;
+
+	memset(dms, '\0', sizeof(*dms));
+	test_pool_alloc(dms, &pool);
+	test_pool_unlimited(dms, &pool);
+	test_arena(dms);
+
+	printf("ut_mempool %s\n", dms->fail_count ? "FAILED" : "ok");
+
+	return dms->fail_count ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_mempool,	1,	1,	do_ut_mempool,
+	"Basic test of object pools", ""
+);
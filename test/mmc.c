@@ -0,0 +1,399 @@
+/*
+ * Tests for eMMC bus mode selection in drivers/mmc/mmc.c, using an
+ * emulated host and card
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <errno.h>
+#include <dm.h>
+#include <mmc.h>
+#include <dm/device-internal.h>
+#include <dm/root.h>
+#include <dm/test.h>
+#include <dm/ut.h>
+
+/* The card, and what the host saw of it */
+struct emu_mmc {
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	bool switch_err;	/* the last CMD6 was refused */
+	bool tuning_fails;	/* CMD21 returns a corrupt block */
+	int busy;		/* CMD1s for which the card stays busy */
+	int op_conds;		/* number of CMD1s */
+	int identified;		/* number of CMD2s */
+	uint clock;
+	uint bus_width;
+	int tuned;		/* number of execute_tuning() calls */
+	uint tune_clock;
+	uint tune_bus_width;
+	uint tune_caps;
+	int tune_blocksize;
+};
+
+static struct emu_mmc emu;
+
+static int emu_switch(struct emu_mmc *card, uint arg)
+{
+	uint index = (arg >> 16) & 0xff;
+	uint value = (arg >> 8) & 0xff;
+	u8 type = card->ext_csd[EXT_CSD_CARD_TYPE];
+
+	card->switch_err = false;
+	if (index == EXT_CSD_HS_TIMING) {
+		if (value == EXT_CSD_TIMING_HS200 &&
+		    !(type & EXT_CSD_CARD_TYPE_HS200))
+			card->switch_err = true;
+	} else if (index == EXT_CSD_BUS_WIDTH) {
+		if (value >= EXT_CSD_DDR_BUS_WIDTH_4 &&
+		    !(type & EXT_CSD_CARD_TYPE_DDR_52))
+			card->switch_err = true;
+	}
+	if (!card->switch_err)
+		card->ext_csd[index] = value;
+
+	return 0;
+}
+
+static int emu_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
+			struct mmc_data *data)
+{
+	struct emu_mmc *card = mmc->priv;
+	const u8 *pattern;
+	int size;
+
+	memset(cmd->response, '\0', sizeof(cmd->response));
+	switch (cmd->cmdidx) {
+	case MMC_CMD_ALL_SEND_CID:
+		card->identified++;
+		break;
+	case MMC_CMD_GO_IDLE_STATE:
+	case MMC_CMD_SET_RELATIVE_ADDR:
+	case MMC_CMD_SELECT_CARD:
+	case MMC_CMD_SET_BLOCKLEN:
+	case MMC_CMD_SET_BLOCK_COUNT:
+	case MMC_CMD_STOP_TRANSMISSION:
+		break;
+	case MMC_CMD_SEND_EXT_CSD:
+		/* Without data this is the SD SEND_IF_COND */
+		if (!data)
+			return TIMEOUT;
+		memcpy(data->dest, card->ext_csd, MMC_MAX_BLOCK_LEN);
+		break;
+	case MMC_CMD_APP_CMD:
+		return TIMEOUT;
+	case MMC_CMD_SEND_OP_COND:
+		/* OCR_BUSY is set once the card has powered up */
+		cmd->response[0] = OCR_HCS | MMC_VDD_32_33 | MMC_VDD_33_34;
+		if (++card->op_conds > card->busy)
+			cmd->response[0] |= OCR_BUSY;
+		break;
+	case MMC_CMD_SEND_CSD:
+		/* version 4, 26MHz, 512-byte blocks */
+		cmd->response[0] = 4 << 26 | 0x32;
+		cmd->response[1] = 9 << 16;
+		cmd->response[3] = 9 << 22;
+		break;
+	case MMC_CMD_SEND_STATUS:
+		cmd->response[0] = MMC_STATUS_RDY_FOR_DATA | 4 << 9;
+		if (card->switch_err)
+			cmd->response[0] |= MMC_STATUS_SWITCH_ERROR;
+		break;
+	case MMC_CMD_SWITCH:
+		return emu_switch(card, cmd->cmdarg);
+	case MMC_CMD_READ_SINGLE_BLOCK:
+	case MMC_CMD_READ_MULTIPLE_BLOCK:
+		memset(data->dest, '\0', data->blocks * data->blocksize);
+		break;
+	case MMC_CMD_SEND_TUNING_BLOCK_HS200:
+		if (card->ext_csd[EXT_CSD_HS_TIMING] != EXT_CSD_TIMING_HS200)
+			return COMM_ERR;
+		pattern = tuning_blk_pattern_4bit;
+		size = sizeof(tuning_blk_pattern_4bit);
+		if (card->bus_width == 8) {
+			pattern = tuning_blk_pattern_8bit;
+			size = sizeof(tuning_blk_pattern_8bit);
+		}
+		card->tune_blocksize = data->blocksize;
+		if (data->blocksize != size)
+			return COMM_ERR;
+		memcpy(data->dest, pattern, size);
+		if (card->tuning_fails)
+			data->dest[size / 2] ^= 0xff;
+		break;
+	default:
+		return UNUSABLE_ERR;
+	}
+
+	return 0;
+}
+
+static void emu_set_ios(struct mmc *mmc)
+{
+	struct emu_mmc *card = mmc->priv;
+
+	card->clock = mmc->clock;
+	card->bus_width = mmc->bus_width;
+}
+
+static int emu_init(struct mmc *mmc)
+{
+	return 0;
+}
+
+static int emu_getcd(struct mmc *mmc)
+{
+	return 1;
+}
+
+static int emu_execute_tuning(struct mmc *mmc, uint opcode)
+{
+	struct emu_mmc *card = mmc->priv;
+
+	card->tuned++;
+	card->tune_clock = card->clock;
+	card->tune_bus_width = card->bus_width;
+	card->tune_caps = mmc->card_caps;
+
+	return mmc_send_tuning(mmc, opcode);
+}
+
+static const struct mmc_ops emu_ops = {
+	.send_cmd	= emu_send_cmd,
+	.set_ios	= emu_set_ios,
+	.init		= emu_init,
+	.getcd		= emu_getcd,
+	.execute_tuning	= emu_execute_tuning,
+};
+
+#define EMU_CAPS	(MMC_MODE_HS | MMC_MODE_HS_52MHz | MMC_MODE_4BIT | \
+			 MMC_MODE_HC)
+
+/* Set up a host and a card with the given CARD_TYPE */
+static void emu_setup(struct mmc_config *cfg, uint host_caps, u8 card_type,
+		      bool tuning_fails)
+{
+	memset(&emu, '\0', sizeof(emu));
+	emu.ext_csd[EXT_CSD_REV] = 6;
+	emu.ext_csd[EXT_CSD_CARD_TYPE] = card_type;
+	emu.ext_csd[EXT_CSD_SEC_CNT + 3] = 0x01;	/* 8GiB */
+	emu.tuning_fails = tuning_fails;
+
+	memset(cfg, '\0', sizeof(*cfg));
+	cfg->name = "emu_mmc";
+	cfg->ops = &emu_ops;
+	cfg->host_caps = host_caps;
+	cfg->voltages = MMC_VDD_32_33 | MMC_VDD_33_34;
+	cfg->f_min = 400000;
+	cfg->f_max = 200000000;
+	cfg->b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
+}
+
+/* Set up a host and card as emu_setup() does, and bring the card up */
+static struct mmc *emu_start(struct mmc_config *cfg, uint host_caps,
+			     u8 card_type, bool tuning_fails)
+{
+	struct mmc *mmc;
+
+	emu_setup(cfg, host_caps, card_type, tuning_fails);
+	mmc = mmc_create(cfg, &emu);
+	if (mmc && mmc_init(mmc)) {
+		mmc_destroy(mmc);
+		mmc = NULL;
+	}
+
+	return mmc;
+}
+
+/* A card with HS200 is tuned on an 8-bit SDR bus and runs at 200MHz */
+static int mmc_test_hs200(struct dm_test_state *dms)
+{
+	struct mmc_config cfg;
+	struct mmc *mmc;
+
+	mmc = emu_start(&cfg, EMU_CAPS | MMC_MODE_8BIT |
+			MMC_MODE_DDR_52MHz | MMC_MODE_HS200,
+			EXT_CSD_CARD_TYPE_52 | EXT_CSD_CARD_TYPE_DDR_52 |
+			EXT_CSD_CARD_TYPE_HS200, false);
+	ut_assert(mmc);
+	ut_asserteq(1, emu.tuned);
+	ut_asserteq(200000000, emu.tune_clock);
+	ut_asserteq(8, emu.tune_bus_width);
+	ut_assert(emu.tune_caps & MMC_MODE_HS200);
+	ut_asserteq(sizeof(tuning_blk_pattern_8bit), emu.tune_blocksize);
+
+	ut_asserteq(EXT_CSD_TIMING_HS200, emu.ext_csd[EXT_CSD_HS_TIMING]);
+	ut_asserteq(EXT_CSD_BUS_WIDTH_8, emu.ext_csd[EXT_CSD_BUS_WIDTH]);
+	ut_asserteq(200000000, emu.clock);
+	ut_asserteq(8, emu.bus_width);
+	ut_assert(mmc->card_caps & MMC_MODE_HS200);
+	ut_assert(!(mmc->card_caps & MMC_MODE_DDR_52MHz));
+	mmc_destroy(mmc);
+
+	return 0;
+}
+
+/* A 4-bit host tunes with the 64-byte block */
+static int mmc_test_hs200_4bit(struct dm_test_state *dms)
+{
+	struct mmc_config cfg;
+	struct mmc *mmc;
+
+	mmc = emu_start(&cfg, EMU_CAPS | MMC_MODE_HS200,
+			EXT_CSD_CARD_TYPE_52 | EXT_CSD_CARD_TYPE_HS200, false);
+	ut_assert(mmc);
+	ut_asserteq(1, emu.tuned);
+	ut_asserteq(4, emu.tune_bus_width);
+	ut_asserteq(sizeof(tuning_blk_pattern_4bit), emu.tune_blocksize);
+	ut_asserteq(EXT_CSD_TIMING_HS200, emu.ext_csd[EXT_CSD_HS_TIMING]);
+	ut_asserteq(EXT_CSD_BUS_WIDTH_4, emu.ext_csd[EXT_CSD_BUS_WIDTH]);
+	ut_asserteq(200000000, emu.clock);
+	mmc_destroy(mmc);
+
+	return 0;
+}
+
+/* If tuning fails the card goes back to high speed, still SDR */
+static int mmc_test_hs200_fail(struct dm_test_state *dms)
+{
+	struct mmc_config cfg;
+	struct mmc *mmc;
+
+	mmc = emu_start(&cfg, EMU_CAPS | MMC_MODE_8BIT |
+			MMC_MODE_DDR_52MHz | MMC_MODE_HS200,
+			EXT_CSD_CARD_TYPE_52 | EXT_CSD_CARD_TYPE_DDR_52 |
+			EXT_CSD_CARD_TYPE_HS200, true);
+	ut_assert(mmc);
+	ut_asserteq(1, emu.tuned);
+	ut_asserteq(EXT_CSD_TIMING_HS, emu.ext_csd[EXT_CSD_HS_TIMING]);
+	ut_asserteq(EXT_CSD_BUS_WIDTH_8, emu.ext_csd[EXT_CSD_BUS_WIDTH]);
+	ut_asserteq(52000000, emu.clock);
+	ut_assert(!(mmc->card_caps & MMC_MODE_HS200));
+	ut_assert(!(mmc->card_caps & MMC_MODE_DDR_52MHz));
+	mmc_destroy(mmc);
+
+	return 0;
+}
+
+/* Without HS200 on the host a DDR card gets a DDR bus and no tuning */
+static int mmc_test_ddr(struct dm_test_state *dms)
+{
+	struct mmc_config cfg;
+	struct mmc *mmc;
+
+	mmc = emu_start(&cfg, EMU_CAPS | MMC_MODE_8BIT |
+			MMC_MODE_DDR_52MHz,
+			EXT_CSD_CARD_TYPE_52 | EXT_CSD_CARD_TYPE_DDR_52 |
+			EXT_CSD_CARD_TYPE_HS200, false);
+	ut_assert(mmc);
+	ut_asserteq(0, emu.tuned);
+	ut_asserteq(EXT_CSD_TIMING_HS, emu.ext_csd[EXT_CSD_HS_TIMING]);
+	ut_asserteq(EXT_CSD_DDR_BUS_WIDTH_8, emu.ext_csd[EXT_CSD_BUS_WIDTH]);
+	ut_asserteq(52000000, emu.clock);
+	ut_asserteq(8, emu.bus_width);
+	ut_assert(mmc->card_caps & MMC_MODE_DDR_52MHz);
+	mmc_destroy(mmc);
+
+	return 0;
+}
+
+/* A card with neither HS200 nor DDR stays at high speed SDR */
+static int mmc_test_sdr(struct dm_test_state *dms)
+{
+	struct mmc_config cfg;
+	struct mmc *mmc;
+
+	mmc = emu_start(&cfg, EMU_CAPS | MMC_MODE_8BIT |
+			MMC_MODE_DDR_52MHz | MMC_MODE_HS200,
+			EXT_CSD_CARD_TYPE_52, false);
+	ut_assert(mmc);
+	ut_asserteq(0, emu.tuned);
+	ut_asserteq(EXT_CSD_TIMING_HS, emu.ext_csd[EXT_CSD_HS_TIMING]);
+	ut_asserteq(EXT_CSD_BUS_WIDTH_8, emu.ext_csd[EXT_CSD_BUS_WIDTH]);
+	ut_asserteq(52000000, emu.clock);
+	ut_assert(!(mmc->card_caps & (MMC_MODE_HS200 | MMC_MODE_DDR_52MHz)));
+	mmc_destroy(mmc);
+
+	return 0;
+}
+
+/* A card that is powering up is identified in the background */
+static int mmc_test_async(struct dm_test_state *dms)
+{
+	struct mmc_config cfg;
+	struct mmc *mmc;
+	struct udevice *dev;
+	int polls;
+
+	emu_setup(&cfg, EMU_CAPS | MMC_MODE_8BIT, EXT_CSD_CARD_TYPE_52, false);
+	emu.busy = 6;
+	mmc = mmc_create(&cfg, &emu);
+	ut_assert(mmc);
+	dev = mmc->dev;
+	ut_assert(dev);
+
+	/* Probing sends the first two CMD1s, then leaves the card to it */
+	ut_assertok(device_probe_start(dev));
+	ut_asserteq(2, emu.op_conds);
+	ut_assert(dev->flags & DM_FLAG_PROBING);
+	ut_assert(!mmc->has_init);
+
+	/* Each poll sends one more CMD1, until the card is ready */
+	for (polls = 3; polls <= emu.busy; polls++) {
+		dm_probe_poll();
+		ut_asserteq(polls, emu.op_conds);
+		ut_assert(!device_active(dev));
+	}
+	ut_asserteq(0, emu.identified);
+	dm_probe_poll();
+	ut_assert(device_active(dev));
+	ut_assert(mmc->has_init);
+	ut_asserteq(1, emu.identified);
+	ut_asserteq(52000000, emu.clock);
+
+	/* Using the card now costs nothing */
+	ut_assertok(mmc_init(mmc));
+	ut_asserteq(emu.busy + 1, emu.op_conds);
+
+	/* A card that is initialized again is identified again */
+	mmc->has_init = 0;
+	emu.op_conds = 0;
+	ut_assertok(mmc_init(mmc));
+	ut_assert(device_active(dev));
+	ut_asserteq(2, emu.identified);
+
+	/* A card that never powers up fails its probe */
+	mmc->has_init = 0;
+	emu.op_conds = 0;
+	emu.busy = 1 << 30;
+	ut_asserteq(UNUSABLE_ERR, mmc_init(mmc));
+	ut_assert(!device_active(dev));
+	ut_assert(!(dev->flags & DM_FLAG_PROBING));
+	mmc_destroy(mmc);
+
+	return 0;
+}
+
+static int do_ut_mmc(cmd_tbl_t *cmdtp, int flag, int argc,
+		     char * const argv[])
+{
+	struct dm_test_state state, *dms = &state;
+
+	memset(dms, '\0', sizeof(*dms));
+	mmc_test_hs200(dms);
+	mmc_test_hs200_4bit(dms);
+	mmc_test_hs200_fail(dms);
+	mmc_test_ddr(dms);
+	mmc_test_sdr(dms);
+	mmc_test_async(dms);
+
+	printf("ut_mmc %s\n", dms->fail_count ? "FAILED" : "ok");
+
+	return dms->fail_count ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
+U_BOOT_CMD(
+	ut_mmc,	1,	1,	do_ut_mmc,
+	"Basic test of eMMC bus mode selection", ""
+);
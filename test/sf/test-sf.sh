@@ -0,0 +1,86 @@
+#!/bin/sh
+#
+# SPDX-License-Identifier:	GPL-2.0+
+#
+
+# Test SPI flash access above 16MiB with the sandbox flash emulator.
+# S25FL256S has commands with a 4-byte address, which it describes in its
+# SFDP; N25Q256 does not, so only its bank address register reaches the
+# upper half.
+
+BASE="$(dirname $0)/.."
+. $BASE/common.sh
+
+# Write across the 16MiB boundary, in the middle of a 128KiB erased area
+ERASE_START=0xff0000
+ERASE_SIZE=0x20000
+DATA_START=0xfff000
+DATA_SIZE=0x2000
+
+run_sf() {
+	echo "Run sf on $1"
+	./${OUTPUT_DIR}/u-boot --spi_sf 0:0:$1:${flash} <<END
+sf probe 0:0
+sf erase ${ERASE_START} ${ERASE_SIZE}
+mw.b 1000 5a ${DATA_SIZE}
+sf write 1000 ${DATA_START} ${DATA_SIZE}
+sf read 4000 ${DATA_START} ${DATA_SIZE}
+cmp.b 1000 4000 ${DATA_SIZE}
+reset
+END
+}
+
+# Count the bytes in a range of the flash file that do not have a value
+count_other() {
+	dd if=${flash} bs=4096 skip=$(($1 / 4096)) count=$(($2 / 4096)) \
+		2>/dev/null | od -An -v -tx1 | tr -s ' ' '\n' | \
+		grep -v -c -e "^$3\$" -e '^$'
+}
+
+check_results() {
+	echo "Check results for $1"
+
+	if ! grep -q "Detected $1" ${tmp}; then
+		fail "$1 not detected"
+	fi
+	if [ $(grep -c ": OK" ${tmp}) -ne 3 ]; then
+		fail "$1 erase, write or read error"
+	fi
+	if ! grep -q "Total of $((DATA_SIZE)) byte(s) were the same" ${tmp}; then
+		fail "$1 read back differs"
+	fi
+
+	# The data must be at the right place in the flash, not wrapped
+	# round to the bottom 16MiB
+	data_end=$((DATA_START + DATA_SIZE))
+	erase_end=$((ERASE_START + ERASE_SIZE))
+	if [ $(count_other ${DATA_START} ${DATA_SIZE} 5a) -ne 0 ]; then
+		fail "$1 data not written above 16MiB"
+	fi
+	if [ $(count_other ${ERASE_START} $((DATA_START - ERASE_START)) ff) \
+			-ne 0 ] || \
+	   [ $(count_other ${data_end} $((erase_end - data_end)) ff) \
+			-ne 0 ]; then
+		fail "$1 erase error"
+	fi
+	if [ $(count_other 0 ${ERASE_START} 00) -ne 0 ] || \
+	   [ $(count_other ${erase_end} $((0x2000000 - erase_end)) 00) \
+			-ne 0 ]; then
+		fail "$1 wrote outside the erased area"
+	fi
+}
+
+echo "SPI flash test across the 16MiB boundary using sandbox"
+echo
+tmp="$(mktemp)"
+flash="$(mktemp)"
+build_uboot
+for part in S25FL256S_64K N25Q256; do
+	# A fresh 32MiB flash of zeroes, so that erases show
+	rm -f ${flash}
+	dd if=/dev/zero of=${flash} bs=1M count=32 2>/dev/null
+	run_sf ${part} >${tmp}
+	check_results ${part}
+done
+rm ${tmp} ${flash}
+echo "Test passed"